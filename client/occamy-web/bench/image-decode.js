@@ -0,0 +1,323 @@
+/**
+ * Benchmark of the main-thread cost of drawing images received over "img"
+ * streams, comparing the Image element path, through which images were
+ * drawn from data URIs, with the Occamy.ImageDecoder path, through which
+ * images are decoded in a worker and drawn as ImageBitmaps.
+ *
+ * Both paths are driven through a real Occamy.Display. As Node provides no
+ * DOM or image codecs, the DOM is replaced by minimal stand-ins, and each
+ * "image" is zlib-compressed pixel data whose decoding, like that of a PNG,
+ * consists mostly of inflating it. An Image element parses its data URI
+ * when loaded and decodes its pixels when first drawn, both on the main
+ * thread, as browsers do for images drawn to a canvas. The ImageDecoder
+ * path runs its decoding in a worker thread.
+ *
+ * Usage, from client/occamy-web:
+ *
+ *     node bench/image-decode.js
+ *
+ * For each image size, the main-thread time per image is measured with
+ * performance.eventLoopUtilization(), alongside the wall-clock time taken
+ * for all images of a batch to be drawn.
+ */
+
+var perf_hooks = require("perf_hooks");
+var worker_threads = require("worker_threads");
+var zlib = require("zlib");
+
+/**
+ * The number of measured batches of each image size, of which the fastest
+ * is reported.
+ *
+ * @type {Number}
+ */
+var SAMPLES = 5;
+
+/**
+ * The image sizes to measure, each with the number of images drawn per
+ * batch.
+ *
+ * @type {Object[]}
+ */
+var SIZES = [
+    { width: 64,   height: 64,   count: 2000 },
+    { width: 256,  height: 256,  count: 400 },
+    { width: 1920, height: 1080, count: 20 }
+];
+
+/**
+ * Source of the worker decoding images for Occamy.ImageDecoder, replying
+ * with the dimensions of each image once its pixels have been inflated.
+ *
+ * @type {String}
+ */
+var WORKER_SOURCE = [
+    'var parentPort = require("worker_threads").parentPort;',
+    'var zlib = require("zlib");',
+    'parentPort.on("message", function(data) {',
+    '    var image = Buffer.from(data.buffer);',
+    '    zlib.inflateSync(image.subarray(8));',
+    '    parentPort.postMessage({ id: data.id, width: image.readUInt32BE(0),',
+    '            height: image.readUInt32BE(4) });',
+    '});'
+].join('\n');
+
+/**
+ * Returns a DOM element stand-in accepting any style, attribute, child or
+ * canvas operation used by Occamy.Display.
+ *
+ * @return {Object} The element stand-in.
+ */
+function element() {
+
+    var context = new Proxy({
+        drawImage: function(image) {
+            if (image.decode)
+                image.decode();
+        }
+    }, {
+        get: function(target, name) {
+            if (!(name in target))
+                target[name] = function() {};
+            return target[name];
+        }
+    });
+
+    return new Proxy({ style: {}, width: 0, height: 0 }, {
+        get: function(target, name) {
+            if (name === "getContext")
+                return function() { return context; };
+            if (!(name in target))
+                target[name] = function() {};
+            return target[name];
+        }
+    });
+
+}
+
+/**
+ * Image element stand-in, parsing its data URI when loaded and inflating
+ * its pixels when first drawn, both on the main thread.
+ *
+ * @constructor
+ */
+function Image() {
+
+    var image = this;
+    var data = null;
+
+    this.width = 0;
+    this.height = 0;
+
+    Object.defineProperty(this, "src", {
+        set: function(url) {
+            setImmediate(function load() {
+                data = Buffer.from(url.substring(url.indexOf(",") + 1),
+                        "base64");
+                image.width = data.readUInt32BE(0);
+                image.height = data.readUInt32BE(4);
+                image.onload();
+            });
+        }
+    });
+
+    this.decode = function() {
+        if (data) {
+            zlib.inflateSync(data.subarray(8));
+            data = null;
+        }
+    };
+
+}
+
+/**
+ * Worker stand-in for Occamy.ImageDecoder, decoding images within a Node
+ * worker thread. The source given by the decoder is replaced with
+ * WORKER_SOURCE, which decodes the stand-in image format.
+ *
+ * @constructor
+ */
+function Worker() {
+
+    var decoder = this;
+    var thread = new worker_threads.Worker(WORKER_SOURCE, { eval: true });
+    Worker.threads.push(thread);
+
+    thread.on("message", function(data) {
+        decoder.onmessage({ data: {
+            id: data.id,
+            bitmap: { width: data.width, height: data.height,
+                close: function() {} }
+        }});
+    });
+
+    this.postMessage = function(message) {
+        message.blob.arrayBuffer().then(function(buffer) {
+            thread.postMessage({ id: message.id, buffer: buffer }, [buffer]);
+        });
+    };
+
+    this.terminate = function() {
+        thread.terminate();
+    };
+
+}
+
+/**
+ * All worker threads started, which must be stopped for Node to exit.
+ *
+ * @type {Worker[]}
+ */
+Worker.threads = [];
+
+global.document = { createElement: element };
+global.Image = Image;
+
+var Occamy = require("../src/components/occamy.js");
+
+/**
+ * Returns a compressed image of the given dimensions in the stand-in image
+ * format: its width and height, followed by its deflated RGBA pixels. The
+ * pixels resemble a desktop of gradients and text, compressing roughly as
+ * a PNG of the same content would.
+ *
+ * @param {Number} width The width of the image.
+ * @param {Number} height The height of the image.
+ * @return {Buffer} The compressed image.
+ */
+function compressedImage(width, height) {
+
+    var pixels = Buffer.alloc(width * height * 4);
+    for (var y = 0; y < height; y++) {
+        for (var x = 0; x < width; x++) {
+            var offset = (y * width + x) * 4;
+            var text = (y % 16) < 10 && ((x * 7 + y * 13) ^ (x >> 3)) % 5 === 0;
+            pixels[offset]     = text ? 0x20 : (x * 255 / width) | 0;
+            pixels[offset + 1] = text ? 0x20 : (y * 255 / height) | 0;
+            pixels[offset + 2] = text ? 0x20 : 0x80;
+            pixels[offset + 3] = 0xFF;
+        }
+    }
+
+    var header = Buffer.alloc(8);
+    header.writeUInt32BE(width, 0);
+    header.writeUInt32BE(height, 4);
+    return Buffer.concat([header, zlib.deflateSync(pixels)]);
+
+}
+
+/**
+ * Draws the given number of copies of the given image to a new display
+ * through the given path, invoking the given callback with the main-thread
+ * and wall-clock time taken, in milliseconds, once all have been drawn.
+ *
+ * @param {String} path "image" to draw data URIs through Image elements, or
+ *                      "decoder" to draw blobs through Occamy.ImageDecoder.
+ * @param {Buffer} image The compressed image to draw.
+ * @param {Number} count The number of copies to draw.
+ * @param {Function} callback The function to invoke with the times taken.
+ */
+function drawBatch(path, image, count, callback) {
+
+    var display = new Occamy.Display();
+    var layer = display.getDefaultLayer();
+
+    var uri = "data:image/png;base64," + image.toString("base64");
+    var blob = new Blob([image], { type: "image/png" });
+
+    var utilization = perf_hooks.performance.eventLoopUtilization();
+    var start = perf_hooks.performance.now();
+
+    for (var i = 0; i < count; i++) {
+        if (path === "image")
+            display.draw(layer, 0, 0, uri);
+        else
+            display.drawBlob(layer, 0, 0, blob);
+    }
+
+    display.flush(function batchDrawn() {
+        var elapsed = perf_hooks.performance.now() - start;
+        var busy = perf_hooks.performance.eventLoopUtilization(utilization);
+        callback(busy.active, elapsed);
+    });
+
+}
+
+/**
+ * Measures drawing the given image size through the given path SAMPLES
+ * times, after one unmeasured batch, invoking the given callback with the
+ * fastest main-thread time per image and the wall-clock time of the same
+ * batch, in milliseconds.
+ *
+ * @param {String} path The path to draw through, as accepted by drawBatch().
+ * @param {Object} size The image size to measure.
+ * @param {Function} callback The function to invoke with the times taken.
+ */
+function measure(path, size, callback) {
+
+    var image = compressedImage(size.width, size.height);
+    var best = null;
+    var remaining = SAMPLES + 1;
+
+    (function next() {
+        drawBatch(path, image, size.count, function(busy, elapsed) {
+
+            if (remaining-- <= SAMPLES && (!best || busy < best.busy))
+                best = { busy: busy, elapsed: elapsed };
+
+            if (remaining > 0)
+                setImmediate(next);
+            else
+                callback(best.busy / size.count, best.elapsed);
+
+        });
+    })();
+
+}
+
+/**
+ * The paths to compare, each with the globals which select it within
+ * Occamy.Display.
+ *
+ * @type {Object[]}
+ */
+var paths = [
+    { name: "Image", path: "image", setup: function() {
+        delete global.createImageBitmap;
+        delete global.Worker;
+    }},
+    { name: "ImageDecoder", path: "decoder", setup: function() {
+        global.createImageBitmap = function() {
+            throw new Error("Images must be decoded by the worker.");
+        };
+        global.Worker = Worker;
+    }}
+];
+
+var runs = [];
+SIZES.forEach(function(size) {
+    paths.forEach(function(p) {
+        runs.push({ size: size, path: p });
+    });
+});
+
+(function next(index) {
+
+    if (index === runs.length) {
+        Worker.threads.forEach(function(thread) { thread.terminate(); });
+        return;
+    }
+
+    var run = runs[index];
+    run.path.setup();
+
+    measure(run.path.path, run.size, function(busy, elapsed) {
+        console.log((run.size.width + "x" + run.size.height + " ("
+                + run.path.name + ")").padEnd(28)
+                + busy.toFixed(3).padStart(9) + " ms/image main thread "
+                + elapsed.toFixed(1).padStart(9) + " ms/batch of "
+                + run.size.count);
+        next(index + 1);
+    });
+
+})(0);
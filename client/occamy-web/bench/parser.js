@@ -0,0 +1,209 @@
+/**
+ * Microbenchmark of Occamy.Parser, measuring the throughput of parsing
+ * instruction streams delivered in packets of various sizes, as received
+ * over the WebSocket tunnel.
+ *
+ * Usage, from client/occamy-web:
+ *
+ *     node bench/parser.js [BASELINE]
+ *
+ * If BASELINE is given, it is the path of another copy of occamy.js, such as
+ * an earlier revision extracted with "git show", whose parser is measured
+ * against the same streams for comparison.
+ */
+
+var path = require("path");
+
+/**
+ * The number of times each stream is parsed per measurement.
+ *
+ * @type {Number}
+ */
+var ROUNDS = 10;
+
+/**
+ * The number of measurements taken of each stream, of which the fastest is
+ * reported.
+ *
+ * @type {Number}
+ */
+var SAMPLES = 5;
+
+/**
+ * Returns a string consisting of the given number of base64 characters.
+ *
+ * @param {Number} length The length of the string to generate.
+ * @return {String} The generated string.
+ */
+function payload(length) {
+    var chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    var data = "";
+    for (var i = 0; i < length; i++)
+        data += chars.charAt((i * 7919) % chars.length);
+    return data;
+}
+
+/**
+ * Encodes the given opcode and arguments as a single instruction.
+ *
+ * @param {String} opcode The opcode of the instruction.
+ * @param {String[]} args The arguments of the instruction.
+ * @return {String} The encoded instruction.
+ */
+function instruction(opcode, args) {
+    var elements = [opcode].concat(args).map(function(element) {
+        return element.length + "." + element;
+    });
+    return elements.join(",") + ";";
+}
+
+/**
+ * Splits the given stream into packets of the given size. A size of zero
+ * delivers each instruction as its own packet.
+ *
+ * @param {String[]} instructions The encoded instructions of the stream.
+ * @param {Number} size The size of each packet, in characters.
+ * @return {String[]} The packets of the stream.
+ */
+function packetize(instructions, size) {
+
+    if (size === 0)
+        return instructions;
+
+    var stream = instructions.join("");
+    var packets = [];
+    for (var i = 0; i < stream.length; i += size)
+        packets.push(stream.substring(i, i + size));
+    return packets;
+
+}
+
+/**
+ * Builds the streams to parse: large blobs as sent for images and audio, and
+ * small instructions as sent for drawing and synchronization.
+ *
+ * @return {Object[]} The streams, each having a name, its packets, its total
+ *                    length and its number of instructions.
+ */
+function streams() {
+
+    var blob = payload(8192);
+    var blobs = [];
+    for (var i = 0; i < 512; i++)
+        blobs.push(instruction("blob", [String(i % 64), blob]));
+
+    var small = [];
+    for (var j = 0; j < 10000; j++) {
+        small.push(j % 2 === 0
+            ? instruction("sync", [String(1600000000000 + j)])
+            : instruction("copy", ["-1", "0", "0", "64", "64", "14", "0",
+                String(j % 1920), String(j % 1080)]));
+    }
+
+    var cases = [
+        { name: "8 KiB blobs, one per packet", instructions: blobs, size: 0 },
+        { name: "8 KiB blobs, 64 KiB packets", instructions: blobs, size: 65536 },
+        { name: "8 KiB blobs, 1000 B packets", instructions: blobs, size: 1000 },
+        { name: "small, one per packet", instructions: small, size: 0 },
+        { name: "small, 64 KiB packets", instructions: small, size: 65536 },
+        { name: "small, 7 B packets", instructions: small, size: 7 }
+    ];
+
+    return cases.map(function(c) {
+        var packets = packetize(c.instructions, c.size);
+        return {
+            name: c.name,
+            packets: packets,
+            length: packets.reduce(function(n, p) { return n + p.length; }, 0),
+            count: c.instructions.length
+        };
+    });
+
+}
+
+/**
+ * Parses the given stream with a new parser of the given implementation,
+ * returning the number of instructions parsed.
+ *
+ * @param {Function} Parser The parser constructor to use.
+ * @param {Object} stream The stream to parse.
+ * @return {Number} The number of instructions parsed.
+ */
+function parse(Parser, stream) {
+
+    var parser = new Parser();
+    var count = 0;
+    parser.oninstruction = function() { count++; };
+
+    for (var i = 0; i < stream.packets.length; i++)
+        parser.receive(stream.packets[i]);
+
+    if (count !== stream.count)
+        throw new Error(stream.name + ": parsed " + count
+                + " instructions, expected " + stream.count);
+
+    return count;
+
+}
+
+/**
+ * Measures parsing the given stream with the given implementation,
+ * returning the best time taken for ROUNDS passes, in seconds. Each pass
+ * uses a new parser, as each tunnel does. An initial unmeasured pass warms
+ * up the parser and flattens the packets.
+ *
+ * @param {Function} Parser The parser constructor to measure.
+ * @param {Object} stream The stream to parse.
+ * @return {Number} The fastest time taken, in seconds.
+ */
+function measure(Parser, stream) {
+
+    var best = Infinity;
+    parse(Parser, stream);
+
+    for (var sample = 0; sample < SAMPLES; sample++) {
+
+        var start = process.hrtime.bigint();
+        for (var round = 0; round < ROUNDS; round++)
+            parse(Parser, stream);
+
+        best = Math.min(best,
+                Number(process.hrtime.bigint() - start) / 1e9);
+
+    }
+
+    return best;
+
+}
+
+/**
+ * Formats the throughput of parsing the given stream in the given time.
+ *
+ * @param {Object} stream The stream parsed.
+ * @param {Number} elapsed The time taken for ROUNDS passes, in seconds.
+ * @return {String} The formatted throughput.
+ */
+function throughput(stream, elapsed) {
+    var mb = stream.length * ROUNDS / elapsed / 1e6;
+    var instructions = stream.count * ROUNDS / elapsed / 1e6;
+    return mb.toFixed(0).padStart(7) + " MB/s "
+        + instructions.toFixed(2).padStart(7) + " M instr/s";
+}
+
+var parsers = [
+    { name: "current", Parser: require("../src/components/occamy.js").Parser }
+];
+
+if (process.argv.length > 2) {
+    parsers.push({
+        name: "baseline",
+        Parser: require(path.resolve(process.argv[2])).Parser
+    });
+}
+
+streams().forEach(function(stream) {
+    parsers.forEach(function(p) {
+        console.log((stream.name + " (" + p.name + ")").padEnd(48)
+                + throughput(stream, measure(p.Parser, stream)));
+    });
+});
@@ -159,6 +159,371 @@ Occamy.ArrayBufferWriter = function(stream) {
  */
 Occamy.ArrayBufferWriter.DEFAULT_BLOB_LENGTH = 6048;
 
+/**
+ * A player which plays back audio received along the given input stream as
+ * IMA ADPCM, as sent by the Occamy server. Each received blob contains
+ * exactly one packet of audio. Packets are scheduled for playback through
+ * the Web Audio API behind an adaptive jitter buffer, such that variation in
+ * the arrival times of packets does not cause playback to stutter, while
+ * adding no more latency than that variation requires. Note that this object
+ * will overwrite any installed event handlers on the given
+ * Occamy.InputStream.
+ *
+ * @constructor
+ * @param {Occamy.InputStream} stream The stream that audio will be read
+ *                                       from.
+ * @param {String} mimetype The mimetype of the audio, including the "rate"
+ *                          and "channels" parameters describing its format.
+ */
+Occamy.AudioPlayer = function(stream, mimetype) {
+
+    /**
+     * Reference to this Occamy.AudioPlayer.
+     * @private
+     */
+    var guac_player = this;
+
+    /**
+     * The format of the received audio.
+     * @private
+     */
+    var format = Occamy.AudioPlayer.parseFormat(mimetype);
+
+    /**
+     * The Web Audio context through which audio is played.
+     * @private
+     */
+    var context = Occamy.AudioPlayer.getContext();
+
+    /**
+     * The context time at which the next packet should begin playing, in
+     * seconds.
+     * @private
+     */
+    var nextPacketTime = 0;
+
+    /**
+     * The local time at which the previous packet arrived, in milliseconds,
+     * or null if no packet has yet arrived.
+     * @private
+     */
+    var lastArrival = null;
+
+    /**
+     * The duration of the previous packet, in milliseconds.
+     * @private
+     */
+    var lastDuration = 0;
+
+    /**
+     * The smoothed variation in packet arrival times, in milliseconds,
+     * estimated as described by RFC 3550.
+     * @private
+     */
+    var jitter = 0;
+
+    /**
+     * The current state of the decoder for each channel.
+     * @private
+     */
+    var predictors = [];
+    var stepIndices = [];
+
+    /**
+     * The current amount of audio buffered ahead of playback, in seconds,
+     * which the player aims to maintain.
+     *
+     * @type {Number}
+     */
+    this.latency = Occamy.AudioPlayer.MIN_LATENCY;
+
+    /**
+     * Decodes the given packet of IMA ADPCM audio, returning an AudioBuffer
+     * containing the decoded audio.
+     *
+     * @private
+     * @param {ArrayBuffer} buffer The packet to decode.
+     * @returns {AudioBuffer} The decoded audio, or null if the packet is
+     *                        malformed.
+     */
+    function decode(buffer) {
+
+        var bytes = new Uint8Array(buffer);
+        var channels = format.channels;
+        var offset = Occamy.AudioPlayer.PACKET_HEADER_SIZE;
+
+        if (bytes.length < offset + channels * Occamy.AudioPlayer.CHANNEL_HEADER_SIZE)
+            return null;
+
+        var frames = bytes[0] | (bytes[1] << 8);
+
+        // Restore decoder state of each channel
+        for (var channel = 0; channel < channels; channel++) {
+            predictors[channel] = ((bytes[offset] | (bytes[offset + 1] << 8)) << 16) >> 16;
+            stepIndices[channel] = Math.min(bytes[offset + 2], 88);
+            offset += Occamy.AudioPlayer.CHANNEL_HEADER_SIZE;
+        }
+
+        var samples = frames * channels;
+        if (frames === 0 || bytes.length < offset + Math.ceil(samples / 2))
+            return null;
+
+        var audioBuffer = context.createBuffer(channels, frames, format.rate);
+        var data = [];
+        for (channel = 0; channel < channels; channel++)
+            data[channel] = audioBuffer.getChannelData(channel);
+
+        var stepTable = Occamy.AudioPlayer.STEP_TABLE;
+        var indexTable = Occamy.AudioPlayer.INDEX_TABLE;
+
+        for (var i = 0; i < samples; i++) {
+
+            var value = bytes[offset + (i >> 1)];
+            var code = (i & 1) ? (value >> 4) : (value & 0x0F);
+            channel = i % channels;
+
+            // Reconstruct sample exactly as predicted by the encoder
+            var step = stepTable[stepIndices[channel]];
+            var delta = step >> 3;
+            if (code & 4) delta += step;
+            if (code & 2) delta += step >> 1;
+            if (code & 1) delta += step >> 2;
+
+            var predictor = predictors[channel] + ((code & 8) ? -delta : delta);
+            predictors[channel] = Math.max(-32768, Math.min(32767, predictor));
+
+            stepIndices[channel] = Math.max(0, Math.min(88,
+                    stepIndices[channel] + indexTable[code]));
+
+            data[channel][(i / channels) | 0] = predictors[channel] / 32768;
+
+        }
+
+        return audioBuffer;
+
+    }
+
+    /**
+     * Updates the jitter estimate and target latency given the arrival of a
+     * packet of the given duration.
+     *
+     * @private
+     * @param {Number} duration The duration of the packet, in milliseconds.
+     */
+    function updateLatency(duration) {
+
+        var arrival = new Date().getTime();
+
+        if (lastArrival !== null) {
+            var deviation = Math.abs((arrival - lastArrival) - lastDuration);
+            jitter += (deviation - jitter) / 16;
+        }
+
+        lastArrival = arrival;
+        lastDuration = duration;
+
+        // Buffer enough to absorb typical variation in arrival times
+        guac_player.latency = Math.max(Occamy.AudioPlayer.MIN_LATENCY,
+                Math.min(Occamy.AudioPlayer.MAX_LATENCY,
+                    (duration + jitter * 4) / 1000));
+
+    }
+
+    /**
+     * Schedules the given decoded audio for playback immediately after any
+     * previously-scheduled audio.
+     *
+     * @private
+     * @param {AudioBuffer} audioBuffer The audio to play.
+     */
+    function schedule(audioBuffer) {
+
+        var now = context.currentTime;
+
+        // Rebuffer after underrun, rather than playing packets as they arrive
+        if (nextPacketTime < now)
+            nextPacketTime = now + guac_player.latency;
+
+        // Drop audio if far behind, such that latency does not accumulate
+        else if (nextPacketTime - now > guac_player.latency + Occamy.AudioPlayer.MAX_LATENCY)
+            return;
+
+        var source = context.createBufferSource();
+        source.buffer = audioBuffer;
+        source.connect(context.destination);
+        source.start(nextPacketTime);
+
+        nextPacketTime += audioBuffer.duration;
+
+    }
+
+    // Play each packet as it is received
+    var reader = new Occamy.ArrayBufferReader(stream);
+    reader.ondata = function playPacket(buffer) {
+
+        var audioBuffer = decode(buffer);
+        if (!audioBuffer)
+            return;
+
+        updateLatency(audioBuffer.duration * 1000);
+        schedule(audioBuffer);
+
+    };
+
+    // Allow any scheduled audio to finish playing
+    reader.onend = function streamEnded() {
+        if (guac_player.onend)
+            guac_player.onend();
+    };
+
+    /**
+     * Fired once the stream has ended and no further audio will be played.
+     * @event
+     */
+    this.onend = null;
+
+};
+
+/**
+ * The minimum amount of audio to buffer ahead of playback, in seconds.
+ *
+ * @constant
+ * @type {Number}
+ */
+Occamy.AudioPlayer.MIN_LATENCY = 0.04;
+
+/**
+ * The maximum amount of audio to buffer ahead of playback, in seconds.
+ *
+ * @constant
+ * @type {Number}
+ */
+Occamy.AudioPlayer.MAX_LATENCY = 0.3;
+
+/**
+ * The size of the header of each packet, in bytes, excluding the header of
+ * each channel.
+ *
+ * @constant
+ * @type {Number}
+ */
+Occamy.AudioPlayer.PACKET_HEADER_SIZE = 4;
+
+/**
+ * The size of the header describing the decoder state of each channel, in
+ * bytes.
+ *
+ * @constant
+ * @type {Number}
+ */
+Occamy.AudioPlayer.CHANNEL_HEADER_SIZE = 4;
+
+/**
+ * The IMA ADPCM step size table, indexed by step index.
+ *
+ * @constant
+ * @type {Number[]}
+ */
+Occamy.AudioPlayer.STEP_TABLE = [
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+];
+
+/**
+ * The adjustment made to the step index after each 4-bit code, indexed by
+ * that code.
+ *
+ * @constant
+ * @type {Number[]}
+ */
+Occamy.AudioPlayer.INDEX_TABLE = [
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+];
+
+/**
+ * The Web Audio context shared by all audio players, as browsers limit the
+ * number of contexts which may exist at once.
+ *
+ * @private
+ * @type {AudioContext}
+ */
+Occamy.AudioPlayer._context = null;
+
+/**
+ * Returns the Web Audio context shared by all audio players, creating it if
+ * necessary.
+ *
+ * @returns {AudioContext} The shared audio context, or null if the Web Audio
+ *                         API is not supported.
+ */
+Occamy.AudioPlayer.getContext = function getContext() {
+
+    var AudioContext = window.AudioContext || window.webkitAudioContext;
+    if (!AudioContext)
+        return null;
+
+    if (!Occamy.AudioPlayer._context)
+        Occamy.AudioPlayer._context = new AudioContext();
+
+    return Occamy.AudioPlayer._context;
+
+};
+
+/**
+ * Parses the given audio mimetype, returning the format it describes.
+ *
+ * @param {String} mimetype The mimetype to parse, such as
+ *                          "audio/x-ima-adpcm;rate=44100,channels=2".
+ * @returns {Object} An object having "rate" and "channels" properties, or
+ *                   null if the mimetype is not supported.
+ */
+Occamy.AudioPlayer.parseFormat = function parseFormat(mimetype) {
+
+    var parts = mimetype.split(';');
+    if (parts[0] !== 'audio/x-ima-adpcm' || parts.length < 2)
+        return null;
+
+    var format = {};
+    var parameters = parts[1].split(',');
+    for (var i = 0; i < parameters.length; i++) {
+        var pair = parameters[i].split('=');
+        format[pair[0]] = parseInt(pair[1]);
+    }
+
+    if (!(format.rate > 0) || !(format.channels > 0))
+        return null;
+
+    return format;
+
+};
+
+/**
+ * Returns a new Occamy.AudioPlayer for the given stream if the given
+ * mimetype is supported by this browser.
+ *
+ * @param {Occamy.InputStream} stream The stream that audio will be read
+ *                                       from.
+ * @param {String} mimetype The mimetype of the audio.
+ * @returns {Occamy.AudioPlayer} A new audio player, or null if the
+ *                                  mimetype is not supported.
+ */
+Occamy.AudioPlayer.getInstance = function getInstance(stream, mimetype) {
+
+    if (!Occamy.AudioPlayer.parseFormat(mimetype) || !Occamy.AudioPlayer.getContext())
+        return null;
+
+    return new Occamy.AudioPlayer(stream, mimetype);
+
+};
+
 /**
  * A reader which automatically handles the given input stream, assembling all
  * received blobs into a single blob by appending them to each other in order.
@@ -343,14 +708,21 @@ Occamy.BlobWriter = function BlobWriter(stream) {
     };
 
     /**
-     * Sends the contents of the given blob over the underlying stream.
+     * Sends the contents of the given blob over the underlying stream. If the
+     * server already holds the beginning of the blob, as reported for
+     * resumable uploads by
+     * [getResumeOffset()]{@link Occamy.BlobWriter.getResumeOffset}, only the
+     * remainder of the blob need be sent.
      *
      * @param {Blob} blob
      *     The blob to send.
+     *
+     * @param {Number} [start=0]
+     *     The offset within the blob at which sending should begin, in bytes.
      */
-    this.sendBlob = function sendBlob(blob) {
+    this.sendBlob = function sendBlob(blob, start) {
 
-        var offset = 0;
+        var offset = start || 0;
         var reader = new FileReader();
 
         /**
@@ -487,6 +859,33 @@ Occamy.BlobWriter = function BlobWriter(stream) {
 
 };
 
+/**
+ * Returns the offset at which a resumable upload should continue, as reported
+ * by the server within the acknowledgement of the upload stream. An upload is
+ * resumable if its mimetype declares a "transfer" parameter containing an ID
+ * which identifies the upload across reconnects, and a "length" parameter
+ * containing the total size of the file, such as
+ * "application/octet-stream;transfer=2f1c9a;length=1048576". Data preceding
+ * the returned offset is already held by the server and need not be sent
+ * again.
+ *
+ * @param {Occamy.Status} status
+ *     The status acknowledging the upload stream.
+ *
+ * @returns {Number}
+ *     The offset at which the upload should continue, in bytes, or zero if
+ *     the upload must be sent in its entirety.
+ */
+Occamy.BlobWriter.getResumeOffset = function getResumeOffset(status) {
+
+    var match = /^OK \(RESUME (\d+)\)$/.exec(status.message);
+    if (!match || status.isError())
+        return 0;
+
+    return parseInt(match[1], 10);
+
+};
+
 /**
  * Occamy protocol client. Given a {@link Occamy.Tunnel},
  * automatically handles incoming and outgoing Occamy instructions via the
@@ -733,6 +1132,23 @@ Occamy.Client = function(tunnel) {
 
     };
 
+    /**
+     * Sends the scale at which the display is currently rendered. Image
+     * updates may then be downscaled by the server to match, reducing the
+     * bandwidth used by clients viewing the display at reduced size.
+     * 
+     * @param {Number} scale The scale of the display, where 1 is actual size.
+     */
+    this.sendScale = function(scale) {
+
+        // Do not send requests if not connected
+        if (!isConnected())
+            return;
+
+        tunnel.sendMessage("scale", Math.max(1, Math.round(scale * 1000)));
+
+    };
+
     /**
      * Sends a key event having the given properties as if the user
      * pressed or released a key.
@@ -749,6 +1165,21 @@ Occamy.Client = function(tunnel) {
         tunnel.sendMessage("key", keysym, pressed);
     };
 
+    /**
+     * Sends the given text as if typed by the user, such as the result of an
+     * IME composition. The text is sent in its entirety within a single
+     * instruction.
+     * 
+     * @param {String} text The text to send.
+     */
+    this.sendText = function(text) {
+        // Do not send requests if not connected
+        if (!isConnected())
+            return;
+
+        tunnel.sendMessage("text", text);
+    };
+
 
     /**
      * Sends a mouse event having the properties provided by the given mouse
@@ -991,6 +1422,22 @@ Occamy.Client = function(tunnel) {
      */
     this.onerror = null;
 
+    /**
+     * Fired when an audio stream is created. The stream provided to this
+     * event handler will contain its own event handlers for received data.
+     * If no audio player is returned, a default Occamy.AudioPlayer is used
+     * if the mimetype is supported.
+     *
+     * @event
+     * @param {Occamy.InputStream} stream The stream that will receive audio
+     *                                       data from the server.
+     * @param {String} mimetype The mimetype of the audio which will be
+     *                          received.
+     * @return {Occamy.AudioPlayer} An object which will handle playback of
+     *                                 the stream, or null to use the default.
+     */
+    this.onaudio = null;
+
     /**
      * Fired when the clipboard of the remote client is changing.
      * 
@@ -1162,6 +1609,28 @@ Occamy.Client = function(tunnel) {
 
         },
 
+        "audio": function(parameters) {
+
+            var stream_index = parseInt(parameters[0]);
+            var mimetype = parameters[1];
+
+            // Create stream
+            var stream = streams[stream_index] = new Occamy.InputStream(guac_client, stream_index);
+
+            // Get player instance via callback, falling back to default
+            var audioPlayer = null;
+            if (guac_client.onaudio)
+                audioPlayer = guac_client.onaudio(stream, mimetype);
+
+            if (!audioPlayer)
+                audioPlayer = Occamy.AudioPlayer.getInstance(stream, mimetype);
+
+            // Ignore audio of unsupported types
+            if (!audioPlayer)
+                delete streams[stream_index];
+
+        },
+
         "blob": function(parameters) {
 
             // Get stream 
@@ -1374,14 +1843,41 @@ Occamy.Client = function(tunnel) {
             var x = parseInt(parameters[4]);
             var y = parseInt(parameters[5]);
 
+            // Destination dimensions are given only for downscaled images
+            var width = parameters.length > 7 ? parseInt(parameters[6]) : undefined;
+            var height = parameters.length > 7 ? parseInt(parameters[7]) : undefined;
+
             // Create stream
             var stream = streams[stream_index] = new Occamy.InputStream(guac_client, stream_index);
+
+            // Decode image off the main thread, if possible
+            if (Occamy.ImageDecoder.isSupported()) {
+
+                var buffers = [];
+                var bufferReader = new Occamy.ArrayBufferReader(stream);
+
+                // Accumulate image data
+                bufferReader.ondata = function receiveImageData(buffer) {
+                    buffers.push(buffer);
+                };
+
+                // Draw image when stream is complete
+                bufferReader.onend = function drawImageBlob() {
+                    display.setChannelMask(layer, channelMask);
+                    display.drawBlob(layer, x, y,
+                            new Blob(buffers, { 'type' : mimetype }), width, height);
+                };
+
+                return;
+
+            }
+
             var reader = new Occamy.DataURIReader(stream, mimetype);
 
             // Draw image when stream is complete
-            reader.onend = function drawImageBlob() {
+            reader.onend = function drawImageURI() {
                 display.setChannelMask(layer, channelMask);
-                display.draw(layer, x, y, reader.getURI());
+                display.draw(layer, x, y, reader.getURI(), width, height);
             };
 
         },
@@ -2299,7 +2795,9 @@ Occamy.Display = function() {
     /**
      * Draws the image contained within the specified Blob at the given
      * coordinates. The Blob specified must already be populated with image
-     * data.
+     * data. Where supported, the image is decoded off the main thread by
+     * {@link Occamy.ImageDecoder}, and this and any future operations will
+     * wait for decoding to finish.
      *
      * @param {Occamy.Layer} layer
      *     The layer to draw upon.
@@ -2312,8 +2810,41 @@ Occamy.Display = function() {
      *
      * @param {Blob} blob
      *     The Blob containing the image data to draw.
+     *
+     * @param {Number} [width]
+     *     The width of the destination rectangle, if the image should be
+     *     stretched to cover it.
+     *
+     * @param {Number} [height]
+     *     The height of the destination rectangle, if the image should be
+     *     stretched to cover it.
      */
-    this.drawBlob = function(layer, x, y, blob) {
+    this.drawBlob = function(layer, x, y, blob, width, height) {
+
+        // Decode off the main thread, if possible
+        if (Occamy.ImageDecoder.isSupported()) {
+
+            var bitmap = null;
+
+            // Draw and release the decoded image when ready
+            var decodeTask = scheduleTask(function __display_drawBitmap() {
+
+                // Draw the image only if it decoded without errors
+                if (bitmap) {
+                    layer.drawImage(x, y, bitmap, width, height);
+                    bitmap.close();
+                }
+
+            }, true);
+
+            Occamy.ImageDecoder.getInstance().decode(blob, function imageDecoded(decoded) {
+                bitmap = decoded;
+                decodeTask.unblock();
+            });
+
+            return;
+
+        }
 
         // Create URL for blob
         var url = URL.createObjectURL(blob);
@@ -2323,7 +2854,7 @@ Occamy.Display = function() {
 
             // Draw the image only if it loaded without errors
             if (image.width && image.height)
-                layer.drawImage(x, y, image);
+                layer.drawImage(x, y, image, width, height);
 
             // Blob URL no longer needed
             URL.revokeObjectURL(url);
@@ -2347,14 +2878,18 @@ Occamy.Display = function() {
      * @param {Number} x The destination X coordinate.
      * @param {Number} y The destination Y coordinate.
      * @param {String} url The URL of the image to draw.
+     * @param {Number} [width] The width of the destination rectangle, if the
+     *                         image should be stretched to cover it.
+     * @param {Number} [height] The height of the destination rectangle, if the
+     *                          image should be stretched to cover it.
      */
-    this.draw = function(layer, x, y, url) {
+    this.draw = function(layer, x, y, url, width, height) {
 
         var task = scheduleTask(function __display_draw() {
 
             // Draw the image only if it loaded without errors
             if (image.width && image.height)
-                layer.drawImage(x, y, image);
+                layer.drawImage(x, y, image, width, height);
 
         }, true);
 
@@ -3253,6 +3788,194 @@ Occamy.Display.VisibleLayer = function(width, height) {
  */
 Occamy.Display.VisibleLayer.__next_id = 0;
 
+/**
+ * Decoder which converts compressed images into ImageBitmaps without
+ * occupying the main thread. Where Web Workers are available, images are
+ * decoded by createImageBitmap() within a dedicated worker, with the
+ * resulting ImageBitmaps transferred back to the main thread for drawing.
+ * Otherwise, images are decoded by createImageBitmap() on the main thread,
+ * which still decodes asynchronously. A single decoder is shared by all
+ * displays, as obtained through
+ * [getInstance()]{@link Occamy.ImageDecoder.getInstance}.
+ *
+ * @constructor
+ */
+Occamy.ImageDecoder = function ImageDecoder() {
+
+    /**
+     * All decode requests which have been sent to the worker but not yet
+     * completed, indexed by request ID.
+     *
+     * @private
+     * @type {Object.<Number, Object>}
+     */
+    var pending = {};
+
+    /**
+     * The ID to assign to the next decode request sent to the worker.
+     *
+     * @private
+     * @type {Number}
+     */
+    var nextID = 0;
+
+    /**
+     * The worker decoding images, or null if images must be decoded on the
+     * main thread.
+     *
+     * @private
+     * @type {Worker}
+     */
+    var worker = null;
+
+    /**
+     * Decodes the given blob on the main thread, invoking the given callback
+     * with the resulting ImageBitmap, or null if decoding fails.
+     *
+     * @private
+     * @param {Blob} blob
+     *     The blob containing the image to decode.
+     *
+     * @param {function} callback
+     *     The function to invoke once decoding completes.
+     */
+    var decodeLocally = function decodeLocally(blob, callback) {
+        createImageBitmap(blob).then(callback, function decodeFailed() {
+            callback(null);
+        });
+    };
+
+    // Start worker, if possible (the worker may be refused, for example, by
+    // a content security policy which disallows blob URLs)
+    if (typeof Worker !== 'undefined') {
+
+        var source = [
+            'self.onmessage = function(e) {',
+            '    createImageBitmap(e.data.blob).then(function(bitmap) {',
+            '        self.postMessage({ id: e.data.id, bitmap: bitmap }, [bitmap]);',
+            '    }, function() {',
+            '        self.postMessage({ id: e.data.id, bitmap: null });',
+            '    });',
+            '};'
+        ].join('\n');
+
+        try {
+            var url = URL.createObjectURL(new Blob([source],
+                    { 'type' : 'application/javascript' }));
+            worker = new Worker(url);
+            URL.revokeObjectURL(url);
+        }
+        catch (e) {
+            worker = null;
+        }
+
+    }
+
+    if (worker) {
+
+        // Hand decoded images to their callbacks
+        worker.onmessage = function imageDecoded(e) {
+
+            var request = pending[e.data.id];
+            if (!request)
+                return;
+
+            delete pending[e.data.id];
+            request.callback(e.data.bitmap);
+
+        };
+
+        // If the worker fails, decode all further images on the main thread,
+        // including any images the worker had not yet decoded
+        worker.onerror = function workerFailed() {
+
+            worker.terminate();
+            worker = null;
+
+            var unfinished = pending;
+            pending = {};
+
+            for (var id in unfinished) {
+                var request = unfinished[id];
+                decodeLocally(request.blob, request.callback);
+            }
+
+        };
+
+    }
+
+    /**
+     * Decodes the image contained within the given blob, invoking the given
+     * callback once decoding completes. Callbacks are not necessarily
+     * invoked in the order that images were provided; callers requiring
+     * ordering must enforce it themselves, as
+     * [Occamy.Display]{@link Occamy.Display} does with its task queue.
+     *
+     * @param {Blob} blob
+     *     The blob containing the image to decode.
+     *
+     * @param {function} callback
+     *     The function to invoke with the decoded ImageBitmap, or with null
+     *     if the image could not be decoded. The ImageBitmap should be
+     *     closed once no longer needed.
+     */
+    this.decode = function decode(blob, callback) {
+
+        // Decode on the main thread if no worker is available
+        if (!worker) {
+            decodeLocally(blob, callback);
+            return;
+        }
+
+        var id = nextID++;
+        pending[id] = {
+            'blob'     : blob,
+            'callback' : callback
+        };
+
+        worker.postMessage({ 'id' : id, 'blob' : blob });
+
+    };
+
+};
+
+/**
+ * The decoder shared by all displays, or null if not yet created.
+ *
+ * @private
+ * @type {Occamy.ImageDecoder}
+ */
+Occamy.ImageDecoder.__instance = null;
+
+/**
+ * Returns whether images can be decoded by Occamy.ImageDecoder within this
+ * browser. If not, images must be decoded using Image elements on the main
+ * thread.
+ *
+ * @returns {Boolean}
+ *     true if Occamy.ImageDecoder is supported, false otherwise.
+ */
+Occamy.ImageDecoder.isSupported = function isSupported() {
+    return typeof createImageBitmap === 'function';
+};
+
+/**
+ * Returns the decoder shared by all displays, creating it if necessary.
+ * This function may only be called if
+ * [isSupported()]{@link Occamy.ImageDecoder.isSupported} returns true.
+ *
+ * @returns {Occamy.ImageDecoder}
+ *     The shared image decoder.
+ */
+Occamy.ImageDecoder.getInstance = function getInstance() {
+
+    if (!Occamy.ImageDecoder.__instance)
+        Occamy.ImageDecoder.__instance = new Occamy.ImageDecoder();
+
+    return Occamy.ImageDecoder.__instance;
+
+};
+
 /**
  * A hidden input field which attempts to keep itself focused at all times,
  * except when another input field has been intentionally focused, whether
@@ -3619,6 +4342,16 @@ Occamy.Keyboard = function Keyboard(element) {
      */
     this.onkeyup = null;
 
+    /**
+     * Fired whenever the user enters text, such as the result of an IME
+     * composition, within a field being listened to by this Occamy.Keyboard.
+     * If not set, the text is typed as individual key events.
+     *
+     * @event
+     * @param {String} text The text entered by the user.
+     */
+    this.ontext = null;
+
     /**
      * Set of known platform-specific or browser-specific quirks which must be
      * accounted for to properly interpret key events, even if the only way to
@@ -4422,6 +5155,10 @@ Occamy.Keyboard = function Keyboard(element) {
             var codepoint = str.codePointAt ? str.codePointAt(i) : str.charCodeAt(i);
             var keysym = keysym_from_charcode(codepoint);
 
+            // Skip low surrogate of characters outside the BMP
+            if (codepoint > 0xFFFF)
+                i++;
+
             // Press and release key for current character
             guac_keyboard.press(keysym);
             guac_keyboard.release(keysym);
@@ -4430,6 +5167,21 @@ Occamy.Keyboard = function Keyboard(element) {
 
     };
 
+    /**
+     * Sends the given text in its entirety via the ontext handler, if set,
+     * falling back to typing each character as a key press and release.
+     *
+     * @private
+     * @param {String} str
+     *     The text to send.
+     */
+    var sendText = function sendText(str) {
+        if (guac_keyboard.ontext)
+            guac_keyboard.ontext(str);
+        else
+            guac_keyboard.type(str);
+    };
+
     /**
      * Resets the state of this keyboard, releasing all keys, and firing keyup
      * events for each released key.
@@ -4844,15 +5596,15 @@ Occamy.Keyboard = function Keyboard(element) {
         var handleInput = function handleInput(e) {
 
             // Only intercept if handler set
-            if (!guac_keyboard.onkeydown && !guac_keyboard.onkeyup) return;
+            if (!guac_keyboard.onkeydown && !guac_keyboard.onkeyup && !guac_keyboard.ontext) return;
 
             // Ignore events which have already been handled
             if (!markEvent(e)) return;
 
-            // Type all content written
+            // Send all content written
             if (e.data && !e.isComposing) {
                 element.removeEventListener("compositionend", handleComposition, false);
-                guac_keyboard.type(e.data);
+                sendText(e.data);
             }
 
         };
@@ -4870,15 +5622,15 @@ Occamy.Keyboard = function Keyboard(element) {
         var handleComposition = function handleComposition(e) {
 
             // Only intercept if handler set
-            if (!guac_keyboard.onkeydown && !guac_keyboard.onkeyup) return;
+            if (!guac_keyboard.onkeydown && !guac_keyboard.onkeyup && !guac_keyboard.ontext) return;
 
             // Ignore events which have already been handled
             if (!markEvent(e)) return;
 
-            // Type all content written
+            // Send all composed content at once
             if (e.data) {
                 element.removeEventListener("input", handleInput, false);
-                guac_keyboard.type(e.data);
+                sendText(e.data);
             }
 
         };
@@ -5275,11 +6027,23 @@ Occamy.Layer = function(width, height) {
      * @param {Number} y The destination Y coordinate.
      * @param {Image} image The image to draw. Note that this is an Image
      *                      object - not a URL.
+     * @param {Number} [width] The width to stretch the image to, if other
+     *                         than its natural width.
+     * @param {Number} [height] The height to stretch the image to, if other
+     *                          than its natural height.
      */
-    this.drawImage = function(x, y, image) {
-        if (layer.autosize) fitRect(x, y, image.width, image.height);
-        context.drawImage(image, x, y);
+    this.drawImage = function(x, y, image, width, height) {
+
+        // Draw at natural size unless destination dimensions are given
+        if (width === undefined || height === undefined) {
+            width = image.width;
+            height = image.height;
+        }
+
+        if (layer.autosize) fitRect(x, y, width, height);
+        context.drawImage(image, x, y, width, height);
         empty = false;
+
     };
 
     /**
@@ -8147,7 +8911,11 @@ Occamy.OutputStream = function(client, index) {
 
 /**
  * Simple Occamy protocol parser that invokes an oninstruction event when
- * full instructions are available from data received via receive().
+ * full instructions are available from data received via receive(). Data is
+ * parsed incrementally: element lengths are scanned character by character,
+ * partially-received lengths and elements are resumed when further data is
+ * received rather than rescanned, and the array of instruction parameters is
+ * reused between instructions.
  * 
  * @constructor
  */
@@ -8160,113 +8928,187 @@ Occamy.Parser = function() {
     var parser = this;
 
     /**
-     * Current buffer of received data. This buffer grows until a full
-     * element is available. After a full element is available, that element
-     * is flushed into the element buffer.
+     * Current buffer of received data which has not yet been fully parsed.
+     * Data preceding startIndex has already been parsed.
      * 
      * @private
+     * @type {String}
      */
     var buffer = "";
 
     /**
-     * Buffer of all received, complete elements. After an entire instruction
-     * is read, this buffer is flushed, and a new instruction begins.
+     * Buffer of all received, complete parameters of the current
+     * instruction. This array is reused for each instruction, and thus must
+     * not be retained by instruction handlers beyond their invocation.
      * 
      * @private
+     * @type {String[]}
      */
     var element_buffer = [];
 
-    // The location of the last element's terminator
-    var element_end = -1;
+    /**
+     * The opcode of the current instruction, or null if the opcode has not
+     * yet been received.
+     *
+     * @private
+     * @type {String}
+     */
+    var opcode = null;
 
-    // Where to start the next length search or the next element
+    /**
+     * The index within the buffer at which parsing should continue.
+     *
+     * @private
+     * @type {Number}
+     */
     var start_index = 0;
 
+    /**
+     * The location of the terminator of the element currently being
+     * received, or -1 if the length of that element is still being parsed.
+     *
+     * @private
+     * @type {Number}
+     */
+    var element_end = -1;
+
+    /**
+     * The value of the digits of the current element length parsed thus far.
+     *
+     * @private
+     * @type {Number}
+     */
+    var element_length = 0;
+
+    /**
+     * Discards all received data and any partially-received instruction,
+     * throwing an Occamy.Parser.Error with the given message. Data received
+     * afterwards is parsed as the start of a new instruction.
+     *
+     * @private
+     * @param {String} message A human-readable description of the error.
+     * @throws {Occamy.Parser.Error} Always.
+     */
+    var fail = function fail(message) {
+
+        buffer = "";
+        start_index = 0;
+        element_end = -1;
+        element_length = 0;
+        opcode = null;
+        element_buffer.length = 0;
+
+        throw new Occamy.Parser.Error(message);
+
+    };
+
     /**
      * Appends the given instruction data packet to the internal buffer of
      * this Occamy.Parser, executing all completed instructions at
-     * the beginning of this buffer, if any.
+     * the beginning of this buffer, if any. If an instruction handler
+     * throws, the remaining instructions are still handled, and the first
+     * error thrown by a handler is rethrown once the packet is parsed.
      *
      * @param {String} packet The instruction data to receive.
+     * @throws {Occamy.Parser.Error} If the received data is malformed.
      */
     this.receive = function(packet) {
 
-        // Truncate buffer as necessary
-        if (start_index > 4096 && element_end >= start_index) {
+        var handler_error = null;
 
-            buffer = buffer.substring(start_index);
-
-            // Reset parse relative to truncation
-            element_end -= start_index;
+        // Avoid copying if all previous data has been parsed, as is the case
+        // if packets contain only whole instructions
+        if (start_index >= buffer.length) {
+            if (element_end !== -1)
+                element_end -= buffer.length;
+            buffer = packet;
             start_index = 0;
+        }
 
+        // Otherwise, discard parsed data and append the new packet
+        else {
+            if (element_end !== -1)
+                element_end -= start_index;
+            buffer = buffer.substring(start_index) + packet;
+            start_index = 0;
         }
 
-        // Append data to buffer
-        buffer += packet;
+        var length = buffer.length;
 
         // While search is within currently received data
-        while (element_end < buffer.length) {
+        while (start_index < length) {
 
-            // If we are waiting for element data
-            if (element_end >= start_index) {
+            // Parse length, one digit at a time
+            if (element_end === -1) {
 
-                // We now have enough data for the element. Parse.
-                var element = buffer.substring(start_index, element_end);
-                var terminator = buffer.substring(element_end, element_end+1);
-
-                // Add element to array
-                element_buffer.push(element);
+                var c = buffer.charCodeAt(start_index++);
 
-                // If last element, handle instruction
-                if (terminator == ";") {
+                // Continue parsing length until its terminating period
+                if (c !== 0x2E /* "." */) {
 
-                    // Get opcode
-                    var opcode = element_buffer.shift();
+                    if (c < 0x30 /* "0" */ || c > 0x39 /* "9" */)
+                        fail("Non-numeric character in element length.");
 
-                    // Call instruction handler.
-                    if (parser.oninstruction != null)
-                        parser.oninstruction(opcode, element_buffer);
-
-                    // Clear elements
-                    element_buffer.length = 0;
+                    element_length = element_length * 10 + c - 0x30;
+                    continue;
 
                 }
-                else if (terminator != ',')
-                    throw new Error("Illegal terminator.");
 
-                // Start searching for length at character after
-                // element terminator
-                start_index = element_end + 1;
+                // Calculate location of element terminator
+                element_end = start_index + element_length;
+                element_length = 0;
 
             }
 
-            // Search for end of length
-            var length_end = buffer.indexOf(".", start_index);
-            if (length_end != -1) {
+            // Wait for entire element and its terminator to be received
+            if (element_end >= length)
+                break;
 
-                // Parse length
-                var length = parseInt(buffer.substring(element_end+1, length_end));
-                if (isNaN(length))
-                    throw new Error("Non-numeric character in element length.");
+            // We now have enough data for the element. Parse.
+            var element = buffer.substring(start_index, element_end);
+            var terminator = buffer.charCodeAt(element_end);
 
-                // Calculate start of element
-                start_index = length_end + 1;
+            // First element of each instruction is its opcode
+            if (opcode === null)
+                opcode = element;
+            else
+                element_buffer.push(element);
 
-                // Calculate location of element terminator
-                element_end = start_index + length;
+            // Start searching for length at character after element
+            // terminator
+            start_index = element_end + 1;
+            element_end = -1;
+
+            // If last element, handle instruction
+            if (terminator === 0x3B /* ";" */) {
+
+                var instruction_opcode = opcode;
+                opcode = null;
+
+                // Call instruction handler, deferring any error it throws
+                // until the rest of the packet is parsed
+                if (parser.oninstruction != null) {
+                    try {
+                        parser.oninstruction(instruction_opcode, element_buffer);
+                    }
+                    catch (e) {
+                        if (handler_error === null)
+                            handler_error = e;
+                    }
+                }
+
+                // Clear elements
+                element_buffer.length = 0;
 
             }
-            
-            // If no period yet, continue search when more data
-            // is received
-            else {
-                start_index = buffer.length;
-                break;
-            }
+            else if (terminator !== 0x2C /* "," */)
+                fail("Illegal terminator.");
 
         } // end parse loop
 
+        if (handler_error !== null)
+            throw handler_error;
+
     };
 
     /**
@@ -8281,6 +9123,22 @@ Occamy.Parser = function() {
 
 };
 
+/**
+ * An error thrown by Occamy.Parser when received data is not valid
+ * Occamy protocol data. Errors thrown by instruction handlers are never
+ * of this type.
+ *
+ * @constructor
+ * @augments Error
+ * @param {String} message A human-readable description of the error.
+ */
+Occamy.Parser.Error = function(message) {
+    this.name = "Occamy.Parser.Error";
+    this.message = message;
+};
+
+Occamy.Parser.Error.prototype = new Error();
+
 /**
  * A Occamy status. Each Occamy status consists of a status code, defined
  * by the protocol, and an optional human-readable message, usually only
@@ -9137,76 +9995,47 @@ Occamy.WebSocketTunnel = function(tunnelURL) {
             close_tunnel(new Occamy.Status(Occamy.Status.Code.SERVER_ERROR, event.data));
         };
 
-        socket.onmessage = function(event) {
-
-            reset_timeout();
-
-            var message = event.data;
-            var startIndex = 0;
-            var elementEnd;
-
-            var elements = [];
-
-            do {
-
-                // Search for end of length
-                var lengthEnd = message.indexOf(".", startIndex);
-                if (lengthEnd !== -1) {
-
-                    // Parse length
-                    var length = parseInt(message.substring(elementEnd+1, lengthEnd));
+        // Parse received data incrementally, such that instructions may
+        // span messages
+        var parser = new Occamy.Parser();
 
-                    // Calculate start of element
-                    startIndex = lengthEnd + 1;
+        parser.oninstruction = function(opcode, elements) {
 
-                    // Calculate location of element terminator
-                    elementEnd = startIndex + length;
+            // Update state and UUID when first instruction received
+            if (tunnel.state !== Occamy.Tunnel.State.OPEN) {
 
-                }
-                
-                // If no period, incomplete instruction.
-                else
-                    close_tunnel(new Occamy.Status(Occamy.Status.Code.SERVER_ERROR, "Incomplete instruction."));
-
-                // We now have enough data for the element. Parse.
-                var element = message.substring(startIndex, elementEnd);
-                var terminator = message.substring(elementEnd, elementEnd+1);
+                // Associate tunnel UUID if received
+                if (opcode === Occamy.Tunnel.INTERNAL_DATA_OPCODE)
+                    tunnel.uuid = elements[0];
 
-                // Add element to array
-                elements.push(element);
+                // Tunnel is now open and UUID is available
+                tunnel.setState(Occamy.Tunnel.State.OPEN);
 
-                // If last element, handle instruction
-                if (terminator === ";") {
-
-                    // Get opcode
-                    var opcode = elements.shift();
-
-                    // Update state and UUID when first instruction received
-                    if (tunnel.state !== Occamy.Tunnel.State.OPEN) {
+            }
 
-                        // Associate tunnel UUID if received
-                        if (opcode === Occamy.Tunnel.INTERNAL_DATA_OPCODE)
-                            tunnel.uuid = elements[0];
+            // Call instruction handler.
+            if (opcode !== Occamy.Tunnel.INTERNAL_DATA_OPCODE && tunnel.oninstruction)
+                tunnel.oninstruction(opcode, elements);
 
-                        // Tunnel is now open and UUID is available
-                        tunnel.setState(Occamy.Tunnel.State.OPEN);
+        };
 
-                    }
+        socket.onmessage = function(event) {
 
-                    // Call instruction handler.
-                    if (opcode !== Occamy.Tunnel.INTERNAL_DATA_OPCODE && tunnel.oninstruction)
-                        tunnel.oninstruction(opcode, elements);
+            reset_timeout();
 
-                    // Clear elements
-                    elements.length = 0;
+            try {
+                parser.receive(event.data);
+            }
+            catch (e) {
 
-                }
+                // Errors thrown by instruction handlers are not the fault of
+                // the server, and must not close the tunnel
+                if (!(e instanceof Occamy.Parser.Error))
+                    throw e;
 
-                // Start searching for length at character after
-                // element terminator
-                startIndex = elementEnd + 1;
+                close_tunnel(new Occamy.Status(Occamy.Status.Code.SERVER_ERROR, e.message));
 
-            } while (startIndex < message.length);
+            }
 
         };
 
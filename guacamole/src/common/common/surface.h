@@ -58,6 +58,27 @@ typedef struct guac_common_rect {
 
 } guac_common_rect;
 
+/**
+ * Initialize the given rect with the given coordinates and dimensions.
+ *
+ * @param rect The rect to initialize.
+ * @param x The X coordinate of the upper-left corner of the rect.
+ * @param y The Y coordinate of the upper-left corner of the rect.
+ * @param width The width of the rect.
+ * @param height The height of the rect.
+ */
+void guac_common_rect_init(guac_common_rect* rect, int x, int y, int width, int height);
+
+/**
+ * Collapse the given rect such that it exists only within the given maximum
+ * rect. If the rects do not intersect, the resulting width or height will be
+ * zero or negative.
+ *
+ * @param rect The rect to collapse.
+ * @param max The maximum area in which the given rect can exist.
+ */
+void guac_common_rect_constrain(guac_common_rect* rect, const guac_common_rect* max);
+
 /**
  * The maximum number of updates to allow within the bitmap queue.
  */
@@ -106,8 +127,125 @@ typedef struct guac_common_surface_heat_cell {
      */
     int oldest_entry;
 
+    /**
+     * Whether every pixel within the region of the surface associated with
+     * this cell is known to be fully opaque. If zero, the opacity of that
+     * region is unknown and must be determined by inspecting its pixels.
+     */
+    int opaque;
+
 } guac_common_surface_heat_cell;
 
+/**
+ * The minimum framerate, in frames per second, of any region of a surface
+ * considered actively updated, rather than static.
+ */
+#define GUAC_COMMON_SURFACE_ACTIVE_FRAMERATE 5
+
+/**
+ * The minimum framerate, in frames per second, of any region of a surface
+ * considered to contain video-like content.
+ */
+#define GUAC_COMMON_SURFACE_VIDEO_FRAMERATE 20
+
+/**
+ * Classes of surface content for which the cost of encoding and sending
+ * updates is modeled separately. Content is classified by the framerate of the
+ * region being updated, as recorded within the surface heat map.
+ */
+typedef enum guac_common_surface_cost_class {
+
+    /**
+     * Content which is rarely updated, such as application windows and
+     * dialogs, having a framerate below GUAC_COMMON_SURFACE_ACTIVE_FRAMERATE.
+     */
+    GUAC_COMMON_SURFACE_COST_STATIC,
+
+    /**
+     * Content which is updated regularly, such as scrolling text or animated
+     * UI, having a framerate below GUAC_COMMON_SURFACE_VIDEO_FRAMERATE.
+     */
+    GUAC_COMMON_SURFACE_COST_ACTIVE,
+
+    /**
+     * Content which is updated continuously, such as video playback, having
+     * a framerate of at least GUAC_COMMON_SURFACE_VIDEO_FRAMERATE.
+     */
+    GUAC_COMMON_SURFACE_COST_VIDEO
+
+} guac_common_surface_cost_class;
+
+/**
+ * The number of distinct values of guac_common_surface_cost_class.
+ */
+#define GUAC_COMMON_SURFACE_COST_CLASSES 3
+
+/**
+ * A linear model of the cost of flushing an update of a given area, calibrated
+ * from the bytes sent and time spent flushing past updates. The cost of an
+ * update of N pixels is estimated as base_cost + N * pixel_cost, where both
+ * coefficients are fitted by least squares over recent samples, with older
+ * samples weighted exponentially less than newer samples. Costs are measured
+ * in bytes, with time spent encoding converted to an equivalent number of
+ * bytes.
+ */
+typedef struct guac_common_surface_cost_model {
+
+    /**
+     * The total number of samples recorded by this model.
+     */
+    int samples;
+
+    /**
+     * The sum of the weights of all recorded samples.
+     */
+    double weight;
+
+    /**
+     * The weighted sum of the areas, in pixels, of all recorded samples.
+     */
+    double sum_area;
+
+    /**
+     * The weighted sum of the costs of all recorded samples.
+     */
+    double sum_cost;
+
+    /**
+     * The weighted sum of the squares of the areas of all recorded samples.
+     */
+    double sum_area_squared;
+
+    /**
+     * The weighted sum of the products of the area and cost of all recorded
+     * samples.
+     */
+    double sum_area_cost;
+
+    /**
+     * The estimated fixed cost of each update, regardless of its area.
+     */
+    double base_cost;
+
+    /**
+     * The estimated cost of each pixel within an update.
+     */
+    double pixel_cost;
+
+    /**
+     * The average number of bytes sent per pixel of recent updates, for
+     * inspection only.
+     */
+    double bytes_per_pixel;
+
+    /**
+     * The average number of microseconds spent encoding and sending each pixel
+     * of recent updates, for inspection only.
+     */
+    double usecs_per_pixel;
+
+} guac_common_surface_cost_model;
+
 /**
  * Representation of a bitmap update, having a rectangle of image data (stored
  * elsewhere) and a flushed/not-flushed state.
@@ -228,6 +366,25 @@ typedef struct guac_common_surface {
      */
     int realized;
 
+    /**
+     * Non-zero if this surface exists only within guacd, with no counterpart
+     * on any client. Updates to local surfaces are never encoded or sent;
+     * they are only tracked as damage.
+     */
+    int local;
+
+    /**
+     * Non-zero if any part of this surface has been modified since damage
+     * was last retrieved with guac_common_surface_take_damage(), 0 otherwise.
+     */
+    int damaged;
+
+    /**
+     * The rectangle covering all parts of this surface modified since damage
+     * was last retrieved. This is only valid if damaged is non-zero.
+     */
+    guac_common_rect damage_rect;
+
     /**
      * Whether drawing operations are currently clipped by the clipping
      * rectangle.
@@ -255,6 +412,12 @@ typedef struct guac_common_surface {
      */
     guac_common_surface_heat_cell* heat_map;
 
+    /**
+     * Models of the cost of flushing updates to this surface, one for each
+     * class of content, as defined by guac_common_surface_cost_class.
+     */
+    guac_common_surface_cost_model cost_models[GUAC_COMMON_SURFACE_COST_CLASSES];
+
     /**
      * Mutex which is locked internally when access to the surface must be
      * synchronized. All public functions of guac_common_surface should be
@@ -288,6 +451,27 @@ typedef struct guac_common_surface {
 guac_common_surface* guac_common_surface_alloc(guac_client* client,
         guac_socket* socket, const guac_layer* layer, int w, int h);
 
+/**
+ * Allocates a new guac_common_surface which exists only within guacd. The
+ * contents of a local surface are never sent to any client, but may be read
+ * through its buffer and drawn to other surfaces, using the damage reported by
+ * guac_common_surface_take_damage() to limit the area considered.
+ *
+ * @param client
+ *     The client associated with the new surface.
+ *
+ * @param w
+ *     The width of the surface.
+ *
+ * @param h
+ *     The height of the surface.
+ *
+ * @return
+ *     A newly-allocated local guac_common_surface.
+ */
+guac_common_surface* guac_common_surface_alloc_local(guac_client* client,
+        int w, int h);
+
 /**
  * Frees the given guac_common_surface. Beware that this will NOT free any
  * associated layers, which must be freed manually.
@@ -497,6 +681,25 @@ void guac_common_surface_set_opacity(guac_common_surface* surface, int opacity);
  */
 void guac_common_surface_flush(guac_common_surface* surface);
 
+/**
+ * Retrieves and clears the damage of the given surface, the rectangle
+ * covering every part of the surface modified since the last call to this
+ * function.
+ *
+ * @param surface
+ *     The surface whose damage should be retrieved.
+ *
+ * @param rect
+ *     The rectangle to populate with the bounds of the damaged area. This is
+ *     left untouched if the surface has not been damaged.
+ *
+ * @return
+ *     Non-zero if the surface has been damaged, zero otherwise.
+ */
+int guac_common_surface_take_damage(guac_common_surface* surface,
+        guac_common_rect* rect);
+
+
 /**
  * Duplicates the contents of the current surface to the given socket. Pending
  * changes are not flushed.
@@ -26,12 +26,18 @@
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
 #include <guacamole/timestamp.h>
+#include <guacamole/trace.h>
 #include <guacamole/user.h>
 
 #include <pthread.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/time.h>
+
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#endif
 
 /**
  * Initialize the given rect with the given coordinates and dimensions.
@@ -133,12 +139,42 @@ void guac_common_rect_constrain(guac_common_rect* rect, const guac_common_rect*
 #define GUAC_SURFACE_DATA_FACTOR 16
 
 /**
- * The base cost of every update. Each update should be considered to have
- * this starting cost, plus any additional cost estimated from its
- * content.
+ * The base cost of every update, assumed until the cost model for the content
+ * being updated has been calibrated. Each update should be considered to have
+ * this starting cost, plus any additional cost estimated from its content.
  */
 #define GUAC_SURFACE_BASE_COST 4096
 
+/**
+ * The cost of each pixel of every update, assumed until the cost model for
+ * the content being updated has been calibrated.
+ */
+#define GUAC_SURFACE_PIXEL_COST 1
+
+/**
+ * The number of bytes considered equivalent in cost to one microsecond spent
+ * encoding an update.
+ */
+#define GUAC_SURFACE_USEC_COST 4
+
+/**
+ * The factor by which the weight of all past samples within a cost model is
+ * reduced each time a new sample is recorded.
+ */
+#define GUAC_SURFACE_COST_DECAY 0.98
+
+/**
+ * The number of samples which must be recorded by a cost model before its
+ * estimates replace the default costs.
+ */
+#define GUAC_SURFACE_COST_MIN_SAMPLES 16
+
+/**
+ * The number of samples recorded by a cost model between each log message
+ * describing its current calibration.
+ */
+#define GUAC_SURFACE_COST_LOG_INTERVAL 1024
+
 /**
  * An increase in cost is negligible if it is less than
  * 1/GUAC_SURFACE_NEGLIGIBLE_INCREASE of the old cost.
@@ -265,9 +301,234 @@ static void __guac_common_clip_rect(guac_common_surface* surface,
 
 }
 
+/**
+ * Retrieves the rectangle covered by the heat map cell at the given cell
+ * coordinates, constrained within the bounds of the given surface.
+ *
+ * @param surface
+ *     The surface containing the heat map cell.
+ *
+ * @param x
+ *     The X coordinate of the heat map cell, in cells.
+ *
+ * @param y
+ *     The Y coordinate of the heat map cell, in cells.
+ *
+ * @param cell_rect
+ *     The rectangle to populate with the region covered by the cell.
+ */
+static void __guac_common_surface_get_cell_rect(guac_common_surface* surface,
+        int x, int y, guac_common_rect* cell_rect) {
+
+    guac_common_rect bounds;
+    guac_common_rect_init(&bounds, 0, 0, surface->width, surface->height);
+
+    guac_common_rect_init(cell_rect,
+            x * GUAC_COMMON_SURFACE_HEAT_CELL_SIZE,
+            y * GUAC_COMMON_SURFACE_HEAT_CELL_SIZE,
+            GUAC_COMMON_SURFACE_HEAT_CELL_SIZE,
+            GUAC_COMMON_SURFACE_HEAT_CELL_SIZE);
+
+    guac_common_rect_constrain(cell_rect, &bounds);
+
+}
+
+/**
+ * Records that all pixels within the given rectangle have been made fully
+ * opaque. Each heat map cell which is entirely covered by the rectangle is
+ * marked as opaque. Cells only partially covered are left unchanged, as the
+ * opacity of the remainder of those cells is not affected.
+ *
+ * @param surface
+ *     The surface whose pixels have been made opaque.
+ *
+ * @param rect
+ *     The rectangle containing the pixels which have been made opaque. This
+ *     rectangle must be within the bounds of the surface.
+ */
+static void __guac_common_surface_mark_opaque(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    int x, y;
+
+    int heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(surface->width);
+
+    if (rect->width <= 0 || rect->height <= 0)
+        return;
+
+    /* Calculate range of heat map cells intersecting given rect */
+    int min_x = rect->x / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int min_y = rect->y / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_x = (rect->x + rect->width  - 1) / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_y = (rect->y + rect->height - 1) / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    for (y = min_y; y <= max_y; y++) {
+
+        guac_common_surface_heat_cell* heat_cell =
+            surface->heat_map + y * heat_width + min_x;
+
+        for (x = min_x; x <= max_x; x++) {
+
+            guac_common_rect cell_rect;
+            __guac_common_surface_get_cell_rect(surface, x, y, &cell_rect);
+
+            /* Mark cell opaque only if wholly covered */
+            if (rect->x <= cell_rect.x && rect->y <= cell_rect.y
+                    && rect->x + rect->width  >= cell_rect.x + cell_rect.width
+                    && rect->y + rect->height >= cell_rect.y + cell_rect.height)
+                heat_cell->opaque = 1;
+
+            heat_cell++;
+
+        }
+
+    }
+
+}
+
+/**
+ * Records that pixels within the given rectangle may no longer be fully
+ * opaque. Each heat map cell which intersects the rectangle is marked as
+ * having unknown opacity.
+ *
+ * @param surface
+ *     The surface whose pixels may no longer be opaque.
+ *
+ * @param rect
+ *     The rectangle containing the pixels which may no longer be opaque. This
+ *     rectangle must be within the bounds of the surface.
+ */
+static void __guac_common_surface_clear_opaque(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    int x, y;
+
+    int heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(surface->width);
+
+    if (rect->width <= 0 || rect->height <= 0)
+        return;
+
+    /* Calculate range of heat map cells intersecting given rect */
+    int min_x = rect->x / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int min_y = rect->y / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_x = (rect->x + rect->width  - 1) / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_y = (rect->y + rect->height - 1) / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    for (y = min_y; y <= max_y; y++) {
+
+        guac_common_surface_heat_cell* heat_cell =
+            surface->heat_map + y * heat_width + min_x;
+
+        for (x = min_x; x <= max_x; x++)
+            (heat_cell++)->opaque = 0;
+
+    }
+
+}
+
+/**
+ * Returns whether all heat map cells intersecting the given rectangle are
+ * already known to be opaque. Pixel data is not inspected.
+ *
+ * @param surface
+ *     The surface to check.
+ *
+ * @param rect
+ *     The rectangle to check. This rectangle must be within the bounds of the
+ *     surface.
+ *
+ * @return
+ *     Non-zero if the rectangle is known to contain only fully opaque pixels,
+ *     zero if its opacity is unknown.
+ */
+static int __guac_common_surface_is_known_opaque(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    int x, y;
+
+    int heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(surface->width);
+
+    if (rect->width <= 0 || rect->height <= 0)
+        return 1;
+
+    /* Calculate range of heat map cells intersecting given rect */
+    int min_x = rect->x / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int min_y = rect->y / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_x = (rect->x + rect->width  - 1) / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_y = (rect->y + rect->height - 1) / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    for (y = min_y; y <= max_y; y++) {
+
+        guac_common_surface_heat_cell* heat_cell =
+            surface->heat_map + y * heat_width + min_x;
+
+        for (x = min_x; x <= max_x; x++) {
+            if (!(heat_cell++)->opaque)
+                return 0;
+        }
+
+    }
+
+    return 1;
+
+}
+
+/**
+ * Returns whether a rectangle within the given surface buffer contains only
+ * fully opaque pixels, inspecting every pixel. The alpha components of each
+ * row are combined without branching, allowing the compiler to vectorize the
+ * inner loop.
+ *
+ * @param buffer
+ *     The address of the upper-left pixel of the rectangle.
+ *
+ * @param stride
+ *     The number of bytes in each row of the buffer.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ *
+ * @return
+ *     Non-zero if the rectangle contains only fully opaque pixels, zero
+ *     otherwise.
+ */
+static int __guac_common_surface_scan_opaque(const unsigned char* buffer,
+        int stride, int width, int height) {
+
+    int x, y;
+
+    /* For each row */
+    for (y = 0; y < height; y++) {
+
+        const uint32_t* current = (const uint32_t*) buffer;
+        uint32_t alpha = 0xFF000000;
+
+        /* Combine alpha of all pixels in row */
+        for (x = 0; x < width; x++)
+            alpha &= current[x];
+
+        /* Rectangle is non-opaque if a single non-opaque pixel is found */
+        if (alpha != 0xFF000000)
+            return 0;
+
+        /* Next row */
+        buffer += stride;
+
+    }
+
+    /* Rectangle is opaque */
+    return 1;
+
+}
+
 /**
  * Returns whether a rectangle within the given surface contains only fully
- * opaque pixels.
+ * opaque pixels. Pixels are inspected only within heat map cells not already
+ * known to be opaque, and any cell found to be entirely opaque is marked as
+ * such, avoiding the need to inspect its pixels again.
  *
  * @param surface
  *     The surface to check.
@@ -284,26 +545,48 @@ static int __guac_common_surface_is_opaque(guac_common_surface* surface,
 
     int x, y;
 
-    int stride = surface ->stride;
-    unsigned char* buffer =
-        surface->buffer + (stride * rect->y) + (4 * rect->x);
+    int heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(surface->width);
 
-    /* For each row */
-    for (y = 0; y < rect->height; y++) {
+    if (rect->width <= 0 || rect->height <= 0)
+        return 1;
 
-        /* Search for a non-opaque pixel */
-        uint32_t* current = (uint32_t*) buffer;
-        for (x=0; x < rect->width; x++) {
+    /* Calculate range of heat map cells intersecting given rect */
+    int min_x = rect->x / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int min_y = rect->y / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_x = (rect->x + rect->width  - 1) / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_y = (rect->y + rect->height - 1) / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    for (y = min_y; y <= max_y; y++) {
+
+        guac_common_surface_heat_cell* heat_cell =
+            surface->heat_map + y * heat_width + min_x;
+
+        for (x = min_x; x <= max_x; x++, heat_cell++) {
 
-            /* Rectangle is non-opaque if a single non-opaque pixel is found */
-            uint32_t color = *(current++);
-            if ((color & 0xFF000000) != 0xFF000000)
+            /* Skip cells already known to be opaque */
+            if (heat_cell->opaque)
+                continue;
+
+            guac_common_rect cell_rect;
+            __guac_common_surface_get_cell_rect(surface, x, y, &cell_rect);
+
+            /* Inspect only the portion of the cell within the rectangle */
+            guac_common_rect scan_rect = cell_rect;
+            guac_common_rect_constrain(&scan_rect, rect);
+
+            const unsigned char* buffer = surface->buffer
+                + surface->stride * scan_rect.y + 4 * scan_rect.x;
+
+            if (!__guac_common_surface_scan_opaque(buffer, surface->stride,
+                        scan_rect.width, scan_rect.height))
                 return 0;
 
-        }
+            /* Remember result if entire cell was inspected */
+            if (scan_rect.width == cell_rect.width
+                    && scan_rect.height == cell_rect.height)
+                heat_cell->opaque = 1;
 
-        /* Next row */
-        buffer += stride;
+        }
 
     }
 
@@ -313,6 +596,272 @@ static int __guac_common_surface_is_opaque(guac_common_surface* surface,
 }
 
 
+/**
+ * Returns the current time in microseconds, relative to an arbitrary point in
+ * the past. This value is intended only for measuring short durations.
+ *
+ * @return
+ *     The current time in microseconds.
+ */
+static uint64_t __guac_common_surface_current_usecs() {
+
+#ifdef HAVE_CLOCK_GETTIME
+
+    struct timespec current;
+
+    /* Get current time, monotonically increasing */
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &current);
+#else
+    clock_gettime(CLOCK_REALTIME, &current);
+#endif
+
+    return (uint64_t) current.tv_sec * 1000000 + current.tv_nsec / 1000;
+
+#else
+
+    struct timeval current;
+
+    /* Get current time */
+    gettimeofday(&current, NULL);
+
+    return (uint64_t) current.tv_sec * 1000000 + current.tv_usec;
+
+#endif
+
+}
+
+/**
+ * Returns the average framerate of the heat map cells which intersect the
+ * given rectangle, in frames per second.
+ *
+ * @param surface
+ *     The surface containing the heat map cells to be queried.
+ *
+ * @param rect
+ *     The rectangle containing the heat map cells to be queried.
+ *
+ * @return
+ *     The average framerate of the region covered by the given rectangle.
+ */
+static int __guac_common_surface_get_framerate(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    int x, y;
+
+    int sum_framerate = 0;
+    int count = 0;
+
+    /* Calculate heat map dimensions */
+    int heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(surface->width);
+    int heat_height = GUAC_COMMON_SURFACE_HEAT_DIMENSION(surface->height);
+
+    /* Calculate minimum X/Y coordinates intersecting given rect */
+    int min_x = rect->x / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int min_y = rect->y / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    /* Calculate maximum X/Y coordinates intersecting given rect */
+    int max_x = min_x + (rect->width  - 1) / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+    int max_y = min_y + (rect->height - 1) / GUAC_COMMON_SURFACE_HEAT_CELL_SIZE;
+
+    /* Restrict to bounds of heat map */
+    if (min_x < 0) min_x = 0;
+    if (min_y < 0) min_y = 0;
+    if (max_x >= heat_width)  max_x = heat_width  - 1;
+    if (max_y >= heat_height) max_y = heat_height - 1;
+
+    /* Get start of buffer at given coordinates */
+    guac_common_surface_heat_cell* heat_row =
+        surface->heat_map + min_y * heat_width + min_x;
+
+    /* Sum framerates of all heat map cells which intersect with rectangle */
+    for (y = min_y; y <= max_y; y++) {
+
+        /* Get current row of heat map */
+        guac_common_surface_heat_cell* heat_cell = heat_row;
+
+        /* For each cell in subset of row */
+        for (x = min_x; x <= max_x; x++) {
+
+            /* Locate oldest and most recent entries */
+            int oldest_entry = heat_cell->oldest_entry;
+            int latest_entry = oldest_entry - 1;
+            if (latest_entry < 0)
+                latest_entry = GUAC_COMMON_SURFACE_HEAT_CELL_HISTORY_SIZE - 1;
+
+            /* Framerate is derived from time spanned by history */
+            guac_timestamp elapsed = heat_cell->history[latest_entry]
+                                   - heat_cell->history[oldest_entry];
+            if (elapsed > 0)
+                sum_framerate += GUAC_COMMON_SURFACE_HEAT_CELL_HISTORY_SIZE
+                               * 1000 / elapsed;
+
+            /* Advance to next heat map cell */
+            heat_cell++;
+            count++;
+
+        }
+
+        /* Next heat map row */
+        heat_row += heat_width;
+
+    }
+
+    /* Calculate average framerate */
+    if (count == 0)
+        return 0;
+
+    return sum_framerate / count;
+
+}
+
+/**
+ * Classifies the content within the given rectangle of the given surface
+ * according to how frequently that content is updated.
+ *
+ * @param surface
+ *     The surface containing the content to be classified.
+ *
+ * @param rect
+ *     The rectangle containing the content to be classified.
+ *
+ * @return
+ *     The class of content within the given rectangle.
+ */
+static guac_common_surface_cost_class __guac_common_surface_get_cost_class(
+        guac_common_surface* surface, const guac_common_rect* rect) {
+
+    int framerate = __guac_common_surface_get_framerate(surface, rect);
+
+    if (framerate >= GUAC_COMMON_SURFACE_VIDEO_FRAMERATE)
+        return GUAC_COMMON_SURFACE_COST_VIDEO;
+
+    if (framerate >= GUAC_COMMON_SURFACE_ACTIVE_FRAMERATE)
+        return GUAC_COMMON_SURFACE_COST_ACTIVE;
+
+    return GUAC_COMMON_SURFACE_COST_STATIC;
+
+}
+
+/**
+ * Resets the given cost model to its uncalibrated state, such that the
+ * default costs are assumed for all updates.
+ *
+ * @param model
+ *     The cost model to reset.
+ */
+static void __guac_common_surface_cost_model_init(
+        guac_common_surface_cost_model* model) {
+
+    memset(model, 0, sizeof(guac_common_surface_cost_model));
+    model->base_cost  = GUAC_SURFACE_BASE_COST;
+    model->pixel_cost = GUAC_SURFACE_PIXEL_COST;
+
+}
+
+/**
+ * Returns the estimated cost of an update of the given area, according to
+ * the given cost model.
+ *
+ * @param model
+ *     The cost model to use to estimate the cost of the update.
+ *
+ * @param area
+ *     The area of the update, in pixels.
+ *
+ * @return
+ *     The estimated cost of the update.
+ */
+static double __guac_common_surface_estimate_cost(
+        const guac_common_surface_cost_model* model, int area) {
+    return model->base_cost + model->pixel_cost * area;
+}
+
+/**
+ * Records the observed cost of flushing an update, recalibrating the cost
+ * model corresponding to the content of that update.
+ *
+ * @param surface
+ *     The surface that was flushed.
+ *
+ * @param rect
+ *     The rectangle of the update that was flushed.
+ *
+ * @param bytes
+ *     The number of bytes sent while flushing the update.
+ *
+ * @param usecs
+ *     The number of microseconds spent encoding and sending the update.
+ */
+static void __guac_common_surface_record_cost(guac_common_surface* surface,
+        const guac_common_rect* rect, uint64_t bytes, uint64_t usecs) {
+
+    guac_common_surface_cost_class cost_class =
+        __guac_common_surface_get_cost_class(surface, rect);
+
+    guac_common_surface_cost_model* model = &surface->cost_models[cost_class];
+
+    double area = (double) rect->width * rect->height;
+    double cost = bytes + (double) usecs * GUAC_SURFACE_USEC_COST;
+
+    if (area <= 0)
+        return;
+
+    /* Age all past samples */
+    model->weight           *= GUAC_SURFACE_COST_DECAY;
+    model->sum_area         *= GUAC_SURFACE_COST_DECAY;
+    model->sum_cost         *= GUAC_SURFACE_COST_DECAY;
+    model->sum_area_squared *= GUAC_SURFACE_COST_DECAY;
+    model->sum_area_cost    *= GUAC_SURFACE_COST_DECAY;
+
+    /* Add new sample */
+    model->weight           += 1;
+    model->sum_area         += area;
+    model->sum_cost         += cost;
+    model->sum_area_squared += area * area;
+    model->sum_area_cost    += area * cost;
+    model->samples++;
+
+    /* Track per-pixel averages for inspection */
+    model->bytes_per_pixel += (bytes / area - model->bytes_per_pixel)
+                            * (1 - GUAC_SURFACE_COST_DECAY);
+    model->usecs_per_pixel += (usecs / area - model->usecs_per_pixel)
+                            * (1 - GUAC_SURFACE_COST_DECAY);
+
+    /* Continue to assume default costs until enough samples exist */
+    if (model->samples < GUAC_SURFACE_COST_MIN_SAMPLES)
+        return;
+
+    /* Refit model only if areas vary enough to distinguish the fixed and
+     * per-pixel costs */
+    double denominator = model->weight * model->sum_area_squared
+                       - model->sum_area * model->sum_area;
+    if (denominator > 0) {
+
+        double pixel_cost = (model->weight * model->sum_area_cost
+                          - model->sum_area * model->sum_cost) / denominator;
+        double base_cost = (model->sum_cost - pixel_cost * model->sum_area)
+                         / model->weight;
+
+        /* Ignore fits which are not physically meaningful */
+        if (pixel_cost > 0 && base_cost >= 0) {
+            model->pixel_cost = pixel_cost;
+            model->base_cost = base_cost;
+        }
+
+    }
+
+    /* Periodically log calibration state */
+    if (model->samples % GUAC_SURFACE_COST_LOG_INTERVAL == 0)
+        guac_client_log(surface->client, GUAC_LOG_DEBUG, "Layer %i cost "
+                "model for content class %i: base cost %.0f, pixel cost "
+                "%.3f (%.3f bytes/pixel, %.3f us/pixel, %i samples)",
+                surface->layer->index, cost_class, model->base_cost,
+                model->pixel_cost, model->bytes_per_pixel,
+                model->usecs_per_pixel, model->samples);
+
+}
+
 /**
  * Returns whether the given rectangle should be combined into the existing
  * dirty rectangle, to be eventually flushed as a "png" instruction.
@@ -329,7 +878,7 @@ static int __guac_common_should_combine(guac_common_surface* surface, const guac
 
     if (surface->dirty) {
 
-        int combined_cost, dirty_cost, update_cost;
+        double combined_cost, dirty_cost, update_cost;
 
         /* Simulate combination */
         guac_common_rect combined = surface->dirty_rect;
@@ -339,10 +888,14 @@ static int __guac_common_should_combine(guac_common_surface* surface, const guac
         if (combined.width <= GUAC_SURFACE_NEGLIGIBLE_WIDTH && combined.height <= GUAC_SURFACE_NEGLIGIBLE_HEIGHT)
             return 1;
 
+        /* Use the cost model calibrated for content like this update */
+        const guac_common_surface_cost_model* model = &surface->cost_models[
+            __guac_common_surface_get_cost_class(surface, rect)];
+
         /* Estimate costs of the existing update, new update, and both combined */
-        combined_cost = GUAC_SURFACE_BASE_COST + combined.width * combined.height;
-        dirty_cost    = GUAC_SURFACE_BASE_COST + surface->dirty_rect.width * surface->dirty_rect.height;
-        update_cost   = GUAC_SURFACE_BASE_COST + rect->width * rect->height;
+        combined_cost = __guac_common_surface_estimate_cost(model, combined.width * combined.height);
+        dirty_cost    = __guac_common_surface_estimate_cost(model, surface->dirty_rect.width * surface->dirty_rect.height);
+        update_cost   = __guac_common_surface_estimate_cost(model, rect->width * rect->height);
 
         /* Reduce cost if no image data */
         if (rect_only)
@@ -397,6 +950,34 @@ static void __guac_common_mark_dirty(guac_common_surface* surface, const guac_co
 
 }
 
+/**
+ * Expands the damage rect of the given surface to contain the rect described
+ * by the given coordinates. Unlike the dirty rect, which tracks only updates
+ * not yet sent to the client, damage covers every modification since damage
+ * was last retrieved with guac_common_surface_take_damage().
+ *
+ * @param surface The surface to mark as damaged.
+ * @param rect The rectangle of the update which is damaging the surface.
+ */
+static void __guac_common_surface_damage(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    /* Ignore empty rects */
+    if (rect->width <= 0 || rect->height <= 0)
+        return;
+
+    /* If already damaged, update existing rect */
+    if (surface->damaged)
+        guac_common_rect_extend(&surface->damage_rect, rect);
+
+    /* Otherwise init damage rect */
+    else {
+        surface->damage_rect = *rect;
+        surface->damaged = 1;
+    }
+
+}
+
 /**
  * Updates the heat map cells which intersect the given rectangle using the
  * given timestamp. This timestamp, along with timestamps from past updates,
@@ -676,6 +1257,12 @@ static void __guac_common_surface_set(guac_common_surface* dst,
 
     }
 
+    /* Track opacity of all pixels assigned */
+    if (alpha == 0xFF)
+        __guac_common_surface_mark_opaque(dst, rect);
+    else
+        __guac_common_surface_clear_opaque(dst, rect);
+
     /* Restrict destination rect to only updated pixels */
     if (max_x >= min_x && max_y >= min_y) {
         rect->x += min_x;
@@ -847,6 +1434,12 @@ static void __guac_common_surface_put(unsigned char* src_buffer, int src_stride,
 
     }
 
+    /* Track opacity of all pixels copied. Alpha blending can never reduce
+     * the opacity of existing pixels, thus only opaque copies affect
+     * tracking. */
+    if (opaque)
+        __guac_common_surface_mark_opaque(dst, rect);
+
     /* Restrict destination rect to only updated pixels */
     if (max_x >= min_x && max_y >= min_y) {
         rect->x += min_x;
@@ -994,6 +1587,39 @@ static void __guac_common_surface_transfer(guac_common_surface* src, int* sx, in
 
     }
 
+    /* Track opacity of all pixels transferred. Only operations which
+     * replace the alpha component of the destination affect tracking. */
+    switch (op) {
+
+        /* Result is always opaque */
+        case GUAC_TRANSFER_BINARY_BLACK:
+        case GUAC_TRANSFER_BINARY_WHITE:
+            __guac_common_surface_mark_opaque(dst, rect);
+            break;
+
+        /* Result is as opaque as the source */
+        case GUAC_TRANSFER_BINARY_SRC:
+        case GUAC_TRANSFER_BINARY_NSRC: {
+
+            guac_common_rect src_rect;
+            guac_common_rect_init(&src_rect, *sx, *sy,
+                    rect->width, rect->height);
+
+            if (__guac_common_surface_is_known_opaque(src, &src_rect))
+                __guac_common_surface_mark_opaque(dst, rect);
+            else
+                __guac_common_surface_clear_opaque(dst, rect);
+
+            break;
+
+        }
+
+        /* All other operations preserve destination alpha */
+        default:
+            break;
+
+    }
+
     /* Translate X coordinate space of moving backwards */
     if (step < 0) {
         int old_max_x = max_x;
@@ -1029,6 +1655,8 @@ static void __guac_common_surface_transfer(guac_common_surface* src, int* sx, in
 guac_common_surface* guac_common_surface_alloc(guac_client* client,
         guac_socket* socket, const guac_layer* layer, int w, int h) {
 
+    int i;
+
     /* Calculate heat map dimensions */
     int heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(w);
     int heat_height = GUAC_COMMON_SURFACE_HEAT_DIMENSION(h);
@@ -1053,6 +1681,10 @@ guac_common_surface* guac_common_surface_alloc(guac_client* client,
     surface->heat_map = calloc(heat_width * heat_height,
             sizeof(guac_common_surface_heat_cell));
 
+    /* Assume default costs until updates have been observed */
+    for (i = 0; i < GUAC_COMMON_SURFACE_COST_CLASSES; i++)
+        __guac_common_surface_cost_model_init(&surface->cost_models[i]);
+
     /* Reset clipping rect */
     guac_common_surface_reset_clip(surface);
 
@@ -1069,10 +1701,37 @@ guac_common_surface* guac_common_surface_alloc(guac_client* client,
     return surface;
 }
 
+/**
+ * The layer associated with all local surfaces. As local surfaces are never
+ * sent to any client, this layer need only be recognizable as a buffer.
+ */
+static const guac_layer __guac_common_surface_local_layer = { -1 };
+
+guac_common_surface* guac_common_surface_alloc_local(guac_client* client,
+        int w, int h) {
+
+    /* Any instructions still produced for the surface are discarded by a
+     * socket having no handlers */
+    guac_socket* socket = guac_socket_alloc();
+    if (socket == NULL)
+        return NULL;
+
+    guac_common_surface* surface = guac_common_surface_alloc(client, socket,
+            &__guac_common_surface_local_layer, w, h);
+
+    surface->local = 1;
+    return surface;
+
+}
+
 void guac_common_surface_free(guac_common_surface* surface) {
 
+    /* Local surfaces own their socket and have nothing to dispose */
+    if (surface->local)
+        guac_socket_free(surface->socket);
+
     /* Only dispose of surface if it exists */
-    if (surface->realized)
+    else if (surface->realized)
         guac_protocol_send_dispose(surface->socket, surface->layer);
 
     pthread_mutex_destroy(&surface->_lock);
@@ -1117,6 +1776,11 @@ void guac_common_surface_resize(guac_common_surface* surface, int w, int h) {
     surface->buffer = calloc(h, surface->stride);
     __guac_common_bound_rect(surface, &surface->clip_rect, NULL, NULL);
 
+    /* Allocate completely new heat map (can safely discard old stats) */
+    free(surface->heat_map);
+    surface->heat_map = calloc(heat_width * heat_height,
+            sizeof(guac_common_surface_heat_cell));
+
     /* Copy relevant old data */
     __guac_common_bound_rect(surface, &old_rect, NULL, NULL);
     __guac_common_surface_put(old_buffer, old_stride, &sx, &sy, surface, &old_rect, 1);
@@ -1124,11 +1788,6 @@ void guac_common_surface_resize(guac_common_surface* surface, int w, int h) {
     /* Free old data */
     free(old_buffer);
 
-    /* Allocate completely new heat map (can safely discard old stats) */
-    free(surface->heat_map);
-    surface->heat_map = calloc(heat_width * heat_height,
-            sizeof(guac_common_surface_heat_cell));
-
     /* Resize dirty rect to fit new surface dimensions */
     if (surface->dirty) {
         __guac_common_bound_rect(surface, &surface->dirty_rect, NULL, NULL);
@@ -1181,6 +1840,7 @@ void guac_common_surface_draw(guac_common_surface* surface, int x, int y, cairo_
 
     /* Always defer draws */
     __guac_common_mark_dirty(surface, &rect);
+    __guac_common_surface_damage(surface, &rect);
 
 complete:
     pthread_mutex_unlock(&surface->_lock);
@@ -1217,6 +1877,7 @@ void guac_common_surface_paint(guac_common_surface* surface, int x, int y,
 
     /* Always defer draws */
     __guac_common_mark_dirty(surface, &rect);
+    __guac_common_surface_damage(surface, &rect);
 
 complete:
     pthread_mutex_unlock(&surface->_lock);
@@ -1263,8 +1924,9 @@ void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
             goto complete;
     }
 
-    /* Defer if combining */
-    if (__guac_common_should_combine(dst, &drect, 1))
+    /* Defer if combining or if the destination is never sent, such that
+     * the source need not be flushed */
+    if (dst->local || __guac_common_should_combine(dst, &drect, 1))
         __guac_common_mark_dirty(dst, &drect);
 
     /* Otherwise, flush and draw immediately */
@@ -1282,6 +1944,8 @@ void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
         __guac_common_surface_transfer(src, &srect.x, &srect.y,
                 GUAC_TRANSFER_BINARY_SRC, dst, &drect);
 
+    __guac_common_surface_damage(dst, &drect);
+
 complete:
 
     /* Unlock both surfaces */
@@ -1330,8 +1994,9 @@ void guac_common_surface_transfer(guac_common_surface* src, int sx, int sy, int
             goto complete;
     }
 
-    /* Defer if combining */
-    if (__guac_common_should_combine(dst, &drect, 1))
+    /* Defer if combining or if the destination is never sent, such that
+     * the source need not be flushed */
+    if (dst->local || __guac_common_should_combine(dst, &drect, 1))
         __guac_common_mark_dirty(dst, &drect);
 
     /* Otherwise, flush and draw immediately */
@@ -1347,6 +2012,8 @@ void guac_common_surface_transfer(guac_common_surface* src, int sx, int sy, int
     if (src == dst)
         __guac_common_surface_transfer(src, &srect.x, &srect.y, op, dst, &drect);
 
+    __guac_common_surface_damage(dst, &drect);
+
 complete:
 
     /* Unlock both surfaces */
@@ -1389,8 +2056,8 @@ void guac_common_surface_set(guac_common_surface* surface,
 
     }
 
-    /* Defer if combining */
-    else if (__guac_common_should_combine(surface, &rect, 1))
+    /* Defer if combining or if the surface is never sent */
+    else if (surface->local || __guac_common_should_combine(surface, &rect, 1))
         __guac_common_mark_dirty(surface, &rect);
 
     /* Otherwise, flush and draw immediately */
@@ -1401,6 +2068,8 @@ void guac_common_surface_set(guac_common_surface* surface,
         surface->realized = 1;
     }
 
+    __guac_common_surface_damage(surface, &rect);
+
 complete:
     pthread_mutex_unlock(&surface->_lock);
 
@@ -1431,6 +2100,255 @@ void guac_common_surface_reset_clip(guac_common_surface* surface) {
     pthread_mutex_unlock(&surface->_lock);
 }
 
+/**
+ * The largest power of two by which image updates may be downscaled for users
+ * viewing the display at reduced scale, expressed as a bit shift.
+ */
+#define GUAC_COMMON_SURFACE_MAX_SCALE_SHIFT 2
+
+/**
+ * The minimum throttle lag, in milliseconds, at which image updates sent to a
+ * user are downscaled one step further to reduce the bandwidth they consume.
+ */
+#define GUAC_COMMON_SURFACE_THROTTLE_LAG 100
+
+/**
+ * Returns the power of two by which image updates sent to the given user may
+ * be downscaled without visible loss of detail, expressed as a bit shift. The
+ * shift is derived from the scale at which the user's client reports it is
+ * rendering the display.
+ *
+ * @param user
+ *     The user to whom image updates will be sent.
+ *
+ * @return
+ *     The number of bits by which the dimensions of image updates may be
+ *     shifted right for the given user, where zero denotes that updates must
+ *     be sent at full resolution.
+ */
+static int __guac_common_surface_get_scale_shift(guac_user* user) {
+
+    int scale = user->info.display_scale;
+    int shift = 0;
+
+    /* Halve resolution for as long as the client would render at least one
+     * screen pixel per image pixel (clients which have not reported a scale
+     * receive full resolution) */
+    if (scale > 0) {
+        while (shift < GUAC_COMMON_SURFACE_MAX_SCALE_SHIFT
+                && (scale << (shift + 1)) <= 1000)
+            shift++;
+    }
+
+    /* Halve resolution once more while output to the user is throttled by
+     * bandwidth limits, trading detail for smaller updates */
+    if (guac_user_get_throttle_lag(user) >= GUAC_COMMON_SURFACE_THROTTLE_LAG
+            && shift < GUAC_COMMON_SURFACE_MAX_SCALE_SHIFT)
+        shift++;
+
+    return shift;
+
+}
+
+/**
+ * Callback for guac_client_foreach_user() which determines whether any user
+ * may receive downscaled image updates. The data pointer must point to an
+ * int which will be set to non-zero if any such user is found.
+ */
+static void* __guac_common_surface_find_scaled_user(guac_user* user,
+        void* data) {
+
+    int* found = (int*) data;
+
+    if (__guac_common_surface_get_scale_shift(user) > 0)
+        *found = 1;
+
+    return NULL;
+
+}
+
+/**
+ * Downscales the given image data by the given power of two using a box
+ * filter, averaging each square block of pixels into a single pixel. Blocks
+ * along the right and bottom edges which are only partially covered by the
+ * image are averaged over the pixels actually present. As pixel data is
+ * premultiplied, averaging each channel independently is correct for images
+ * with an alpha channel.
+ *
+ * @param buffer
+ *     The first pixel of the image data to downscale.
+ *
+ * @param stride
+ *     The number of bytes in each row of the image data.
+ *
+ * @param format
+ *     The Cairo format of the image data, which must be either
+ *     CAIRO_FORMAT_RGB24 or CAIRO_FORMAT_ARGB32.
+ *
+ * @param width
+ *     The width of the image data, in pixels.
+ *
+ * @param height
+ *     The height of the image data, in pixels.
+ *
+ * @param shift
+ *     The power of two by which the image should be downscaled, expressed as
+ *     a bit shift.
+ *
+ * @return
+ *     A newly-allocated Cairo surface containing the downscaled image, which
+ *     must eventually be freed with cairo_surface_destroy(), or NULL if
+ *     memory could not be allocated.
+ */
+static cairo_surface_t* __guac_common_surface_downscale(unsigned char* buffer,
+        int stride, cairo_format_t format, int width, int height, int shift) {
+
+    int x, y, row;
+
+    int block = 1 << shift;
+    int scaled_width  = (width  + block - 1) >> shift;
+    int scaled_height = (height + block - 1) >> shift;
+
+    /* Per-channel sums for each pixel of the current output row */
+    uint32_t* sums = malloc(sizeof(uint32_t) * 4 * scaled_width);
+    if (sums == NULL)
+        return NULL;
+
+    cairo_surface_t* scaled = cairo_image_surface_create(format,
+            scaled_width, scaled_height);
+
+    unsigned char* scaled_buffer = cairo_image_surface_get_data(scaled);
+    int scaled_stride = cairo_image_surface_get_stride(scaled);
+
+    cairo_surface_flush(scaled);
+
+    for (y = 0; y < scaled_height; y++) {
+
+        /* Number of input rows covered by this output row */
+        int rows = height - (y << shift);
+        if (rows > block)
+            rows = block;
+
+        memset(sums, 0, sizeof(uint32_t) * 4 * scaled_width);
+
+        /* Accumulate all input rows covered by this output row */
+        for (row = 0; row < rows; row++) {
+
+            const unsigned char* src = buffer + ((y << shift) + row) * stride;
+
+            for (x = 0; x < width; x++) {
+                uint32_t* sum = &sums[(x >> shift) * 4];
+                sum[0] += src[0];
+                sum[1] += src[1];
+                sum[2] += src[2];
+                sum[3] += src[3];
+                src += 4;
+            }
+
+        }
+
+        /* Store average of each block */
+        unsigned char* dst = scaled_buffer + y * scaled_stride;
+        for (x = 0; x < scaled_width; x++) {
+
+            /* Number of input columns covered by this output pixel */
+            int columns = width - (x << shift);
+            if (columns > block)
+                columns = block;
+
+            uint32_t area = rows * columns;
+            uint32_t* sum = &sums[x * 4];
+            dst[0] = sum[0] / area;
+            dst[1] = sum[1] / area;
+            dst[2] = sum[2] / area;
+            dst[3] = sum[3] / area;
+            dst += 4;
+
+        }
+
+    }
+
+    cairo_surface_mark_dirty(scaled);
+    free(sums);
+
+    return scaled;
+
+}
+
+/**
+ * An image update being sent to each user individually, such that users
+ * viewing the display at reduced scale may receive downscaled copies.
+ */
+typedef struct guac_common_surface_png_update {
+
+    /**
+     * The surface being flushed.
+     */
+    guac_common_surface* surface;
+
+    /**
+     * The Cairo format of the image data being flushed.
+     */
+    cairo_format_t format;
+
+    /**
+     * The full-resolution image data being flushed.
+     */
+    cairo_surface_t* rect;
+
+    /**
+     * Downscaled copies of the image data, indexed by scale shift, created
+     * only as needed. The entry at index zero is unused.
+     */
+    cairo_surface_t* scaled[GUAC_COMMON_SURFACE_MAX_SCALE_SHIFT + 1];
+
+} guac_common_surface_png_update;
+
+/**
+ * Callback for guac_client_foreach_user() which sends the image update
+ * described by the given guac_common_surface_png_update to a single user,
+ * downscaling that update if the user is viewing the display at reduced
+ * scale.
+ */
+static void* __guac_common_surface_stream_png_to_user(guac_user* user,
+        void* data) {
+
+    guac_common_surface_png_update* update =
+        (guac_common_surface_png_update*) data;
+
+    guac_common_surface* surface = update->surface;
+    guac_common_rect* rect = &surface->dirty_rect;
+
+    int shift = __guac_common_surface_get_scale_shift(user);
+
+    /* Downscale update only once for all users sharing the same scale */
+    if (shift > 0 && update->scaled[shift] == NULL) {
+
+        unsigned char* buffer = surface->buffer
+                              + rect->y * surface->stride
+                              + rect->x * 4;
+
+        update->scaled[shift] = __guac_common_surface_downscale(buffer,
+                surface->stride, update->format, rect->width, rect->height,
+                shift);
+
+    }
+
+    /* Send downscaled image, to be stretched back over the full rect */
+    if (shift > 0 && update->scaled[shift] != NULL)
+        guac_user_stream_scaled_png(user, user->socket, GUAC_COMP_OVER,
+                surface->layer, rect->x, rect->y, rect->width, rect->height,
+                update->scaled[shift]);
+
+    /* Otherwise, send the update at full resolution */
+    else
+        guac_user_stream_png(user, user->socket, GUAC_COMP_OVER,
+                surface->layer, rect->x, rect->y, update->rect);
+
+    return NULL;
+
+}
+
 /**
  * Flushes the bitmap update currently described by the dirty rectangle within
  * the given surface directly via an "img" instruction as PNG data. The
@@ -1480,9 +2398,51 @@ static void __guac_common_surface_flush_to_png(guac_common_surface* surface,
 
         }
 
-        /* Send PNG for rect */
-        guac_client_stream_png(surface->client, socket, GUAC_COMP_OVER,
-                layer, surface->dirty_rect.x, surface->dirty_rect.y, rect);
+        /* Determine whether any user may receive a downscaled update */
+        int scaled_users = 0;
+        if (socket == surface->client->socket)
+            guac_client_foreach_user(surface->client,
+                    __guac_common_surface_find_scaled_user, &scaled_users);
+
+        /* Send PNG for rect to each user individually, downscaling as
+         * allowed by the scale at which each user views the display */
+        if (scaled_users) {
+
+            int shift;
+
+            guac_common_surface_png_update update = {
+                .surface = surface,
+                .format  = opaque ? CAIRO_FORMAT_RGB24 : CAIRO_FORMAT_ARGB32,
+                .rect    = rect
+            };
+
+            guac_client_foreach_user(surface->client,
+                    __guac_common_surface_stream_png_to_user, &update);
+
+            /* Free any downscaled copies */
+            for (shift = 1; shift <= GUAC_COMMON_SURFACE_MAX_SCALE_SHIFT;
+                    shift++) {
+                if (update.scaled[shift] != NULL)
+                    cairo_surface_destroy(update.scaled[shift]);
+            }
+
+        }
+
+        /* Otherwise, send the same PNG to all users at once, recording the
+         * observed cost of doing so */
+        else {
+
+            uint64_t bytes_before = socket->bytes_written;
+            uint64_t start = __guac_common_surface_current_usecs();
+
+            guac_client_stream_png(surface->client, socket, GUAC_COMP_OVER,
+                    layer, surface->dirty_rect.x, surface->dirty_rect.y, rect);
+
+            __guac_common_surface_record_cost(surface, &surface->dirty_rect,
+                    socket->bytes_written - bytes_before,
+                    __guac_common_surface_current_usecs() - start);
+
+        }
 
         cairo_surface_destroy(rect);
         surface->realized = 1;
@@ -1551,6 +2511,13 @@ static void __guac_common_surface_flush_properties(
 
 static void __guac_common_surface_flush(guac_common_surface* surface) {
 
+    /* Local surfaces are never sent; discard all pending updates */
+    if (surface->local) {
+        surface->bitmap_queue_length = 0;
+        surface->dirty = 0;
+        return;
+    }
+
     /* Flush final dirty rectangle to queue. */
     __guac_common_surface_flush_to_queue(surface);
 
@@ -1629,13 +2596,37 @@ void guac_common_surface_flush(guac_common_surface* surface) {
 
     pthread_mutex_lock(&surface->_lock);
 
+    guac_trace_event(surface->client, GUAC_TRACE_BEGIN, "flush",
+            surface->layer->index);
+
     /* Flush any applicable layer properties */
     __guac_common_surface_flush_properties(surface);
 
     /* Flush surface contents */
     __guac_common_surface_flush(surface);
 
+    guac_trace_event(surface->client, GUAC_TRACE_END, "flush",
+            surface->layer->index);
+
+    pthread_mutex_unlock(&surface->_lock);
+
+}
+
+int guac_common_surface_take_damage(guac_common_surface* surface,
+        guac_common_rect* rect) {
+
+    pthread_mutex_lock(&surface->_lock);
+
+    int damaged = surface->damaged;
+
+    /* Hand off and clear any accumulated damage */
+    if (damaged) {
+        *rect = surface->damage_rect;
+        surface->damaged = 0;
+    }
+
     pthread_mutex_unlock(&surface->_lock);
+    return damaged;
 
 }
 
@@ -0,0 +1,224 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Standalone benchmark of downscaled image updates. A full-HD image is
+ * downscaled with the box filter used for users viewing the display at
+ * reduced scale, and the result encoded as PNG, at each scale shift from 0
+ * (full resolution, no downscaling) to GUAC_COMMON_SURFACE_MAX_SCALE_SHIFT.
+ * The size reported is that of the blob instructions sent, which carry the
+ * PNG data base64-encoded. The surface implementation is included as source
+ * to reach its box filter.
+ *
+ * Build from this directory of a configured and built source tree:
+ *
+ *     gcc -std=gnu99 -O2 -Wall -I.. -I../../.. -I../../libguac \
+ *         -I../../libguac/guacamole $(pkg-config --cflags cairo) \
+ *         bench_surface_downscale.c -L../../libguac/.libs -lguac \
+ *         $(pkg-config --libs cairo) -o bench_surface_downscale
+ *
+ * Usage:
+ *
+ *     ./bench_surface_downscale [ITERATIONS [PNG_FILE]]
+ *
+ * If PNG_FILE is given, it is used in place of the generated image, which
+ * resembles a desktop of windows containing gradients and text.
+ */
+
+#include "config.h"
+
+#include "surface.c"
+#include "encode-png.h"
+
+#include <cairo/cairo.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The number of times each scale is downscaled and encoded if not specified.
+ */
+#define BENCH_DEFAULT_ITERATIONS 20
+
+/**
+ * The width of the generated image, in pixels.
+ */
+#define BENCH_WIDTH 1920
+
+/**
+ * The height of the generated image, in pixels.
+ */
+#define BENCH_HEIGHT 1080
+
+/**
+ * Returns the current value of the monotonic clock, in seconds.
+ */
+static double __bench_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Generates a full-HD image resembling a desktop: a gradient background
+ * overlaid with flat windows, each containing rows of text-like runs of
+ * dark pixels.
+ */
+static cairo_surface_t* __bench_generate_image() {
+
+    cairo_surface_t* image = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+            BENCH_WIDTH, BENCH_HEIGHT);
+
+    unsigned char* data = cairo_image_surface_get_data(image);
+    int stride = cairo_image_surface_get_stride(image);
+    int x, y;
+
+    cairo_surface_flush(image);
+
+    for (y = 0; y < BENCH_HEIGHT; y++) {
+
+        uint32_t* row = (uint32_t*) (data + y * stride);
+
+        for (x = 0; x < BENCH_WIDTH; x++) {
+
+            int in_window = (x % 960) >= 80 && (x % 960) < 880
+                         && (y % 540) >= 60 && (y % 540) < 500;
+
+            /* Gradient background */
+            if (!in_window)
+                row[x] = (x * 255 / BENCH_WIDTH) << 16
+                       | (y * 255 / BENCH_HEIGHT) << 8 | 0x80;
+
+            /* Text within windows, as pseudo-random runs on 16-pixel lines */
+            else if ((y % 16) < 10 && ((x * 7 + y * 13) ^ (x >> 3)) % 5 == 0)
+                row[x] = 0x202020;
+
+            /* Window background */
+            else
+                row[x] = 0xF0F0F0;
+
+        }
+
+    }
+
+    cairo_surface_mark_dirty(image);
+    return image;
+
+}
+
+int main(int argc, char** argv) {
+
+    int iterations = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+    cairo_surface_t* image;
+    int shift, i;
+
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [ITERATIONS [PNG_FILE]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc > 2)
+        image = cairo_image_surface_create_from_png(argv[2]);
+    else
+        image = __bench_generate_image();
+
+    if (cairo_surface_status(image) != CAIRO_STATUS_SUCCESS) {
+        fprintf(stderr, "Unable to read or generate image.\n");
+        return EXIT_FAILURE;
+    }
+
+    unsigned char* data = cairo_image_surface_get_data(image);
+    int stride = cairo_image_surface_get_stride(image);
+    int width = cairo_image_surface_get_width(image);
+    int height = cairo_image_surface_get_height(image);
+    cairo_format_t format = cairo_image_surface_get_format(image);
+
+    /* Blobs are written to a temporary file to measure their size */
+    FILE* output = tmpfile();
+    if (output == NULL) {
+        fprintf(stderr, "Unable to create temporary file.\n");
+        return EXIT_FAILURE;
+    }
+
+    int fd = fileno(output);
+    guac_socket* socket = guac_socket_open(fd);
+    guac_stream stream = { .index = 0 };
+
+    printf("image:      %ix%i\n", width, height);
+    printf("iterations: %i\n", iterations);
+    printf("%-6s %12s %12s %12s %10s\n", "shift", "scale ms",
+            "encode ms", "total ms", "sent KiB");
+
+    for (shift = 0; shift <= GUAC_COMMON_SURFACE_MAX_SCALE_SHIFT; shift++) {
+
+        double scale_time = 0;
+        double encode_time = 0;
+        off_t size = 0;
+
+        for (i = 0; i < iterations; i++) {
+
+            /* Downscale, unless sending at full resolution */
+            double start = __bench_now();
+            cairo_surface_t* scaled = image;
+            if (shift > 0) {
+                scaled = __guac_common_surface_downscale(data, stride,
+                        format, width, height, shift);
+                if (scaled == NULL) {
+                    fprintf(stderr, "Unable to downscale image.\n");
+                    return EXIT_FAILURE;
+                }
+            }
+            double scaled_at = __bench_now();
+
+            /* Encode as PNG blobs */
+            lseek(fd, 0, SEEK_SET);
+            if (ftruncate(fd, 0) || guac_png_write(socket, &stream, scaled)) {
+                fprintf(stderr, "Unable to encode image.\n");
+                return EXIT_FAILURE;
+            }
+            guac_socket_flush(socket);
+            double encoded_at = __bench_now();
+
+            size = lseek(fd, 0, SEEK_CUR);
+            scale_time += scaled_at - start;
+            encode_time += encoded_at - scaled_at;
+
+            if (scaled != image)
+                cairo_surface_destroy(scaled);
+
+        }
+
+        printf("%-6i %12.2f %12.2f %12.2f %10.1f\n", shift,
+                scale_time * 1e3 / iterations,
+                encode_time * 1e3 / iterations,
+                (scale_time + encode_time) * 1e3 / iterations,
+                size / 1024.0);
+
+    }
+
+    guac_socket_free(socket);
+    cairo_surface_destroy(image);
+    return EXIT_SUCCESS;
+
+}
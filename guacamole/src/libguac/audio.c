@@ -0,0 +1,653 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "audio.h"
+#include "client.h"
+#include "protocol.h"
+#include "socket.h"
+#include "stream.h"
+#include "timestamp.h"
+#include "user.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The IMA ADPCM step size table, indexed by step index.
+ */
+static const int __guac_audio_step_table[89] = {
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/**
+ * The adjustment made to the step index after each 4-bit code, indexed by
+ * that code.
+ */
+static const int __guac_audio_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/**
+ * Encodes a single sample, updating the given encoder state.
+ *
+ * @param state
+ *     The state of the encoder for the channel containing the sample.
+ *
+ * @param sample
+ *     The sample to encode.
+ *
+ * @return
+ *     The 4-bit code representing the sample.
+ */
+static int __guac_audio_adpcm_encode(guac_audio_adpcm_state* state,
+        int sample) {
+
+    int step = __guac_audio_step_table[state->step_index];
+    int diff = sample - state->predictor;
+    int delta = step >> 3;
+    int code = 0;
+
+    /* Encode sign */
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+
+    /* Encode magnitude as multiples of the step size, tracking the delta
+     * which the decoder will reconstruct */
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+        delta += step;
+    }
+
+    step >>= 1;
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+        delta += step;
+    }
+
+    step >>= 1;
+    if (diff >= step) {
+        code |= 1;
+        delta += step;
+    }
+
+    /* Update predictor exactly as the decoder will */
+    if (code & 8)
+        state->predictor -= delta;
+    else
+        state->predictor += delta;
+
+    if (state->predictor > 32767)
+        state->predictor = 32767;
+    else if (state->predictor < -32768)
+        state->predictor = -32768;
+
+    /* Adapt step size */
+    state->step_index += __guac_audio_index_table[code];
+    if (state->step_index < 0)
+        state->step_index = 0;
+    else if (state->step_index > 88)
+        state->step_index = 88;
+
+    return code;
+
+}
+
+/**
+ * Returns whether the given user supports GUAC_AUDIO_MIMETYPE, and is thus
+ * announced any audio stream and sent its audio.
+ *
+ * @param user
+ *     The user to check.
+ *
+ * @return
+ *     Non-zero if the given user supports GUAC_AUDIO_MIMETYPE, zero
+ *     otherwise.
+ */
+static int __guac_audio_user_supported(guac_user* user) {
+
+    const char** mimetype = user->info.audio_mimetypes;
+
+    /* Users which do not support audio are never sent audio */
+    if (mimetype == NULL)
+        return 0;
+
+    for (; *mimetype != NULL; mimetype++) {
+        if (strcmp(*mimetype, GUAC_AUDIO_MIMETYPE) == 0)
+            return 1;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Callback which sends the most recently encoded packet of the given audio
+ * stream to the given user if that user was announced the stream. The
+ * encode_lock of the audio stream must be held.
+ *
+ * @param user
+ *     The user to send the packet to.
+ *
+ * @param data
+ *     The audio stream whose packet should be sent.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __guac_audio_stream_send_blob(guac_user* user, void* data) {
+
+    guac_audio_stream* audio = (guac_audio_stream*) data;
+
+    if (__guac_audio_user_supported(user)) {
+        guac_protocol_send_blob(user->socket, audio->stream,
+                audio->packet, audio->packet_length);
+        guac_socket_flush(user->socket);
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Callback which ends the given audio stream for the given user if that user
+ * was announced the stream. The encode_lock of the audio stream must be
+ * held.
+ *
+ * @param user
+ *     The user to end the audio stream for.
+ *
+ * @param data
+ *     The audio stream to end.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __guac_audio_stream_send_end(guac_user* user, void* data) {
+
+    guac_audio_stream* audio = (guac_audio_stream*) data;
+
+    if (__guac_audio_user_supported(user)) {
+        guac_protocol_send_end(user->socket, audio->stream);
+        guac_socket_flush(user->socket);
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Ends the current stream of the given audio stream for all users which were
+ * announced that stream, and frees the stream. The encode_lock of the audio
+ * stream must be held.
+ *
+ * @param audio
+ *     The audio stream whose current stream should be ended.
+ */
+static void __guac_audio_stream_end(guac_audio_stream* audio) {
+
+    guac_client_foreach_user(audio->client, __guac_audio_stream_send_end,
+            audio);
+    guac_client_free_stream(audio->client, audio->stream);
+    audio->stream = NULL;
+
+}
+
+/**
+ * Encodes the given number of frames from the frames buffer of the given
+ * audio stream as a single packet, sending that packet to all users which
+ * were announced the stream. The
+ * encode_lock of the audio stream must be held.
+ *
+ * @param audio
+ *     The audio stream whose buffered frames should be encoded and sent.
+ *
+ * @param frames
+ *     The number of frames within the frames buffer.
+ */
+static void __guac_audio_stream_send_packet(guac_audio_stream* audio,
+        int frames) {
+
+    unsigned char* packet = audio->packet;
+    int samples = frames * audio->channels;
+    int i;
+
+    /* Packet header */
+    *(packet++) = frames & 0xFF;
+    *(packet++) = (frames >> 8) & 0xFF;
+    *(packet++) = 0;
+    *(packet++) = 0;
+
+    /* Per-channel encoder state at start of packet */
+    for (i = 0; i < audio->channels; i++) {
+        guac_audio_adpcm_state* state = &(audio->state[i]);
+        *(packet++) = state->predictor & 0xFF;
+        *(packet++) = (state->predictor >> 8) & 0xFF;
+        *(packet++) = state->step_index;
+        *(packet++) = 0;
+    }
+
+    /* Encode samples, two per byte, earliest within the low nibble */
+    for (i = 0; i < samples; i++) {
+
+        int code = __guac_audio_adpcm_encode(
+                &(audio->state[i % audio->channels]), audio->frames[i]);
+
+        if (i & 1)
+            *(packet++) |= code << 4;
+        else
+            *packet = code;
+
+    }
+
+    if (samples & 1)
+        packet++;
+
+    audio->packet_length = packet - audio->packet;
+    guac_client_foreach_user(audio->client, __guac_audio_stream_send_blob,
+            audio);
+
+}
+
+/**
+ * Returns the number of frames which should be encoded as the next packet,
+ * or zero if no packet should yet be sent. The lock guarding the pcm buffer
+ * must be held.
+ *
+ * @param audio
+ *     The audio stream to check.
+ *
+ * @param now
+ *     The current time, in milliseconds.
+ *
+ * @return
+ *     The number of frames which should be encoded as the next packet, or
+ *     zero if no packet should yet be sent.
+ */
+static int __guac_audio_stream_ready(guac_audio_stream* audio,
+        guac_timestamp now) {
+
+    /* Always send complete packets */
+    if (audio->pcm_length >= audio->packet_frames)
+        return audio->packet_frames;
+
+    /* Send partial packets only if flushed or if the audio received so far
+     * would otherwise be delayed by more than one packet */
+    if (audio->pcm_length > 0 && (audio->flush_requested
+                || now - audio->pending_since >= GUAC_AUDIO_PACKET_DURATION))
+        return audio->pcm_length;
+
+    audio->flush_requested = 0;
+    return 0;
+
+}
+
+/**
+ * Removes the given number of frames from the pcm buffer of the given audio
+ * stream, copying them into the frames buffer for encoding. Both the lock
+ * guarding the pcm buffer and the encode_lock must be held.
+ *
+ * @param audio
+ *     The audio stream whose buffered frames should be removed.
+ *
+ * @param frames
+ *     The number of frames to remove.
+ *
+ * @param now
+ *     The current time, in milliseconds.
+ */
+static void __guac_audio_stream_take(guac_audio_stream* audio, int frames,
+        guac_timestamp now) {
+
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        memcpy(audio->frames + i * audio->channels,
+                audio->pcm + audio->pcm_start * audio->channels,
+                sizeof(int16_t) * audio->channels);
+        audio->pcm_start = (audio->pcm_start + 1) % audio->pcm_size;
+    }
+
+    audio->pcm_length -= frames;
+
+    /* Restart the timeout of any remaining partial packet, as it directly
+     * follows the packet just taken and thus cannot be played before that
+     * packet has been played in full */
+    audio->pending_since = now;
+
+}
+
+/**
+ * The encoder thread of each audio stream. Buffered audio is encoded and
+ * sent as packets of GUAC_AUDIO_PACKET_DURATION milliseconds, with any
+ * partial packet sent once it has been pending for that duration.
+ *
+ * @param data
+ *     The audio stream whose audio should be encoded.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __guac_audio_stream_encoder(void* data) {
+
+    guac_audio_stream* audio = (guac_audio_stream*) data;
+
+    pthread_mutex_lock(&(audio->lock));
+    while (!audio->stopping) {
+
+        guac_timestamp now = guac_timestamp_current();
+        int frames = audio->stream != NULL
+            ? __guac_audio_stream_ready(audio, now) : 0;
+
+        /* Wait for audio, or for the pending partial packet to expire */
+        if (frames == 0) {
+
+            if (audio->pcm_length > 0) {
+
+                struct timespec timeout;
+                int remaining = GUAC_AUDIO_PACKET_DURATION
+                    - (now - audio->pending_since);
+
+                clock_gettime(CLOCK_REALTIME, &timeout);
+                timeout.tv_nsec += remaining * 1000000L;
+                timeout.tv_sec += timeout.tv_nsec / 1000000000L;
+                timeout.tv_nsec %= 1000000000L;
+
+                pthread_cond_timedwait(&(audio->modified), &(audio->lock),
+                        &timeout);
+
+            }
+            else
+                pthread_cond_wait(&(audio->modified), &(audio->lock));
+
+            continue;
+
+        }
+
+        /* Re-acquire in lock order, as the format may change meanwhile */
+        pthread_mutex_unlock(&(audio->lock));
+        pthread_mutex_lock(&(audio->encode_lock));
+        pthread_mutex_lock(&(audio->lock));
+
+        now = guac_timestamp_current();
+        frames = audio->stream != NULL
+            ? __guac_audio_stream_ready(audio, now) : 0;
+        if (frames > 0)
+            __guac_audio_stream_take(audio, frames, now);
+
+        /* Encode and send without blocking writers of PCM audio */
+        pthread_mutex_unlock(&(audio->lock));
+        if (frames > 0)
+            __guac_audio_stream_send_packet(audio, frames);
+        pthread_mutex_unlock(&(audio->encode_lock));
+
+        pthread_mutex_lock(&(audio->lock));
+
+    }
+    pthread_mutex_unlock(&(audio->lock));
+
+    return NULL;
+
+}
+
+/**
+ * Callback which announces the given audio stream to the given user if that
+ * user supports GUAC_AUDIO_MIMETYPE. The encode_lock of the audio stream
+ * must be held.
+ *
+ * @param user
+ *     The user to announce the audio stream to.
+ *
+ * @param data
+ *     The audio stream to announce.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __guac_audio_stream_announce(guac_user* user, void* data) {
+
+    guac_audio_stream* audio = (guac_audio_stream*) data;
+
+    if (__guac_audio_user_supported(user)) {
+        guac_protocol_send_audio(user->socket, audio->stream,
+                audio->mimetype);
+        guac_socket_flush(user->socket);
+    }
+
+    return NULL;
+
+}
+
+guac_audio_stream* guac_audio_stream_alloc(guac_client* client) {
+
+    guac_audio_stream* audio = calloc(1, sizeof(guac_audio_stream));
+    if (audio == NULL)
+        return NULL;
+
+    audio->client = client;
+
+    pthread_mutex_init(&(audio->lock), NULL);
+    pthread_mutex_init(&(audio->encode_lock), NULL);
+    pthread_cond_init(&(audio->modified), NULL);
+
+    if (pthread_create(&(audio->encoder_thread), NULL,
+                __guac_audio_stream_encoder, audio)) {
+        pthread_cond_destroy(&(audio->modified));
+        pthread_mutex_destroy(&(audio->encode_lock));
+        pthread_mutex_destroy(&(audio->lock));
+        free(audio);
+        return NULL;
+    }
+
+    return audio;
+
+}
+
+int guac_audio_stream_reset(guac_audio_stream* audio, int rate, int channels,
+        int bps) {
+
+    int packet_frames;
+    int pcm_size;
+
+    /* Reject unsupported formats */
+    if (rate <= 0 || channels <= 0 || channels > GUAC_AUDIO_MAX_CHANNELS
+            || (bps != 8 && bps != 16))
+        return 1;
+
+    packet_frames = rate * GUAC_AUDIO_PACKET_DURATION / 1000;
+    pcm_size = rate * GUAC_AUDIO_BUFFER_DURATION / 1000;
+    if (packet_frames <= 0 || packet_frames > 0xFFFF)
+        return 1;
+
+    /* Nothing needed if format is unchanged, leaving buffered audio to the
+     * encoder thread such that the caller never waits on encoding */
+    pthread_mutex_lock(&(audio->lock));
+    if (audio->stream != NULL && audio->rate == rate
+            && audio->channels == channels && audio->bps == bps) {
+        pthread_mutex_unlock(&(audio->lock));
+        return 0;
+    }
+    pthread_mutex_unlock(&(audio->lock));
+
+    pthread_mutex_lock(&(audio->encode_lock));
+    pthread_mutex_lock(&(audio->lock));
+
+    /* Send any audio buffered in the old format, then end the old stream */
+    if (audio->stream != NULL) {
+        while (audio->pcm_length > 0) {
+            int frames = audio->pcm_length < audio->packet_frames
+                ? audio->pcm_length : audio->packet_frames;
+            __guac_audio_stream_take(audio, frames, guac_timestamp_current());
+            __guac_audio_stream_send_packet(audio, frames);
+        }
+        __guac_audio_stream_end(audio);
+    }
+
+    /* Reallocate buffers for new format */
+    free(audio->pcm);
+    free(audio->frames);
+    free(audio->packet);
+
+    audio->rate = rate;
+    audio->channels = channels;
+    audio->bps = bps;
+    audio->packet_frames = packet_frames;
+
+    audio->pcm_size = pcm_size;
+    audio->pcm_start = 0;
+    audio->pcm_length = 0;
+    audio->pcm = malloc(sizeof(int16_t) * pcm_size * channels);
+    audio->frames = malloc(sizeof(int16_t) * packet_frames * channels);
+    audio->packet = malloc(GUAC_AUDIO_PACKET_HEADER_SIZE
+            + GUAC_AUDIO_CHANNEL_HEADER_SIZE * channels
+            + (packet_frames * channels + 1) / 2);
+
+    memset(audio->state, 0, sizeof(audio->state));
+
+    snprintf(audio->mimetype, sizeof(audio->mimetype),
+            GUAC_AUDIO_MIMETYPE ";rate=%i,channels=%i", rate, channels);
+
+    /* Announce new stream to all users supporting audio */
+    audio->stream = guac_client_alloc_stream(audio->client);
+    if (audio->stream != NULL)
+        guac_client_foreach_user(audio->client,
+                __guac_audio_stream_announce, audio);
+
+    pthread_mutex_unlock(&(audio->lock));
+    pthread_mutex_unlock(&(audio->encode_lock));
+    return 0;
+
+}
+
+void guac_audio_stream_add_user(guac_audio_stream* audio, guac_user* user) {
+
+    pthread_mutex_lock(&(audio->encode_lock));
+
+    if (audio->stream != NULL)
+        __guac_audio_stream_announce(user, audio);
+
+    pthread_mutex_unlock(&(audio->encode_lock));
+
+}
+
+void guac_audio_stream_write_pcm(guac_audio_stream* audio,
+        const unsigned char* data, int length) {
+
+    int frame_size;
+    int frames;
+    int i, j;
+
+    pthread_mutex_lock(&(audio->lock));
+
+    /* Drop audio written before any format is set */
+    if (audio->pcm == NULL) {
+        pthread_mutex_unlock(&(audio->lock));
+        return;
+    }
+
+    frame_size = audio->channels * audio->bps / 8;
+    frames = length / frame_size;
+
+    if (audio->pcm_length == 0)
+        audio->pending_since = guac_timestamp_current();
+
+    for (i = 0; i < frames; i++) {
+
+        int16_t* frame;
+
+        /* Drop oldest audio if the encoder has fallen too far behind */
+        if (audio->pcm_length == audio->pcm_size) {
+            audio->pcm_start = (audio->pcm_start + 1) % audio->pcm_size;
+            audio->pcm_length--;
+        }
+
+        frame = audio->pcm + ((audio->pcm_start + audio->pcm_length)
+                % audio->pcm_size) * audio->channels;
+
+        /* Convert to signed 16-bit */
+        for (j = 0; j < audio->channels; j++) {
+            if (audio->bps == 16) {
+                frame[j] = (int16_t) (data[0] | (data[1] << 8));
+                data += 2;
+            }
+            else
+                frame[j] = (*(data++) - 128) << 8;
+        }
+
+        audio->pcm_length++;
+
+    }
+
+    pthread_cond_signal(&(audio->modified));
+    pthread_mutex_unlock(&(audio->lock));
+
+}
+
+void guac_audio_stream_flush(guac_audio_stream* audio) {
+
+    pthread_mutex_lock(&(audio->lock));
+    audio->flush_requested = 1;
+    pthread_cond_signal(&(audio->modified));
+    pthread_mutex_unlock(&(audio->lock));
+
+}
+
+void guac_audio_stream_free(guac_audio_stream* audio) {
+
+    /* Stop encoder thread */
+    pthread_mutex_lock(&(audio->lock));
+    audio->stopping = 1;
+    pthread_cond_signal(&(audio->modified));
+    pthread_mutex_unlock(&(audio->lock));
+    pthread_join(audio->encoder_thread, NULL);
+
+    /* End stream */
+    if (audio->stream != NULL)
+        __guac_audio_stream_end(audio);
+
+    pthread_cond_destroy(&(audio->modified));
+    pthread_mutex_destroy(&(audio->encode_lock));
+    pthread_mutex_destroy(&(audio->lock));
+
+    free(audio->pcm);
+    free(audio->frames);
+    free(audio->packet);
+    free(audio);
+
+}
+
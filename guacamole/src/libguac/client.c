@@ -28,6 +28,7 @@
 #include "socket.h"
 #include "stream.h"
 #include "timestamp.h"
+#include "trace.h"
 #include "user.h"
 
 #include <dlfcn.h>
@@ -403,6 +404,9 @@ int guac_client_end_frame(guac_client* client) {
     guac_client_log(client, GUAC_LOG_TRACE, "Server completed "
             "frame %" PRIu64 "ms.", client->last_sent_timestamp);
 
+    guac_trace_event(client, GUAC_TRACE_INSTANT, "end-frame",
+            client->last_sent_timestamp);
+
     return guac_protocol_send_sync(client->socket, client->last_sent_timestamp);
 
 }
@@ -473,9 +477,15 @@ static void* __calculate_lag(guac_user* user, void* data) {
 
     int* processing_lag = (int*) data;
 
+    /* Output delayed by bandwidth limits counts as lag */
+    int user_lag = user->processing_lag;
+    int throttle_lag = guac_user_get_throttle_lag(user);
+    if (throttle_lag > user_lag)
+        user_lag = throttle_lag;
+
     /* Simply find maximum */
-    if (user->processing_lag > *processing_lag)
-        *processing_lag = user->processing_lag;
+    if (user_lag > *processing_lag)
+        *processing_lag = user_lag;
 
     return NULL;
 
@@ -496,6 +506,8 @@ void guac_client_stream_png(guac_client* client, guac_socket* socket,
         guac_composite_mode mode, const guac_layer* layer, int x, int y,
         cairo_surface_t* surface) {
 
+    guac_trace_event(client, GUAC_TRACE_BEGIN, "encode", 0);
+
     /* Allocate new stream for image */
     guac_stream* stream = guac_client_alloc_stream(client);
 
@@ -511,4 +523,6 @@ void guac_client_stream_png(guac_client* client, guac_socket* socket,
     /* Free allocated stream */
     guac_client_free_stream(client, stream);
 
+    guac_trace_event(client, GUAC_TRACE_END, "encode", 0);
+
 }
@@ -0,0 +1,80 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _GUAC_AUDIO_TYPES_H
+#define _GUAC_AUDIO_TYPES_H
+
+/**
+ * Type definitions related to audio streams.
+ *
+ * @file audio-types.h
+ */
+
+/**
+ * The mimetype of audio encoded by guac_audio_stream, excluding the
+ * parameters describing the rate and number of channels of that audio.
+ */
+#define GUAC_AUDIO_MIMETYPE "audio/x-ima-adpcm"
+
+/**
+ * The duration of audio encoded within each packet, in milliseconds. Audio
+ * is packetized by time rather than by the amount of data received, such
+ * that each packet contains the same duration of audio regardless of format.
+ */
+#define GUAC_AUDIO_PACKET_DURATION 20
+
+/**
+ * The maximum duration of audio which may be buffered prior to encoding, in
+ * milliseconds. If the encoder falls behind by more than this amount, the
+ * oldest buffered audio is dropped.
+ */
+#define GUAC_AUDIO_BUFFER_DURATION 500
+
+/**
+ * The maximum number of channels supported by guac_audio_stream.
+ */
+#define GUAC_AUDIO_MAX_CHANNELS 2
+
+/**
+ * The size of the header of each packet, in bytes, excluding the per-channel
+ * header.
+ */
+#define GUAC_AUDIO_PACKET_HEADER_SIZE 4
+
+/**
+ * The size of the header describing the encoder state of each channel at the
+ * beginning of each packet, in bytes.
+ */
+#define GUAC_AUDIO_CHANNEL_HEADER_SIZE 4
+
+/**
+ * An audio stream which encodes PCM audio as IMA ADPCM within a dedicated
+ * encoder thread, sending the encoded audio to all connected users as
+ * packets of fixed duration.
+ */
+typedef struct guac_audio_stream guac_audio_stream;
+
+/**
+ * The state of the IMA ADPCM encoder for a single channel.
+ */
+typedef struct guac_audio_adpcm_state guac_audio_adpcm_state;
+
+#endif
+
@@ -0,0 +1,288 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _GUAC_AUDIO_H
+#define _GUAC_AUDIO_H
+
+/**
+ * Provides functions and structures for streaming audio to all users of a
+ * client. PCM audio received from the remote desktop is buffered and encoded
+ * as IMA ADPCM by a dedicated encoder thread, such that the thread receiving
+ * the audio is never blocked by encoding. Encoded audio is sent as blobs,
+ * each containing GUAC_AUDIO_PACKET_DURATION milliseconds of audio.
+ *
+ * Each packet begins with a GUAC_AUDIO_PACKET_HEADER_SIZE byte header
+ * containing the number of frames within the packet as a little-endian
+ * 16-bit integer, followed by two reserved bytes. This is followed by a
+ * GUAC_AUDIO_CHANNEL_HEADER_SIZE byte header for each channel, containing
+ * the predicted sample as a signed little-endian 16-bit integer, the step
+ * index as a single byte, and one reserved byte. The remainder of the packet
+ * contains one 4-bit code per sample, with the samples of each frame
+ * interleaved by channel, and the earliest sample within the low nibble of
+ * each byte.
+ *
+ * @file audio.h
+ */
+
+#include "audio-types.h"
+#include "client-types.h"
+#include "stream-types.h"
+#include "timestamp-types.h"
+#include "user-types.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+struct guac_audio_adpcm_state {
+
+    /**
+     * The current predicted sample.
+     */
+    int predictor;
+
+    /**
+     * The index of the current step size within the IMA ADPCM step table.
+     */
+    int step_index;
+
+};
+
+struct guac_audio_stream {
+
+    /**
+     * The client associated with this audio stream.
+     */
+    guac_client* client;
+
+    /**
+     * The stream along which encoded audio is sent, or NULL if no format has
+     * yet been set.
+     */
+    guac_stream* stream;
+
+    /**
+     * The mimetype of the encoded audio, including the rate and number of
+     * channels of that audio, as announced to each user.
+     */
+    char mimetype[64];
+
+    /**
+     * The number of samples per second of each channel.
+     */
+    int rate;
+
+    /**
+     * The number of channels.
+     */
+    int channels;
+
+    /**
+     * The number of bits per sample of the PCM audio provided to
+     * guac_audio_stream_write_pcm(). This must be 8 (unsigned) or 16 (signed,
+     * little-endian).
+     */
+    int bps;
+
+    /**
+     * The number of frames encoded within each complete packet.
+     */
+    int packet_frames;
+
+    /**
+     * Ring buffer of received PCM samples, converted to 16-bit, which have
+     * not yet been encoded.
+     */
+    int16_t* pcm;
+
+    /**
+     * The number of frames which fit within the pcm buffer.
+     */
+    int pcm_size;
+
+    /**
+     * The index of the first frame within the pcm buffer which has not yet
+     * been encoded.
+     */
+    int pcm_start;
+
+    /**
+     * The number of frames within the pcm buffer which have not yet been
+     * encoded.
+     */
+    int pcm_length;
+
+    /**
+     * The time at which the oldest unencoded frame was received, in
+     * milliseconds. Any partial packet is encoded once it has been pending
+     * for GUAC_AUDIO_PACKET_DURATION milliseconds.
+     */
+    guac_timestamp pending_since;
+
+    /**
+     * The state of the encoder for each channel.
+     */
+    guac_audio_adpcm_state state[GUAC_AUDIO_MAX_CHANNELS];
+
+    /**
+     * Buffer into which the frames of each packet are copied from the pcm
+     * buffer prior to encoding.
+     */
+    int16_t* frames;
+
+    /**
+     * Buffer into which each packet is encoded.
+     */
+    unsigned char* packet;
+
+    /**
+     * The length of the most recently encoded packet, in bytes.
+     */
+    int packet_length;
+
+    /**
+     * Lock which guards the pcm buffer and the flags controlling the encoder
+     * thread. This lock is never held while encoding or sending audio, thus
+     * writing PCM audio never waits for encoding.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Lock which guards the stream, the state of the encoder, and the
+     * buffers used for encoding. The format of the audio is only changed
+     * while both this lock and the lock guarding the pcm buffer are held. If
+     * both locks must be acquired, this lock must be acquired first.
+     */
+    pthread_mutex_t encode_lock;
+
+    /**
+     * Condition which is signalled whenever PCM audio is written, or when
+     * the encoder thread must stop.
+     */
+    pthread_cond_t modified;
+
+    /**
+     * The thread encoding and sending buffered audio.
+     */
+    pthread_t encoder_thread;
+
+    /**
+     * Non-zero if all buffered audio should be encoded and sent immediately,
+     * even if it does not fill a complete packet, zero otherwise.
+     */
+    int flush_requested;
+
+    /**
+     * Non-zero if the encoder thread must stop, zero otherwise.
+     */
+    int stopping;
+
+};
+
+/**
+ * Allocates a new audio stream for the given client, starting its encoder
+ * thread. No audio will be sent until a format is set with
+ * guac_audio_stream_reset().
+ *
+ * @param client
+ *     The client to which audio should be sent.
+ *
+ * @return
+ *     The newly-allocated audio stream, or NULL if the stream or its encoder
+ *     thread could not be allocated.
+ */
+guac_audio_stream* guac_audio_stream_alloc(guac_client* client);
+
+/**
+ * Sets the format of all PCM audio subsequently written to the given audio
+ * stream. Any buffered audio is encoded and sent, the current stream is
+ * ended, and a new stream is announced to all users supporting
+ * GUAC_AUDIO_MIMETYPE. If the format is unchanged, only the buffered audio is
+ * sent.
+ *
+ * @param audio
+ *     The audio stream to reset.
+ *
+ * @param rate
+ *     The number of samples per second of each channel.
+ *
+ * @param channels
+ *     The number of channels, which must not exceed GUAC_AUDIO_MAX_CHANNELS.
+ *
+ * @param bps
+ *     The number of bits per sample, which must be 8 or 16.
+ *
+ * @return
+ *     Zero if the format was set, non-zero if the format is not supported.
+ */
+int guac_audio_stream_reset(guac_audio_stream* audio, int rate, int channels,
+        int bps);
+
+/**
+ * Announces the given audio stream to the given user, who has joined after
+ * the format of that stream was set. If the user does not support
+ * GUAC_AUDIO_MIMETYPE, or no format has yet been set, this function has no
+ * effect.
+ *
+ * @param audio
+ *     The audio stream to announce.
+ *
+ * @param user
+ *     The user joining the client associated with the audio stream.
+ */
+void guac_audio_stream_add_user(guac_audio_stream* audio, guac_user* user);
+
+/**
+ * Buffers the given PCM audio for encoding by the encoder thread. The audio
+ * must be in the format most recently set with guac_audio_stream_reset().
+ * This function never blocks for the duration of encoding.
+ *
+ * @param audio
+ *     The audio stream to write to.
+ *
+ * @param data
+ *     The PCM audio to write, consisting of whole frames.
+ *
+ * @param length
+ *     The number of bytes of PCM audio to write.
+ */
+void guac_audio_stream_write_pcm(guac_audio_stream* audio,
+        const unsigned char* data, int length);
+
+/**
+ * Requests that all buffered audio be encoded and sent immediately, even if
+ * it does not fill a complete packet, such as when playback is paused.
+ *
+ * @param audio
+ *     The audio stream to flush.
+ */
+void guac_audio_stream_flush(guac_audio_stream* audio);
+
+/**
+ * Stops the encoder thread of the given audio stream, ends the stream, and
+ * frees all associated memory. Any audio which has not yet been encoded is
+ * discarded.
+ *
+ * @param audio
+ *     The audio stream to free.
+ */
+void guac_audio_stream_free(guac_audio_stream* audio);
+
+#endif
+
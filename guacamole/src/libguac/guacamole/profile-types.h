@@ -0,0 +1,47 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _GUAC_PROFILE_TYPES_H
+#define _GUAC_PROFILE_TYPES_H
+
+/**
+ * Type definitions related to sampling profiles of native threads.
+ *
+ * @file profile-types.h
+ */
+
+/**
+ * The maximum number of stack frames recorded within each profile sample.
+ */
+#define GUAC_PROFILE_MAX_DEPTH 32
+
+/**
+ * The maximum length of the connection ID recorded with each profile sample,
+ * including null terminator.
+ */
+#define GUAC_PROFILE_ID_LENGTH 64
+
+/**
+ * A single sample of the call stack of a profiled thread.
+ */
+typedef struct guac_profile_sample guac_profile_sample;
+
+#endif
+
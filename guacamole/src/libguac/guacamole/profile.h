@@ -0,0 +1,132 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _GUAC_PROFILE_H
+#define _GUAC_PROFILE_H
+
+/**
+ * Provides a sampling profiler for the native threads of connections. Each
+ * thread which should be profiled registers itself, and the call stacks of
+ * all registered threads are periodically captured while a profile is being
+ * collected. Threads which are not registered, including all threads of the
+ * Go runtime, are never interrupted.
+ *
+ * @file profile.h
+ */
+
+#include "client-types.h"
+#include "profile-types.h"
+
+#include <stdint.h>
+
+struct guac_profile_sample {
+
+    /**
+     * The connection ID of the client associated with the sampled thread.
+     */
+    char connection_id[GUAC_PROFILE_ID_LENGTH];
+
+    /**
+     * The number of nanoseconds of CPU time consumed by the sampled thread
+     * since it was last sampled.
+     */
+    uint64_t cpu_time;
+
+    /**
+     * The number of entries within the stack array.
+     */
+    int depth;
+
+    /**
+     * The program counter of the innermost frame, followed by the return
+     * addresses of each calling frame, as recovered by following frame
+     * pointers. Stacks passing through code compiled without frame pointers
+     * will be truncated.
+     */
+    uintptr_t stack[GUAC_PROFILE_MAX_DEPTH];
+
+};
+
+/**
+ * Registers the current thread for profiling on behalf of the given client.
+ * The thread is automatically unregistered when it exits.
+ *
+ * @param client
+ *     The client on whose behalf the current thread is running.
+ *
+ * @return
+ *     Zero if the thread was successfully registered, non-zero otherwise.
+ */
+int guac_profile_register_thread(guac_client* client);
+
+/**
+ * Collects a profile of all registered threads, sampling the call stack of
+ * each thread at the given frequency for the given duration. Only samples of
+ * threads which consumed CPU time since they were last sampled are returned.
+ * This function blocks for the duration of the profile, and only one profile
+ * may be collected at a time.
+ *
+ * @param duration
+ *     The duration of the profile, in milliseconds.
+ *
+ * @param frequency
+ *     The number of times each thread should be sampled per second.
+ *
+ * @param samples
+ *     Pointer to the location in which a newly-allocated array of samples
+ *     should be stored. This array must be freed with free().
+ *
+ * @return
+ *     The number of samples collected, or a negative value if the profile
+ *     could not be collected, such as because another profile is already
+ *     being collected.
+ */
+int guac_profile_collect(int duration, int frequency,
+        guac_profile_sample** samples);
+
+/**
+ * Resolves the given code address to the nearest preceding dynamic symbol and
+ * the shared object containing it.
+ *
+ * @param address
+ *     The code address to resolve.
+ *
+ * @param name
+ *     Pointer to the location in which the symbol name should be stored. The
+ *     stored value will be NULL if no symbol could be found.
+ *
+ * @param file
+ *     Pointer to the location in which the path of the containing shared
+ *     object should be stored. The stored value will be NULL if the address
+ *     is not within any shared object.
+ *
+ * @param base
+ *     Pointer to the location in which the base address of the containing
+ *     shared object should be stored.
+ *
+ * @return
+ *     Zero if the address could be resolved to a shared object, non-zero
+ *     otherwise.
+ */
+int guac_profile_symbolize(uintptr_t address, const char** name,
+        const char** file, uintptr_t* base);
+
+#endif
+
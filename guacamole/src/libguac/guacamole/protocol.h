@@ -186,6 +186,21 @@ int guac_protocol_send_filesystem(guac_socket* socket,
 
 /* MEDIA INSTRUCTIONS */
 
+/**
+ * Sends an audio instruction over the given guac_socket connection.
+ *
+ * If an error occurs sending the instruction, a non-zero value is
+ * returned, and guac_error is set appropriately.
+ *
+ * @param socket The guac_socket connection to use.
+ * @param stream The stream to use.
+ * @param mimetype The mimetype of the audio data being sent, including any
+ *                 parameters describing the format of that data.
+ * @return Zero on success, non-zero on error.
+ */
+int guac_protocol_send_audio(guac_socket* socket, const guac_stream* stream,
+        const char* mimetype);
+
 /**
  * Sends a file instruction over the given guac_socket connection.
  *
@@ -358,6 +373,57 @@ int guac_protocol_send_img(guac_socket* socket, const guac_stream* stream,
         guac_composite_mode mode, const guac_layer* layer,
         const char* mimetype, int x, int y);
 
+/**
+ * Sends an img instruction over the given guac_socket connection, including
+ * the dimensions of the destination rectangle. The image data received over
+ * the stream will be stretched by the client to cover that rectangle. Clients
+ * which do not support scaled images will ignore the destination dimensions,
+ * thus this instruction must only be sent to users whose clients have
+ * declared support for scaled images.
+ *
+ * If an error occurs sending the instruction, a non-zero value is
+ * returned, and guac_error is set appropriately.
+ *
+ * @param socket
+ *     The guac_socket connection to use when sending the img instruction.
+ *
+ * @param stream
+ *     The stream over which the image data will be sent.
+ *
+ * @param mode
+ *     The composite mode to use when drawing the image over the destination
+ *     layer.
+ *
+ * @param layer
+ *     The destination layer.
+ *
+ * @param mimetype
+ *     The mimetype of the image data being sent.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rectangle
+ *     within the destination layer, in pixels.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rectangle
+ *     within the destination layer, in pixels.
+ *
+ * @param width
+ *     The width of the destination rectangle within the destination layer,
+ *     in pixels.
+ *
+ * @param height
+ *     The height of the destination rectangle within the destination layer,
+ *     in pixels.
+ *
+ * @return
+ *     Zero if the instruction was successfully sent, non-zero on error.
+ */
+int guac_protocol_send_scaled_img(guac_socket* socket,
+        const guac_stream* stream, guac_composite_mode mode,
+        const guac_layer* layer, const char* mimetype, int x, int y,
+        int width, int height);
+
 /**
  * Sends a rect instruction over the given guac_socket connection.
  *
@@ -92,6 +92,15 @@ struct guac_socket {
      */
     guac_timestamp last_write_timestamp;
 
+    /**
+     * The total number of bytes successfully written to this guac_socket
+     * since it was allocated. This value is maintained for the sake of
+     * measuring the cost of outbound data and is only approximate if the
+     * socket is written to concurrently without first acquiring the
+     * instruction lock.
+     */
+    uint64_t bytes_written;
+
     /**
      * The number of bytes present in the base64 "ready" buffer.
      */
@@ -0,0 +1,55 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _GUAC_TRACE_TYPES_H
+#define _GUAC_TRACE_TYPES_H
+
+/**
+ * Type definitions related to frame lifecycle tracing.
+ *
+ * @file trace-types.h
+ */
+
+/**
+ * The phase of a traced event, using the values defined by the Chrome trace
+ * event format.
+ */
+typedef enum guac_trace_phase {
+
+    /**
+     * The start of a span of time. Each span must be closed by a
+     * corresponding GUAC_TRACE_END event having the same name, logged from
+     * the same thread.
+     */
+    GUAC_TRACE_BEGIN = 'B',
+
+    /**
+     * The end of a span of time started by a GUAC_TRACE_BEGIN event.
+     */
+    GUAC_TRACE_END = 'E',
+
+    /**
+     * A single point in time.
+     */
+    GUAC_TRACE_INSTANT = 'i'
+
+} guac_trace_phase;
+
+#endif
+
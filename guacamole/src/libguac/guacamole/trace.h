@@ -0,0 +1,95 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _GUAC_TRACE_H
+#define _GUAC_TRACE_H
+
+/**
+ * Provides functions for recording the lifecycle of frames as trace events,
+ * retained within an in-memory ring buffer and exportable in the Chrome trace
+ * event format. Tracing is disabled by default, in which case recording an
+ * event has no effect.
+ *
+ * @file trace.h
+ */
+
+#include "client-types.h"
+#include "trace-types.h"
+
+#include <stdint.h>
+
+/**
+ * Enables or disables tracing. If enabled, the most recent trace events, up
+ * to the given number of events, are retained in memory. Any previously
+ * retained events are discarded.
+ *
+ * @param size
+ *     The maximum number of events to retain, or zero to disable tracing.
+ *
+ * @return
+ *     Zero if tracing was successfully enabled or disabled, non-zero if the
+ *     memory required to retain the requested number of events could not be
+ *     allocated.
+ */
+int guac_trace_enable(int size);
+
+/**
+ * Returns whether tracing is currently enabled.
+ *
+ * @return
+ *     Non-zero if tracing is enabled, zero otherwise.
+ */
+int guac_trace_enabled();
+
+/**
+ * Records a trace event for the given client. If tracing is disabled, this
+ * function has no effect.
+ *
+ * @param client
+ *     The client associated with the event, or NULL if the event is not
+ *     associated with any particular client.
+ *
+ * @param phase
+ *     The phase of the event.
+ *
+ * @param name
+ *     The name of the event. This must be a string constant, as only the
+ *     pointer is retained.
+ *
+ * @param value
+ *     An arbitrary value to associate with the event, such as the timestamp
+ *     of the frame concerned or the number of bytes processed.
+ */
+void guac_trace_event(guac_client* client, guac_trace_phase phase,
+        const char* name, int64_t value);
+
+/**
+ * Returns all retained trace events as a JSON document in the Chrome trace
+ * event format, suitable for loading into chrome://tracing or Perfetto.
+ * Events of each client are grouped as a separate process.
+ *
+ * @return
+ *     A newly-allocated string containing the JSON document, which must be
+ *     freed with free(), or NULL if the document could not be allocated.
+ */
+char* guac_trace_dump();
+
+#endif
+
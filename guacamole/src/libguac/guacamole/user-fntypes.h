@@ -26,12 +26,15 @@
  * @file user-fntypes.h
  */
 
+#include "client-types.h"
 #include "object-types.h"
 #include "protocol-types.h"
 #include "stream-types.h"
 #include "timestamp-types.h"
 #include "user-types.h"
 
+#include <stdarg.h>
+
 /**
  * Callback which relates to a single guac_user at a time, along with arbitrary
  * data.
@@ -115,6 +118,23 @@ typedef int guac_user_mouse_handler(guac_user* user, int x, int y,
  */
 typedef int guac_user_key_handler(guac_user* user, int keysym, int pressed);
 
+/**
+ * Handler for Guacamole text events, invoked when a "text" event has been
+ * received from a user. Text events carry entire strings of text committed by
+ * the user at once, such as the result of input method (IME) composition.
+ *
+ * @param user
+ *     The user that sent the text event.
+ *
+ * @param text
+ *     The UTF-8 text entered by the user.
+ *
+ * @return
+ *     Zero if the text event was handled successfully, or non-zero if an
+ *     error occurred.
+ */
+typedef int guac_user_text_handler(guac_user* user, const char* text);
+
 /**
  * Handler for Guacamole clipboard streams received from a user. Each such
  * clipboard stream begins when the user sends a "clipboard" instruction. To
@@ -401,5 +421,25 @@ typedef int guac_user_get_handler(guac_user* user, guac_object* object,
 typedef int guac_user_put_handler(guac_user* user, guac_object* object,
         guac_stream* stream, char* mimetype, char* name);
 
-#endif
+/**
+ * Handler for logging messages related to a given guac_user instance. If no
+ * such handler is defined, messages are logged through the log handler of the
+ * client associated with the user.
+ *
+ * @param user
+ *     The user related to the message being logged.
+ *
+ * @param level
+ *     The log level at which to log the given message.
+ *
+ * @param format
+ *     A printf-style format string, defining the message to be logged.
+ *
+ * @param args
+ *     The va_list containing the arguments to be used when filling the
+ *     conversion specifiers ("%s", "%i", etc.) within the format string.
+ */
+typedef void guac_user_log_handler(guac_user* user,
+        guac_client_log_level level, const char* format, va_list args);
 
+#endif
@@ -94,6 +94,12 @@ struct guac_user_info {
      */
     int optimal_height;
 
+    /**
+     * NULL-terminated array of client-supported audio mimetypes. If the client
+     * does not support audio at all, this will be NULL.
+     */
+    const char** audio_mimetypes;
+
     /**
      * NULL-terminated array of client-supported video mimetypes. If the client
      * does not support video at all, this will be NULL.
@@ -116,6 +122,16 @@ struct guac_user_info {
      */
     int optimal_resolution;
 
+    /**
+     * The scale at which the remote client is currently rendering the
+     * display, in thousandths (a value of 1000 denotes that the display is
+     * rendered at actual size). Image updates sent to this user alone may be
+     * downscaled accordingly, as the detail lost would not be visible anyway.
+     * If the client has not reported its scale via a "scale" instruction,
+     * this will be zero, and images will always be sent at full resolution.
+     */
+    int display_scale;
+
 };
 
 struct guac_user {
@@ -189,6 +205,24 @@ struct guac_user {
      */
     int processing_lag;
 
+    /**
+     * The amount of time, in milliseconds, that output to the user was most
+     * recently delayed by bandwidth limits, as reported by whichever
+     * component forwards the user's socket. This is treated as additional
+     * processing lag until throttle_deadline, such that fewer frames are
+     * produced while throttled. As it is reported from outside the threads
+     * of the client, it must only be accessed through
+     * guac_user_report_throttle() and guac_user_get_throttle_lag().
+     */
+    int throttle_lag;
+
+    /**
+     * The time at which the delay most recently reported in throttle_lag
+     * elapses. Once this time has passed, output to the user is no longer
+     * considered throttled, even if no further delay is reported.
+     */
+    guac_timestamp throttle_deadline;
+
     /**
      * Information structure containing properties exposed by the remote
      * user during the initial handshake process.
@@ -480,6 +514,40 @@ struct guac_user {
      */
     guac_user_put_handler* put_handler;
 
+    /**
+     * Handler for logging messages related to this user. If not defined,
+     * messages logged for this user are passed to the log handler of the
+     * associated guac_client.
+     *
+     * Example:
+     * @code
+     *     void log_handler(guac_user* user, guac_client_log_level level,
+     *             const char* format, va_list args);
+     *
+     *     user->log_handler = log_handler;
+     * @endcode
+     */
+    guac_user_log_handler* log_handler;
+
+    /**
+     * Handler for text events sent by the Guacamole web-client, carrying
+     * entire strings of text committed at once, such as the result of input
+     * method (IME) composition. If not defined, each character of the text is
+     * passed to the key handler as a keysym which is pressed and released.
+     *
+     * The handler takes the UTF-8 text entered.
+     *
+     * Example:
+     * @code
+     *     int text_handler(guac_user* user, const char* text);
+     *
+     *     int guac_user_init(guac_user* user, int argc, char** argv) {
+     *         user->text_handler = text_handler;
+     *     }
+     * @endcode
+     */
+    guac_user_text_handler* text_handler;
+
 };
 
 /**
@@ -579,6 +647,36 @@ void guac_user_free_stream(guac_user* user, guac_stream* stream);
  */
 void guac_user_stop(guac_user* user);
 
+/**
+ * Reports that output to the given user is being delayed by bandwidth
+ * limits for the given amount of time, starting now. The delay is treated
+ * as processing lag of the user until it elapses, or until a later report
+ * replaces it. This function may be invoked from any thread.
+ *
+ * @param user
+ *     The user whose output is being delayed.
+ *
+ * @param delay
+ *     The amount of time that output to the user is being delayed, in
+ *     milliseconds. Zero denotes that output is no longer being delayed.
+ */
+void guac_user_report_throttle(guac_user* user, int delay);
+
+/**
+ * Returns the amount of time, in milliseconds, that output to the given
+ * user was most recently delayed by bandwidth limits, as reported by
+ * guac_user_report_throttle(), or zero if that delay has since elapsed.
+ * This function may be invoked from any thread.
+ *
+ * @param user
+ *     The user whose output delay should be returned.
+ *
+ * @return
+ *     The current delay of output to the given user, in milliseconds, or
+ *     zero if output to the user is not being throttled.
+ */
+int guac_user_get_throttle_lag(guac_user* user);
+
 /**
  * Signals the given user to stop gracefully, while also signalling via the
  * Guacamole protocol that an error has occurred. Note that this is a completely
@@ -692,6 +790,47 @@ void guac_user_stream_png(guac_user* user, guac_socket* socket,
         guac_composite_mode mode, const guac_layer* layer, int x, int y,
         cairo_surface_t* surface);
 
+/**
+ * Streams the image data of the given surface over an image stream ("img"
+ * instruction) as PNG-encoded data, requesting that the client stretch the
+ * image to cover the given destination rectangle. This allows a downscaled
+ * copy of an update to be sent to a user who is viewing the display at
+ * reduced scale. The image stream will be automatically allocated and freed.
+ *
+ * @param user
+ *     The Guacamole user for whom the image stream should be allocated.
+ *
+ * @param socket
+ *     The socket over which instructions associated with the image stream
+ *     should be sent.
+ *
+ * @param mode
+ *     The composite mode to use when rendering the image over the given layer.
+ *
+ * @param layer
+ *     The destination layer.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rectangle
+ *     within the given layer.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rectangle
+ *     within the given layer.
+ *
+ * @param width
+ *     The width of the destination rectangle within the given layer.
+ *
+ * @param height
+ *     The height of the destination rectangle within the given layer.
+ *
+ * @param surface
+ *     A Cairo surface containing the image data to be streamed.
+ */
+void guac_user_stream_scaled_png(guac_user* user, guac_socket* socket,
+        guac_composite_mode mode, const guac_layer* layer, int x, int y,
+        int width, int height, cairo_surface_t* surface);
+
 /**
  * Automatically handles a single argument received from a joining user,
  * returning a newly-allocated string containing that value. If the argument
@@ -0,0 +1,537 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+/* Required for pthread_getattr_np(), dladdr() and ucontext register names */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "client.h"
+#include "profile.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+/**
+ * The signal used to interrupt registered threads such that their call stacks
+ * may be sampled. A real-time signal is used to avoid interfering with any
+ * signals handled by the Go runtime or other libraries.
+ */
+#define GUAC_PROFILE_SIGNAL (SIGRTMIN + 3)
+
+/**
+ * The maximum number of milliseconds to wait for a signalled thread to
+ * capture its call stack before skipping that thread.
+ */
+#define GUAC_PROFILE_SAMPLE_TIMEOUT 100
+
+/**
+ * A thread registered for profiling.
+ */
+typedef struct guac_profile_thread {
+
+    /**
+     * The registered thread.
+     */
+    pthread_t thread;
+
+    /**
+     * The clock measuring the CPU time consumed by the registered thread.
+     */
+    clockid_t cpu_clock;
+
+    /**
+     * The CPU time consumed by the registered thread as of the last time it
+     * was sampled, in nanoseconds.
+     */
+    uint64_t last_cpu_time;
+
+    /**
+     * The lowest address within the stack of the registered thread.
+     */
+    uintptr_t stack_low;
+
+    /**
+     * The address immediately following the highest address within the stack
+     * of the registered thread.
+     */
+    uintptr_t stack_high;
+
+    /**
+     * The connection ID of the client on whose behalf the registered thread
+     * is running.
+     */
+    char connection_id[GUAC_PROFILE_ID_LENGTH];
+
+    /**
+     * The next registered thread, or NULL if this is the last.
+     */
+    struct guac_profile_thread* next;
+
+} guac_profile_thread;
+
+/**
+ * All currently-registered threads.
+ */
+static guac_profile_thread* __guac_profile_threads = NULL;
+
+/**
+ * Lock which guards access to the list of registered threads.
+ */
+static pthread_mutex_t __guac_profile_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Lock which is held while a profile is being collected, ensuring only one
+ * profile is collected at a time.
+ */
+static pthread_mutex_t __guac_profile_collect_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Key used to unregister each registered thread upon exit.
+ */
+static pthread_key_t __guac_profile_key;
+
+/**
+ * Guard ensuring the thread-local key and signal handler are initialized
+ * only once.
+ */
+static pthread_once_t __guac_profile_once = PTHREAD_ONCE_INIT;
+
+/**
+ * The thread currently being sampled. Only one thread is sampled at a time.
+ */
+static guac_profile_thread* volatile __guac_profile_target = NULL;
+
+/**
+ * The sequence number of the sample currently requested from
+ * __guac_profile_target, or zero if no sample is requested. The request is
+ * claimed by exactly one signal handler, or cancelled by the sampler if it
+ * times out, by atomically replacing this value with zero.
+ */
+static unsigned int __guac_profile_request = 0;
+
+/**
+ * The sequence number of the most recent sample requested. Only the sampler
+ * accesses this value.
+ */
+static unsigned int __guac_profile_sequence = 0;
+
+/**
+ * The sample populated by the signal handler which claimed the current
+ * request. Only that handler writes to this sample, and only after claiming
+ * the request.
+ */
+static guac_profile_sample __guac_profile_pending;
+
+/**
+ * Semaphore posted by the signal handler once the pending sample has been
+ * populated. It is posted exactly once for each claimed request.
+ */
+static sem_t __guac_profile_captured;
+
+/**
+ * Signal handler which captures the call stack of the interrupted thread by
+ * following frame pointers, storing it as the pending sample if the request
+ * which sent the signal has not since been cancelled. Only async-signal-safe
+ * operations are performed.
+ *
+ * @param sig
+ *     The signal received.
+ *
+ * @param info
+ *     Information describing the signal received.
+ *
+ * @param context
+ *     The ucontext_t describing the state of the interrupted thread.
+ */
+static void __guac_profile_handle_signal(int sig, siginfo_t* info,
+        void* context) {
+
+    ucontext_t* uc = (ucontext_t*) context;
+    unsigned int request = __atomic_load_n(&__guac_profile_request,
+            __ATOMIC_ACQUIRE);
+    guac_profile_thread* target = __guac_profile_target;
+
+    uintptr_t stack[GUAC_PROFILE_MAX_DEPTH];
+    int depth = 0;
+
+    uintptr_t pc = 0;
+    uintptr_t fp = 0;
+
+    /* Ignore signals not sent by the sampler */
+    if (request == 0 || target == NULL
+            || !pthread_equal(target->thread, pthread_self()))
+        return;
+
+#if defined(__x86_64__)
+    pc = (uintptr_t) uc->uc_mcontext.gregs[REG_RIP];
+    fp = (uintptr_t) uc->uc_mcontext.gregs[REG_RBP];
+#elif defined(__i386__)
+    pc = (uintptr_t) uc->uc_mcontext.gregs[REG_EIP];
+    fp = (uintptr_t) uc->uc_mcontext.gregs[REG_EBP];
+#elif defined(__aarch64__)
+    pc = (uintptr_t) uc->uc_mcontext.pc;
+    fp = (uintptr_t) uc->uc_mcontext.regs[29];
+#endif
+
+    if (pc != 0)
+        stack[depth++] = pc;
+
+    /* Follow frame pointers while they remain within the thread's stack */
+    while (depth < GUAC_PROFILE_MAX_DEPTH
+            && fp >= target->stack_low
+            && fp + 2 * sizeof(uintptr_t) <= target->stack_high
+            && fp % sizeof(uintptr_t) == 0) {
+
+        uintptr_t next_fp = ((uintptr_t*) fp)[0];
+        uintptr_t return_address = ((uintptr_t*) fp)[1];
+
+        if (return_address == 0)
+            break;
+
+        stack[depth++] = return_address;
+
+        /* Stacks grow downward; each caller frame must be higher */
+        if (next_fp <= fp)
+            break;
+
+        fp = next_fp;
+
+    }
+
+    /* Claim the request, unless the sampler has already given up on it or
+     * another handler has claimed it */
+    if (!__atomic_compare_exchange_n(&__guac_profile_request, &request, 0,
+                0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return;
+
+    __guac_profile_pending.depth = depth;
+    memcpy(__guac_profile_pending.stack, stack, depth * sizeof(uintptr_t));
+
+    sem_post(&__guac_profile_captured);
+
+}
+
+/**
+ * Removes the given thread from the list of registered threads and frees it.
+ * This function is invoked automatically when a registered thread exits.
+ *
+ * @param data
+ *     The guac_profile_thread of the exiting thread.
+ */
+static void __guac_profile_unregister_thread(void* data) {
+
+    guac_profile_thread* thread = (guac_profile_thread*) data;
+    guac_profile_thread** current;
+
+    pthread_mutex_lock(&__guac_profile_threads_lock);
+
+    for (current = &__guac_profile_threads; *current != NULL;
+            current = &(*current)->next) {
+        if (*current == thread) {
+            *current = thread->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&__guac_profile_threads_lock);
+
+    free(thread);
+
+}
+
+/**
+ * Initializes the thread-local key, semaphore and signal handler used by the
+ * profiler.
+ */
+static void __guac_profile_init() {
+
+    struct sigaction action;
+
+    pthread_key_create(&__guac_profile_key, __guac_profile_unregister_thread);
+    sem_init(&__guac_profile_captured, 0, 0);
+
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = __guac_profile_handle_signal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    sigaction(GUAC_PROFILE_SIGNAL, &action, NULL);
+
+}
+
+/**
+ * Returns the CPU time consumed by the given thread, in nanoseconds.
+ *
+ * @param thread
+ *     The thread to query.
+ *
+ * @return
+ *     The CPU time consumed by the given thread, in nanoseconds.
+ */
+static uint64_t __guac_profile_cpu_time(guac_profile_thread* thread) {
+
+    struct timespec current;
+
+    if (clock_gettime(thread->cpu_clock, &current))
+        return thread->last_cpu_time;
+
+    return (uint64_t) current.tv_sec * 1000000000 + current.tv_nsec;
+
+}
+
+int guac_profile_register_thread(guac_client* client) {
+
+    pthread_attr_t attr;
+    void* stack_addr;
+    size_t stack_size;
+
+    pthread_once(&__guac_profile_once, __guac_profile_init);
+
+    /* Do not register the same thread twice */
+    if (pthread_getspecific(__guac_profile_key) != NULL)
+        return 0;
+
+    guac_profile_thread* thread = calloc(1, sizeof(guac_profile_thread));
+    if (thread == NULL)
+        return 1;
+
+    thread->thread = pthread_self();
+
+    /* Determine stack bounds, such that frame pointers can be validated */
+    if (pthread_getattr_np(thread->thread, &attr)) {
+        free(thread);
+        return 1;
+    }
+
+    pthread_attr_getstack(&attr, &stack_addr, &stack_size);
+    pthread_attr_destroy(&attr);
+
+    thread->stack_low = (uintptr_t) stack_addr;
+    thread->stack_high = (uintptr_t) stack_addr + stack_size;
+
+    /* Track CPU time of thread, such that idle threads are not sampled */
+    if (pthread_getcpuclockid(thread->thread, &thread->cpu_clock)) {
+        free(thread);
+        return 1;
+    }
+
+    thread->last_cpu_time = __guac_profile_cpu_time(thread);
+
+    snprintf(thread->connection_id, sizeof(thread->connection_id), "%s",
+            client->connection_id != NULL ? client->connection_id : "");
+
+    /* Unregister automatically upon thread exit */
+    pthread_setspecific(__guac_profile_key, thread);
+
+    pthread_mutex_lock(&__guac_profile_threads_lock);
+    thread->next = __guac_profile_threads;
+    __guac_profile_threads = thread;
+    pthread_mutex_unlock(&__guac_profile_threads_lock);
+
+    return 0;
+
+}
+
+/**
+ * Samples the call stack of the given thread, appending the sample to the
+ * given array if the thread has consumed CPU time since it was last sampled.
+ * The lock guarding the list of registered threads must be held.
+ *
+ * @param thread
+ *     The thread to sample.
+ *
+ * @param samples
+ *     The array of samples to append to.
+ *
+ * @param count
+ *     The number of samples currently within the array.
+ *
+ * @param available
+ *     The number of samples which the array can currently hold.
+ *
+ * @return
+ *     The new array of samples, which may have been reallocated.
+ */
+static guac_profile_sample* __guac_profile_sample_thread(
+        guac_profile_thread* thread, guac_profile_sample* samples,
+        int* count, int* available) {
+
+    struct timespec timeout;
+    unsigned int request;
+
+    /* Skip threads which have been idle */
+    uint64_t cpu_time = __guac_profile_cpu_time(thread);
+    if (cpu_time == thread->last_cpu_time)
+        return samples;
+
+    /* Skip zero, which denotes the absence of any request */
+    request = ++__guac_profile_sequence;
+    if (request == 0)
+        request = ++__guac_profile_sequence;
+
+    /* Interrupt thread and wait for its stack to be captured */
+    __guac_profile_target = thread;
+    __atomic_store_n(&__guac_profile_request, request, __ATOMIC_RELEASE);
+    if (pthread_kill(thread->thread, GUAC_PROFILE_SIGNAL)) {
+        __atomic_store_n(&__guac_profile_request, 0, __ATOMIC_RELEASE);
+        __guac_profile_target = NULL;
+        return samples;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_nsec += GUAC_PROFILE_SAMPLE_TIMEOUT * 1000000L;
+    if (timeout.tv_nsec >= 1000000000L) {
+        timeout.tv_sec++;
+        timeout.tv_nsec -= 1000000000L;
+    }
+
+    while (sem_timedwait(&__guac_profile_captured, &timeout)) {
+
+        if (errno == EINTR)
+            continue;
+
+        /* Cancel the request if no handler has claimed it. Otherwise, the
+         * claiming handler is about to post, and the sample is still
+         * consumed such that its post is not mistaken for a later one. */
+        if (__atomic_compare_exchange_n(&__guac_profile_request, &request, 0,
+                    0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __guac_profile_target = NULL;
+            return samples;
+        }
+
+        while (sem_wait(&__guac_profile_captured) && errno == EINTR);
+        break;
+
+    }
+
+    __guac_profile_target = NULL;
+
+    /* Grow array as necessary */
+    if (*count == *available) {
+        int new_available = *available ? *available * 2 : 256;
+        guac_profile_sample* new_samples = realloc(samples,
+                new_available * sizeof(guac_profile_sample));
+        if (new_samples == NULL)
+            return samples;
+        samples = new_samples;
+        *available = new_available;
+    }
+
+    /* Store sample, attributing CPU time consumed since the last sample */
+    guac_profile_sample* sample = &samples[(*count)++];
+    *sample = __guac_profile_pending;
+    sample->cpu_time = cpu_time - thread->last_cpu_time;
+    memcpy(sample->connection_id, thread->connection_id,
+            sizeof(sample->connection_id));
+
+    thread->last_cpu_time = cpu_time;
+    return samples;
+
+}
+
+int guac_profile_collect(int duration, int frequency,
+        guac_profile_sample** samples) {
+
+    guac_profile_thread* thread;
+    struct timespec now;
+    uint64_t deadline;
+
+    int count = 0;
+    int available = 0;
+
+    if (duration <= 0 || frequency <= 0 || frequency > 1000)
+        return -1;
+
+    struct timespec interval = {
+        .tv_sec  = 0,
+        .tv_nsec = 1000000000L / frequency
+    };
+
+    pthread_once(&__guac_profile_once, __guac_profile_init);
+
+    /* Only one profile may be collected at a time */
+    if (pthread_mutex_trylock(&__guac_profile_collect_lock))
+        return -1;
+
+    *samples = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    deadline = (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000
+             + duration;
+
+    /* Discard CPU time consumed before profiling began */
+    pthread_mutex_lock(&__guac_profile_threads_lock);
+    for (thread = __guac_profile_threads; thread != NULL; thread = thread->next)
+        thread->last_cpu_time = __guac_profile_cpu_time(thread);
+    pthread_mutex_unlock(&__guac_profile_threads_lock);
+
+    do {
+
+        nanosleep(&interval, NULL);
+
+        /* Sample each registered thread in turn */
+        pthread_mutex_lock(&__guac_profile_threads_lock);
+        for (thread = __guac_profile_threads; thread != NULL;
+                thread = thread->next)
+            *samples = __guac_profile_sample_thread(thread, *samples,
+                    &count, &available);
+        pthread_mutex_unlock(&__guac_profile_threads_lock);
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+    } while ((uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000 < deadline);
+
+    pthread_mutex_unlock(&__guac_profile_collect_lock);
+
+    return count;
+
+}
+
+int guac_profile_symbolize(uintptr_t address, const char** name,
+        const char** file, uintptr_t* base) {
+
+    Dl_info info;
+
+    *name = NULL;
+    *file = NULL;
+    *base = 0;
+
+    if (!dladdr((void*) address, &info))
+        return 1;
+
+    *name = info.dli_sname;
+    *file = info.dli_fname;
+    *base = (uintptr_t) info.dli_fbase;
+
+    return 0;
+
+}
+
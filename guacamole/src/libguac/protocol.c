@@ -80,6 +80,24 @@ int guac_protocol_send_ack(guac_socket* socket, guac_stream* stream,
 
 }
 
+int guac_protocol_send_audio(guac_socket* socket, const guac_stream* stream,
+        const char* mimetype) {
+
+    int ret_val;
+
+    guac_socket_instruction_begin(socket);
+    ret_val =
+           guac_socket_write_string(socket, "5.audio,")
+        || __guac_socket_write_length_int(socket, stream->index)
+        || guac_socket_write_string(socket, ",")
+        || __guac_socket_write_length_string(socket, mimetype)
+        || guac_socket_write_string(socket, ";");
+
+    guac_socket_instruction_end(socket);
+    return ret_val;
+
+}
+
 int guac_protocol_send_blob(guac_socket* socket, const guac_stream* stream,
         const void* data, int count) {
 
@@ -449,6 +467,38 @@ int guac_protocol_send_img(guac_socket* socket, const guac_stream* stream,
 
 }
 
+int guac_protocol_send_scaled_img(guac_socket* socket,
+        const guac_stream* stream, guac_composite_mode mode,
+        const guac_layer* layer, const char* mimetype, int x, int y,
+        int width, int height) {
+
+    int ret_val;
+
+    guac_socket_instruction_begin(socket);
+    ret_val =
+           guac_socket_write_string(socket, "3.img,")
+        || __guac_socket_write_length_int(socket, stream->index)
+        || guac_socket_write_string(socket, ",")
+        || __guac_socket_write_length_int(socket, mode)
+        || guac_socket_write_string(socket, ",")
+        || __guac_socket_write_length_int(socket, layer->index)
+        || guac_socket_write_string(socket, ",")
+        || __guac_socket_write_length_string(socket, mimetype)
+        || guac_socket_write_string(socket, ",")
+        || __guac_socket_write_length_int(socket, x)
+        || guac_socket_write_string(socket, ",")
+        || __guac_socket_write_length_int(socket, y)
+        || guac_socket_write_string(socket, ",")
+        || __guac_socket_write_length_int(socket, width)
+        || guac_socket_write_string(socket, ",")
+        || __guac_socket_write_length_int(socket, height)
+        || guac_socket_write_string(socket, ";");
+
+    guac_socket_instruction_end(socket);
+    return ret_val;
+
+}
+
 int guac_protocol_send_rect(guac_socket* socket,
         const guac_layer* layer, int x, int y, int width, int height) {
 
@@ -41,10 +41,20 @@ static ssize_t __guac_socket_write(guac_socket* socket,
     socket->last_write_timestamp = guac_timestamp_current();
 
     /* If handler defined, call it. */
-    if (socket->write_handler)
-        return socket->write_handler(socket, buf, count);
+    if (socket->write_handler) {
+
+        ssize_t written = socket->write_handler(socket, buf, count);
+
+        /* Record number of bytes written */
+        if (written > 0)
+            socket->bytes_written += written;
+
+        return written;
+
+    }
 
     /* Otherwise, pretend everything was written. */
+    socket->bytes_written += count;
     return count;
 
 }
@@ -109,6 +119,7 @@ guac_socket* guac_socket_alloc() {
     socket->data = NULL;
     socket->state = GUAC_SOCKET_OPEN;
     socket->last_write_timestamp = guac_timestamp_current();
+    socket->bytes_written = 0;
 
     /* No handlers yet */
     socket->read_handler   = NULL;
@@ -0,0 +1,284 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "client.h"
+#include "trace.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#endif
+
+/**
+ * The maximum length of the connection ID recorded with each trace event,
+ * including null terminator.
+ */
+#define GUAC_TRACE_ID_LENGTH 64
+
+/**
+ * The maximum number of bytes required to represent a single trace event as
+ * JSON, excluding the connection ID.
+ */
+#define GUAC_TRACE_EVENT_JSON_LENGTH 256
+
+/**
+ * A single recorded trace event.
+ */
+typedef struct guac_trace_record {
+
+    /**
+     * The time at which the event occurred, in microseconds.
+     */
+    uint64_t time;
+
+    /**
+     * The phase of the event.
+     */
+    guac_trace_phase phase;
+
+    /**
+     * The name of the event.
+     */
+    const char* name;
+
+    /**
+     * The arbitrary value associated with the event.
+     */
+    int64_t value;
+
+    /**
+     * The thread which recorded the event.
+     */
+    unsigned long thread;
+
+    /**
+     * The connection ID of the client associated with the event, or an empty
+     * string if there is no such client.
+     */
+    char connection_id[GUAC_TRACE_ID_LENGTH];
+
+} guac_trace_record;
+
+/**
+ * Ring buffer of all retained trace events, or NULL if tracing is disabled.
+ * The buffer itself is guarded by __guac_trace_lock. The pointer is
+ * additionally stored and loaded atomically, such that whether tracing is
+ * enabled may be checked without acquiring the lock.
+ */
+static guac_trace_record* __guac_trace_records = NULL;
+
+/**
+ * The number of events which may be stored within the ring buffer.
+ */
+static int __guac_trace_size = 0;
+
+/**
+ * The total number of events recorded since tracing was enabled. The index of
+ * the next event to be written within the ring buffer is this value modulo
+ * __guac_trace_size.
+ */
+static uint64_t __guac_trace_count = 0;
+
+/**
+ * Lock which guards all access to the ring buffer.
+ */
+static pthread_mutex_t __guac_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the current time in microseconds, relative to an arbitrary point in
+ * the past.
+ *
+ * @return
+ *     The current time in microseconds.
+ */
+static uint64_t __guac_trace_current_usecs() {
+
+#ifdef HAVE_CLOCK_GETTIME
+
+    struct timespec current;
+
+    /* Get current time, monotonically increasing */
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &current);
+#else
+    clock_gettime(CLOCK_REALTIME, &current);
+#endif
+
+    return (uint64_t) current.tv_sec * 1000000 + current.tv_nsec / 1000;
+
+#else
+
+    struct timeval current;
+
+    /* Get current time */
+    gettimeofday(&current, NULL);
+
+    return (uint64_t) current.tv_sec * 1000000 + current.tv_usec;
+
+#endif
+
+}
+
+/**
+ * Returns a numeric identifier for the given connection ID, for use as the
+ * process ID of trace events associated with that connection.
+ *
+ * @param connection_id
+ *     The connection ID to hash.
+ *
+ * @return
+ *     A positive integer derived from the given connection ID.
+ */
+static unsigned int __guac_trace_hash(const char* connection_id) {
+
+    unsigned int hash = 5381;
+
+    while (*connection_id != '\0')
+        hash = hash * 33 + (unsigned char) *(connection_id++);
+
+    return (hash & 0x7FFFFFFF) + 1;
+
+}
+
+int guac_trace_enable(int size) {
+
+    guac_trace_record* records = NULL;
+
+    /* Allocate new buffer only if tracing is being enabled */
+    if (size > 0) {
+        records = calloc(size, sizeof(guac_trace_record));
+        if (records == NULL)
+            return 1;
+    }
+
+    pthread_mutex_lock(&__guac_trace_lock);
+
+    /* Replace any existing buffer */
+    free(__guac_trace_records);
+    __atomic_store_n(&__guac_trace_records, records, __ATOMIC_RELEASE);
+    __guac_trace_size = size > 0 ? size : 0;
+    __guac_trace_count = 0;
+
+    pthread_mutex_unlock(&__guac_trace_lock);
+
+    return 0;
+
+}
+
+int guac_trace_enabled() {
+    return __atomic_load_n(&__guac_trace_records, __ATOMIC_ACQUIRE) != NULL;
+}
+
+void guac_trace_event(guac_client* client, guac_trace_phase phase,
+        const char* name, int64_t value) {
+
+    /* Do nothing if tracing is disabled, without contending for the lock */
+    if (!guac_trace_enabled())
+        return;
+
+    uint64_t time = __guac_trace_current_usecs();
+
+    pthread_mutex_lock(&__guac_trace_lock);
+
+    /* Recheck now that buffer cannot change, as tracing may have been
+     * disabled since the check above */
+    if (__guac_trace_records != NULL) {
+
+        guac_trace_record* record = &__guac_trace_records[
+            __guac_trace_count++ % __guac_trace_size];
+
+        record->time = time;
+        record->phase = phase;
+        record->name = name;
+        record->value = value;
+        record->thread = (unsigned long) pthread_self();
+
+        /* Copy connection ID, as the client may be freed before the event is
+         * dumped */
+        if (client != NULL && client->connection_id != NULL)
+            snprintf(record->connection_id, sizeof(record->connection_id),
+                    "%s", client->connection_id);
+        else
+            record->connection_id[0] = '\0';
+
+    }
+
+    pthread_mutex_unlock(&__guac_trace_lock);
+
+}
+
+char* guac_trace_dump() {
+
+    pthread_mutex_lock(&__guac_trace_lock);
+
+    uint64_t count = __guac_trace_count;
+    uint64_t first = 0;
+    uint64_t i;
+
+    /* Only the most recent events remain in the ring buffer */
+    if (count > (uint64_t) __guac_trace_size)
+        first = count - __guac_trace_size;
+
+    /* Allocate enough space for all events */
+    size_t length = 64 + (count - first)
+        * (GUAC_TRACE_EVENT_JSON_LENGTH + GUAC_TRACE_ID_LENGTH);
+    char* json = malloc(length);
+    if (json == NULL) {
+        pthread_mutex_unlock(&__guac_trace_lock);
+        return NULL;
+    }
+
+    size_t written = snprintf(json, length, "{\"traceEvents\":[");
+
+    /* Append each retained event, oldest first */
+    for (i = first; i < count; i++) {
+
+        guac_trace_record* record = &__guac_trace_records[i % __guac_trace_size];
+
+        written += snprintf(json + written, length - written,
+                "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRIu64 ","
+                "\"pid\":%u,\"tid\":%lu,%s\"args\":{\"session\":\"%s\","
+                "\"value\":%" PRId64 "}}",
+                i == first ? "" : ",",
+                record->name, (char) record->phase, record->time,
+                __guac_trace_hash(record->connection_id), record->thread,
+                record->phase == GUAC_TRACE_INSTANT ? "\"s\":\"t\"," : "",
+                record->connection_id, record->value);
+
+    }
+
+    snprintf(json + written, length - written,
+            "],\"displayTimeUnit\":\"ms\"}");
+
+    pthread_mutex_unlock(&__guac_trace_lock);
+
+    return json;
+
+}
+
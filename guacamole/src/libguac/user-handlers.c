@@ -24,6 +24,8 @@
 #include "protocol.h"
 #include "stream.h"
 #include "timestamp.h"
+#include "trace.h"
+#include "unicode.h"
 #include "user.h"
 #include "user-handlers.h"
 
@@ -31,6 +33,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Guacamole instruction handler map */
 
@@ -38,9 +41,11 @@ __guac_instruction_handler_mapping __guac_instruction_handler_map[] = {
    {"sync",       __guac_handle_sync},
    {"mouse",      __guac_handle_mouse},
    {"key",        __guac_handle_key},
+   {"text",       __guac_handle_text},
    {"clipboard",  __guac_handle_clipboard},
    {"disconnect", __guac_handle_disconnect},
    {"size",       __guac_handle_size},
+   {"scale",      __guac_handle_scale},
    {"file",       __guac_handle_file},
    {"pipe",       __guac_handle_pipe},
    {"ack",        __guac_handle_ack},
@@ -91,6 +96,8 @@ int __guac_handle_sync(guac_user* user, int argc, char** argv) {
     guac_timestamp current = guac_timestamp_current();
     guac_timestamp timestamp = __guac_parse_int(argv[0]);
 
+    guac_trace_event(user->client, GUAC_TRACE_INSTANT, "sync", timestamp);
+
     /* Error if timestamp is in future */
     if (timestamp > user->client->last_sent_timestamp)
         return -1;
@@ -156,6 +163,47 @@ int __guac_handle_key(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
+int __guac_handle_text(guac_user* user, int argc, char** argv) {
+
+    /* Text is required */
+    if (argc < 1)
+        return 0;
+
+    /* Pass entire text to handler, if defined */
+    if (user->text_handler)
+        return user->text_handler(user, argv[0]);
+
+    /* Otherwise, type each character as a press and release of its keysym */
+    if (user->key_handler) {
+
+        const char* text = argv[0];
+        int length = strlen(text);
+
+        while (length > 0) {
+
+            int codepoint;
+            int bytes = guac_utf8_read(text, length, &codepoint);
+            if (bytes == 0)
+                break;
+
+            text += bytes;
+            length -= bytes;
+
+            /* Latin-1 keysyms match their codepoints, while all other
+             * characters have keysyms derived directly from Unicode */
+            int keysym = codepoint <= 0xFF ? codepoint : 0x1000000 | codepoint;
+
+            user->key_handler(user, keysym, 1);
+            user->key_handler(user, keysym, 0);
+
+        }
+
+    }
+
+    return 0;
+
+}
+
 /**
  * Retrieves the existing user-level input stream having the given index. These
  * will be streams which were created by the remotely-connected user. If the
@@ -312,6 +360,17 @@ int __guac_handle_size(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
+int __guac_handle_scale(guac_user* user, int argc, char** argv) {
+
+    /* Record scale at which client renders display, in thousandths */
+    int scale = atoi(argv[0]);
+    if (scale > 0)
+        user->info.display_scale = scale;
+
+    return 0;
+
+}
+
 int __guac_handle_file(guac_user* user, int argc, char** argv) {
 
     /* Pull corresponding stream */
@@ -92,6 +92,14 @@ __guac_instruction_handler __guac_handle_mouse;
  */
 __guac_instruction_handler __guac_handle_key;
 
+/**
+ * Internal initial handler for the text instruction. When a text instruction
+ * is received, this handler will be called. The client's text handler will
+ * be invoked if defined, otherwise the text is typed through the client's key
+ * handler one character at a time.
+ */
+__guac_instruction_handler __guac_handle_text;
+
 /**
  * Internal initial handler for the clipboard instruction. When a clipboard
  * instruction is received, this handler will be called. The client's clipboard
@@ -155,6 +163,14 @@ __guac_instruction_handler __guac_handle_put;
  */
 __guac_instruction_handler __guac_handle_size;
 
+/**
+ * Internal initial handler for the scale instruction. When a scale
+ * instruction is received, the scale at which the client is rendering the
+ * display is recorded within the user's guac_user_info, allowing image
+ * updates to be downscaled for that user.
+ */
+__guac_instruction_handler __guac_handle_scale;
+
 /**
  * Internal initial handler for the disconnect instruction. When a disconnect
  * instruction is received, this handler will be called. Disconnect
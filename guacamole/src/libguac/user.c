@@ -27,6 +27,7 @@
 #include "socket.h"
 #include "stream.h"
 #include "timestamp.h"
+#include "trace.h"
 #include "user.h"
 #include "user-handlers.h"
 #include "error.h"
@@ -52,6 +53,8 @@ guac_user* guac_user_alloc(char* uid) {
     user->last_received_timestamp = guac_timestamp_current();
     user->last_frame_duration = 0;
     user->processing_lag = 0;
+    user->throttle_lag = 0;
+    user->throttle_deadline = 0;
     user->active = 1;
 
     /* Allocate stream pool */
@@ -188,6 +191,29 @@ void guac_user_stop(guac_user* user) {
     user->active = 0;
 }
 
+void guac_user_report_throttle(guac_user* user, int delay) {
+
+    guac_timestamp deadline = guac_timestamp_current() + delay;
+
+    /* Publish the delay before the deadline which makes it visible */
+    __atomic_store_n(&user->throttle_lag, delay, __ATOMIC_RELAXED);
+    __atomic_store_n(&user->throttle_deadline, deadline, __ATOMIC_RELEASE);
+
+}
+
+int guac_user_get_throttle_lag(guac_user* user) {
+
+    guac_timestamp deadline = __atomic_load_n(&user->throttle_deadline,
+            __ATOMIC_ACQUIRE);
+
+    /* Output is no longer throttled once the reported delay has elapsed */
+    if (guac_timestamp_current() >= deadline)
+        return 0;
+
+    return __atomic_load_n(&user->throttle_lag, __ATOMIC_RELAXED);
+
+}
+
 void vguac_user_abort(guac_user* user, guac_protocol_status status,
         const char* format, va_list ap) {
 
@@ -223,7 +249,13 @@ void guac_user_abort(guac_user* user, guac_protocol_status status,
 void vguac_user_log(guac_user* user, guac_client_log_level level,
         const char* format, va_list ap) {
 
-    vguac_client_log(user->client, level, format, ap);
+    /* Call user-specific handler if defined */
+    if (user->log_handler != NULL)
+        user->log_handler(user, level, format, ap);
+
+    /* Otherwise, log on behalf of the client */
+    else
+        vguac_client_log(user->client, level, format, ap);
 
 }
 
@@ -233,7 +265,7 @@ void guac_user_log(guac_user* user, guac_client_log_level level,
     va_list args;
     va_start(args, format);
 
-    vguac_client_log(user->client, level, format, args);
+    vguac_user_log(user, level, format, args);
 
     va_end(args);
 
@@ -243,6 +275,8 @@ void guac_user_stream_png(guac_user* user, guac_socket* socket,
         guac_composite_mode mode, const guac_layer* layer, int x, int y,
         cairo_surface_t* surface) {
 
+    guac_trace_event(user->client, GUAC_TRACE_BEGIN, "encode", 0);
+
     /* Allocate new stream for image */
     guac_stream* stream = guac_user_alloc_stream(user);
 
@@ -258,6 +292,34 @@ void guac_user_stream_png(guac_user* user, guac_socket* socket,
     /* Free allocated stream */
     guac_user_free_stream(user, stream);
 
+    guac_trace_event(user->client, GUAC_TRACE_END, "encode", 0);
+
+}
+
+void guac_user_stream_scaled_png(guac_user* user, guac_socket* socket,
+        guac_composite_mode mode, const guac_layer* layer, int x, int y,
+        int width, int height, cairo_surface_t* surface) {
+
+    guac_trace_event(user->client, GUAC_TRACE_BEGIN, "encode", 0);
+
+    /* Allocate new stream for image */
+    guac_stream* stream = guac_user_alloc_stream(user);
+
+    /* Declare stream as containing image data to be stretched */
+    guac_protocol_send_scaled_img(socket, stream, mode, layer, "image/png",
+            x, y, width, height);
+
+    /* Write PNG data */
+    guac_png_write(socket, stream, surface);
+
+    /* Terminate stream */
+    guac_protocol_send_end(socket, stream);
+
+    /* Free allocated stream */
+    guac_user_free_stream(user, stream);
+
+    guac_trace_event(user->client, GUAC_TRACE_END, "encode", 0);
+
 }
 
 char* guac_user_parse_args_string(guac_user* user, const char** arg_names,
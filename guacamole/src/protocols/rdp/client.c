@@ -87,6 +87,10 @@ int guac_rdp_client_free_handler(guac_client* client) {
     if (rdp_client->settings != NULL)
         guac_rdp_settings_free(rdp_client->settings);
 
+    /* Free audio stream, if allocated */
+    if (rdp_client->audio != NULL)
+        guac_audio_stream_free(rdp_client->audio);
+
     /* Free display update module */
     guac_rdp_disp_free(rdp_client->disp);
 
@@ -64,6 +64,16 @@
  */
 #define GUAC_RDP_REASONABLE_AREA (800*600)
 
+/**
+ * The smallest desktop scale factor, in percent, accepted by RDP servers.
+ */
+#define GUAC_RDP_MIN_DESKTOP_SCALE_FACTOR 100
+
+/**
+ * The largest desktop scale factor, in percent, accepted by RDP servers.
+ */
+#define GUAC_RDP_MAX_DESKTOP_SCALE_FACTOR 500
+
 /**
  * The maximum number of bytes to allow within the clipboard.
  */
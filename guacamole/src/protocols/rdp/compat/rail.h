@@ -27,6 +27,7 @@
 
 #define RailChannel_Class                  RDP_EVENT_CLASS_RAIL
 #define RailChannel_ClientSystemParam      RDP_EVENT_TYPE_RAIL_CLIENT_SET_SYSPARAMS
+#define RailChannel_ClientWindowMove       RDP_EVENT_TYPE_RAIL_CLIENT_WINDOW_MOVE
 #define RailChannel_GetSystemParam         RDP_EVENT_TYPE_RAIL_CHANNEL_GET_SYSPARAMS
 #define RailChannel_ServerExecuteResult    RDP_EVENT_TYPE_RAIL_CHANNEL_EXEC_RESULTS
 #define RailChannel_ServerSystemParam      RDP_EVENT_TYPE_RAIL_CHANNEL_SERVER_SYSPARAM
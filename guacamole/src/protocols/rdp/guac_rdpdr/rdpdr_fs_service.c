@@ -22,6 +22,7 @@
 
 #include "rdp.h"
 #include "rdpdr_fs_messages.h"
+#include "rdpdr_io.h"
 #include "rdpdr_messages.h"
 #include "rdpdr_service.h"
 
@@ -40,6 +41,15 @@
 static void guac_rdpdr_device_fs_iorequest_handler(guac_rdpdr_device* device,
         wStream* input_stream, int file_id, int completion_id, int major_func, int minor_func) {
 
+    /* Requests other than those performed by the I/O pool must observe the
+     * effects of all prior requests against the same file */
+    if (major_func != IRP_MJ_CREATE
+            && major_func != IRP_MJ_READ
+            && major_func != IRP_MJ_WRITE
+            && !(major_func == IRP_MJ_DIRECTORY_CONTROL
+                && minor_func == IRP_MN_QUERY_DIRECTORY))
+        guac_rdpdr_io_pool_wait(device->io_pool, file_id);
+
     switch (major_func) {
 
         /* File open */
@@ -52,14 +62,18 @@ static void guac_rdpdr_device_fs_iorequest_handler(guac_rdpdr_device* device,
             guac_rdpdr_fs_process_close(device, input_stream, file_id, completion_id);
             break;
 
-        /* File read */
+        /* File read (may block, thus performed by I/O pool) */
         case IRP_MJ_READ:
-            guac_rdpdr_fs_process_read(device, input_stream, file_id, completion_id);
+            guac_rdpdr_io_pool_submit(device->io_pool,
+                    guac_rdpdr_fs_process_read, input_stream,
+                    file_id, completion_id);
             break;
 
-        /* File write */
+        /* File write (may block, thus performed by I/O pool) */
         case IRP_MJ_WRITE:
-            guac_rdpdr_fs_process_write(device, input_stream, file_id, completion_id);
+            guac_rdpdr_io_pool_submit(device->io_pool,
+                    guac_rdpdr_fs_process_write, input_stream,
+                    file_id, completion_id);
             break;
 
         /* Device control request (Windows FSCTL_ control codes) */
@@ -89,9 +103,12 @@ static void guac_rdpdr_device_fs_iorequest_handler(guac_rdpdr_device* device,
 
         case IRP_MJ_DIRECTORY_CONTROL:
 
-            /* Enumerate directory contents */
+            /* Enumerate directory contents (may block, thus performed by
+             * I/O pool) */
             if (minor_func == IRP_MN_QUERY_DIRECTORY)
-                guac_rdpdr_fs_process_query_directory(device, input_stream, file_id, completion_id);
+                guac_rdpdr_io_pool_submit(device->io_pool,
+                        guac_rdpdr_fs_process_query_directory, input_stream,
+                        file_id, completion_id);
 
             /* Request notification of changes to directory */
             else if (minor_func == IRP_MN_NOTIFY_CHANGE_DIRECTORY)
@@ -115,6 +132,7 @@ static void guac_rdpdr_device_fs_iorequest_handler(guac_rdpdr_device* device,
 
 static void guac_rdpdr_device_fs_free_handler(guac_rdpdr_device* device) {
 
+    guac_rdpdr_io_pool_free(device->io_pool);
     Stream_Free(device->device_announce, 1);
     
 }
@@ -153,5 +171,8 @@ void guac_rdpdr_register_fs(guac_rdpdrPlugin* rdpdr, char* drive_name) {
     /* Init data */
     device->data = rdp_client->filesystem;
 
+    /* Perform blocking I/O requests outside the channel thread */
+    device->io_pool = guac_rdpdr_io_pool_alloc(device);
+
 }
 
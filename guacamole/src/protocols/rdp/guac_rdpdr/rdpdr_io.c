@@ -0,0 +1,302 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "rdpdr_io.h"
+#include "rdpdr_service.h"
+
+#include <guacamole/client.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#ifdef ENABLE_WINPR
+#include <winpr/stream.h>
+#else
+#include "compat/winpr-stream.h"
+#endif
+
+/**
+ * Returns whether a request targeting the given file is currently in
+ * progress. The pool must be locked.
+ *
+ * @param pool
+ *     The pool performing requests.
+ *
+ * @param file_id
+ *     The ID of the file to check.
+ *
+ * @return
+ *     Non-zero if a request targeting the given file is in progress, zero
+ *     otherwise.
+ */
+static int __guac_rdpdr_io_pool_is_active(guac_rdpdr_io_pool* pool,
+        int file_id) {
+
+    int i;
+
+    for (i = 0; i < GUAC_RDPDR_IO_THREADS; i++) {
+        if (pool->active_files[i] == file_id)
+            return 1;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Returns whether any request targeting the given file is queued or in
+ * progress. The pool must be locked.
+ *
+ * @param pool
+ *     The pool performing requests.
+ *
+ * @param file_id
+ *     The ID of the file to check.
+ *
+ * @return
+ *     Non-zero if a request targeting the given file is queued or in
+ *     progress, zero otherwise.
+ */
+static int __guac_rdpdr_io_pool_is_pending(guac_rdpdr_io_pool* pool,
+        int file_id) {
+
+    guac_rdpdr_io_request* request;
+
+    if (__guac_rdpdr_io_pool_is_active(pool, file_id))
+        return 1;
+
+    for (request = pool->first; request != NULL; request = request->next) {
+        if (request->file_id == file_id)
+            return 1;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Removes and returns the oldest queued request whose file has no request in
+ * progress, such that requests against the same file are performed in order
+ * while requests against other files proceed. The pool must be locked.
+ *
+ * @param pool
+ *     The pool performing requests.
+ *
+ * @return
+ *     The next request to perform, or NULL if no request may currently be
+ *     performed.
+ */
+static guac_rdpdr_io_request* __guac_rdpdr_io_pool_next(
+        guac_rdpdr_io_pool* pool) {
+
+    guac_rdpdr_io_request* previous = NULL;
+    guac_rdpdr_io_request* request = pool->first;
+
+    while (request != NULL) {
+
+        /* Remove first request whose file is idle */
+        if (!__guac_rdpdr_io_pool_is_active(pool, request->file_id)) {
+
+            if (previous != NULL)
+                previous->next = request->next;
+            else
+                pool->first = request->next;
+
+            if (pool->last == request)
+                pool->last = previous;
+
+            return request;
+
+        }
+
+        previous = request;
+        request = request->next;
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Thread which repeatedly performs queued requests until the pool is stopped.
+ *
+ * @param data
+ *     The guac_rdpdr_io_pool whose requests should be performed.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __guac_rdpdr_io_pool_thread(void* data) {
+
+    guac_rdpdr_io_pool* pool = (guac_rdpdr_io_pool*) data;
+    guac_rdpdr_io_request* request;
+    int slot;
+
+    pthread_mutex_lock(&(pool->lock));
+
+    for (;;) {
+
+        /* Wait for a request which may be performed */
+        while (!pool->stopping
+                && (request = __guac_rdpdr_io_pool_next(pool)) == NULL)
+            pthread_cond_wait(&(pool->modified), &(pool->lock));
+
+        if (pool->stopping)
+            break;
+
+        /* Claim a slot, of which there is always one per thread */
+        for (slot = 0; pool->active_files[slot] != -1; slot++);
+        pool->active_files[slot] = request->file_id;
+
+        /* Perform request without blocking other threads */
+        pthread_mutex_unlock(&(pool->lock));
+        request->handler(pool->device, request->input_stream,
+                request->file_id, request->completion_id);
+        Stream_Free(request->input_stream, 1);
+        free(request);
+        pthread_mutex_lock(&(pool->lock));
+
+        /* Release slot */
+        pool->active_files[slot] = -1;
+        pool->pending--;
+        pthread_cond_broadcast(&(pool->modified));
+
+    }
+
+    pthread_mutex_unlock(&(pool->lock));
+    return NULL;
+
+}
+
+guac_rdpdr_io_pool* guac_rdpdr_io_pool_alloc(guac_rdpdr_device* device) {
+
+    int i;
+
+    guac_rdpdr_io_pool* pool = calloc(1, sizeof(guac_rdpdr_io_pool));
+    pool->device = device;
+
+    pthread_mutex_init(&(pool->lock), NULL);
+    pthread_cond_init(&(pool->modified), NULL);
+
+    for (i = 0; i < GUAC_RDPDR_IO_THREADS; i++)
+        pool->active_files[i] = -1;
+
+    /* Start threads, performing requests on the channel thread if none can
+     * be started */
+    for (i = 0; i < GUAC_RDPDR_IO_THREADS; i++) {
+
+        if (pthread_create(&(pool->threads[pool->thread_count]), NULL,
+                    __guac_rdpdr_io_pool_thread, pool)) {
+            guac_client_log(device->rdpdr->client, GUAC_LOG_WARNING,
+                    "Unable to start I/O thread for device %i (%s).",
+                    device->device_id, device->device_name);
+            break;
+        }
+
+        pool->thread_count++;
+
+    }
+
+    return pool;
+
+}
+
+void guac_rdpdr_io_pool_submit(guac_rdpdr_io_pool* pool,
+        guac_rdpdr_io_handler* handler, wStream* input_stream,
+        int file_id, int completion_id) {
+
+    guac_rdpdr_io_request* request;
+    int length;
+
+    /* Perform request immediately if no threads are available */
+    if (pool->thread_count == 0) {
+        handler(pool->device, input_stream, file_id, completion_id);
+        return;
+    }
+
+    /* Copy remainder of request, as the channel will free the original */
+    length = Stream_Length(input_stream) - Stream_GetPosition(input_stream);
+    request = malloc(sizeof(guac_rdpdr_io_request));
+    request->handler = handler;
+    request->input_stream = Stream_New(NULL, length);
+    request->file_id = file_id;
+    request->completion_id = completion_id;
+    request->next = NULL;
+
+    Stream_Write(request->input_stream, Stream_Pointer(input_stream), length);
+    Stream_SetPosition(request->input_stream, 0);
+
+    pthread_mutex_lock(&(pool->lock));
+
+    /* Apply backpressure once too many requests are pending */
+    while (pool->pending >= GUAC_RDPDR_IO_MAX_PENDING)
+        pthread_cond_wait(&(pool->modified), &(pool->lock));
+
+    /* Add request to end of queue */
+    if (pool->last != NULL)
+        pool->last->next = request;
+    else
+        pool->first = request;
+
+    pool->last = request;
+    pool->pending++;
+
+    pthread_cond_broadcast(&(pool->modified));
+    pthread_mutex_unlock(&(pool->lock));
+
+}
+
+void guac_rdpdr_io_pool_wait(guac_rdpdr_io_pool* pool, int file_id) {
+
+    pthread_mutex_lock(&(pool->lock));
+
+    while (__guac_rdpdr_io_pool_is_pending(pool, file_id))
+        pthread_cond_wait(&(pool->modified), &(pool->lock));
+
+    pthread_mutex_unlock(&(pool->lock));
+
+}
+
+void guac_rdpdr_io_pool_free(guac_rdpdr_io_pool* pool) {
+
+    int i;
+
+    /* Allow all pending requests to complete before stopping */
+    pthread_mutex_lock(&(pool->lock));
+
+    while (pool->pending > 0)
+        pthread_cond_wait(&(pool->modified), &(pool->lock));
+
+    pool->stopping = 1;
+    pthread_cond_broadcast(&(pool->modified));
+    pthread_mutex_unlock(&(pool->lock));
+
+    for (i = 0; i < pool->thread_count; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&(pool->modified));
+    pthread_mutex_destroy(&(pool->lock));
+    free(pool);
+
+}
+
@@ -0,0 +1,235 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef __GUAC_RDPDR_IO_H
+#define __GUAC_RDPDR_IO_H
+
+/**
+ * A pool of threads which perform device I/O requests independently of the
+ * RDPDR channel thread, such that requests which block on slow storage do
+ * not stall processing of other channels.
+ *
+ * @file rdpdr_io.h
+ */
+
+#include "config.h"
+
+#include "rdpdr_service.h"
+
+#include <pthread.h>
+
+#ifdef ENABLE_WINPR
+#include <winpr/stream.h>
+#else
+#include "compat/winpr-stream.h"
+#endif
+
+/**
+ * The number of threads performing I/O requests for each device.
+ */
+#define GUAC_RDPDR_IO_THREADS 4
+
+/**
+ * The maximum number of I/O requests which may be queued or in progress for
+ * each device at any one time. Once this many requests are pending, further
+ * requests block the RDPDR channel thread until a request completes,
+ * bounding the memory consumed by the requests of each session.
+ */
+#define GUAC_RDPDR_IO_MAX_PENDING 32
+
+/**
+ * Handler which performs an I/O request, sending its completion along the
+ * RDPDR channel once done.
+ *
+ * @param device
+ *     The device which received the I/O request.
+ *
+ * @param input_stream
+ *     The remaining contents of the I/O request, following its header.
+ *
+ * @param file_id
+ *     The ID of the file targeted by the I/O request.
+ *
+ * @param completion_id
+ *     The completion ID which must be included within the completion of the
+ *     I/O request.
+ */
+typedef void guac_rdpdr_io_handler(guac_rdpdr_device* device,
+        wStream* input_stream, int file_id, int completion_id);
+
+/**
+ * A single I/O request awaiting a thread of the I/O pool.
+ */
+typedef struct guac_rdpdr_io_request guac_rdpdr_io_request;
+
+struct guac_rdpdr_io_request {
+
+    /**
+     * The handler which performs this request.
+     */
+    guac_rdpdr_io_handler* handler;
+
+    /**
+     * Copy of the remaining contents of the I/O request, owned by this
+     * request.
+     */
+    wStream* input_stream;
+
+    /**
+     * The ID of the file targeted by this request.
+     */
+    int file_id;
+
+    /**
+     * The completion ID of this request.
+     */
+    int completion_id;
+
+    /**
+     * The next request in the queue, or NULL if this is the last request.
+     */
+    guac_rdpdr_io_request* next;
+
+};
+
+/**
+ * A pool of threads performing the I/O requests of a single device. Requests
+ * targeting different files are performed concurrently and may complete out
+ * of order, as allowed by RDPDR. Requests targeting the same file are
+ * performed in the order received.
+ */
+struct guac_rdpdr_io_pool {
+
+    /**
+     * The device whose requests are performed by this pool.
+     */
+    guac_rdpdr_device* device;
+
+    /**
+     * Lock which guards all other members of this pool.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever a request is queued or
+     * completes, or the pool is stopping.
+     */
+    pthread_cond_t modified;
+
+    /**
+     * The oldest queued request, or NULL if no requests are queued.
+     */
+    guac_rdpdr_io_request* first;
+
+    /**
+     * The most recently queued request, or NULL if no requests are queued.
+     */
+    guac_rdpdr_io_request* last;
+
+    /**
+     * The number of requests queued or in progress.
+     */
+    int pending;
+
+    /**
+     * The ID of the file targeted by the request in progress within each
+     * slot, or -1 if the slot is unused.
+     */
+    int active_files[GUAC_RDPDR_IO_THREADS];
+
+    /**
+     * Non-zero if the threads of this pool should exit, zero otherwise.
+     */
+    int stopping;
+
+    /**
+     * The number of threads successfully started.
+     */
+    int thread_count;
+
+    /**
+     * All threads performing requests.
+     */
+    pthread_t threads[GUAC_RDPDR_IO_THREADS];
+
+};
+
+/**
+ * Allocates a new I/O pool for the given device, starting its threads.
+ *
+ * @param device
+ *     The device whose requests will be performed by the pool.
+ *
+ * @return
+ *     A newly-allocated I/O pool, which must eventually be freed with
+ *     guac_rdpdr_io_pool_free().
+ */
+guac_rdpdr_io_pool* guac_rdpdr_io_pool_alloc(guac_rdpdr_device* device);
+
+/**
+ * Queues the given I/O request for performance by a thread of the given
+ * pool, copying the remaining contents of the request. If the maximum number
+ * of requests are already pending, this function blocks until a request
+ * completes.
+ *
+ * @param pool
+ *     The pool which should perform the request.
+ *
+ * @param handler
+ *     The handler which performs the request.
+ *
+ * @param input_stream
+ *     The I/O request, positioned immediately after its header.
+ *
+ * @param file_id
+ *     The ID of the file targeted by the request.
+ *
+ * @param completion_id
+ *     The completion ID of the request.
+ */
+void guac_rdpdr_io_pool_submit(guac_rdpdr_io_pool* pool,
+        guac_rdpdr_io_handler* handler, wStream* input_stream,
+        int file_id, int completion_id);
+
+/**
+ * Waits for all queued and in-progress requests targeting the given file to
+ * complete. This must be invoked before handling any request outside the
+ * pool which may observe or alter the state of that file, such as closing
+ * it.
+ *
+ * @param pool
+ *     The pool performing requests.
+ *
+ * @param file_id
+ *     The ID of the file whose requests should complete.
+ */
+void guac_rdpdr_io_pool_wait(guac_rdpdr_io_pool* pool, int file_id);
+
+/**
+ * Waits for all pending requests of the given pool to complete, stops its
+ * threads, and frees the pool.
+ *
+ * @param pool
+ *     The pool to free.
+ */
+void guac_rdpdr_io_pool_free(guac_rdpdr_io_pool* pool);
+
+#endif
+
@@ -39,6 +39,7 @@
 
 typedef struct guac_rdpdrPlugin guac_rdpdrPlugin;
 typedef struct guac_rdpdr_device guac_rdpdr_device;
+typedef struct guac_rdpdr_io_pool guac_rdpdr_io_pool;
 
 /**
  * Handler for client device list announce. Each implementing device must write
@@ -109,6 +110,12 @@ struct guac_rdpdr_device {
      */
     guac_rdpdr_device_free_handler* free_handler;
 
+    /**
+     * Pool of threads performing the I/O requests of this device which may
+     * block, or NULL if all I/O requests are handled on the channel thread.
+     */
+    guac_rdpdr_io_pool* io_pool;
+
     /**
      * Arbitrary data, used internally by the handlers for this device.
      */
@@ -0,0 +1,351 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "rdp.h"
+#include "rdpsnd_messages.h"
+#include "rdpsnd_service.h"
+
+#include <freerdp/utils/svc_plugin.h>
+#include <guacamole/audio.h>
+#include <guacamole/client.h>
+
+#ifdef ENABLE_WINPR
+#include <winpr/stream.h>
+#else
+#include "compat/winpr-stream.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Returns the audio stream of the client owning the given RDPSND plugin, or
+ * NULL if audio is disabled.
+ */
+static guac_audio_stream* guac_rdpsnd_get_audio(guac_rdpsndPlugin* rdpsnd) {
+    guac_rdp_client* rdp_client = (guac_rdp_client*) rdpsnd->client->data;
+    return rdp_client->audio;
+}
+
+/**
+ * Sets the format of the audio stream to the agreed format having the given
+ * index, returning non-zero if no such format exists or the audio stream is
+ * unavailable.
+ */
+static int guac_rdpsnd_select_format(guac_rdpsndPlugin* rdpsnd, int format) {
+
+    guac_audio_stream* audio = guac_rdpsnd_get_audio(rdpsnd);
+    if (audio == NULL)
+        return 1;
+
+    if (format < 0 || format >= rdpsnd->format_count) {
+        guac_client_log(rdpsnd->client, GUAC_LOG_WARNING,
+                "RDP server requested unknown audio format %i.", format);
+        return 1;
+    }
+
+    /* Reset stream only if the format is actually changing */
+    return guac_audio_stream_reset(audio,
+            rdpsnd->formats[format].rate,
+            rdpsnd->formats[format].channels,
+            rdpsnd->formats[format].bps);
+
+}
+
+/**
+ * Sends a Wave Confirm PDU acknowledging the block having the given number,
+ * as received at the given server timestamp.
+ */
+static void guac_rdpsnd_send_wave_confirm(guac_rdpsndPlugin* rdpsnd,
+        int timestamp, int block_number) {
+
+    wStream* output_stream = Stream_New(NULL, 8);
+
+    /* Write header */
+    Stream_Write_UINT8(output_stream, SNDC_WAVECONFIRM);
+    Stream_Write_UINT8(output_stream, 0);
+    Stream_Write_UINT16(output_stream, 4);
+
+    /* Write content */
+    Stream_Write_UINT16(output_stream, timestamp);
+    Stream_Write_UINT8(output_stream, block_number);
+    Stream_Write_UINT8(output_stream, 0);
+
+    svc_plugin_send((rdpSvcPlugin*) rdpsnd, output_stream);
+
+}
+
+/* MESSAGE HANDLERS */
+
+void guac_rdpsnd_formats_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header) {
+
+    int server_format_count;
+    int server_version;
+    int i;
+
+    wStream* output_stream;
+    int output_body_size;
+    unsigned char* output_stream_end;
+
+    /* Reset own format count */
+    rdpsnd->format_count = 0;
+
+    /* Format header */
+    Stream_Seek(input_stream, 14);
+    Stream_Read_UINT16(input_stream, server_format_count);
+    Stream_Seek_UINT8(input_stream);
+    Stream_Read_UINT16(input_stream, server_version);
+    Stream_Seek_UINT8(input_stream);
+
+    /* Initialize Client Audio Formats and Version PDU */
+    output_stream = Stream_New(NULL, 24);
+    Stream_Write_UINT8(output_stream,  SNDC_FORMATS);
+    Stream_Write_UINT8(output_stream,  0);
+
+    /* Fill in body size later */
+    Stream_Seek_UINT16(output_stream); /* offset = 0x02 */
+
+    /* Flags, volume, and pitch */
+    Stream_Write_UINT32(output_stream, TSSNDCAPS_ALIVE);
+    Stream_Write_UINT32(output_stream, 0);
+    Stream_Write_UINT32(output_stream, 0);
+
+    /* Datagram port (UDP) */
+    Stream_Write_UINT16(output_stream, 0);
+
+    /* Fill in format count later */
+    Stream_Seek_UINT16(output_stream); /* offset = 0x12 */
+
+    /* Version and padding */
+    Stream_Write_UINT8(output_stream,  0);
+    Stream_Write_UINT16(output_stream, GUAC_RDPSND_VERSION);
+    Stream_Write_UINT8(output_stream,  0);
+
+    /* Check each server format, respond if supported */
+    for (i=0; i < server_format_count; i++) {
+
+        unsigned char* format_start;
+
+        int format_tag;
+        int channels;
+        int rate;
+        int bps;
+        int body_size;
+
+        /* Remember position in stream */
+        Stream_GetPointer(input_stream, format_start);
+
+        /* Read format */
+        Stream_Read_UINT16(input_stream, format_tag);
+        Stream_Read_UINT16(input_stream, channels);
+        Stream_Read_UINT32(input_stream, rate);
+        Stream_Seek_UINT32(input_stream);
+        Stream_Seek_UINT16(input_stream);
+        Stream_Read_UINT16(input_stream, bps);
+
+        /* Skip past extra data */
+        Stream_Read_UINT16(input_stream, body_size);
+        Stream_Seek(input_stream, body_size);
+
+        /* Only PCM in a format supported by the audio stream is accepted */
+        if (format_tag != WAVE_FORMAT_PCM
+                || channels < 1 || channels > GUAC_AUDIO_MAX_CHANNELS
+                || (bps != 8 && bps != 16))
+            continue;
+
+        /* Ignore further formats if no room remains */
+        if (rdpsnd->format_count == GUAC_RDP_MAX_FORMATS) {
+            guac_client_log(rdpsnd->client, GUAC_LOG_INFO,
+                    "Dropped valid format: %i Hz, %i channels, "
+                    "%i bits per sample", rate, channels, bps);
+            continue;
+        }
+
+        /* Store format */
+        rdpsnd->formats[rdpsnd->format_count].rate     = rate;
+        rdpsnd->formats[rdpsnd->format_count].channels = channels;
+        rdpsnd->formats[rdpsnd->format_count].bps      = bps;
+        rdpsnd->format_count++;
+
+        /* Ensure audio format will fit in stream */
+        Stream_EnsureRemainingCapacity(output_stream, 18 + body_size);
+
+        /* Copy format verbatim */
+        Stream_Write(output_stream, format_start, 18 + body_size);
+
+        guac_client_log(rdpsnd->client, GUAC_LOG_INFO,
+                "Accepted format: %i-bit PCM with %i channels at "
+                "%i Hz", bps, channels, rate);
+
+    }
+
+    /* Calculate size of PDU */
+    output_body_size = Stream_GetPosition(output_stream) - 4;
+    Stream_GetPointer(output_stream, output_stream_end);
+
+    /* Set body size */
+    Stream_SetPosition(output_stream, 0x02);
+    Stream_Write_UINT16(output_stream, output_body_size);
+
+    /* Set format count */
+    Stream_SetPosition(output_stream, 0x12);
+    Stream_Write_UINT16(output_stream, rdpsnd->format_count);
+
+    /* Reposition cursor at end (necessary for message send) */
+    Stream_SetPointer(output_stream, output_stream_end);
+
+    /* Send accepted formats */
+    svc_plugin_send((rdpSvcPlugin*) rdpsnd, output_stream);
+
+    /* If version greater than 6, must send Quality Mode PDU */
+    if (server_version >= 6) {
+
+        /* Always send High Quality for now */
+        output_stream = Stream_New(NULL, 8);
+        Stream_Write_UINT8(output_stream, SNDC_QUALITYMODE);
+        Stream_Write_UINT8(output_stream, 0);
+        Stream_Write_UINT16(output_stream, 4);
+        Stream_Write_UINT16(output_stream, HIGH_QUALITY);
+        Stream_Write_UINT16(output_stream, 0);
+
+        svc_plugin_send((rdpSvcPlugin*) rdpsnd, output_stream);
+
+    }
+
+}
+
+void guac_rdpsnd_training_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header) {
+
+    int data_size;
+    wStream* output_stream;
+
+    /* Read timestamp and data size */
+    Stream_Read_UINT16(input_stream, rdpsnd->server_timestamp);
+    Stream_Read_UINT16(input_stream, data_size);
+
+    /* Send training response */
+    output_stream = Stream_New(NULL, 8);
+    Stream_Write_UINT8(output_stream, SNDC_TRAINING);
+    Stream_Write_UINT8(output_stream, 0);
+    Stream_Write_UINT16(output_stream, 4);
+    Stream_Write_UINT16(output_stream, rdpsnd->server_timestamp);
+    Stream_Write_UINT16(output_stream, data_size);
+
+    svc_plugin_send((rdpSvcPlugin*) rdpsnd, output_stream);
+
+}
+
+void guac_rdpsnd_wave_info_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header) {
+
+    int format;
+
+    /* Read wave information */
+    Stream_Read_UINT16(input_stream, rdpsnd->server_timestamp);
+    Stream_Read_UINT16(input_stream, format);
+    Stream_Read_UINT8(input_stream, rdpsnd->waveinfo_block_number);
+    Stream_Seek(input_stream, 3);
+    Stream_Read(input_stream, rdpsnd->initial_wave_data, 4);
+
+    /*
+     * Size of incoming wave data is equal to the body size field of this
+     * header, less the size of a WaveInfo PDU (not including the header),
+     * thus body_size - 12.
+     */
+    rdpsnd->incoming_wave_size = header->body_size - 12;
+
+    /* Read wave in next iteration */
+    rdpsnd->next_pdu_is_wave = 1;
+
+    /* Switch to format of coming wave, if necessary */
+    guac_rdpsnd_select_format(rdpsnd, format);
+
+}
+
+void guac_rdpsnd_wave_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header) {
+
+    guac_audio_stream* audio = guac_rdpsnd_get_audio(rdpsnd);
+
+    /* Wave Confirmation PDU is sent regardless of whether audio is
+     * actually streamed, as the server otherwise stalls */
+    unsigned char* buffer = Stream_Buffer(input_stream);
+
+    /* Restore the four bytes of wave data sent within the WaveInfo PDU */
+    memcpy(buffer, rdpsnd->initial_wave_data, 4);
+
+    /* Hand off to encoder thread, never blocking for encoding */
+    if (audio != NULL && rdpsnd->incoming_wave_size + 4
+            <= (int) Stream_Length(input_stream))
+        guac_audio_stream_write_pcm(audio, buffer,
+                rdpsnd->incoming_wave_size + 4);
+
+    guac_rdpsnd_send_wave_confirm(rdpsnd, rdpsnd->server_timestamp,
+            rdpsnd->waveinfo_block_number);
+
+    rdpsnd->next_pdu_is_wave = 0;
+
+}
+
+void guac_rdpsnd_wave2_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header) {
+
+    guac_audio_stream* audio = guac_rdpsnd_get_audio(rdpsnd);
+
+    int format;
+    int block_number;
+    int wave_size = header->body_size - 12;
+
+    /* Read wave information, ignoring the audio timestamp */
+    Stream_Read_UINT16(input_stream, rdpsnd->server_timestamp);
+    Stream_Read_UINT16(input_stream, format);
+    Stream_Read_UINT8(input_stream, block_number);
+    Stream_Seek(input_stream, 3);
+    Stream_Seek_UINT32(input_stream);
+
+    /* Hand off to encoder thread in the format given */
+    if (guac_rdpsnd_select_format(rdpsnd, format) == 0 && wave_size > 0
+            && Stream_GetPosition(input_stream) + wave_size
+                <= Stream_Length(input_stream)) {
+        unsigned char* buffer;
+        Stream_GetPointer(input_stream, buffer);
+        guac_audio_stream_write_pcm(audio, buffer, wave_size);
+    }
+
+    guac_rdpsnd_send_wave_confirm(rdpsnd, rdpsnd->server_timestamp,
+            block_number);
+
+}
+
+void guac_rdpsnd_close_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header) {
+
+    guac_audio_stream* audio = guac_rdpsnd_get_audio(rdpsnd);
+
+    /* Send remaining audio without waiting for the packet to fill */
+    if (audio != NULL)
+        guac_audio_stream_flush(audio);
+
+}
+
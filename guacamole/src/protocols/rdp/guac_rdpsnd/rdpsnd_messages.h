@@ -0,0 +1,140 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef __GUAC_RDPSND_MESSAGES_H
+#define __GUAC_RDPSND_MESSAGES_H
+
+#include "config.h"
+
+#include "rdpsnd_service.h"
+
+#ifdef ENABLE_WINPR
+#include <winpr/stream.h>
+#else
+#include "compat/winpr-stream.h"
+#endif
+
+/*
+ * PDU Message Types as required by the RDP spec (see: [MS-RDPEA].pdf)
+ */
+
+#define SNDC_CLOSE         0x01
+#define SNDC_WAVE          0x02
+#define SNDC_SETVOLUME     0x03
+#define SNDC_SETPITCH      0x04
+#define SNDC_WAVECONFIRM   0x05
+#define SNDC_TRAINING      0x06
+#define SNDC_FORMATS       0x07
+#define SNDC_QUALITYMODE   0x0C
+#define SNDC_WAVE2         0x0D
+
+/**
+ * The version of the RDPSND protocol implemented by the guacsnd plugin. As
+ * of version 6, the server accepts the Quality Mode PDU.
+ */
+#define GUAC_RDPSND_VERSION 6
+
+/**
+ * Capability flag indicating that the client is capable of consuming audio
+ * data. This flag MUST be set in the client's capabilities.
+ */
+#define TSSNDCAPS_ALIVE 1
+
+/**
+ * Quality mode requesting that the server always favor audio quality over
+ * bandwidth. As audio is re-encoded by guacsnd prior to being sent to users,
+ * the server need not reduce the quality of the audio it sends.
+ */
+#define HIGH_QUALITY 0x0002
+
+/**
+ * The format tag of uncompressed PCM audio, as defined by the WAVEFORMATEX
+ * structure.
+ */
+#define WAVE_FORMAT_PCM 0x0001
+
+/**
+ * The header common to all RDPSND PDUs.
+ */
+typedef struct guac_rdpsnd_pdu_header {
+
+    /**
+     * The type of message represented by this PDU (SNDC_WAVE, etc.)
+     */
+    int message_type;
+
+    /**
+     * The size of the remainder of the message.
+     */
+    int body_size;
+
+} guac_rdpsnd_pdu_header;
+
+/**
+ * Handler for the SNDC_FORMATS (Server Audio Formats and Version) PDU. The
+ * SNDC_FORMATS PDU describes all audio formats supported by the RDP server,
+ * as well as the version of RDPSND implemented.
+ */
+void guac_rdpsnd_formats_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header);
+
+/**
+ * Handler for the SNDC_TRAINING (Training) PDU. The SNDC_TRAINING PDU is used
+ * to by RDP servers to test audio streaming latency, etc. without actually
+ * sending audio data.
+ */
+void guac_rdpsnd_training_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header);
+
+/**
+ * Handler for the SNDC_WAVE (WaveInfo) PDU. The SNDC_WAVE immediately
+ * precedes a SNDWAV PDU and describes the data about to be received. It also
+ * (very strangely) contains exactly 4 bytes of audio data. The following
+ * SNDWAV PDU then contains 4 bytes of padding prior to the audio data where it
+ * would make perfect sense for this data to go.
+ */
+void guac_rdpsnd_wave_info_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header);
+
+/**
+ * Handler for the SNDWAV (Wave) PDU which follows any WaveInfo PDU. The
+ * SNDWAV PDU contains the actual audio data, less the four bytes of audio
+ * data included in the SNDC_WAVE PDU.
+ */
+void guac_rdpsnd_wave_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header);
+
+/**
+ * Handler for the SNDC_WAVE2 (Wave2) PDU. Unlike the SNDC_WAVE PDU, the
+ * SNDC_WAVE2 PDU contains all audio data of the block being sent.
+ */
+void guac_rdpsnd_wave2_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header);
+
+/**
+ * Handler for the SNDC_CLOSE (Close) PDU. This PDU is sent when audio
+ * streaming has stopped. Any audio still buffered for encoding is sent
+ * immediately, rather than waiting for the packet to fill.
+ */
+void guac_rdpsnd_close_handler(guac_rdpsndPlugin* rdpsnd,
+        wStream* input_stream, guac_rdpsnd_pdu_header* header);
+
+#endif
+
@@ -24,6 +24,7 @@
 #include "keyboard.h"
 #include "rdp.h"
 #include "rdp_disp.h"
+#include "resolution.h"
 
 #include <freerdp/freerdp.h>
 #include <freerdp/input.h>
@@ -133,6 +134,20 @@ int guac_rdp_user_key_handler(guac_user* user, int keysym, int pressed) {
 
 }
 
+int guac_rdp_user_text_handler(guac_user* user, const char* text) {
+
+    guac_client* client = user->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+
+    /* Skip if keyboard not yet ready */
+    if (rdp_client->keyboard == NULL)
+        return 0;
+
+    guac_rdp_keyboard_send_text(rdp_client->keyboard, text);
+    return 0;
+
+}
+
 int guac_rdp_user_size_handler(guac_user* user, int width, int height) {
 
     guac_client* client = user->client;
@@ -140,13 +155,20 @@ int guac_rdp_user_size_handler(guac_user* user, int width, int height) {
     guac_rdp_settings* settings = rdp_client->settings;
     freerdp* rdp_inst = rdp_client->rdp_inst;
 
+    /* Reduce resolution for the new size only if necessary to remain within
+     * the limit on remote pixels */
+    int resolution = guac_rdp_resolution_constrain(width, height,
+            user->info.optimal_resolution, settings->resolution,
+            settings->max_pixels);
+
     /* Convert client pixels to remote pixels */
-    width  = width  * settings->resolution / user->info.optimal_resolution;
-    height = height * settings->resolution / user->info.optimal_resolution;
+    width  = width  * resolution / user->info.optimal_resolution;
+    height = height * resolution / user->info.optimal_resolution;
 
     /* Send display update */
     pthread_mutex_lock(&(rdp_client->rdp_lock));
-    guac_rdp_disp_set_size(rdp_client->disp, settings, rdp_inst, width, height);
+    guac_rdp_disp_set_size(rdp_client->disp, settings, rdp_inst, width, height,
+            resolution);
     pthread_mutex_unlock(&(rdp_client->rdp_lock));
 
     return 0;
@@ -32,6 +32,11 @@ guac_user_mouse_handler guac_rdp_user_mouse_handler;
  */
 guac_user_key_handler guac_rdp_user_key_handler;
 
+/**
+ * Handler for Guacamole user text events.
+ */
+guac_user_text_handler guac_rdp_user_text_handler;
+
 /**
  * Handler for Guacamole user size events.
  */
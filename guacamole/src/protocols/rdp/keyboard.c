@@ -28,9 +28,11 @@
 #include <freerdp/freerdp.h>
 #include <freerdp/input.h>
 #include <guacamole/client.h>
+#include <guacamole/unicode.h>
 
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * Translates the given keysym into the corresponding lock flag, as would be
@@ -119,6 +121,35 @@ static void guac_rdp_send_key_event(guac_rdp_client* rdp_client,
 
 }
 
+/**
+ * Sends the RDP Unicode events representing the given Unicode codepoint. As
+ * RDP Unicode events carry UTF-16 code units, codepoints outside the Basic
+ * Multilingual Plane are sent as a surrogate pair of two events. The RDP lock
+ * must already be held, and the RDP client must be connected.
+ *
+ * @param rdp_inst
+ *     The FreeRDP instance of the current RDP session.
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the character being input.
+ */
+static void __guac_rdp_send_codepoint(freerdp* rdp_inst, int codepoint) {
+
+    rdpInput* input = rdp_inst->input;
+
+    /* Codepoints within the BMP are sent as-is */
+    if (codepoint <= 0xFFFF) {
+        input->UnicodeKeyboardEvent(input, 0, codepoint);
+        return;
+    }
+
+    /* All others require a surrogate pair */
+    codepoint -= 0x10000;
+    input->UnicodeKeyboardEvent(input, 0, 0xD800 | (codepoint >> 10));
+    input->UnicodeKeyboardEvent(input, 0, 0xDC00 | (codepoint & 0x3FF));
+
+}
+
 /**
  * Immediately sends an RDP Unicode event having the given Unicode codepoint.
  * Unlike key events, RDP Unicode events do have not a pressed or released
@@ -145,10 +176,8 @@ static void guac_rdp_send_unicode_event(guac_rdp_client* rdp_client,
         return;
     }
 
-    /* Send Unicode event */
-    rdp_inst->input->UnicodeKeyboardEvent(
-            rdp_inst->input,
-            0, codepoint);
+    /* Send Unicode event(s) */
+    __guac_rdp_send_codepoint(rdp_inst, codepoint);
 
     pthread_mutex_unlock(&(rdp_client->rdp_lock));
 
@@ -420,6 +449,42 @@ int guac_rdp_keyboard_send_event(guac_rdp_keyboard* keyboard,
     return 0;
 }
 
+void guac_rdp_keyboard_send_text(guac_rdp_keyboard* keyboard,
+        const char* text) {
+
+    guac_client* client = keyboard->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+
+    int length = strlen(text);
+
+    pthread_mutex_lock(&(rdp_client->rdp_lock));
+
+    /* Skip if not yet connected */
+    freerdp* rdp_inst = rdp_client->rdp_inst;
+    if (rdp_inst == NULL) {
+        pthread_mutex_unlock(&(rdp_client->rdp_lock));
+        return;
+    }
+
+    /* Send each character as Unicode, independent of the keymap */
+    while (length > 0) {
+
+        int codepoint;
+        int bytes = guac_utf8_read(text, length, &codepoint);
+        if (bytes == 0)
+            break;
+
+        text += bytes;
+        length -= bytes;
+
+        __guac_rdp_send_codepoint(rdp_inst, codepoint);
+
+    }
+
+    pthread_mutex_unlock(&(rdp_client->rdp_lock));
+
+}
+
 void guac_rdp_keyboard_send_events(guac_rdp_keyboard* keyboard,
         const int* keysym_string, guac_rdp_key_state from,
         guac_rdp_key_state to) {
@@ -177,6 +177,20 @@ int guac_rdp_keyboard_is_defined(guac_rdp_keyboard* keyboard, int keysym);
 int guac_rdp_keyboard_send_event(guac_rdp_keyboard* keyboard,
         int keysym, int pressed);
 
+/**
+ * Sends the given text as RDP Unicode events, one per UTF-16 code unit. The
+ * text is sent in its entirety regardless of the current keymap, and the
+ * local and remote state of all keys remains untouched.
+ *
+ * @param keyboard
+ *     The guac_rdp_keyboard associated with the current RDP session.
+ *
+ * @param text
+ *     The UTF-8 text to send.
+ */
+void guac_rdp_keyboard_send_text(guac_rdp_keyboard* keyboard,
+        const char* text);
+
 /**
  * For every keysym in the given NULL-terminated array of keysyms, send the RDP
  * key events required to update the remote state of those keys as specified,
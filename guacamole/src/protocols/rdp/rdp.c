@@ -29,6 +29,7 @@
 #include "rdp_bitmap.h"
 #include "rdp_cliprdr.h"
 #include "rdp_disp.h"
+#include "rdp_gfx.h"
 #include "rdp_fs.h"
 #include "rdp_print_job.h"
 #include "rdp_gdi.h"
@@ -47,9 +48,11 @@
 #include <freerdp/channels/channels.h>
 #include <freerdp/freerdp.h>
 #include <guacamole/client.h>
+#include <guacamole/profile.h>
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
 #include <guacamole/timestamp.h>
+#include <guacamole/trace.h>
 
 #ifdef HAVE_FREERDP_CLIENT_CLIPRDR_H
 #include <freerdp/client/cliprdr.h>
@@ -174,10 +177,16 @@ static void guac_rdp_channel_connected(rdpContext* context,
 
             DispClientContext* disp = (DispClientContext*) e->pInterface;
 
-            /* Init module with current display size */
-            guac_rdp_disp_set_size(rdp_client->disp, rdp_client->settings,
-                    context->instance, guac_rdp_get_width(context->instance),
-                    guac_rdp_get_height(context->instance));
+            /* Init module with current display size, unless a size was
+             * already requested while the channel was connecting, in which
+             * case that request remains pending and is sent once connected */
+            if (rdp_client->disp->requested_width == 0
+                    || rdp_client->disp->requested_height == 0)
+                guac_rdp_disp_set_size(rdp_client->disp, rdp_client->settings,
+                        context->instance,
+                        guac_rdp_get_width(context->instance),
+                        guac_rdp_get_height(context->instance),
+                        settings->resolution);
 
             /* Store connected channel */
             guac_rdp_disp_connect(rdp_client->disp, disp);
@@ -188,6 +197,16 @@ static void guac_rdp_channel_connected(rdpContext* context,
 #endif
     }
 
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+    /* Handle graphics pipeline commands once the channel is connected */
+    if (strcmp(e->name, RDPGFX_DVC_CHANNEL_NAME) == 0) {
+        guac_rdp_gfx_connect(rdp_client->gfx,
+                (RdpgfxClientContext*) e->pInterface);
+        guac_client_log(client, GUAC_LOG_DEBUG,
+                "Graphics pipeline channel connected.");
+    }
+#endif
+
 }
 #endif
 
@@ -225,6 +244,20 @@ BOOL rdp_freerdp_pre_connect(freerdp* instance) {
         guac_rdp_disp_load_plugin(instance->context, dvc_list);
 #endif
 
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+    /* Load "rdpgfx" plugin for the graphics pipeline */
+    if (settings->enable_gfx)
+        guac_rdp_gfx_load_plugin(instance->context, dvc_list);
+#endif
+
+    /* Load sound plugin if audio is enabled */
+    if (rdp_client->audio != NULL) {
+        if (freerdp_channels_load_plugin(channels, instance->settings,
+                    "guacsnd", client))
+            guac_client_log(client, GUAC_LOG_WARNING,
+                    "Failed to load guacsnd plugin. Audio will not work.");
+    }
+
     /* Load clipboard plugin */
     if (freerdp_channels_load_plugin(channels, instance->settings,
                 "cliprdr", NULL))
@@ -365,6 +398,10 @@ BOOL rdp_freerdp_pre_connect(freerdp* instance) {
     offscreen_cache_register_callbacks(instance->update);
     palette_cache_register_callbacks(instance->update);
 
+    /* Display RemoteApp windows within their own layers */
+    if (rdp_client->rail != NULL)
+        guac_rdp_rail_register_callbacks(instance->update);
+
     /* Init channels (pre-connect) */
     if (freerdp_channels_pre_connect(channels, instance)) {
         guac_client_abort(client, GUAC_PROTOCOL_STATUS_SERVER_ERROR, "Error initializing RDP client channel manager");
@@ -634,7 +671,24 @@ static int guac_rdp_handle_connection(guac_client* client) {
             rdp_client->settings->width,
             rdp_client->settings->height);
 
-    rdp_client->current_surface = rdp_client->display->default_surface;
+    /* Render the desktop only within guacd if RemoteApp is in use, drawing
+     * each window to its own layer */
+    if (settings->remote_app != NULL) {
+        rdp_client->rail = guac_rdp_rail_alloc(client, rdp_client->display,
+                rdp_client->settings->width, rdp_client->settings->height);
+        rdp_client->desktop_surface = rdp_client->rail->desktop;
+    }
+
+    /* Otherwise, render the desktop directly to the default layer */
+    else {
+        rdp_client->rail = NULL;
+        rdp_client->desktop_surface = rdp_client->display->default_surface;
+    }
+
+    rdp_client->current_surface = rdp_client->desktop_surface;
+
+    /* Init graphics pipeline module, drawing to the new display */
+    rdp_client->gfx = guac_rdp_gfx_alloc(client);
 
     rdp_client->requested_clipboard_format = CB_FORMAT_TEXT;
     rdp_client->available_svc = guac_common_list_alloc();
@@ -706,6 +760,8 @@ static int guac_rdp_handle_connection(guac_client* client) {
             int processing_lag = guac_client_get_processing_lag(client);
             guac_timestamp frame_start = guac_timestamp_current();
 
+            guac_trace_event(client, GUAC_TRACE_BEGIN, "receive", frame_start);
+
             /* Read server messages until frame is built */
             do {
 
@@ -771,6 +827,8 @@ static int guac_rdp_handle_connection(guac_client* client) {
 
             } while (wait_result > 0);
 
+            guac_trace_event(client, GUAC_TRACE_END, "receive", frame_start);
+
             /* Record end of frame, excluding server-side rendering time (we
              * assume server-side rendering time will be consistent between any
              * two subsequent frames, and that this time should thus be
@@ -795,6 +853,14 @@ static int guac_rdp_handle_connection(guac_client* client) {
 
         /* Flush frame only if successful */
         else {
+
+            /* Draw damaged regions of any RemoteApp windows */
+            if (rdp_client->rail != NULL) {
+                pthread_mutex_lock(&(rdp_client->rdp_lock));
+                guac_rdp_rail_flush(rdp_client->rail);
+                pthread_mutex_unlock(&(rdp_client->rdp_lock));
+            }
+
             guac_common_display_flush(rdp_client->display);
             guac_client_end_frame(client);
             guac_socket_flush(client->socket);
@@ -810,8 +876,15 @@ static int guac_rdp_handle_connection(guac_client* client) {
 
     pthread_mutex_lock(&(rdp_client->rdp_lock));
 
-    /* Disconnect client and channels */
+    /* Ignore any further graphics pipeline commands, and close the channels
+     * without holding the RDP lock, as freerdp_channels_close() waits for
+     * plugin threads which may themselves be waiting on the RDP lock */
+    guac_rdp_gfx_close(rdp_client->gfx);
+    pthread_mutex_unlock(&(rdp_client->rdp_lock));
     freerdp_channels_close(channels, rdp_inst);
+    pthread_mutex_lock(&(rdp_client->rdp_lock));
+
+    /* Disconnect client and channels */
     freerdp_channels_free(channels);
     freerdp_disconnect(rdp_inst);
 
@@ -830,6 +903,16 @@ static int guac_rdp_handle_connection(guac_client* client) {
     /* Free RDP keyboard state */
     guac_rdp_keyboard_free(rdp_client->keyboard);
 
+    /* Free graphics pipeline module prior to the display it draws to */
+    guac_rdp_gfx_free(rdp_client->gfx);
+    rdp_client->gfx = NULL;
+
+    /* Free RemoteApp state prior to the display containing its layers */
+    if (rdp_client->rail != NULL) {
+        guac_rdp_rail_free(rdp_client->rail);
+        rdp_client->rail = NULL;
+    }
+
     /* Free display */
     guac_common_display_free(rdp_client->display);
 
@@ -848,6 +931,17 @@ void* guac_rdp_client_thread(void* data) {
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
     guac_rdp_settings* settings = rdp_client->settings;
 
+    /* Allow this thread to be sampled by the native profiler */
+    guac_profile_register_thread(client);
+
+    /* Allocate audio stream if audio enabled */
+    if (settings->audio_enabled) {
+        rdp_client->audio = guac_audio_stream_alloc(client);
+        if (rdp_client->audio == NULL)
+            guac_client_log(client, GUAC_LOG_WARNING,
+                    "Unable to start audio encoder. Audio will not work.");
+    }
+
     /* Load filesystem if drive enabled */
     if (settings->drive_enabled) {
 
@@ -29,11 +29,14 @@
 #include "keyboard.h"
 #include "rdp_disp.h"
 #include "rdp_fs.h"
+#include "rdp_gfx.h"
 #include "rdp_print_job.h"
+#include "rdp_rail.h"
 #include "rdp_settings.h"
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/color.h>
+#include <guacamole/audio.h>
 #include <guacamole/client.h>
 
 #include <pthread.h>
@@ -74,12 +77,30 @@ typedef struct guac_rdp_client {
      */
     guac_common_display* display;
 
+    /**
+     * The surface representing the entire remote desktop. This is the default
+     * layer of the display, unless RemoteApp is in use, in which case it is a
+     * local surface from which each window is drawn to its own layer.
+     */
+    guac_common_surface* desktop_surface;
+
+    /**
+     * RemoteApp state, or NULL if RemoteApp is not in use.
+     */
+    guac_rdp_rail* rail;
+
     /**
      * The surface that GDI operations should draw to. RDP messages exist which
      * change this surface to allow drawing to occur off-screen.
      */
     guac_common_surface* current_surface;
 
+    /**
+     * The audio stream to which audio played within the RDP session is
+     * written, or NULL if audio is disabled.
+     */
+    guac_audio_stream* audio;
+
     /**
      * The current state of the keyboard with respect to the RDP session.
      */
@@ -113,6 +134,13 @@ typedef struct guac_rdp_client {
      */
     guac_rdp_disp* disp;
 
+    /**
+     * Graphics pipeline module. This is allocated for each RDP connection,
+     * as the buffers backing its surfaces belong to the display of that
+     * connection.
+     */
+    guac_rdp_gfx* gfx;
+
     /**
      * List of all available static virtual channels.
      */
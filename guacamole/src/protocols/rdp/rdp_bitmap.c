@@ -122,7 +122,7 @@ void guac_rdp_bitmap_paint(rdpContext* context, rdpBitmap* bitmap) {
     /* If cached, retrieve from cache */
     if (buffer != NULL)
         guac_common_surface_copy(buffer->surface, 0, 0, width, height,
-                rdp_client->display->default_surface,
+                rdp_client->desktop_surface,
                 bitmap->left, bitmap->top);
 
     /* Otherwise, draw with stored image data */
@@ -133,8 +133,8 @@ void guac_rdp_bitmap_paint(rdpContext* context, rdpBitmap* bitmap) {
             bitmap->data, CAIRO_FORMAT_RGB24,
             width, height, 4*bitmap->width);
 
-        /* Draw image on default surface */
-        guac_common_surface_draw(rdp_client->display->default_surface,
+        /* Draw image on desktop surface */
+        guac_common_surface_draw(rdp_client->desktop_surface,
                 bitmap->left, bitmap->top, image);
 
         /* Free surface */
@@ -165,7 +165,7 @@ void guac_rdp_bitmap_setsurface(rdpContext* context, rdpBitmap* bitmap, BOOL pri
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
     if (primary)
-        rdp_client->current_surface = rdp_client->display->default_surface;
+        rdp_client->current_surface = rdp_client->desktop_surface;
 
     else {
 
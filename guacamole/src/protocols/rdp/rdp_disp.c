@@ -23,6 +23,7 @@
 #include "rdp.h"
 #include "rdp_disp.h"
 #include "rdp_settings.h"
+#include "resolution.h"
 
 #include <freerdp/freerdp.h>
 #include <guacamole/client.h>
@@ -43,8 +44,10 @@ guac_rdp_disp* guac_rdp_disp_alloc() {
 
     /* No requests have been made */
     disp->last_request = guac_timestamp_current();
+    disp->last_change = disp->last_request;
     disp->requested_width  = 0;
     disp->requested_height = 0;
+    disp->requested_resolution = 0;
     disp->reconnect_needed = 0;
 
     return disp;
@@ -115,7 +118,7 @@ static void guac_rdp_disp_fit(int* a, int* b) {
 }
 
 void guac_rdp_disp_set_size(guac_rdp_disp* disp, guac_rdp_settings* settings,
-        freerdp* rdp_inst, int width, int height) {
+        freerdp* rdp_inst, int width, int height, int resolution) {
 
     /* Fit width within bounds, adjusting height to maintain aspect ratio */
     guac_rdp_disp_fit(&width, &height);
@@ -127,9 +130,14 @@ void guac_rdp_disp_set_size(guac_rdp_disp* disp, guac_rdp_settings* settings,
     if (width % 2 == 1)
         width -= 1;
 
+    /* Restart settling period if the requested size has changed */
+    if (width != disp->requested_width || height != disp->requested_height)
+        disp->last_change = guac_timestamp_current();
+
     /* Store deferred size */
     disp->requested_width = width;
     disp->requested_height = height;
+    disp->requested_resolution = resolution;
 
     /* Send display update notification if possible */
     guac_rdp_disp_update_size(disp, settings, rdp_inst);
@@ -148,6 +156,11 @@ void guac_rdp_disp_update_size(guac_rdp_disp* disp,
 
     guac_timestamp now = guac_timestamp_current();
 
+    /* Wait for the requested size to settle, such that resizing a window
+     * results in only one request */
+    if (now - disp->last_change < GUAC_RDP_DISP_SETTLE_INTERVAL)
+        return;
+
     /* Limit display update frequency */
     if (now - disp->last_request <= GUAC_RDP_DISP_UPDATE_INTERVAL)
         return;
@@ -158,8 +171,6 @@ void guac_rdp_disp_update_size(guac_rdp_disp* disp,
             && height == guac_rdp_get_height(rdp_inst))
         return;
 
-    disp->last_request = now;
-
     if (settings->resize_method == GUAC_RESIZE_RECONNECT) {
 
         /* Update settings with new dimensions */
@@ -168,11 +179,24 @@ void guac_rdp_disp_update_size(guac_rdp_disp* disp,
 
         /* Signal reconnect */
         disp->reconnect_needed = 1;
+        disp->last_request = now;
 
     }
 
     else if (settings->resize_method == GUAC_RESIZE_DISPLAY_UPDATE) {
 #ifdef HAVE_FREERDP_DISPLAY_UPDATE_SUPPORT
+
+        /* Scale the remote desktop only if its pixels are limited, leaving
+         * the server's own scale factors in effect otherwise */
+        int desktop_scale_factor = 0;
+        int device_scale_factor = 0;
+        if (settings->max_pixels > 0) {
+            desktop_scale_factor = guac_rdp_desktop_scale_factor(
+                    disp->requested_resolution);
+            device_scale_factor = guac_rdp_device_scale_factor(
+                    desktop_scale_factor);
+        }
+
         DISPLAY_CONTROL_MONITOR_LAYOUT monitors[1] = {{
             .Flags  = 0x1, /* DISPLAYCONTROL_MONITOR_PRIMARY */
             .Left = 0,
@@ -182,13 +206,16 @@ void guac_rdp_disp_update_size(guac_rdp_disp* disp,
             .PhysicalWidth = 0,
             .PhysicalHeight = 0,
             .Orientation = 0,
-            .DesktopScaleFactor = 0,
-            .DeviceScaleFactor = 0
+            .DesktopScaleFactor = desktop_scale_factor,
+            .DeviceScaleFactor = device_scale_factor
         }};
 
-        /* Send display update notification if display channel is connected */
-        if (disp->disp != NULL)
+        /* Send display update notification if display channel is connected,
+         * otherwise leave the request pending until the channel connects */
+        if (disp->disp != NULL) {
             disp->disp->SendMonitorLayout(disp->disp, 1, monitors);
+            disp->last_request = now;
+        }
 #endif
     }
 
@@ -45,6 +45,14 @@
  */
 #define GUAC_RDP_DISP_UPDATE_INTERVAL 500
 
+/**
+ * The amount of time that the requested size must remain unchanged before a
+ * display size update is sent, in milliseconds. Resizing a browser window
+ * produces a continuous stream of size changes, of which only the last
+ * matters.
+ */
+#define GUAC_RDP_DISP_SETTLE_INTERVAL 300
+
 /**
  * Display size update module.
  */
@@ -63,6 +71,13 @@ typedef struct guac_rdp_disp {
      */
     guac_timestamp last_request;
 
+    /**
+     * The timestamp of the last change to the requested size. No display
+     * update request is sent until the requested size has remained unchanged
+     * for GUAC_RDP_DISP_SETTLE_INTERVAL milliseconds.
+     */
+    guac_timestamp last_change;
+
     /**
      * The last requested screen width, in pixels.
      */
@@ -73,6 +88,14 @@ typedef struct guac_rdp_disp {
      */
     int requested_height;
 
+    /**
+     * The resolution, in DPI, at which the remote display is rendered at the
+     * last requested size, after applying any limit on remote pixels. The
+     * scale factors sent with each display update are derived from this
+     * resolution.
+     */
+    int requested_resolution;
+
     /**
      * Whether the size has changed and the RDP connection must be closed and
      * reestablished.
@@ -160,9 +183,13 @@ void guac_rdp_disp_connect(guac_rdp_disp* guac_disp, DispClientContext* disp);
  *     The desired display height, in pixels. Due to the restrictions of the
  *     RDP display update channel, this will be contrained to the range of 200
  *     through 8192 inclusive.
+ *
+ * @param resolution
+ *     The resolution, in DPI, at which the remote display will be rendered at
+ *     the desired size, after applying any limit on remote pixels.
  */
 void guac_rdp_disp_set_size(guac_rdp_disp* disp, guac_rdp_settings* settings,
-        freerdp* rdp_inst, int width, int height);
+        freerdp* rdp_inst, int width, int height, int resolution);
 
 /**
  * Sends an actual display update request to the RDP server based on previous
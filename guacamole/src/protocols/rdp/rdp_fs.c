@@ -27,6 +27,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fnmatch.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -64,12 +65,14 @@ guac_rdp_fs* guac_rdp_fs_alloc(guac_client* client, const char* drive_path,
     fs->drive_path = strdup(drive_path);
     fs->file_id_pool = guac_pool_alloc(0);
     fs->open_files = 0;
+    pthread_mutex_init(&(fs->lock), NULL);
 
     return fs;
 
 }
 
 void guac_rdp_fs_free(guac_rdp_fs* fs) {
+    pthread_mutex_destroy(&(fs->lock));
     guac_pool_free(fs->file_id_pool);
     free(fs->drive_path);
     free(fs);
@@ -352,8 +355,20 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
         return guac_rdp_fs_get_errorcode(errno);
     }
 
-    /* Get file ID, init file */
+    /* Get file ID, failing if all files were claimed by concurrent opens */
+    pthread_mutex_lock(&(fs->lock));
+    if (fs->open_files >= GUAC_RDP_FS_MAX_FILES) {
+        pthread_mutex_unlock(&(fs->lock));
+        guac_client_log(fs->client, GUAC_LOG_DEBUG,
+                "%s: Too many open files.", __func__);
+        close(fd);
+        return GUAC_RDP_FS_ENFILE;
+    }
     file_id = guac_pool_next_int(fs->file_id_pool);
+    fs->open_files++;
+    pthread_mutex_unlock(&(fs->lock));
+
+    /* Init file */
     file = &(fs->files[file_id]);
     file->id = file_id;
     file->fd  = fd;
@@ -396,13 +411,11 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
 
     }
 
-    fs->open_files++;
-
     return file_id;
 
 }
 
-int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, int offset,
+int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, uint64_t offset,
         void* buffer, int length) {
 
     int bytes_read;
@@ -415,8 +428,7 @@ int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, int offset,
     }
 
     /* Attempt read */
-    lseek(file->fd, offset, SEEK_SET);
-    bytes_read = read(file->fd, buffer, length);
+    bytes_read = pread(file->fd, buffer, length, offset);
 
     /* Translate errno on error */
     if (bytes_read < 0)
@@ -426,7 +438,7 @@ int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, int offset,
 
 }
 
-int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, int offset,
+int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, uint64_t offset,
         void* buffer, int length) {
 
     int bytes_written;
@@ -439,8 +451,7 @@ int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, int offset,
     }
 
     /* Attempt write */
-    lseek(file->fd, offset, SEEK_SET);
-    bytes_written = write(file->fd, buffer, length);
+    bytes_written = pwrite(file->fd, buffer, length, offset);
 
     /* Translate errno on error */
     if (bytes_written < 0)
@@ -571,8 +582,10 @@ void guac_rdp_fs_close(guac_rdp_fs* fs, int file_id) {
     free(file->real_path);
 
     /* Free ID back to pool */
+    pthread_mutex_lock(&(fs->lock));
     guac_pool_free_int(fs->file_id_pool, file_id);
     fs->open_files--;
+    pthread_mutex_unlock(&(fs->lock));
 
 }
 
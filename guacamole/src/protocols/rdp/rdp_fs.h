@@ -38,6 +38,7 @@
 #include <guacamole/pool.h>
 
 #include <dirent.h>
+#include <pthread.h>
 #include <stdint.h>
 
 /**
@@ -273,6 +274,13 @@ typedef struct guac_rdp_fs {
      */
     int open_files;
 
+    /**
+     * Lock which guards the number of open files and the allocation of file
+     * IDs, as files may be opened and closed concurrently by the threads
+     * servicing RDPDR I/O requests and by users uploading files.
+     */
+    pthread_mutex_t lock;
+
     /**
      * Pool of file IDs.
      */
@@ -487,7 +495,7 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
  *     error occurs. All error codes are negative values and correspond to
  *     GUAC_RDP_FS constants, such as GUAC_RDP_FS_ENOENT.
  */
-int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, int offset,
+int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, uint64_t offset,
         void* buffer, int length);
 
 /**
@@ -515,7 +523,7 @@ int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, int offset,
  *     occurs. All error codes are negative values and correspond to
  *     GUAC_RDP_FS constants, such as GUAC_RDP_FS_ENOENT.
  */
-int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, int offset,
+int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, uint64_t offset,
         void* buffer, int length);
 
 /**
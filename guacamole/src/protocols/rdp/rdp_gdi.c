@@ -226,7 +226,7 @@ void guac_rdp_gdi_scrblt(rdpContext* context, SCRBLT_ORDER* scrblt) {
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
     /* Copy screen rect to current surface */
-    guac_common_surface_copy(rdp_client->display->default_surface,
+    guac_common_surface_copy(rdp_client->desktop_surface,
             x_src, y_src, w, h, current_surface, x, y);
 
 }
@@ -419,11 +419,11 @@ void guac_rdp_gdi_set_bounds(rdpContext* context, rdpBounds* bounds) {
 
     /* If no bounds given, clear bounding rect */
     if (bounds == NULL)
-        guac_common_surface_reset_clip(rdp_client->display->default_surface);
+        guac_common_surface_reset_clip(rdp_client->desktop_surface);
 
     /* Otherwise, set bounding rectangle */
     else
-        guac_common_surface_clip(rdp_client->display->default_surface,
+        guac_common_surface_clip(rdp_client->desktop_surface,
                 bounds->left, bounds->top,
                 bounds->right - bounds->left + 1,
                 bounds->bottom - bounds->top + 1);
@@ -439,11 +439,22 @@ void guac_rdp_gdi_desktop_resize(rdpContext* context) {
     guac_client* client = ((rdp_freerdp_context*) context)->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
-    guac_common_surface_resize(rdp_client->display->default_surface,
+    /* Resize in place. The overlapping region is retained both here and by
+     * connected users, and as the image and fill updates of the repaint which
+     * follows are diffed against the retained contents, only newly-exposed or
+     * changed pixels are encoded and sent */
+    guac_common_surface_resize(rdp_client->desktop_surface,
             guac_rdp_get_width(context->instance),
             guac_rdp_get_height(context->instance));
 
-    guac_common_surface_reset_clip(rdp_client->display->default_surface);
+    guac_common_surface_reset_clip(rdp_client->desktop_surface);
+
+    /* Keep the otherwise-empty default layer the size of the desktop if
+     * RemoteApp windows are drawn separately */
+    if (rdp_client->desktop_surface != rdp_client->display->default_surface)
+        guac_common_surface_resize(rdp_client->display->default_surface,
+                guac_rdp_get_width(context->instance),
+                guac_rdp_get_height(context->instance));
 
     guac_client_log(client, GUAC_LOG_DEBUG, "Server resized display to %ix%i",
             guac_rdp_get_width(context->instance),
@@ -0,0 +1,961 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "common/display.h"
+#include "common/surface.h"
+#include "dvc.h"
+#include "rdp.h"
+#include "rdp_gfx.h"
+
+#include <cairo/cairo.h>
+#include <freerdp/freerdp.h>
+#include <guacamole/client.h>
+
+#ifdef HAVE_FREERDP_CLIENT_RDPGFX_H
+#include <freerdp/client/rdpgfx.h>
+#endif
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+guac_rdp_gfx* guac_rdp_gfx_alloc(guac_client* client) {
+
+    guac_rdp_gfx* gfx = calloc(1, sizeof(guac_rdp_gfx));
+    gfx->client = client;
+
+#ifdef HAVE_FREERDP_CODEC_PLANAR_H
+    gfx->planar = freerdp_bitmap_planar_context_new(0, 64, 64);
+#endif
+
+#ifdef HAVE_FREERDP_CODEC_PROGRESSIVE_H
+    gfx->progressive = progressive_context_new(FALSE);
+#endif
+
+    return gfx;
+
+}
+
+/**
+ * Frees the buffer and any decoder state associated with the given surface,
+ * marking the surface as unallocated.
+ *
+ * @param gfx
+ *     The graphics pipeline module containing the surface.
+ *
+ * @param surface
+ *     The surface to free.
+ */
+static void __guac_rdp_gfx_surface_free(guac_rdp_gfx* gfx,
+        guac_rdp_gfx_surface* surface) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) gfx->client->data;
+
+    if (surface->buffer == NULL)
+        return;
+
+#ifdef HAVE_FREERDP_CODEC_PROGRESSIVE_H
+    if (surface->progressive_data != NULL)
+        progressive_delete_surface_context(gfx->progressive, surface->id);
+#endif
+
+    free(surface->progressive_data);
+    guac_common_display_free_buffer(rdp_client->display, surface->buffer);
+    memset(surface, 0, sizeof(guac_rdp_gfx_surface));
+
+}
+
+/**
+ * Frees the buffer stored within the given cache slot, if any, returning its
+ * memory to the cache budget.
+ *
+ * @param gfx
+ *     The graphics pipeline module containing the cache.
+ *
+ * @param slot
+ *     The index of the cache slot to free, which must be valid.
+ */
+static void __guac_rdp_gfx_cache_free(guac_rdp_gfx* gfx, int slot) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) gfx->client->data;
+    guac_common_display_layer* buffer = gfx->cache[slot];
+
+    if (buffer == NULL)
+        return;
+
+    gfx->cache_size -= (size_t) buffer->surface->width
+        * buffer->surface->height * 4;
+    guac_common_display_free_buffer(rdp_client->display, buffer);
+    gfx->cache[slot] = NULL;
+
+}
+
+/**
+ * Frees all surfaces and all cache slots of the given module.
+ *
+ * @param gfx
+ *     The graphics pipeline module to reset.
+ */
+static void __guac_rdp_gfx_reset(guac_rdp_gfx* gfx) {
+
+    int i;
+
+    for (i = 0; i < GUAC_RDP_GFX_MAX_SURFACES; i++)
+        __guac_rdp_gfx_surface_free(gfx, &gfx->surfaces[i]);
+
+    for (i = 0; i <= GUAC_RDP_GFX_MAX_CACHE_SLOTS; i++)
+        __guac_rdp_gfx_cache_free(gfx, i);
+
+}
+
+void guac_rdp_gfx_free(guac_rdp_gfx* gfx) {
+
+    __guac_rdp_gfx_reset(gfx);
+
+#ifdef HAVE_FREERDP_CODEC_PLANAR_H
+    freerdp_bitmap_planar_context_free(gfx->planar);
+#endif
+
+#ifdef HAVE_FREERDP_CODEC_PROGRESSIVE_H
+    progressive_context_free(gfx->progressive);
+#endif
+
+    free(gfx);
+
+}
+
+void guac_rdp_gfx_close(guac_rdp_gfx* gfx) {
+    gfx->closing = 1;
+}
+
+void guac_rdp_gfx_load_plugin(rdpContext* context, guac_rdp_dvc_list* list) {
+
+#ifdef HAVE_RDPSETTINGS_SUPPORTGRAPHICSPIPELINE
+    context->settings->SupportGraphicsPipeline = TRUE;
+    context->settings->GfxThinClient = FALSE;
+    context->settings->GfxSmallCache = TRUE;
+    context->settings->GfxH264 = FALSE;
+#ifdef HAVE_FREERDP_CODEC_PROGRESSIVE_H
+    context->settings->GfxProgressive = TRUE;
+#else
+    context->settings->GfxProgressive = FALSE;
+#endif
+#endif
+
+    /* Add "rdpgfx" channel */
+    guac_rdp_dvc_list_add(list, "rdpgfx", NULL);
+
+}
+
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+
+/**
+ * Returns the surface having the given ID, or NULL if no such surface
+ * exists.
+ *
+ * @param gfx
+ *     The graphics pipeline module containing the surface.
+ *
+ * @param id
+ *     The surface ID assigned by the RDP server.
+ *
+ * @return
+ *     The surface having the given ID, or NULL if no such surface exists.
+ */
+static guac_rdp_gfx_surface* __guac_rdp_gfx_get_surface(guac_rdp_gfx* gfx,
+        int id) {
+
+    int i;
+    for (i = 0; i < GUAC_RDP_GFX_MAX_SURFACES; i++) {
+        guac_rdp_gfx_surface* surface = &gfx->surfaces[i];
+        if (surface->buffer != NULL && surface->id == id)
+            return surface;
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Returns the buffer stored within the given cache slot, or NULL if the slot
+ * is empty or invalid.
+ *
+ * @param gfx
+ *     The graphics pipeline module containing the cache.
+ *
+ * @param slot
+ *     The index of the cache slot.
+ *
+ * @return
+ *     The buffer stored within the given cache slot, or NULL if the slot is
+ *     empty or invalid.
+ */
+static guac_common_display_layer* __guac_rdp_gfx_get_cache(guac_rdp_gfx* gfx,
+        int slot) {
+
+    if (slot < 0 || slot > GUAC_RDP_GFX_MAX_CACHE_SLOTS)
+        return NULL;
+
+    return gfx->cache[slot];
+
+}
+
+/**
+ * Records that the given rectangle of the given surface has been modified,
+ * such that it is copied to the output at the end of the current frame if
+ * the surface is mapped.
+ *
+ * @param surface
+ *     The modified surface.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the modified rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the modified rectangle.
+ *
+ * @param w
+ *     The width of the modified rectangle.
+ *
+ * @param h
+ *     The height of the modified rectangle.
+ */
+static void __guac_rdp_gfx_surface_touch(guac_rdp_gfx_surface* surface,
+        int x, int y, int w, int h) {
+
+    int right = x + w;
+    int bottom = y + h;
+
+    /* Constrain to surface bounds */
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (right  > surface->width)  right  = surface->width;
+    if (bottom > surface->height) bottom = surface->height;
+
+    if (x >= right || y >= bottom)
+        return;
+
+    /* Start new region if none is pending */
+    if (surface->dirty_left >= surface->dirty_right) {
+        surface->dirty_left   = x;
+        surface->dirty_top    = y;
+        surface->dirty_right  = right;
+        surface->dirty_bottom = bottom;
+        return;
+    }
+
+    /* Otherwise extend pending region */
+    if (x < surface->dirty_left)          surface->dirty_left   = x;
+    if (y < surface->dirty_top)           surface->dirty_top    = y;
+    if (right > surface->dirty_right)     surface->dirty_right  = right;
+    if (bottom > surface->dirty_bottom)   surface->dirty_bottom = bottom;
+
+}
+
+/**
+ * Draws the given 32-bit image data to the given surface.
+ *
+ * @param surface
+ *     The surface to draw to.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination.
+ *
+ * @param w
+ *     The width of the image, in pixels.
+ *
+ * @param h
+ *     The height of the image, in pixels.
+ *
+ * @param data
+ *     The image data, in XRGB or ARGB format.
+ *
+ * @param stride
+ *     The number of bytes in each row of image data.
+ *
+ * @param alpha
+ *     Non-zero if the alpha component of the image data is meaningful, zero
+ *     if the image is opaque.
+ */
+static void __guac_rdp_gfx_surface_draw(guac_rdp_gfx_surface* surface,
+        int x, int y, int w, int h, unsigned char* data, int stride,
+        int alpha) {
+
+    cairo_surface_t* image = cairo_image_surface_create_for_data(data,
+            alpha ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24, w, h, stride);
+
+    guac_common_surface_draw(surface->buffer->surface, x, y, image);
+    cairo_surface_destroy(image);
+
+    __guac_rdp_gfx_surface_touch(surface, x, y, w, h);
+
+}
+
+/**
+ * Returns the graphics pipeline module associated with the given graphics
+ * pipeline interface, acquiring the RDP lock such that the module may be
+ * used safely from the thread of the "rdpgfx" plugin. The lock must be
+ * released with __guac_rdp_gfx_unlock(). If the module has been closed with
+ * guac_rdp_gfx_close(), the lock is not held and NULL is returned, and the
+ * PDU being handled must be ignored.
+ *
+ * @param context
+ *     The graphics pipeline interface.
+ *
+ * @return
+ *     The associated graphics pipeline module, or NULL if the module has
+ *     been closed.
+ */
+static guac_rdp_gfx* __guac_rdp_gfx_lock(RdpgfxClientContext* context) {
+
+    guac_rdp_gfx* gfx = (guac_rdp_gfx*) context->custom;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) gfx->client->data;
+
+    pthread_mutex_lock(&(rdp_client->rdp_lock));
+
+    /* Ignore PDUs received while the channels are being closed */
+    if (gfx->closing) {
+        pthread_mutex_unlock(&(rdp_client->rdp_lock));
+        return NULL;
+    }
+
+    return gfx;
+
+}
+
+/**
+ * Releases the RDP lock acquired by __guac_rdp_gfx_lock().
+ *
+ * @param gfx
+ *     The graphics pipeline module returned by __guac_rdp_gfx_lock().
+ */
+static void __guac_rdp_gfx_unlock(guac_rdp_gfx* gfx) {
+    guac_rdp_client* rdp_client = (guac_rdp_client*) gfx->client->data;
+    pthread_mutex_unlock(&(rdp_client->rdp_lock));
+}
+
+/**
+ * Handler for the ResetGraphics PDU, which discards all surfaces and cache
+ * slots and resizes the output.
+ */
+static int guac_rdp_gfx_reset_graphics(RdpgfxClientContext* context,
+        RDPGFX_RESET_GRAPHICS_PDU* reset) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) gfx->client->data;
+
+    __guac_rdp_gfx_reset(gfx);
+
+    guac_common_surface_resize(rdp_client->desktop_surface,
+            reset->width, reset->height);
+    guac_common_surface_reset_clip(rdp_client->desktop_surface);
+
+    /* Keep the otherwise-empty default layer the size of the desktop if
+     * RemoteApp windows are drawn separately */
+    if (rdp_client->desktop_surface != rdp_client->display->default_surface)
+        guac_common_surface_resize(rdp_client->display->default_surface,
+                reset->width, reset->height);
+
+    __guac_rdp_gfx_unlock(gfx);
+    return 0;
+
+}
+
+/**
+ * Handler for the CreateSurface PDU, which allocates a new buffer to back
+ * the created surface.
+ */
+static int guac_rdp_gfx_create_surface(RdpgfxClientContext* context,
+        RDPGFX_CREATE_SURFACE_PDU* create) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) gfx->client->data;
+
+    int i;
+    int status = -1;
+
+    /* Replace any existing surface having the same ID */
+    guac_rdp_gfx_surface* surface = __guac_rdp_gfx_get_surface(gfx,
+            create->surfaceId);
+    if (surface != NULL)
+        __guac_rdp_gfx_surface_free(gfx, surface);
+
+    for (i = 0; i < GUAC_RDP_GFX_MAX_SURFACES; i++) {
+
+        surface = &gfx->surfaces[i];
+        if (surface->buffer != NULL)
+            continue;
+
+        surface->id = create->surfaceId;
+        surface->width = create->width;
+        surface->height = create->height;
+        surface->buffer = guac_common_display_alloc_buffer(
+                rdp_client->display, create->width, create->height);
+
+        status = 0;
+        break;
+
+    }
+
+    if (status != 0)
+        guac_client_log(gfx->client, GUAC_LOG_WARNING, "Unable to create "
+                "graphics pipeline surface %i: too many surfaces.",
+                create->surfaceId);
+
+    __guac_rdp_gfx_unlock(gfx);
+    return status;
+
+}
+
+/**
+ * Handler for the DeleteSurface PDU, which frees the buffer backing the
+ * deleted surface.
+ */
+static int guac_rdp_gfx_delete_surface(RdpgfxClientContext* context,
+        RDPGFX_DELETE_SURFACE_PDU* delete) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+
+    guac_rdp_gfx_surface* surface = __guac_rdp_gfx_get_surface(gfx,
+            delete->surfaceId);
+    if (surface != NULL)
+        __guac_rdp_gfx_surface_free(gfx, surface);
+
+    __guac_rdp_gfx_unlock(gfx);
+    return 0;
+
+}
+
+/**
+ * Handler for the MapSurfaceToOutput PDU, which associates a surface with a
+ * location on the Guacamole display.
+ */
+static int guac_rdp_gfx_map_surface_to_output(RdpgfxClientContext* context,
+        RDPGFX_MAP_SURFACE_TO_OUTPUT_PDU* map) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+
+    guac_rdp_gfx_surface* surface = __guac_rdp_gfx_get_surface(gfx,
+            map->surfaceId);
+    if (surface != NULL) {
+        surface->mapped = 1;
+        surface->output_x = map->outputOriginX;
+        surface->output_y = map->outputOriginY;
+        __guac_rdp_gfx_surface_touch(surface, 0, 0,
+                surface->width, surface->height);
+    }
+
+    __guac_rdp_gfx_unlock(gfx);
+    return 0;
+
+}
+
+/**
+ * Handler for the SolidFill PDU, which fills rectangles of a surface with a
+ * single color.
+ */
+static int guac_rdp_gfx_solid_fill(RdpgfxClientContext* context,
+        RDPGFX_SOLID_FILL_PDU* fill) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+
+    int i;
+    guac_rdp_gfx_surface* surface = __guac_rdp_gfx_get_surface(gfx,
+            fill->surfaceId);
+
+    if (surface != NULL) {
+        for (i = 0; i < fill->fillRectCount; i++) {
+
+            RDPGFX_RECT16* rect = &fill->fillRects[i];
+            int w = rect->right - rect->left;
+            int h = rect->bottom - rect->top;
+
+            guac_common_surface_set(surface->buffer->surface,
+                    rect->left, rect->top, w, h,
+                    fill->fillPixel.R, fill->fillPixel.G, fill->fillPixel.B,
+                    0xFF);
+
+            __guac_rdp_gfx_surface_touch(surface, rect->left, rect->top,
+                    w, h);
+
+        }
+    }
+
+    __guac_rdp_gfx_unlock(gfx);
+    return 0;
+
+}
+
+/**
+ * Handler for the SurfaceToSurface PDU, which copies a rectangle of one
+ * surface to one or more locations within another (or the same) surface.
+ */
+static int guac_rdp_gfx_surface_to_surface(RdpgfxClientContext* context,
+        RDPGFX_SURFACE_TO_SURFACE_PDU* copy) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+
+    int i;
+    guac_rdp_gfx_surface* src = __guac_rdp_gfx_get_surface(gfx,
+            copy->surfaceIdSrc);
+    guac_rdp_gfx_surface* dst = __guac_rdp_gfx_get_surface(gfx,
+            copy->surfaceIdDest);
+
+    if (src != NULL && dst != NULL) {
+
+        int w = copy->rectSrc.right - copy->rectSrc.left;
+        int h = copy->rectSrc.bottom - copy->rectSrc.top;
+
+        for (i = 0; i < copy->destPtsCount; i++) {
+
+            RDPGFX_POINT16* point = &copy->destPts[i];
+
+            guac_common_surface_copy(src->buffer->surface,
+                    copy->rectSrc.left, copy->rectSrc.top, w, h,
+                    dst->buffer->surface, point->x, point->y);
+
+            __guac_rdp_gfx_surface_touch(dst, point->x, point->y, w, h);
+
+        }
+
+    }
+
+    __guac_rdp_gfx_unlock(gfx);
+    return 0;
+
+}
+
+/**
+ * Handler for the SurfaceToCache PDU, which copies a rectangle of a surface
+ * into a new buffer stored within a cache slot.
+ */
+static int guac_rdp_gfx_surface_to_cache(RdpgfxClientContext* context,
+        RDPGFX_SURFACE_TO_CACHE_PDU* cache) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) gfx->client->data;
+
+    int slot = cache->cacheSlot;
+    guac_rdp_gfx_surface* surface = __guac_rdp_gfx_get_surface(gfx,
+            cache->surfaceId);
+
+    if (surface != NULL && slot >= 0 && slot <= GUAC_RDP_GFX_MAX_CACHE_SLOTS) {
+
+        int w = cache->rectSrc.right - cache->rectSrc.left;
+        int h = cache->rectSrc.bottom - cache->rectSrc.top;
+
+        /* Replace any existing cache entry */
+        __guac_rdp_gfx_cache_free(gfx, slot);
+
+        /* Refuse entries beyond the advertised cache size, leaving the slot
+         * empty such that later copies from it are ignored */
+        if (w <= 0 || h <= 0 || gfx->cache_size + (size_t) w * h * 4
+                > GUAC_RDP_GFX_MAX_CACHE_SIZE) {
+            guac_client_log(gfx->client, GUAC_LOG_DEBUG, "Ignoring %ix%i "
+                    "graphics pipeline cache entry for slot %i: cache "
+                    "size limit reached.", w, h, slot);
+        }
+
+        else {
+
+            guac_common_display_layer* buffer =
+                guac_common_display_alloc_buffer(rdp_client->display, w, h);
+
+            guac_common_surface_copy(surface->buffer->surface,
+                    cache->rectSrc.left, cache->rectSrc.top, w, h,
+                    buffer->surface, 0, 0);
+
+            gfx->cache[slot] = buffer;
+            gfx->cache_size += (size_t) w * h * 4;
+
+        }
+
+    }
+
+    __guac_rdp_gfx_unlock(gfx);
+    return 0;
+
+}
+
+/**
+ * Handler for the CacheToSurface PDU, which copies the contents of a cache
+ * slot to one or more locations within a surface.
+ */
+static int guac_rdp_gfx_cache_to_surface(RdpgfxClientContext* context,
+        RDPGFX_CACHE_TO_SURFACE_PDU* cache) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+
+    int i;
+    guac_common_display_layer* buffer = __guac_rdp_gfx_get_cache(gfx,
+            cache->cacheSlot);
+    guac_rdp_gfx_surface* surface = __guac_rdp_gfx_get_surface(gfx,
+            cache->surfaceId);
+
+    if (buffer != NULL && surface != NULL) {
+
+        int w = buffer->surface->width;
+        int h = buffer->surface->height;
+
+        for (i = 0; i < cache->destPtsCount; i++) {
+
+            RDPGFX_POINT16* point = &cache->destPts[i];
+
+            guac_common_surface_copy(buffer->surface, 0, 0, w, h,
+                    surface->buffer->surface, point->x, point->y);
+
+            __guac_rdp_gfx_surface_touch(surface, point->x, point->y, w, h);
+
+        }
+
+    }
+
+    __guac_rdp_gfx_unlock(gfx);
+    return 0;
+
+}
+
+/**
+ * Handler for the EvictCacheEntry PDU, which frees the buffer stored within
+ * a cache slot.
+ */
+static int guac_rdp_gfx_evict_cache_entry(RdpgfxClientContext* context,
+        RDPGFX_EVICT_CACHE_ENTRY_PDU* evict) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+
+    if (__guac_rdp_gfx_get_cache(gfx, evict->cacheSlot) != NULL)
+        __guac_rdp_gfx_cache_free(gfx, evict->cacheSlot);
+
+    __guac_rdp_gfx_unlock(gfx);
+    return 0;
+
+}
+
+/**
+ * Decodes the given planar-encoded surface command onto its surface.
+ *
+ * @return
+ *     Zero if the command was decoded successfully, non-zero otherwise.
+ */
+static int __guac_rdp_gfx_decode_planar(guac_rdp_gfx* gfx,
+        guac_rdp_gfx_surface* surface, RDPGFX_SURFACE_COMMAND* cmd) {
+
+#ifdef HAVE_FREERDP_CODEC_PLANAR_H
+    int stride = cmd->width * 4;
+    BYTE* data = malloc(stride * cmd->height);
+
+    int status = planar_decompress(gfx->planar, cmd->data, cmd->length,
+            &data, PIXEL_FORMAT_XRGB32, stride, 0, 0,
+            cmd->width, cmd->height, FALSE);
+
+    if (status >= 0)
+        __guac_rdp_gfx_surface_draw(surface, cmd->left, cmd->top,
+                cmd->width, cmd->height, data, stride, 0);
+
+    free(data);
+    return status < 0;
+#else
+    return 1;
+#endif
+
+}
+
+/**
+ * Reads an unsigned 16-bit little-endian integer from the given buffer.
+ *
+ * @param data
+ *     The buffer containing the integer.
+ *
+ * @return
+ *     The integer read.
+ */
+static int __guac_rdp_gfx_read_uint16(const unsigned char* data) {
+    return data[0] | (data[1] << 8);
+}
+
+/**
+ * Reads an unsigned 32-bit little-endian integer from the given buffer.
+ *
+ * @param data
+ *     The buffer containing the integer.
+ *
+ * @return
+ *     The integer read.
+ */
+static unsigned int __guac_rdp_gfx_read_uint32(const unsigned char* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16)
+        | ((unsigned int) data[3] << 24);
+}
+
+/**
+ * Redraws the rectangles listed within the region blocks of the given
+ * progressive-encoded data from the decoded image of the given surface. Each
+ * top-level block begins with a 16-bit block type and 32-bit block length,
+ * and each region block lists the rectangles covered by its tiles, in
+ * surface coordinates, at offset 18.
+ *
+ * @param surface
+ *     The surface whose decoded image should be redrawn.
+ *
+ * @param data
+ *     The progressive-encoded data which was decoded.
+ *
+ * @param length
+ *     The number of bytes of progressive-encoded data.
+ *
+ * @return
+ *     The number of rectangles redrawn, which is zero if the data contains
+ *     no region blocks.
+ */
+static int __guac_rdp_gfx_draw_progressive_rects(
+        guac_rdp_gfx_surface* surface, const unsigned char* data,
+        unsigned int length) {
+
+    int stride = surface->width * 4;
+    int drawn = 0;
+
+    while (length >= 6) {
+
+        int type = __guac_rdp_gfx_read_uint16(data);
+        unsigned int block_length = __guac_rdp_gfx_read_uint32(data + 2);
+
+        if (block_length < 6 || block_length > length)
+            break;
+
+        /* Redraw each rectangle of each region block */
+        if (type == GUAC_RDP_GFX_PROGRESSIVE_REGION && block_length >= 18) {
+
+            const unsigned char* rect = data + 18;
+            int count = __guac_rdp_gfx_read_uint16(data + 7);
+
+            if (count > (block_length - 18) / 8)
+                count = (block_length - 18) / 8;
+
+            for (; count > 0; count--, rect += 8) {
+
+                int x = __guac_rdp_gfx_read_uint16(rect);
+                int y = __guac_rdp_gfx_read_uint16(rect + 2);
+                int w = __guac_rdp_gfx_read_uint16(rect + 4);
+                int h = __guac_rdp_gfx_read_uint16(rect + 6);
+
+                /* Constrain to surface bounds */
+                if (x + w > surface->width)  w = surface->width  - x;
+                if (y + h > surface->height) h = surface->height - y;
+                if (w <= 0 || h <= 0)
+                    continue;
+
+                __guac_rdp_gfx_surface_draw(surface, x, y, w, h,
+                        surface->progressive_data + y * stride + x * 4,
+                        stride, 0);
+                drawn++;
+
+            }
+
+        }
+
+        data += block_length;
+        length -= block_length;
+
+    }
+
+    return drawn;
+
+}
+
+/**
+ * Decodes the given progressive-encoded surface command onto its surface.
+ * As the progressive codec refines tiles over successive commands, the
+ * decoded image of the entire surface is retained, and only the rectangles
+ * listed within the command are redrawn from that image. The entire surface
+ * is redrawn only if the command lists no rectangles.
+ *
+ * @return
+ *     Zero if the command was decoded successfully, non-zero otherwise.
+ */
+static int __guac_rdp_gfx_decode_progressive(guac_rdp_gfx* gfx,
+        guac_rdp_gfx_surface* surface, RDPGFX_SURFACE_COMMAND* cmd) {
+
+#ifdef HAVE_FREERDP_CODEC_PROGRESSIVE_H
+    int stride = surface->width * 4;
+
+    /* Create decoding context upon first use */
+    if (surface->progressive_data == NULL) {
+
+        if (progressive_create_surface_context(gfx->progressive, surface->id,
+                    surface->width, surface->height) < 0)
+            return 1;
+
+        surface->progressive_data = calloc(surface->height, stride);
+
+    }
+
+    BYTE* data = surface->progressive_data;
+    int status = progressive_decompress(gfx->progressive, cmd->data,
+            cmd->length, &data, PIXEL_FORMAT_XRGB32, stride, 0, 0,
+            surface->id);
+
+    if (status >= 0 && __guac_rdp_gfx_draw_progressive_rects(surface,
+                cmd->data, cmd->length) == 0)
+        __guac_rdp_gfx_surface_draw(surface, 0, 0, surface->width,
+                surface->height, surface->progressive_data, stride, 0);
+
+    return status < 0;
+#else
+    return 1;
+#endif
+
+}
+
+/**
+ * Handler for surface commands, which decodes image data onto a surface.
+ * Only the uncompressed, planar and progressive codecs are supported, and
+ * the H.264 codecs are never advertised to the server.
+ */
+static int guac_rdp_gfx_surface_command(RdpgfxClientContext* context,
+        RDPGFX_SURFACE_COMMAND* cmd) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+
+    int status = 0;
+    guac_rdp_gfx_surface* surface = __guac_rdp_gfx_get_surface(gfx,
+            cmd->surfaceId);
+
+    if (surface == NULL) {
+        __guac_rdp_gfx_unlock(gfx);
+        return 0;
+    }
+
+    switch (cmd->codecId) {
+
+        /* Raw 32-bit image data */
+        case RDPGFX_CODECID_UNCOMPRESSED:
+            if (cmd->length >= cmd->width * cmd->height * 4)
+                __guac_rdp_gfx_surface_draw(surface, cmd->left, cmd->top,
+                        cmd->width, cmd->height, cmd->data, cmd->width * 4,
+                        cmd->format == GUAC_RDP_GFX_PIXEL_FORMAT_ARGB);
+            break;
+
+        case RDPGFX_CODECID_PLANAR:
+            status = __guac_rdp_gfx_decode_planar(gfx, surface, cmd);
+            break;
+
+        case RDPGFX_CODECID_CAPROGRESSIVE:
+            status = __guac_rdp_gfx_decode_progressive(gfx, surface, cmd);
+            break;
+
+        default:
+            status = 1;
+
+    }
+
+    if (status != 0)
+        guac_client_log(gfx->client, GUAC_LOG_DEBUG, "Unable to decode "
+                "graphics pipeline surface command using codec 0x%04X.",
+                cmd->codecId);
+
+    __guac_rdp_gfx_unlock(gfx);
+    return 0;
+
+}
+
+/**
+ * Handler for the EndFrame PDU, which copies the modified regions of all
+ * mapped surfaces to the Guacamole display.
+ */
+static int guac_rdp_gfx_end_frame(RdpgfxClientContext* context,
+        RDPGFX_END_FRAME_PDU* end) {
+
+    guac_rdp_gfx* gfx = __guac_rdp_gfx_lock(context);
+    if (gfx == NULL)
+        return 0;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) gfx->client->data;
+
+    int i;
+    for (i = 0; i < GUAC_RDP_GFX_MAX_SURFACES; i++) {
+
+        guac_rdp_gfx_surface* surface = &gfx->surfaces[i];
+        if (surface->buffer == NULL || !surface->mapped
+                || surface->dirty_left >= surface->dirty_right)
+            continue;
+
+        guac_common_surface_copy(surface->buffer->surface,
+                surface->dirty_left, surface->dirty_top,
+                surface->dirty_right - surface->dirty_left,
+                surface->dirty_bottom - surface->dirty_top,
+                rdp_client->desktop_surface,
+                surface->output_x + surface->dirty_left,
+                surface->output_y + surface->dirty_top);
+
+        surface->dirty_left = surface->dirty_right = 0;
+
+    }
+
+    __guac_rdp_gfx_unlock(gfx);
+    return 0;
+
+}
+
+void guac_rdp_gfx_connect(guac_rdp_gfx* guac_gfx, RdpgfxClientContext* gfx) {
+
+    guac_gfx->gfx = gfx;
+    gfx->custom = guac_gfx;
+
+    gfx->ResetGraphics = guac_rdp_gfx_reset_graphics;
+    gfx->EndFrame = guac_rdp_gfx_end_frame;
+    gfx->SurfaceCommand = guac_rdp_gfx_surface_command;
+    gfx->CreateSurface = guac_rdp_gfx_create_surface;
+    gfx->DeleteSurface = guac_rdp_gfx_delete_surface;
+    gfx->SolidFill = guac_rdp_gfx_solid_fill;
+    gfx->SurfaceToSurface = guac_rdp_gfx_surface_to_surface;
+    gfx->SurfaceToCache = guac_rdp_gfx_surface_to_cache;
+    gfx->CacheToSurface = guac_rdp_gfx_cache_to_surface;
+    gfx->EvictCacheEntry = guac_rdp_gfx_evict_cache_entry;
+    gfx->MapSurfaceToOutput = guac_rdp_gfx_map_surface_to_output;
+
+}
+
+#endif
+
@@ -0,0 +1,283 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_RDP_GFX_H
+#define GUAC_RDP_GFX_H
+
+#include "config.h"
+
+#include "common/display.h"
+#include "dvc.h"
+
+#include <freerdp/freerdp.h>
+#include <guacamole/client.h>
+
+#include <stddef.h>
+
+#ifdef HAVE_FREERDP_CLIENT_RDPGFX_H
+#include <freerdp/client/rdpgfx.h>
+#endif
+
+#ifdef HAVE_FREERDP_CODEC_PLANAR_H
+#include <freerdp/codec/planar.h>
+#endif
+
+#ifdef HAVE_FREERDP_CODEC_PROGRESSIVE_H
+#include <freerdp/codec/progressive.h>
+#endif
+
+/**
+ * The maximum number of graphics pipeline surfaces which may exist at any
+ * one time. Servers typically create one surface per monitor, plus a small
+ * number of offscreen surfaces.
+ */
+#define GUAC_RDP_GFX_MAX_SURFACES 64
+
+/**
+ * The maximum number of bitmap cache slots, as advertised to the server via
+ * the small cache capability. Cache slot indices are 1-based.
+ */
+#define GUAC_RDP_GFX_MAX_CACHE_SLOTS 4096
+
+/**
+ * The maximum total size of all bitmap cache entries, in bytes, as
+ * advertised to the server via the small cache capability. Cache entries
+ * which would exceed this size are not stored.
+ */
+#define GUAC_RDP_GFX_MAX_CACHE_SIZE (16 * 1024 * 1024)
+
+/**
+ * The block type of progressive codec region blocks, which list the
+ * rectangles of the surface updated by the tiles they contain.
+ */
+#define GUAC_RDP_GFX_PROGRESSIVE_REGION 0xCCC4
+
+/**
+ * The pixel format value denoting 32-bit ARGB surface command data. Any
+ * other format is 32-bit XRGB, where the alpha component is ignored.
+ */
+#define GUAC_RDP_GFX_PIXEL_FORMAT_ARGB 0x21
+
+/**
+ * A surface created by the RDP server through the graphics pipeline, backed
+ * by a Guacamole buffer.
+ */
+typedef struct guac_rdp_gfx_surface {
+
+    /**
+     * The surface ID assigned by the RDP server.
+     */
+    int id;
+
+    /**
+     * The buffer containing the contents of this surface, or NULL if this
+     * surface is not allocated.
+     */
+    guac_common_display_layer* buffer;
+
+    /**
+     * The width of this surface, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of this surface, in pixels.
+     */
+    int height;
+
+    /**
+     * Whether this surface has been mapped to the output (the Guacamole
+     * display).
+     */
+    int mapped;
+
+    /**
+     * The X coordinate of the output location of the upper-left corner of
+     * this surface, if mapped.
+     */
+    int output_x;
+
+    /**
+     * The Y coordinate of the output location of the upper-left corner of
+     * this surface, if mapped.
+     */
+    int output_y;
+
+    /**
+     * The leftmost X coordinate of the region of this surface modified since
+     * the surface was last copied to the output. The modified region is
+     * empty if this is greater than or equal to dirty_right.
+     */
+    int dirty_left;
+
+    /**
+     * The topmost Y coordinate of the region of this surface modified since
+     * the surface was last copied to the output.
+     */
+    int dirty_top;
+
+    /**
+     * The X coordinate immediately right of the region of this surface
+     * modified since the surface was last copied to the output.
+     */
+    int dirty_right;
+
+    /**
+     * The Y coordinate immediately below the region of this surface modified
+     * since the surface was last copied to the output.
+     */
+    int dirty_bottom;
+
+    /**
+     * Image data of the entire surface, in 32-bit XRGB format, as refined by
+     * the progressive codec, or NULL if the progressive codec has not yet
+     * been used with this surface.
+     */
+    unsigned char* progressive_data;
+
+} guac_rdp_gfx_surface;
+
+/**
+ * Graphics pipeline module, translating the surface, cache and fill commands
+ * of the RDPGFX dynamic virtual channel into operations on Guacamole buffers.
+ */
+typedef struct guac_rdp_gfx {
+
+    /**
+     * The client associated with the RDP connection.
+     */
+    guac_client* client;
+
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+    /**
+     * Graphics pipeline interface, or NULL if the channel has not yet
+     * connected.
+     */
+    RdpgfxClientContext* gfx;
+#endif
+
+#ifdef HAVE_FREERDP_CODEC_PLANAR_H
+    /**
+     * Decoder for surface commands using the planar codec.
+     */
+    BITMAP_PLANAR_CONTEXT* planar;
+#endif
+
+#ifdef HAVE_FREERDP_CODEC_PROGRESSIVE_H
+    /**
+     * Decoder for surface commands using the progressive codec.
+     */
+    PROGRESSIVE_CONTEXT* progressive;
+#endif
+
+    /**
+     * All surfaces which may be created by the RDP server.
+     */
+    guac_rdp_gfx_surface surfaces[GUAC_RDP_GFX_MAX_SURFACES];
+
+    /**
+     * The buffers stored within each bitmap cache slot, indexed by cache slot
+     * index. Unused slots are NULL.
+     */
+    guac_common_display_layer* cache[GUAC_RDP_GFX_MAX_CACHE_SLOTS + 1];
+
+    /**
+     * The total size of the image data of all buffers stored within the
+     * bitmap cache, in bytes.
+     */
+    size_t cache_size;
+
+    /**
+     * Non-zero if the module has been closed with guac_rdp_gfx_close(), in
+     * which case all further graphics pipeline commands are ignored. Access
+     * to this flag is guarded by the RDP lock.
+     */
+    int closing;
+
+} guac_rdp_gfx;
+
+/**
+ * Allocates a new graphics pipeline module. The module will draw to the
+ * display of the given client, which must already be allocated.
+ *
+ * @param client
+ *     The client associated with the RDP connection.
+ *
+ * @return
+ *     A newly-allocated graphics pipeline module.
+ */
+guac_rdp_gfx* guac_rdp_gfx_alloc(guac_client* client);
+
+/**
+ * Frees the given graphics pipeline module, along with all buffers backing
+ * its surfaces and cache slots.
+ *
+ * @param gfx
+ *     The graphics pipeline module to free.
+ */
+void guac_rdp_gfx_free(guac_rdp_gfx* gfx);
+
+/**
+ * Marks the given graphics pipeline module as closed, such that graphics
+ * pipeline commands received from this point onward are ignored without
+ * waiting on the RDP lock. The RDP lock must be held by the current thread.
+ * This function must be invoked before the RDP lock is released for the
+ * channels to be closed, as the thread of the "rdpgfx" plugin may otherwise
+ * be blocked on the RDP lock while freerdp_channels_close() waits for it.
+ *
+ * @param gfx
+ *     The graphics pipeline module to close.
+ */
+void guac_rdp_gfx_close(guac_rdp_gfx* gfx);
+
+/**
+ * Adds FreeRDP's "rdpgfx" plugin to the list of dynamic virtual channel
+ * plugins to be loaded by FreeRDP's "drdynvc" plugin, and enables the
+ * graphics pipeline within the RDP settings. The plugin will only be loaded
+ * once guac_rdp_load_drdynvc() is invoked with the guac_rdp_dvc_list
+ * provided.
+ *
+ * @param context
+ *     The rdpContext associated with the active RDP session.
+ *
+ * @param list
+ *     The guac_rdp_dvc_list to which the "rdpgfx" plugin should be added,
+ *     such that it may later be loaded by guac_rdp_load_drdynvc().
+ */
+void guac_rdp_gfx_load_plugin(rdpContext* context, guac_rdp_dvc_list* list);
+
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+/**
+ * Stores the given graphics pipeline interface within the given module,
+ * registering handlers for all graphics pipeline commands. Surface commands
+ * received prior to this call are not handled.
+ *
+ * @param guac_gfx
+ *     The graphics pipeline module to associate with the connected channel.
+ *
+ * @param gfx
+ *     The graphics pipeline interface provided by the connected "rdpgfx"
+ *     plugin.
+ */
+void guac_rdp_gfx_connect(guac_rdp_gfx* guac_gfx, RdpgfxClientContext* gfx);
+#endif
+
+#endif
+
@@ -20,13 +20,17 @@
 #include "config.h"
 
 #include "client.h"
+#include "common/display.h"
+#include "common/surface.h"
 #include "rdp.h"
 #include "rdp_rail.h"
 #include "rdp_settings.h"
 
+#include <cairo/cairo.h>
 #include <freerdp/channels/channels.h>
 #include <freerdp/freerdp.h>
 #include <freerdp/utils/event.h>
+#include <freerdp/window.h>
 #include <guacamole/client.h>
 
 #ifdef ENABLE_WINPR
@@ -42,6 +46,7 @@
 #endif
 
 #include <stddef.h>
+#include <stdlib.h>
 
 void guac_rdp_process_rail_event(guac_client* client, wMessage* event) {
 
@@ -56,11 +61,19 @@ void guac_rdp_process_rail_event(guac_client* client, wMessage* event) {
                 guac_rdp_process_rail_get_sysparam(client, event);
                 break;
 
+            /* Window size and position limits */
+            case RailChannel_ServerMinMaxInfo:
+                guac_rdp_process_rail_minmaxinfo(client, event);
+                break;
+
+            /* Start or end of window move/resize */
+            case RailChannel_ServerLocalMoveSize:
+                guac_rdp_process_rail_localmovesize(client, event);
+                break;
+
             /* Currently ignored events */
             case RailChannel_ServerSystemParam:
             case RailChannel_ServerExecuteResult:
-            case RailChannel_ServerMinMaxInfo:
-            case RailChannel_ServerLocalMoveSize:
             case RailChannel_ServerGetAppIdResponse:
             case RailChannel_ServerLanguageBarInfo:
                 break;
@@ -120,3 +133,380 @@ void guac_rdp_process_rail_get_sysparam(guac_client* client, wMessage* event) {
 
 }
 
+void guac_rdp_process_rail_minmaxinfo(guac_client* client, wMessage* event) {
+
+    RAIL_MINMAXINFO_ORDER* minmax;
+
+    /* Get min/max info structure */
+#ifdef LEGACY_EVENT
+    minmax = (RAIL_MINMAXINFO_ORDER*) event->user_data;
+#else
+    minmax = (RAIL_MINMAXINFO_ORDER*) event->wParam;
+#endif
+
+    /* Windows are resized only by the RDP server, which already enforces
+     * these limits */
+    guac_client_log(client, GUAC_LOG_DEBUG, "RemoteApp window 0x%x may be "
+            "resized from %ix%i to %ix%i, and maximizes to %ix%i at (%i, %i).",
+            minmax->windowId,
+            minmax->minTrackWidth, minmax->minTrackHeight,
+            minmax->maxTrackWidth, minmax->maxTrackHeight,
+            minmax->maxWidth, minmax->maxHeight,
+            minmax->maxPosX, minmax->maxPosY);
+
+}
+
+/**
+ * Frees the data associated with an event allocated by the RAIL handlers
+ * within this file. This function is provided to FreeRDP as the free
+ * callback of each such event.
+ *
+ * @param event
+ *     The event whose data should be freed.
+ */
+static void __guac_rdp_rail_free_event_data(wMessage* event) {
+#ifdef LEGACY_EVENT
+    free(event->user_data);
+#else
+    free(event->wParam);
+#endif
+}
+
+/**
+ * Returns the RemoteApp window having the given ID, optionally allocating a
+ * new window and corresponding layer if no such window exists.
+ *
+ * @param rail
+ *     The RemoteApp state containing the window.
+ *
+ * @param id
+ *     The ID assigned to the window by the RDP server.
+ *
+ * @param create
+ *     Non-zero if a new window should be allocated if no window having the
+ *     given ID exists, zero otherwise.
+ *
+ * @return
+ *     The window having the given ID, or NULL if no such window exists and
+ *     either create is zero or all window slots are in use.
+ */
+static guac_rdp_rail_window* __guac_rdp_rail_get_window(guac_rdp_rail* rail,
+        uint32_t id, int create) {
+
+    int i;
+    guac_rdp_rail_window* unused = NULL;
+
+    for (i = 0; i < GUAC_RDP_RAIL_MAX_WINDOWS; i++) {
+
+        guac_rdp_rail_window* window = &rail->windows[i];
+
+        /* Note first unused slot in case a new window is needed */
+        if (window->layer == NULL) {
+            if (unused == NULL)
+                unused = window;
+        }
+
+        else if (window->id == id)
+            return window;
+
+    }
+
+    /* Window does not exist */
+    if (!create || unused == NULL)
+        return NULL;
+
+    /* Allocate new window, sized once its state is known */
+    unused->id = id;
+    unused->layer = guac_common_display_alloc_layer(rail->display, 0, 0);
+    unused->x = 0;
+    unused->y = 0;
+    unused->width = 0;
+    unused->height = 0;
+    unused->visible = 1;
+    unused->stale = 1;
+
+    return unused;
+
+}
+
+void guac_rdp_process_rail_localmovesize(guac_client* client,
+        wMessage* event) {
+
+    RAIL_LOCALMOVESIZE_ORDER* movesize;
+    RAIL_WINDOW_MOVE_ORDER* window_move;
+    wMessage* response;
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    rdpChannels* channels = rdp_client->rdp_inst->context->channels;
+
+    /* Get local move/size structure */
+#ifdef LEGACY_EVENT
+    movesize = (RAIL_LOCALMOVESIZE_ORDER*) event->user_data;
+#else
+    movesize = (RAIL_LOCALMOVESIZE_ORDER*) event->wParam;
+#endif
+
+    /* Nothing to report until the move or resize is complete */
+    if (movesize->isMoveSizeStart || rdp_client->rail == NULL)
+        return;
+
+    guac_rdp_rail_window* window = __guac_rdp_rail_get_window(
+            rdp_client->rail, movesize->windowId, 0);
+    if (window == NULL)
+        return;
+
+    /* Confirm final window position, as last reported by the server */
+    window_move = malloc(sizeof(RAIL_WINDOW_MOVE_ORDER));
+    window_move->windowId = window->id;
+    window_move->left     = window->x;
+    window_move->top      = window->y;
+    window_move->right    = window->x + window->width;
+    window_move->bottom   = window->y + window->height;
+
+    response = freerdp_event_new(RailChannel_Class,
+                                 RailChannel_ClientWindowMove,
+                                 __guac_rdp_rail_free_event_data,
+                                 window_move);
+
+    /* Send response */
+    freerdp_channels_send_event(channels, response);
+
+}
+
+guac_rdp_rail* guac_rdp_rail_alloc(guac_client* client,
+        guac_common_display* display, int width, int height) {
+
+    guac_rdp_rail* rail = calloc(1, sizeof(guac_rdp_rail));
+    rail->client = client;
+    rail->display = display;
+    rail->desktop = guac_common_surface_alloc_local(client, width, height);
+
+    return rail;
+
+}
+
+void guac_rdp_rail_free(guac_rdp_rail* rail) {
+
+    int i;
+
+    /* Free layers of all windows */
+    for (i = 0; i < GUAC_RDP_RAIL_MAX_WINDOWS; i++) {
+        guac_rdp_rail_window* window = &rail->windows[i];
+        if (window->layer != NULL)
+            guac_common_display_free_layer(rail->display, window->layer);
+    }
+
+    guac_common_surface_free(rail->desktop);
+    free(rail);
+
+}
+
+/**
+ * Returns the RemoteApp state of the RDP session associated with the given
+ * context.
+ *
+ * @param context
+ *     The rdpContext of the RDP session.
+ *
+ * @return
+ *     The RemoteApp state of the RDP session, or NULL if RemoteApp is not in
+ *     use.
+ */
+static guac_rdp_rail* __guac_rdp_rail_get(rdpContext* context) {
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    return ((guac_rdp_client*) client->data)->rail;
+}
+
+/**
+ * Handler for the WindowCreate and WindowUpdate orders, which describe the
+ * position, size and show state of new and existing RemoteApp windows.
+ */
+static void guac_rdp_rail_window_update(rdpContext* context,
+        WINDOW_ORDER_INFO* order_info, WINDOW_STATE_ORDER* window_state) {
+
+    guac_rdp_rail* rail = __guac_rdp_rail_get(context);
+    if (rail == NULL)
+        return;
+
+    guac_rdp_rail_window* window = __guac_rdp_rail_get_window(rail,
+            order_info->windowId, 1);
+
+    /* Render to desktop only if window cannot be displayed */
+    if (window == NULL) {
+        guac_client_log(rail->client, GUAC_LOG_WARNING, "Too many RemoteApp "
+                "windows. Window 0x%x will not be displayed.",
+                order_info->windowId);
+        return;
+    }
+
+    guac_common_surface* surface = window->layer->surface;
+    UINT32 flags = order_info->fieldFlags;
+
+    /* Moving a window moves only its layer. Any repaint of the window at its
+     * new location results in damage which is redrawn, but as the contents
+     * of the layer moved with it, only pixels which actually changed are
+     * sent. */
+    if (flags & WINDOW_ORDER_FIELD_WND_OFFSET) {
+        window->x = (INT32) window_state->windowOffsetX;
+        window->y = (INT32) window_state->windowOffsetY;
+        guac_common_surface_move(surface, window->x, window->y);
+    }
+
+    /* Resize in place, retaining the overlapping region */
+    if (flags & WINDOW_ORDER_FIELD_WND_SIZE) {
+        window->width = window_state->windowWidth;
+        window->height = window_state->windowHeight;
+        guac_common_surface_resize(surface, window->width, window->height);
+    }
+
+    /* Hide minimized and hidden windows, redrawing in full when shown again
+     * as their layers are not updated while hidden */
+    if (flags & WINDOW_ORDER_FIELD_SHOW) {
+
+        int visible = window_state->showState != GUAC_RDP_RAIL_SHOW_HIDDEN
+                   && window_state->showState != GUAC_RDP_RAIL_SHOW_MINIMIZED;
+
+        if (visible && !window->visible)
+            window->stale = 1;
+
+        window->visible = visible;
+        guac_common_surface_set_opacity(surface, visible ? 0xFF : 0);
+
+    }
+
+}
+
+/**
+ * Handler for the WindowDelete order, which removes an existing RemoteApp
+ * window.
+ */
+static void guac_rdp_rail_window_delete(rdpContext* context,
+        WINDOW_ORDER_INFO* order_info) {
+
+    guac_rdp_rail* rail = __guac_rdp_rail_get(context);
+    if (rail == NULL)
+        return;
+
+    guac_rdp_rail_window* window = __guac_rdp_rail_get_window(rail,
+            order_info->windowId, 0);
+    if (window == NULL)
+        return;
+
+    guac_common_display_free_layer(rail->display, window->layer);
+    window->layer = NULL;
+
+}
+
+/**
+ * Handler for the MonitoredDesktop order, which describes the Z-order of all
+ * RemoteApp windows.
+ */
+static void guac_rdp_rail_monitored_desktop(rdpContext* context,
+        WINDOW_ORDER_INFO* order_info, MONITORED_DESKTOP_ORDER* desktop) {
+
+    int i;
+
+    guac_rdp_rail* rail = __guac_rdp_rail_get(context);
+    if (rail == NULL)
+        return;
+
+    if (!(order_info->fieldFlags & WINDOW_ORDER_FIELD_DESKTOP_ZORDER))
+        return;
+
+    /* Window IDs are listed topmost first */
+    for (i = 0; i < (int) desktop->numWindowIds; i++) {
+
+        guac_rdp_rail_window* window = __guac_rdp_rail_get_window(rail,
+                desktop->windowIds[i], 0);
+
+        if (window != NULL)
+            guac_common_surface_stack(window->layer->surface,
+                    desktop->numWindowIds - i);
+
+    }
+
+}
+
+void guac_rdp_rail_register_callbacks(rdpUpdate* update) {
+
+    rdpWindowUpdate* window = update->window;
+
+    window->WindowCreate = guac_rdp_rail_window_update;
+    window->WindowUpdate = guac_rdp_rail_window_update;
+    window->WindowDelete = guac_rdp_rail_window_delete;
+    window->MonitoredDesktop = guac_rdp_rail_monitored_desktop;
+
+}
+
+/**
+ * Draws the given rectangle of the remote desktop to the layer of the given
+ * window. The rectangle is in desktop coordinates, and is constrained to the
+ * bounds of the desktop.
+ *
+ * @param rail
+ *     The RemoteApp state containing the window.
+ *
+ * @param window
+ *     The window to draw to.
+ *
+ * @param rect
+ *     The rectangle of the remote desktop to draw.
+ */
+static void __guac_rdp_rail_draw_window(guac_rdp_rail* rail,
+        guac_rdp_rail_window* window, guac_common_rect* rect) {
+
+    guac_common_surface* desktop = rail->desktop;
+
+    /* Constrain to desktop */
+    guac_common_rect bounds;
+    guac_common_rect_init(&bounds, 0, 0, desktop->width, desktop->height);
+    guac_common_rect_constrain(rect, &bounds);
+    if (rect->width <= 0 || rect->height <= 0)
+        return;
+
+    /* Wrap relevant region of desktop without copying */
+    cairo_surface_t* image = cairo_image_surface_create_for_data(
+            desktop->buffer + rect->y * desktop->stride + rect->x * 4,
+            CAIRO_FORMAT_RGB24, rect->width, rect->height, desktop->stride);
+
+    /* Only pixels which differ from the layer are marked dirty and sent */
+    guac_common_surface_draw(window->layer->surface,
+            rect->x - window->x, rect->y - window->y, image);
+
+    cairo_surface_destroy(image);
+
+}
+
+void guac_rdp_rail_flush(guac_rdp_rail* rail) {
+
+    int i;
+
+    guac_common_rect damage;
+    int damaged = guac_common_surface_take_damage(rail->desktop, &damage);
+
+    for (i = 0; i < GUAC_RDP_RAIL_MAX_WINDOWS; i++) {
+
+        guac_rdp_rail_window* window = &rail->windows[i];
+
+        /* Hidden windows are redrawn in full once shown */
+        if (window->layer == NULL || !window->visible)
+            continue;
+
+        guac_common_rect rect;
+        guac_common_rect_init(&rect, window->x, window->y,
+                window->width, window->height);
+
+        /* Redraw stale windows in full, otherwise only where damaged */
+        if (window->stale)
+            window->stale = 0;
+        else if (damaged)
+            guac_common_rect_constrain(&rect, &damage);
+        else
+            continue;
+
+        __guac_rdp_rail_draw_window(rail, window, &rect);
+
+    }
+
+}
+
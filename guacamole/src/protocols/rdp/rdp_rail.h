@@ -23,6 +23,10 @@
 
 #include "config.h"
 
+#include "common/display.h"
+#include "common/surface.h"
+
+#include <freerdp/freerdp.h>
 #include <guacamole/client.h>
 
 #ifdef ENABLE_WINPR
@@ -31,6 +35,162 @@
 #include "compat/winpr-stream.h"
 #endif
 
+#include <stdint.h>
+
+/**
+ * The maximum number of RemoteApp windows which may be displayed at once.
+ * Windows beyond this limit are still rendered to the remote desktop, but
+ * are not displayed.
+ */
+#define GUAC_RDP_RAIL_MAX_WINDOWS 64
+
+/**
+ * The window show state sent by the RDP server for windows which are hidden.
+ */
+#define GUAC_RDP_RAIL_SHOW_HIDDEN 0
+
+/**
+ * The window show state sent by the RDP server for windows which are
+ * minimized.
+ */
+#define GUAC_RDP_RAIL_SHOW_MINIMIZED 2
+
+/**
+ * A single RemoteApp window, displayed within its own Guacamole layer.
+ */
+typedef struct guac_rdp_rail_window {
+
+    /**
+     * The ID assigned to this window by the RDP server.
+     */
+    uint32_t id;
+
+    /**
+     * The layer displaying the contents of this window, or NULL if this
+     * window slot is unused.
+     */
+    guac_common_display_layer* layer;
+
+    /**
+     * The X coordinate of the upper-left corner of this window within the
+     * remote desktop, in pixels.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the upper-left corner of this window within the
+     * remote desktop, in pixels.
+     */
+    int y;
+
+    /**
+     * The width of this window, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of this window, in pixels.
+     */
+    int height;
+
+    /**
+     * Non-zero if this window is currently shown, zero if it is hidden or
+     * minimized.
+     */
+    int visible;
+
+    /**
+     * Non-zero if the entire window must be redrawn from the remote desktop
+     * at the next flush, regardless of damage, as is the case after the
+     * window is created or shown.
+     */
+    int stale;
+
+} guac_rdp_rail_window;
+
+/**
+ * RemoteApp state for a single RDP connection. The remote desktop is rendered
+ * only within guacd, and each RemoteApp window is drawn from the region of
+ * that desktop it occupies into its own layer. Moving a window thus moves its
+ * layer without resending its contents.
+ */
+typedef struct guac_rdp_rail {
+
+    /**
+     * The client associated with the RDP session.
+     */
+    guac_client* client;
+
+    /**
+     * The display containing the layers of all windows.
+     */
+    guac_common_display* display;
+
+    /**
+     * The local surface to which the remote desktop is rendered. The contents
+     * of this surface are never sent directly to any user.
+     */
+    guac_common_surface* desktop;
+
+    /**
+     * All RemoteApp windows. Unused slots have a NULL layer.
+     */
+    guac_rdp_rail_window windows[GUAC_RDP_RAIL_MAX_WINDOWS];
+
+} guac_rdp_rail;
+
+/**
+ * Allocates RemoteApp state for a new RDP connection, including the local
+ * surface to which the remote desktop will be rendered.
+ *
+ * @param client
+ *     The guac_client associated with the RDP session.
+ *
+ * @param display
+ *     The display within which window layers should be allocated.
+ *
+ * @param width
+ *     The width of the remote desktop, in pixels.
+ *
+ * @param height
+ *     The height of the remote desktop, in pixels.
+ *
+ * @return
+ *     Newly-allocated RemoteApp state.
+ */
+guac_rdp_rail* guac_rdp_rail_alloc(guac_client* client,
+        guac_common_display* display, int width, int height);
+
+/**
+ * Frees the given RemoteApp state, including the layers of all windows and
+ * the local desktop surface. The display given when the state was allocated
+ * must not yet have been freed.
+ *
+ * @param rail
+ *     The RemoteApp state to free.
+ */
+void guac_rdp_rail_free(guac_rdp_rail* rail);
+
+/**
+ * Registers handlers for the window orders which describe RemoteApp windows.
+ * This must be invoked from the PreConnect handler of the RDP client.
+ *
+ * @param update
+ *     The rdpUpdate structure of the RDP client.
+ */
+void guac_rdp_rail_register_callbacks(rdpUpdate* update);
+
+/**
+ * Draws the contents of all visible windows from the damaged regions of the
+ * remote desktop. Only pixels which have actually changed relative to a
+ * window's layer are sent. This must be invoked once per frame, while the
+ * RDP lock is held, prior to flushing the display.
+ *
+ * @param rail
+ *     The RemoteApp state whose windows should be drawn.
+ */
+void guac_rdp_rail_flush(guac_rdp_rail* rail);
+
 /**
  * Dispatches a given RAIL event to the appropriate handler.
  *
@@ -54,5 +214,32 @@ void guac_rdp_process_rail_event(guac_client* client, wMessage* event);
  */
 void guac_rdp_process_rail_get_sysparam(guac_client* client, wMessage* event);
 
+/**
+ * Handles the event sent when the RDP server reports the size and position
+ * limits of a window. The event given MUST be a MINMAXINFO event.
+ *
+ * @param client
+ *     The guac_client associated with the current RDP session.
+ *
+ * @param event
+ *     The min/max info event to process.
+ */
+void guac_rdp_process_rail_minmaxinfo(guac_client* client, wMessage* event);
+
+/**
+ * Handles the event sent when the RDP server begins or ends a local move or
+ * resize of a window. Windows are moved and resized by the RDP server itself,
+ * so the end of each local move or resize is answered with the window
+ * position last reported by the server. The event given MUST be a
+ * LOCALMOVESIZE event.
+ *
+ * @param client
+ *     The guac_client associated with the current RDP session.
+ *
+ * @param event
+ *     The local move/size event to process.
+ */
+void guac_rdp_process_rail_localmovesize(guac_client* client, wMessage* event);
+
 #endif
 
@@ -35,6 +35,7 @@
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 /* Client plugin arguments */
@@ -47,6 +48,7 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "width",
     "height",
     "dpi",
+    "max-pixels",
     "initial-program",
     "color-depth",
     "enable-printing",
@@ -74,6 +76,8 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "disable-bitmap-caching",
     "disable-offscreen-caching",
     "disable-glyph-caching",
+    "enable-gfx",
+    "disable-audio",
     "preconnection-id",
     "preconnection-blob",
 
@@ -144,6 +148,15 @@ enum RDP_ARGS_IDX {
      */
     IDX_DPI,
 
+    /**
+     * The maximum number of pixels the remote display may contain. If
+     * specified, the remote display is rendered at the user's own resolution
+     * (HiDPI) unless doing so would exceed this limit, in which case the
+     * resolution is reduced and the user's display scales the result. If
+     * omitted, the number of pixels is not limited.
+     */
+    IDX_MAX_PIXELS,
+
     /**
      * The initial program to run, if any.
      */
@@ -307,6 +320,20 @@ enum RDP_ARGS_IDX {
      */
     IDX_DISABLE_GLYPH_CACHING,
 
+    /**
+     * "true" if the RDP graphics pipeline (RDPGFX) should be used where
+     * supported by the RDP server, "false" or blank otherwise. As servers only
+     * use the graphics pipeline for 32-bit sessions, enabling the graphics
+     * pipeline overrides any other color depth with 32-bit color.
+     */
+    IDX_ENABLE_GFX,
+
+    /**
+     * "true" if audio should be disabled, "false" or blank if audio played
+     * within the RDP session should be streamed to users supporting it.
+     */
+    IDX_DISABLE_AUDIO,
+
     /**
      * The preconnection ID to send within the preconnection PDU when
      * initiating an RDP connection, if any.
@@ -520,10 +547,22 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
             user->info.optimal_height,
             user->info.optimal_resolution);
 
+    /* Limit on remote pixels, if any */
+    settings->max_pixels =
+        guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_MAX_PIXELS, 0);
+
     /* Use suggested resolution unless overridden */
     settings->resolution =
         guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
-                IDX_DPI, guac_rdp_suggest_resolution(user));
+                IDX_DPI, guac_rdp_suggest_resolution(user,
+                    settings->max_pixels));
+
+    /* Respect limit on remote pixels even if resolution is overridden */
+    settings->resolution = guac_rdp_resolution_constrain(
+            user->info.optimal_width, user->info.optimal_height,
+            user->info.optimal_resolution, settings->resolution,
+            settings->max_pixels);
 
     /* Use optimal width unless overridden */
     settings->width = user->info.optimal_width
@@ -560,6 +599,22 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
                 argv[IDX_WIDTH], settings->height);
     }
 
+    /* Respect limit on remote pixels even if dimensions are overridden */
+    if (settings->max_pixels > 0 && (int64_t) settings->width
+            * settings->height > settings->max_pixels) {
+
+        guac_rdp_resolution_constrain_size(&settings->width,
+                &settings->height, settings->max_pixels);
+
+        /* Round width down to nearest multiple of 4 */
+        settings->width = settings->width & ~0x3;
+
+        guac_user_log(user, GUAC_LOG_INFO, "Reducing requested resolution "
+                "to %ix%i to stay within the limit of %i pixels.",
+                settings->width, settings->height, settings->max_pixels);
+
+    }
+
     guac_user_log(user, GUAC_LOG_DEBUG,
             "Using resolution of %ix%i at %i DPI",
             settings->width,
@@ -656,11 +711,32 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_DISABLE_GLYPH_CACHING, 0);
 
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+    settings->enable_gfx =
+        guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_ENABLE_GFX, 0);
+#else
+    settings->enable_gfx = 0;
+#endif
+
+    /* Audio enable/disable */
+    settings->audio_enabled =
+        !guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_DISABLE_AUDIO, 0);
+
     /* Session color depth */
     settings->color_depth = 
         guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_COLOR_DEPTH, RDP_DEFAULT_DEPTH);
 
+    /* The graphics pipeline is only used by servers for 32-bit sessions */
+    if (settings->enable_gfx && settings->color_depth != 32) {
+        guac_user_log(user, GUAC_LOG_INFO, "Overriding requested %i-bit "
+                "color depth with 32-bit color, as required by the graphics "
+                "pipeline.", settings->color_depth);
+        settings->color_depth = 32;
+    }
+
     /* Preconnection ID */
     settings->preconnection_id = -1;
     if (argv[IDX_PRECONNECTION_ID][0] != '\0') {
@@ -983,6 +1059,19 @@ void guac_rdp_push_settings(guac_rdp_settings* guac_settings, freerdp* rdp) {
     rdp_settings->KeyboardLayout = guac_settings->server_layout->freerdp_keyboard_layout;
 #endif
 
+    /* Scale remote desktop to match its resolution, if its pixels are
+     * limited (the resolution is already constrained by that limit) */
+    if (guac_settings->max_pixels > 0) {
+#ifdef HAVE_RDPSETTINGS_DESKTOPSCALEFACTOR
+        rdp_settings->DesktopScaleFactor =
+            guac_rdp_desktop_scale_factor(guac_settings->resolution);
+#endif
+#ifdef HAVE_RDPSETTINGS_DEVICESCALEFACTOR
+        rdp_settings->DeviceScaleFactor = guac_rdp_device_scale_factor(
+                guac_rdp_desktop_scale_factor(guac_settings->resolution));
+#endif
+    }
+
     /* Performance flags */
 #ifdef LEGACY_RDPSETTINGS
 
@@ -1043,6 +1132,14 @@ void guac_rdp_push_settings(guac_rdp_settings* guac_settings, freerdp* rdp) {
 #endif
 #endif
 
+    /* Audio */
+#ifdef HAVE_RDPSETTINGS_AUDIO_PLAYBACK
+    rdp_settings->audio_playback = guac_settings->audio_enabled;
+#endif
+#ifdef HAVE_RDPSETTINGS_AUDIOPLAYBACK
+    rdp_settings->AudioPlayback = guac_settings->audio_enabled;
+#endif
+
     /* Security */
     switch (guac_settings->security_mode) {
 
@@ -162,6 +162,12 @@ typedef struct guac_rdp_settings {
      */
     int resolution;
 
+    /**
+     * The maximum number of pixels the remote display may contain, or zero if
+     * the number of pixels is not limited.
+     */
+    int max_pixels;
+
     /**
      * Whether printing is enabled.
      */
@@ -312,6 +318,20 @@ typedef struct guac_rdp_settings {
      */
     int disable_glyph_caching;
 
+    /**
+     * Whether the RDP graphics pipeline (RDPGFX) should be used. By default
+     * it is not used - this allows users to explicitly enable it where
+     * supported by FreeRDP. If enabled, the color depth is always 32-bit.
+     */
+    int enable_gfx;
+
+    /**
+     * Whether audio played within the RDP session should be streamed to
+     * users. By default it is enabled - this allows users to explicitly
+     * disable it.
+     */
+    int audio_enabled;
+
     /**
      * The preconnection ID to send within the preconnection PDU when
      * initiating an RDP connection, if any. If no preconnection ID is
@@ -47,7 +47,10 @@
 #include "compat/winpr-wtypes.h"
 #endif
 
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * Writes the given filename to the given upload path, sanitizing the filename
@@ -80,50 +83,219 @@ static void __generate_upload_path(const char* filename, char* path) {
 
 }
 
-int guac_rdp_upload_file_handler(guac_user* user, guac_stream* stream,
-        char* mimetype, char* filename) {
+/**
+ * Parses the parameters of the given upload mimetype, which may declare the
+ * upload resumable. A resumable upload is declared with a "transfer"
+ * parameter containing an ID chosen by the client which identifies the
+ * upload across reconnects, and optionally a "length" parameter containing
+ * the total length of the file in bytes, for example
+ * "application/octet-stream;transfer=2f1c9a;length=1048576". Characters of
+ * the transfer ID which are not alphanumeric, '-' or '_' are replaced with
+ * underscores.
+ *
+ * @param mimetype
+ *     The mimetype of the upload, including any parameters.
+ *
+ * @param transfer_id
+ *     Buffer of at least GUAC_RDP_UPLOAD_MAX_TRANSFER_ID bytes which will
+ *     receive the transfer ID, if any.
+ *
+ * @param length
+ *     Pointer which will receive the declared length of the file, or zero
+ *     if no length is declared.
+ *
+ * @return
+ *     Non-zero if the upload is resumable, zero otherwise.
+ */
+static int __guac_rdp_upload_parse_mimetype(const char* mimetype,
+        char* transfer_id, uint64_t* length) {
 
-    guac_client* client = user->client;
-    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    const char* param = strchr(mimetype, ';');
+
+    *transfer_id = '\0';
+    *length = 0;
+
+    while (param != NULL) {
+
+        const char* value;
+        int name_length;
+
+        /* Locate value of current parameter */
+        param++;
+        value = strchr(param, '=');
+        if (value == NULL)
+            break;
+
+        name_length = value - param;
+        value++;
+
+        /* Copy sanitized transfer ID */
+        if (name_length == 8 && strncmp(param, "transfer", 8) == 0) {
+
+            int i;
+            for (i = 0; i < GUAC_RDP_UPLOAD_MAX_TRANSFER_ID - 1
+                    && value[i] != '\0' && value[i] != ';'; i++) {
+
+                char c = value[i];
+                if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                            || (c >= '0' && c <= '9') || c == '-'))
+                    c = '_';
+
+                transfer_id[i] = c;
+
+            }
+
+            transfer_id[i] = '\0';
+
+        }
+
+        /* Parse declared length */
+        else if (name_length == 6 && strncmp(param, "length", 6) == 0)
+            *length = strtoull(value, NULL, 10);
+
+        param = strchr(value, ';');
+
+    }
+
+    return *transfer_id != '\0';
+
+}
+
+/**
+ * Opens the file at the given path for upload along the given stream,
+ * initializing the stream for upload and acknowledging the stream. If the
+ * upload is resumable, data is written to a partial file named after the
+ * transfer ID, and any data already present within that partial file is
+ * retained. The acknowledgement of a resumable upload reports the offset at
+ * which the client must continue sending data as "OK (RESUME <offset>)",
+ * such that only missing data is sent.
+ *
+ * @param user
+ *     The user uploading the file.
+ *
+ * @param stream
+ *     The stream along which the file will be received.
+ *
+ * @param fs
+ *     The filesystem to which the file is being uploaded.
+ *
+ * @param path
+ *     The absolute path of the file within the filesystem.
+ *
+ * @param mimetype
+ *     The mimetype of the upload, including any parameters declaring the
+ *     upload resumable.
+ */
+static void __guac_rdp_upload_begin(guac_user* user, guac_stream* stream,
+        guac_rdp_fs* fs, const char* path, const char* mimetype) {
 
     int file_id;
     guac_rdp_stream* rdp_stream;
-    char file_path[GUAC_RDP_FS_MAX_PATH];
+    char transfer_id[GUAC_RDP_UPLOAD_MAX_TRANSFER_ID];
+    char partial_path[GUAC_RDP_FS_MAX_PATH];
+    char message[64];
+    uint64_t length;
+    uint64_t offset = 0;
+
+    int resumable = __guac_rdp_upload_parse_mimetype(mimetype, transfer_id,
+            &length);
+
+    /* Resumable uploads retain any data previously received */
+    if (resumable) {
+
+        guac_rdp_fs_file* file;
+
+        if (snprintf(partial_path, sizeof(partial_path), "%s%s%s", path,
+                    GUAC_RDP_UPLOAD_PARTIAL_SUFFIX, transfer_id)
+                >= (int) sizeof(partial_path)) {
+            guac_protocol_send_ack(user->socket, stream, "FAIL (PATH TOO LONG)",
+                    GUAC_PROTOCOL_STATUS_CLIENT_BAD_REQUEST);
+            guac_socket_flush(user->socket);
+            return;
+        }
+
+        file_id = guac_rdp_fs_open(fs, partial_path, ACCESS_GENERIC_WRITE, 0,
+                DISP_FILE_OPEN_IF, 0);
+
+        /* Data received so far is the contiguous prefix of the file, as
+         * uploads are always written sequentially */
+        file = guac_rdp_fs_get_file(fs, file_id);
+        if (file != NULL)
+            offset = file->size;
+
+        /* Discard partial data which cannot belong to this upload */
+        if (file != NULL && length != 0 && offset > length) {
+            guac_rdp_fs_truncate(fs, file_id, 0);
+            offset = 0;
+        }
+
+        if (offset != 0)
+            guac_user_log(user, GUAC_LOG_INFO, "Resuming upload of \"%s\" "
+                    "at offset %" PRIu64 ".", path, offset);
 
-    /* Get filesystem, return error if no filesystem */
-    guac_rdp_fs* fs = rdp_client->filesystem;
-    if (fs == NULL) {
-        guac_protocol_send_ack(user->socket, stream, "FAIL (NO FS)",
-                GUAC_PROTOCOL_STATUS_SERVER_ERROR);
-        guac_socket_flush(user->socket);
-        return 0;
     }
 
-    /* Translate name */
-    __generate_upload_path(filename, file_path);
+    /* Otherwise, overwrite any existing file */
+    else
+        file_id = guac_rdp_fs_open(fs, path, ACCESS_GENERIC_WRITE, 0,
+                DISP_FILE_OVERWRITE_IF, 0);
 
-    /* Open file */
-    file_id = guac_rdp_fs_open(fs, file_path, ACCESS_GENERIC_WRITE, 0,
-            DISP_FILE_OVERWRITE_IF, 0);
+    /* Abort on failure */
     if (file_id < 0) {
         guac_protocol_send_ack(user->socket, stream, "FAIL (CANNOT OPEN)",
                 GUAC_PROTOCOL_STATUS_CLIENT_FORBIDDEN);
         guac_socket_flush(user->socket);
-        return 0;
+        return;
     }
 
     /* Init upload status */
     rdp_stream = malloc(sizeof(guac_rdp_stream));
     rdp_stream->type = GUAC_RDP_UPLOAD_STREAM;
-    rdp_stream->upload_status.offset = 0;
+    rdp_stream->upload_status.offset = offset;
     rdp_stream->upload_status.file_id = file_id;
+    rdp_stream->upload_status.resumable = resumable;
+    rdp_stream->upload_status.length = length;
+    strncpy(rdp_stream->upload_status.path, path, GUAC_RDP_FS_MAX_PATH - 1);
+    rdp_stream->upload_status.path[GUAC_RDP_FS_MAX_PATH - 1] = '\0';
+
+    /* Init stream for file upload */
     stream->data = rdp_stream;
     stream->blob_handler = guac_rdp_upload_blob_handler;
     stream->end_handler = guac_rdp_upload_end_handler;
 
-    guac_protocol_send_ack(user->socket, stream, "OK (STREAM BEGIN)",
+    /* Acknowledge stream creation, reporting data already present */
+    if (resumable)
+        snprintf(message, sizeof(message), "OK (RESUME %" PRIu64 ")", offset);
+    else
+        strcpy(message, "OK (STREAM BEGIN)");
+
+    guac_protocol_send_ack(user->socket, stream, message,
             GUAC_PROTOCOL_STATUS_SUCCESS);
     guac_socket_flush(user->socket);
+
+}
+
+int guac_rdp_upload_file_handler(guac_user* user, guac_stream* stream,
+        char* mimetype, char* filename) {
+
+    guac_client* client = user->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+
+    char file_path[GUAC_RDP_FS_MAX_PATH];
+
+    /* Get filesystem, return error if no filesystem */
+    guac_rdp_fs* fs = rdp_client->filesystem;
+    if (fs == NULL) {
+        guac_protocol_send_ack(user->socket, stream, "FAIL (NO FS)",
+                GUAC_PROTOCOL_STATUS_SERVER_ERROR);
+        guac_socket_flush(user->socket);
+        return 0;
+    }
+
+    /* Translate name */
+    __generate_upload_path(filename, file_path);
+
+    __guac_rdp_upload_begin(user, stream, fs, file_path, mimetype);
     return 0;
 
 }
@@ -256,6 +428,7 @@ int guac_rdp_upload_end_handler(guac_user* user, guac_stream* stream) {
     guac_client* client = user->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
     guac_rdp_stream* rdp_stream = (guac_rdp_stream*) stream->data;
+    guac_rdp_upload_status* upload_status = &(rdp_stream->upload_status);
 
     /* Get filesystem, return error if no filesystem */
     guac_rdp_fs* fs = rdp_client->filesystem;
@@ -266,8 +439,42 @@ int guac_rdp_upload_end_handler(guac_user* user, guac_stream* stream) {
         return 0;
     }
 
+    /* Resumable uploads which end early remain partial, such that a later
+     * upload may continue where this upload stopped */
+    if (upload_status->resumable && upload_status->length != 0
+            && upload_status->offset < upload_status->length) {
+
+        char message[64];
+        snprintf(message, sizeof(message), "OK (PARTIAL %" PRIu64 ")",
+                upload_status->offset);
+
+        guac_rdp_fs_close(fs, upload_status->file_id);
+        guac_protocol_send_ack(user->socket, stream, message,
+                GUAC_PROTOCOL_STATUS_SUCCESS);
+        guac_socket_flush(user->socket);
+
+        free(rdp_stream);
+        return 0;
+
+    }
+
+    /* Move completed resumable uploads into place */
+    if (upload_status->resumable
+            && guac_rdp_fs_rename(fs, upload_status->file_id,
+                upload_status->path)) {
+
+        guac_rdp_fs_close(fs, upload_status->file_id);
+        guac_protocol_send_ack(user->socket, stream, "FAIL (CANNOT RENAME)",
+                GUAC_PROTOCOL_STATUS_CLIENT_FORBIDDEN);
+        guac_socket_flush(user->socket);
+
+        free(rdp_stream);
+        return 0;
+
+    }
+
     /* Close file */
-    guac_rdp_fs_close(fs, rdp_stream->upload_status.file_id);
+    guac_rdp_fs_close(fs, upload_status->file_id);
 
     /* Acknowledge stream end */
     guac_protocol_send_ack(user->socket, stream, "OK (STREAM END)",
@@ -372,34 +579,211 @@ int guac_rdp_download_ack_handler(guac_user* user, guac_stream* stream,
 
 }
 
+/**
+ * Compares the strings pointed to by the given pointers, as required by
+ * qsort().
+ *
+ * @param a
+ *     Pointer to the first string to compare.
+ *
+ * @param b
+ *     Pointer to the second string to compare.
+ *
+ * @return
+ *     A negative value, zero, or a positive value if the first string sorts
+ *     before, equal to, or after the second string respectively.
+ */
+static int __guac_rdp_ls_compare(const void* a, const void* b) {
+    return strcmp(*((char* const*) a), *((char* const*) b));
+}
+
+/**
+ * Returns the name of the next entry to be listed, skipping the current and
+ * parent directory entries and any entries not matching the filter of the
+ * listing.
+ *
+ * @param ls_status
+ *     The state of the directory listing.
+ *
+ * @return
+ *     The name of the next entry to be listed, or NULL if no entries remain.
+ */
+static const char* __guac_rdp_ls_next_entry(guac_rdp_ls_status* ls_status) {
+
+    const char* filename;
+
+    /* Read from sorted entries, if sorting */
+    if (ls_status->entries != NULL) {
+
+        if (ls_status->entry_index >= ls_status->entry_count)
+            return NULL;
+
+        return ls_status->entries[ls_status->entry_index++];
+
+    }
+
+    while ((filename = guac_rdp_fs_read_dir(ls_status->fs,
+                    ls_status->file_id)) != NULL) {
+
+        /* Skip current and parent directory entries */
+        if (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0)
+            continue;
+
+        /* Skip entries not matching filter */
+        if (ls_status->filter[0] != '\0'
+                && guac_rdp_fs_matches(filename, ls_status->filter))
+            continue;
+
+        return filename;
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Reads the names of all entries to be listed from the directory, sorting
+ * those names such that they are listed in order.
+ *
+ * @param ls_status
+ *     The state of the directory listing, which must not yet have listed
+ *     any entries.
+ */
+static void __guac_rdp_ls_sort_entries(guac_rdp_ls_status* ls_status) {
+
+    const char* filename;
+    int available = GUAC_RDP_LS_INITIAL_ENTRIES;
+
+    char** entries = malloc(sizeof(char*) * available);
+    int count = 0;
+
+    while ((filename = __guac_rdp_ls_next_entry(ls_status)) != NULL) {
+
+        /* Expand array as necessary */
+        if (count == available) {
+            available *= 2;
+            entries = realloc(entries, sizeof(char*) * available);
+        }
+
+        entries[count++] = strdup(filename);
+
+    }
+
+    qsort(entries, count, sizeof(char*), __guac_rdp_ls_compare);
+
+    ls_status->entries = entries;
+    ls_status->entry_count = count;
+    ls_status->entry_index = 0;
+
+}
+
+/**
+ * Parses the options which may follow the path of a directory listing
+ * request, as described for guac_rdp_download_get_handler(), removing those
+ * options from the path. Unrecognized options are ignored.
+ *
+ * @param user
+ *     The user requesting the directory listing.
+ *
+ * @param path
+ *     The requested path, which will be truncated at the start of its
+ *     options, if any.
+ *
+ * @param filter
+ *     Buffer of GUAC_RDP_FS_MAX_PATH bytes which will receive the filter
+ *     pattern, or an empty string if no filter was requested.
+ *
+ * @return
+ *     Non-zero if sorting was requested, zero otherwise.
+ */
+static int __guac_rdp_ls_parse_options(guac_user* user, char* path,
+        char* filter) {
+
+    int sorted = 0;
+    char* option = strchr(path, GUAC_RDP_LS_OPTIONS_SEPARATOR);
+
+    filter[0] = '\0';
+
+    /* No options unless separator is present */
+    if (option == NULL)
+        return 0;
+
+    *(option++) = '\0';
+
+    while (option != NULL) {
+
+        /* Isolate current option */
+        char* next = strchr(option, '&');
+        if (next != NULL)
+            *(next++) = '\0';
+
+        if (strcmp(option, "sort=name") == 0)
+            sorted = 1;
+
+        else if (strncmp(option, "filter=", 7) == 0) {
+            strncpy(filter, option + 7, GUAC_RDP_FS_MAX_PATH - 1);
+            filter[GUAC_RDP_FS_MAX_PATH - 1] = '\0';
+        }
+
+        else
+            guac_user_log(user, GUAC_LOG_DEBUG, "Ignoring unknown directory "
+                    "listing option \"%s\".", option);
+
+        option = next;
+
+    }
+
+    return sorted;
+
+}
+
+/**
+ * Releases all resources associated with the given directory listing stream,
+ * including the directory being listed.
+ *
+ * @param rdp_stream
+ *     The directory listing stream to free.
+ */
+static void __guac_rdp_ls_free(guac_rdp_stream* rdp_stream) {
+
+    guac_rdp_ls_status* ls_status = &(rdp_stream->ls_status);
+    int i;
+
+    /* Free any sorted entries */
+    if (ls_status->entries != NULL) {
+        for (i = 0; i < ls_status->entry_count; i++)
+            free(ls_status->entries[i]);
+        free(ls_status->entries);
+    }
+
+    guac_rdp_fs_close(ls_status->fs, ls_status->file_id);
+    free(rdp_stream);
+
+}
+
 int guac_rdp_ls_ack_handler(guac_user* user, guac_stream* stream,
         char* message, guac_protocol_status status) {
 
     int blob_written = 0;
-    const char* filename;
+    const char* filename = NULL;
 
     guac_rdp_stream* rdp_stream = (guac_rdp_stream*) stream->data;
 
     /* If unsuccessful, free stream and abort */
     if (status != GUAC_PROTOCOL_STATUS_SUCCESS) {
-        guac_rdp_fs_close(rdp_stream->ls_status.fs,
-                rdp_stream->ls_status.file_id);
+        __guac_rdp_ls_free(rdp_stream);
         guac_user_free_stream(user, stream);
-        free(rdp_stream);
         return 0;
     }
 
-    /* While directory entries remain */
-    while ((filename = guac_rdp_fs_read_dir(rdp_stream->ls_status.fs,
-                    rdp_stream->ls_status.file_id)) != NULL
-            && !blob_written) {
+    /* Write entries until one page has been sent, checking for a complete
+     * page before reading each entry such that no entry is lost */
+    while (!blob_written && (filename =
+                __guac_rdp_ls_next_entry(&rdp_stream->ls_status)) != NULL) {
 
         char absolute_path[GUAC_RDP_FS_MAX_PATH];
 
-        /* Skip current and parent directory entries */
-        if (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0)
-            continue;
-
         /* Concatenate into absolute path - skip if invalid */
         if (!guac_rdp_fs_append_filename(absolute_path,
                     rdp_stream->ls_status.directory_name, filename)) {
@@ -452,9 +836,7 @@ int guac_rdp_ls_ack_handler(guac_user* user, guac_stream* stream,
                 &rdp_stream->ls_status.json_state);
 
         /* Clean up resources */
-        guac_rdp_fs_close(rdp_stream->ls_status.fs,
-                rdp_stream->ls_status.file_id);
-        free(rdp_stream);
+        __guac_rdp_ls_free(rdp_stream);
 
         /* Signal of stream */
         guac_protocol_send_end(user->socket, stream);
@@ -473,11 +855,17 @@ int guac_rdp_download_get_handler(guac_user* user, guac_object* object,
     guac_client* client = user->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
+    char filter[GUAC_RDP_FS_MAX_PATH];
+    int sorted;
+
     /* Get filesystem, ignore request if no filesystem */
     guac_rdp_fs* fs = rdp_client->filesystem;
     if (fs == NULL)
         return 0;
 
+    /* Separate any directory listing options from path */
+    sorted = __guac_rdp_ls_parse_options(user, name, filter);
+
     /* Attempt to open file for reading */
     int file_id = guac_rdp_fs_open(fs, name, ACCESS_GENERIC_READ, 0,
             DISP_FILE_OPEN, 0);
@@ -506,6 +894,14 @@ int guac_rdp_download_get_handler(guac_user* user, guac_object* object,
         rdp_stream->ls_status.file_id = file_id;
         strncpy(rdp_stream->ls_status.directory_name, name,
                 sizeof(rdp_stream->ls_status.directory_name) - 1);
+        rdp_stream->ls_status.directory_name[
+            sizeof(rdp_stream->ls_status.directory_name) - 1] = '\0';
+        strcpy(rdp_stream->ls_status.filter, filter);
+        rdp_stream->ls_status.entries = NULL;
+
+        /* Read and sort all entries up front if sorting was requested */
+        if (sorted)
+            __guac_rdp_ls_sort_entries(&rdp_stream->ls_status);
 
         /* Allocate stream for body */
         guac_stream* stream = guac_user_alloc_stream(user);
@@ -561,33 +957,7 @@ int guac_rdp_upload_put_handler(guac_user* user, guac_object* object,
         return 0;
     }
 
-    /* Open file */
-    int file_id = guac_rdp_fs_open(fs, name, ACCESS_GENERIC_WRITE, 0,
-            DISP_FILE_OVERWRITE_IF, 0);
-
-    /* Abort on failure */
-    if (file_id < 0) {
-        guac_protocol_send_ack(user->socket, stream, "FAIL (CANNOT OPEN)",
-                GUAC_PROTOCOL_STATUS_CLIENT_FORBIDDEN);
-        guac_socket_flush(user->socket);
-        return 0;
-    }
-
-    /* Init upload stream data */
-    guac_rdp_stream* rdp_stream = malloc(sizeof(guac_rdp_stream));
-    rdp_stream->type = GUAC_RDP_UPLOAD_STREAM;
-    rdp_stream->upload_status.offset = 0;
-    rdp_stream->upload_status.file_id = file_id;
-
-    /* Allocate stream, init for file upload */
-    stream->data = rdp_stream;
-    stream->blob_handler = guac_rdp_upload_blob_handler;
-    stream->end_handler = guac_rdp_upload_end_handler;
-
-    /* Acknowledge stream creation */
-    guac_protocol_send_ack(user->socket, stream, "OK (STREAM BEGIN)",
-            GUAC_PROTOCOL_STATUS_SUCCESS);
-    guac_socket_flush(user->socket);
+    __guac_rdp_upload_begin(user, stream, fs, name, mimetype);
     return 0;
 }
 
@@ -48,6 +48,18 @@ typedef struct guac_rdp_download_status {
 
 } guac_rdp_download_status;
 
+/**
+ * The maximum length of the transfer ID of a resumable upload, including
+ * null terminator. Longer transfer IDs are truncated.
+ */
+#define GUAC_RDP_UPLOAD_MAX_TRANSFER_ID 65
+
+/**
+ * The suffix appended to the path of a file being uploaded resumably, prior
+ * to the transfer ID, while the upload is incomplete.
+ */
+#define GUAC_RDP_UPLOAD_PARTIAL_SUFFIX ".partial-"
+
 /**
  * Structure which represents the current state of an upload.
  */
@@ -57,17 +69,54 @@ typedef struct guac_rdp_upload_status {
      * The overall offset within the file that the next write should
      * occur at.
      */
-    int offset;
+    uint64_t offset;
 
     /**
      * The ID of the file being written to.
      */
     int file_id;
 
+    /**
+     * Whether this upload is resumable. Resumable uploads are written to a
+     * partial file named after their transfer ID, which is moved to the
+     * destination path only once the upload is complete. If the upload is
+     * interrupted, a later upload having the same transfer ID continues from
+     * the end of the partial file.
+     */
+    int resumable;
+
+    /**
+     * The total length of the file being uploaded, in bytes, if declared by
+     * the client. Only valid for resumable uploads.
+     */
+    uint64_t length;
+
+    /**
+     * The absolute path that the file should be moved to once the upload is
+     * complete. Only valid for resumable uploads.
+     */
+    char path[GUAC_RDP_FS_MAX_PATH];
+
 } guac_rdp_upload_status;
 
 /**
- * The current state of a directory listing operation.
+ * The character separating the path of a directory listing request from its
+ * options. As '?' may not appear within Windows filenames, it cannot be
+ * part of a valid path.
+ */
+#define GUAC_RDP_LS_OPTIONS_SEPARATOR '?'
+
+/**
+ * The initial number of entries to allocate space for when sorting a
+ * directory listing. The space allocated is doubled as necessary.
+ */
+#define GUAC_RDP_LS_INITIAL_ENTRIES 256
+
+/**
+ * The current state of a directory listing operation. Each acknowledgement
+ * received from the user produces at most one page of the listing, bounded
+ * by the size of the JSON buffer, such that listings of any size are sent at
+ * the rate the user receives them.
  */
 typedef struct guac_rdp_ls_status {
 
@@ -86,6 +135,28 @@ typedef struct guac_rdp_ls_status {
      */
     char directory_name[GUAC_RDP_FS_MAX_PATH];
 
+    /**
+     * Pattern which the names of listed entries must match, as accepted by
+     * guac_rdp_fs_matches(), or an empty string if all entries are listed.
+     */
+    char filter[GUAC_RDP_FS_MAX_PATH];
+
+    /**
+     * The names of all listed entries in sorted order, or NULL if entries
+     * are listed in the order they are read from the directory.
+     */
+    char** entries;
+
+    /**
+     * The number of names within the entries array.
+     */
+    int entry_count;
+
+    /**
+     * The index of the next name within the entries array to be listed.
+     */
+    int entry_index;
+
     /**
      * The current state of the JSON directory object being written.
      */
@@ -211,7 +282,11 @@ guac_user_ack_handler guac_rdp_ls_ack_handler;
 /**
  * Handler for get messages. In context of downloads and the filesystem exposed
  * via the Guacamole protocol, get messages request the body of a file within
- * the filesystem.
+ * the filesystem. Requests for directory listings may append options to the
+ * path following GUAC_RDP_LS_OPTIONS_SEPARATOR, as "&"-separated name/value
+ * pairs: "sort=name" lists entries sorted by name, and "filter=PATTERN" lists
+ * only entries whose names match the given wildcard pattern, for example
+ * "/Documents?sort=name&filter=*.pdf".
  */
 guac_user_get_handler guac_rdp_download_get_handler;
 
@@ -22,6 +22,8 @@
 
 #include <guacamole/user.h>
 
+#include <stdint.h>
+
 int guac_rdp_resolution_reasonable(guac_user* user, int resolution) {
 
     int width  = user->info.optimal_width;
@@ -40,7 +42,14 @@ int guac_rdp_resolution_reasonable(guac_user* user, int resolution) {
 
 }
 
-int guac_rdp_suggest_resolution(guac_user* user) {
+int guac_rdp_suggest_resolution(guac_user* user, int max_pixels) {
+
+    /* If the operator has budgeted remote pixels, render at the user's own
+     * resolution, scaling down only as far as that budget requires */
+    if (max_pixels > 0)
+        return guac_rdp_resolution_constrain(user->info.optimal_width,
+                user->info.optimal_height, user->info.optimal_resolution,
+                user->info.optimal_resolution, max_pixels);
 
     /* Prefer RDP's native resolution */
     if (guac_rdp_resolution_reasonable(user, GUAC_RDP_NATIVE_RESOLUTION))
@@ -55,3 +64,79 @@ int guac_rdp_suggest_resolution(guac_user* user) {
 
 }
 
+int guac_rdp_resolution_constrain(int width, int height, int user_resolution,
+        int resolution, int max_pixels) {
+
+    /* No limit */
+    if (max_pixels <= 0)
+        return resolution;
+
+    /* Step down until the remote display fits, never going below 1 DPI */
+    while (resolution > 1) {
+
+        /* Convert user pixels to remote pixels */
+        int64_t remote_width  = (int64_t) width  * resolution / user_resolution;
+        int64_t remote_height = (int64_t) height * resolution / user_resolution;
+
+        if (remote_width * remote_height <= max_pixels)
+            break;
+
+        resolution--;
+
+    }
+
+    return resolution;
+
+}
+
+void guac_rdp_resolution_constrain_size(int* width, int* height,
+        int max_pixels) {
+
+    int64_t original_width = *width;
+    int64_t original_height = *height;
+
+    /* No limit, or already within limit */
+    if (max_pixels <= 0 || original_width * original_height <= max_pixels)
+        return;
+
+    /* Step down width, scaling height to match, until the display fits */
+    int64_t new_width = original_width;
+    int64_t new_height = original_height;
+    while (new_width > 1 && new_width * new_height > max_pixels) {
+        new_width--;
+        new_height = original_height * new_width / original_width;
+    }
+
+    *width = new_width;
+    *height = new_height > 0 ? new_height : 1;
+
+}
+
+int guac_rdp_desktop_scale_factor(int resolution) {
+
+    int scale = resolution * 100 / GUAC_RDP_NATIVE_RESOLUTION;
+
+    /* Constrain to range accepted by RDP servers */
+    if (scale < GUAC_RDP_MIN_DESKTOP_SCALE_FACTOR)
+        return GUAC_RDP_MIN_DESKTOP_SCALE_FACTOR;
+
+    if (scale > GUAC_RDP_MAX_DESKTOP_SCALE_FACTOR)
+        return GUAC_RDP_MAX_DESKTOP_SCALE_FACTOR;
+
+    return scale;
+
+}
+
+int guac_rdp_device_scale_factor(int desktop_scale_factor) {
+
+    /* Choose nearest of the three allowed values */
+    if (desktop_scale_factor >= 160)
+        return 180;
+
+    if (desktop_scale_factor >= 120)
+        return 140;
+
+    return 100;
+
+}
+
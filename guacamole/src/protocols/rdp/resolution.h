@@ -39,16 +39,97 @@ int guac_rdp_resolution_reasonable(guac_user* user, int resolution);
 
 /**
  * Returns a reasonable resolution for the remote display, given the size and
- * resolution of a guac_user.
+ * resolution of a guac_user. If a maximum number of remote pixels is given,
+ * the user's own resolution is preferred, such that HiDPI displays are
+ * rendered at full detail within that limit.
  *
  * @param user
  *     The guac_user whose size and resolution shall be used to determine an
  *     appropriate remote display resolution.
  *
+ * @param max_pixels
+ *     The maximum number of pixels the remote display may contain, or zero
+ *     if no limit applies.
+ *
  * @return
  *     A reasonable resolution for the remote display, in DPI.
  */
-int guac_rdp_suggest_resolution(guac_user* user);
+int guac_rdp_suggest_resolution(guac_user* user, int max_pixels);
+
+/**
+ * Returns the highest resolution, not exceeding the given resolution, at
+ * which a remote display covering the given area of the user's display would
+ * contain no more than the given number of pixels.
+ *
+ * @param width
+ *     The width of the area of the user's display, in user pixels.
+ *
+ * @param height
+ *     The height of the area of the user's display, in user pixels.
+ *
+ * @param user_resolution
+ *     The resolution of the user's display, in DPI.
+ *
+ * @param resolution
+ *     The desired resolution of the remote display, in DPI.
+ *
+ * @param max_pixels
+ *     The maximum number of pixels the remote display may contain, or zero
+ *     if no limit applies.
+ *
+ * @return
+ *     The given resolution, reduced as necessary to satisfy max_pixels, in
+ *     DPI.
+ */
+int guac_rdp_resolution_constrain(int width, int height, int user_resolution,
+        int resolution, int max_pixels);
+
+/**
+ * Reduces the given dimensions of the remote display, preserving their
+ * aspect ratio, until the remote display contains no more than the given
+ * number of pixels. Dimensions which already satisfy the limit are left
+ * untouched.
+ *
+ * @param width
+ *     A pointer to the width of the remote display, in remote pixels, which
+ *     is reduced as necessary.
+ *
+ * @param height
+ *     A pointer to the height of the remote display, in remote pixels, which
+ *     is reduced as necessary.
+ *
+ * @param max_pixels
+ *     The maximum number of pixels the remote display may contain, or zero
+ *     if no limit applies.
+ */
+void guac_rdp_resolution_constrain_size(int* width, int* height,
+        int max_pixels);
+
+/**
+ * Returns the desktop scale factor which should be requested of the RDP
+ * server for a remote display of the given resolution, such that the remote
+ * desktop renders text and UI elements at their intended physical size.
+ *
+ * @param resolution
+ *     The resolution of the remote display, in DPI.
+ *
+ * @return
+ *     The desktop scale factor, in percent.
+ */
+int guac_rdp_desktop_scale_factor(int resolution);
+
+/**
+ * Returns the device scale factor which should be requested of the RDP server
+ * alongside the given desktop scale factor. RDP accepts only device scale
+ * factors of 100, 140 or 180 percent, and the nearest is chosen.
+ *
+ * @param desktop_scale_factor
+ *     The desktop scale factor being requested, in percent.
+ *
+ * @return
+ *     The device scale factor, in percent.
+ */
+int guac_rdp_device_scale_factor(int desktop_scale_factor);
 
 #endif
 
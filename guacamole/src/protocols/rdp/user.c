@@ -85,12 +85,17 @@ int guac_rdp_user_join_handler(guac_user* user, int argc, char** argv) {
         guac_socket_flush(user->socket);
     }
 
+    /* Announce audio stream, if already started */
+    if (rdp_client->audio != NULL)
+        guac_audio_stream_add_user(rdp_client->audio, user);
+
     /* Only handle events if not read-only */
     if (!settings->read_only) {
 
         /* General mouse/keyboard/clipboard events */
         user->mouse_handler     = guac_rdp_user_mouse_handler;
         user->key_handler       = guac_rdp_user_key_handler;
+        user->text_handler      = guac_rdp_user_text_handler;
         user->clipboard_handler = guac_rdp_clipboard_handler;
 
         /* Display size change events */
@@ -81,6 +81,12 @@ int guac_ssh_client_free_handler(guac_client* client) {
         guac_terminal_free(ssh_client->term);
     }
 
+#ifdef ENABLE_SSH_AGENT
+    /* Free agent if not already freed by ssh_client_thread */
+    if (ssh_client->auth_agent != NULL)
+        ssh_auth_agent_free(ssh_client->auth_agent);
+#endif
+
     /* Free terminal channel now that the terminal is finished */
     if (ssh_client->term_channel != NULL)
         libssh2_channel_free(ssh_client->term_channel);
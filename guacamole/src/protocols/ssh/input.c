@@ -60,6 +60,21 @@ int guac_ssh_user_key_handler(guac_user* user, int keysym, int pressed) {
     return 0;
 }
 
+int guac_ssh_user_text_handler(guac_user* user, const char* text) {
+
+    guac_client* client = user->client;
+    guac_ssh_client* ssh_client = (guac_ssh_client*) client->data;
+    guac_terminal* term = ssh_client->term;
+
+    /* Skip if terminal not yet ready */
+    if (term == NULL)
+        return 0;
+
+    /* Send text */
+    guac_terminal_send_text(term, text);
+    return 0;
+}
+
 int guac_ssh_user_size_handler(guac_user* user, int width, int height) {
 
     /* Get terminal */
@@ -34,6 +34,11 @@ guac_user_mouse_handler guac_ssh_user_mouse_handler;
  */
 guac_user_key_handler guac_ssh_user_key_handler;
 
+/**
+ * Handler for text events received by the Guacamole protocol.
+ */
+guac_user_text_handler guac_ssh_user_text_handler;
+
 /**
  * Handler for Guacamole user size events.
  */
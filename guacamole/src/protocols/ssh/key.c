@@ -25,13 +25,20 @@
 
 #include <openssl/bio.h>
 #include <openssl/bn.h>
+#include <openssl/crypto.h>
 #include <openssl/dsa.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
 #include <openssl/obj_mac.h>
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
+#include <openssl/sha.h>
 
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -112,7 +119,6 @@ void guac_common_ssh_buffer_write_data(char** buffer, const char* data,
  */
 void guac_common_ssh_buffer_write_bignum(char** buffer, const BIGNUM* value) {
 
-    unsigned char* bn_buffer;
     int length;
 
     /* If zero, just write zero length */
@@ -121,27 +127,20 @@ void guac_common_ssh_buffer_write_bignum(char** buffer, const BIGNUM* value) {
         return;
     }
 
-    /* Allocate output buffer, add padding byte */
     length = BN_num_bytes(value);
-    bn_buffer = malloc(length);
-
-    /* Convert BIGNUM */
-    BN_bn2bin(value, bn_buffer);
 
     /* If first byte has high bit set, write padding byte */
-    if (bn_buffer[0] & 0x80) {
+    if (BN_num_bits(value) % 8 == 0) {
         guac_common_ssh_buffer_write_uint32(buffer, length+1);
         guac_common_ssh_buffer_write_byte(buffer, 0);
     }
     else
         guac_common_ssh_buffer_write_uint32(buffer, length);
 
-    /* Write data */
-    memcpy(*buffer, bn_buffer, length);
+    /* Convert BIGNUM directly into buffer */
+    BN_bn2bin(value, (unsigned char*) *buffer);
     *buffer += length;
 
-    free(bn_buffer);
-
 }
 
 /**
@@ -237,115 +236,789 @@ char* guac_common_ssh_buffer_read_string(char** buffer, int* length) {
 
 }
 
-guac_common_ssh_key* guac_common_ssh_key_alloc(char* data, int length,
-        char* passphrase) {
+char* guac_common_ssh_buffer_read_bounded_string(char** buffer,
+        const char* end, int* length) {
+
+    uint8_t* data = (uint8_t*) *buffer;
+    uint32_t value_length;
+    char* value;
+
+    /* Length must fit within buffer */
+    if (end - *buffer < 4)
+        return NULL;
+
+    value_length = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+
+    /* Value must fit within remainder of buffer */
+    if (value_length > (uint32_t) (end - *buffer - 4))
+        return NULL;
 
+    value = *buffer + 4;
+    *buffer = value + value_length;
+    *length = value_length;
+
+    return value;
+
+}
+
+/**
+ * A single entry within the process-wide cache of parsed keys.
+ */
+typedef struct guac_common_ssh_key_cache_entry {
+
+    /**
+     * Hash of the key data and passphrase from which the key was parsed.
+     */
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+
+    /**
+     * The cached key, or NULL if this entry is unused. The cache holds its
+     * own reference to this key.
+     */
     guac_common_ssh_key* key;
-    BIO* key_bio;
 
-    char* public_key;
+    /**
+     * The value of __guac_common_ssh_key_cache_clock when this entry was
+     * last used.
+     */
+    uint64_t last_used;
+
+} guac_common_ssh_key_cache_entry;
+
+/**
+ * Process-wide cache of parsed keys, such that connections using the same
+ * key need not parse and re-encode that key.
+ */
+static guac_common_ssh_key_cache_entry
+    __guac_common_ssh_key_cache[GUAC_COMMON_SSH_KEY_CACHE_SIZE];
+
+/**
+ * Counter which increases with each use of the key cache, used to determine
+ * the least-recently-used entry.
+ */
+static uint64_t __guac_common_ssh_key_cache_clock = 0;
+
+/**
+ * Lock which guards the key cache and the reference counts of all keys.
+ */
+static pthread_mutex_t __guac_common_ssh_key_cache_lock =
+    PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Calculates the hash identifying the given key data and passphrase within
+ * the key cache.
+ *
+ * @param data
+ *     The key data.
+ *
+ * @param length
+ *     The length of the key data, in bytes.
+ *
+ * @param passphrase
+ *     The passphrase to use when decrypting the key, if any.
+ *
+ * @param hash
+ *     The buffer into which the hash should be written. This buffer must be
+ *     at least SHA256_DIGEST_LENGTH bytes.
+ *
+ * @return
+ *     Zero if the hash was calculated successfully, non-zero otherwise.
+ */
+static int __guac_common_ssh_key_hash(const char* data, int length,
+        const char* passphrase, unsigned char* hash) {
+
+    unsigned char length_prefix[4];
+    char* pos = (char*) length_prefix;
+
+    EVP_MD_CTX* md_ctx = EVP_MD_CTX_create();
+    if (md_ctx == NULL)
+        return 1;
+
+    /* Length-prefix the key data such that data and passphrase cannot be
+     * confused */
+    guac_common_ssh_buffer_write_uint32(&pos, length);
+
+    EVP_DigestInit(md_ctx, EVP_sha256());
+    EVP_DigestUpdate(md_ctx, length_prefix, sizeof(length_prefix));
+    EVP_DigestUpdate(md_ctx, data, length);
+    if (passphrase != NULL)
+        EVP_DigestUpdate(md_ctx, passphrase, strlen(passphrase));
+    EVP_DigestFinal(md_ctx, hash, NULL);
+
+    EVP_MD_CTX_destroy(md_ctx);
+    return 0;
+
+}
+
+/**
+ * Releases a single reference to the given key, freeing the key if no
+ * references remain. The key cache lock must be held.
+ *
+ * @param key
+ *     The key to release.
+ */
+static void __guac_common_ssh_key_release(guac_common_ssh_key* key) {
+
+    if (--key->refcount > 0)
+        return;
+
+    /* Free key-specific data */
+    if (key->type == SSH_KEY_RSA)
+        RSA_free(key->rsa);
+    else if (key->type == SSH_KEY_DSA)
+        DSA_free(key->dsa);
+    else
+        EVP_PKEY_free(key->pkey);
+
+    OPENSSL_cleanse(key->private_key, key->private_key_length);
+    free(key->private_key);
+    free(key->public_key);
+    free(key);
+
+}
+
+/**
+ * Searches the key cache for a key parsed from data and passphrase having
+ * the given hash, acquiring a new reference to that key if found. The key
+ * cache lock must be held.
+ *
+ * @param hash
+ *     The hash of the key data and passphrase.
+ *
+ * @return
+ *     The cached key, or NULL if no such key is cached.
+ */
+static guac_common_ssh_key* __guac_common_ssh_key_cache_get(
+        const unsigned char* hash) {
+
+    int i;
+
+    for (i = 0; i < GUAC_COMMON_SSH_KEY_CACHE_SIZE; i++) {
+
+        guac_common_ssh_key_cache_entry* entry =
+            &__guac_common_ssh_key_cache[i];
+
+        if (entry->key != NULL
+                && CRYPTO_memcmp(entry->hash, hash, sizeof(entry->hash)) == 0) {
+            entry->last_used = ++__guac_common_ssh_key_cache_clock;
+            entry->key->refcount++;
+            return entry->key;
+        }
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Stores the given key within the key cache, replacing the least-recently
+ * used entry if the cache is full. The key cache lock must be held.
+ *
+ * @param hash
+ *     The hash of the key data and passphrase from which the key was parsed.
+ *
+ * @param key
+ *     The key to cache.
+ */
+static void __guac_common_ssh_key_cache_put(const unsigned char* hash,
+        guac_common_ssh_key* key) {
+
+    guac_common_ssh_key_cache_entry* victim = &__guac_common_ssh_key_cache[0];
+    int i;
+
+    /* Use first unused entry, or the least-recently-used entry */
+    for (i = 0; i < GUAC_COMMON_SSH_KEY_CACHE_SIZE; i++) {
+
+        guac_common_ssh_key_cache_entry* entry =
+            &__guac_common_ssh_key_cache[i];
+
+        if (entry->key == NULL) {
+            victim = entry;
+            break;
+        }
+
+        if (entry->last_used < victim->last_used)
+            victim = entry;
+
+    }
+
+    /* Release the cache's reference to any evicted key */
+    if (victim->key != NULL)
+        __guac_common_ssh_key_release(victim->key);
+
+    memcpy(victim->hash, hash, sizeof(victim->hash));
+    victim->key = key;
+    victim->last_used = ++__guac_common_ssh_key_cache_clock;
+    key->refcount++;
+
+}
+
+/**
+ * Allocates a new key of the given type, with no associated public key.
+ *
+ * @param type
+ *     The type of the key.
+ *
+ * @return
+ *     A newly-allocated key having a single reference.
+ */
+static guac_common_ssh_key* __guac_common_ssh_key_create(
+        guac_common_ssh_key_type type) {
+
+    guac_common_ssh_key* key = calloc(1, sizeof(guac_common_ssh_key));
+    key->type = type;
+    key->refcount = 1;
+
+    /* Allocate space for public key */
+    key->public_key = malloc(4096);
+
+    return key;
+
+}
+
+/**
+ * Allocates a new key wrapping the given RSA private key, encoding its
+ * public key as necessary for SSH.
+ *
+ * @param rsa_key
+ *     The RSA private key. The new key takes ownership of this RSA key.
+ *
+ * @return
+ *     A newly-allocated key having a single reference.
+ */
+static guac_common_ssh_key* __guac_common_ssh_key_create_rsa(RSA* rsa_key) {
+
+    guac_common_ssh_key* key = __guac_common_ssh_key_create(SSH_KEY_RSA);
+    char* pos = key->public_key;
+
+    const BIGNUM* key_e;
+    const BIGNUM* key_n;
+
+    key->rsa = rsa_key;
+
+    /* Retrieve public key */
+    RSA_get0_key(rsa_key, &key_n, &key_e, NULL);
+
+    /* Send public key formatted for SSH */
+    guac_common_ssh_buffer_write_string(&pos, "ssh-rsa", sizeof("ssh-rsa")-1);
+    guac_common_ssh_buffer_write_bignum(&pos, key_e);
+    guac_common_ssh_buffer_write_bignum(&pos, key_n);
+
+    key->public_key_length = pos - key->public_key;
+    return key;
+
+}
+
+/**
+ * Allocates a new key wrapping the given DSA private key, encoding its
+ * public key as necessary for SSH.
+ *
+ * @param dsa_key
+ *     The DSA private key. The new key takes ownership of this DSA key.
+ *
+ * @return
+ *     A newly-allocated key having a single reference.
+ */
+static guac_common_ssh_key* __guac_common_ssh_key_create_dsa(DSA* dsa_key) {
+
+    guac_common_ssh_key* key = __guac_common_ssh_key_create(SSH_KEY_DSA);
+    char* pos = key->public_key;
+
+    const BIGNUM* key_p;
+    const BIGNUM* key_q;
+    const BIGNUM* key_g;
+    const BIGNUM* pub_key;
+
+    key->dsa = dsa_key;
+
+    /* Retrieve public key */
+    DSA_get0_pqg(dsa_key, &key_p, &key_q, &key_g);
+    DSA_get0_key(dsa_key, &pub_key, NULL);
+
+    /* Send public key formatted for SSH */
+    guac_common_ssh_buffer_write_string(&pos, "ssh-dss", sizeof("ssh-dss")-1);
+    guac_common_ssh_buffer_write_bignum(&pos, key_p);
+    guac_common_ssh_buffer_write_bignum(&pos, key_q);
+    guac_common_ssh_buffer_write_bignum(&pos, key_g);
+    guac_common_ssh_buffer_write_bignum(&pos, pub_key);
+
+    key->public_key_length = pos - key->public_key;
+    return key;
+
+}
+
+#ifdef HAVE_ECDSA_SIG_GET0
+/**
+ * Returns the SSH name of the given ECDSA curve, along with the NID of the
+ * digest which must be used when signing with keys on that curve.
+ *
+ * @param curve
+ *     The NID of the curve.
+ *
+ * @param md_nid
+ *     A pointer to an int which will receive the NID of the digest to use.
+ *
+ * @return
+ *     The SSH name of the curve, or NULL if the curve is not supported by
+ *     SSH.
+ */
+static const char* __guac_common_ssh_key_ecdsa_curve(int curve, int* md_nid) {
+
+    switch (curve) {
+
+        case NID_X9_62_prime256v1:
+            *md_nid = NID_sha256;
+            return "nistp256";
+
+        case NID_secp384r1:
+            *md_nid = NID_sha384;
+            return "nistp384";
+
+        case NID_secp521r1:
+            *md_nid = NID_sha512;
+            return "nistp521";
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Allocates a new key wrapping the given ECDSA private key, encoding its
+ * public key as necessary for SSH.
+ *
+ * @param pkey
+ *     The ECDSA private key. The new key takes ownership of this key only if
+ *     allocation succeeds.
+ *
+ * @return
+ *     A newly-allocated key having a single reference, or NULL if the curve
+ *     of the given key is not supported by SSH.
+ */
+static guac_common_ssh_key* __guac_common_ssh_key_create_ecdsa(
+        EVP_PKEY* pkey) {
+
+    const EC_KEY* ec_key = EVP_PKEY_get0_EC_KEY(pkey);
+    const EC_GROUP* group = EC_KEY_get0_group(ec_key);
+
+    unsigned char point[256];
+    size_t point_length;
+
+    char name[32];
+    const char* curve;
+    int md_nid;
+
+    guac_common_ssh_key* key;
     char* pos;
 
-    /* Create BIO for reading key from memory */
-    key_bio = BIO_new_mem_buf(data, length);
+    /* Only NIST curves are supported by SSH */
+    curve = __guac_common_ssh_key_ecdsa_curve(EC_GROUP_get_curve_name(group),
+            &md_nid);
+    if (curve == NULL)
+        return NULL;
 
-    /* If RSA key, load RSA */
-    if (length > sizeof(SSH_RSA_KEY_HEADER)-1
-            && memcmp(SSH_RSA_KEY_HEADER, data,
-                      sizeof(SSH_RSA_KEY_HEADER)-1) == 0) {
+    /* Retrieve public key */
+    point_length = EC_POINT_point2oct(group, EC_KEY_get0_public_key(ec_key),
+            POINT_CONVERSION_UNCOMPRESSED, point, sizeof(point), NULL);
+    if (point_length == 0)
+        return NULL;
 
-        RSA* rsa_key;
+    key = __guac_common_ssh_key_create(SSH_KEY_ECDSA);
+    key->pkey = pkey;
+    pos = key->public_key;
 
-        const BIGNUM* key_e;
-        const BIGNUM* key_n;
+    /* Send public key formatted for SSH */
+    snprintf(name, sizeof(name), "ecdsa-sha2-%s", curve);
+    guac_common_ssh_buffer_write_string(&pos, name, strlen(name));
+    guac_common_ssh_buffer_write_string(&pos, curve, strlen(curve));
+    guac_common_ssh_buffer_write_string(&pos, (char*) point, point_length);
 
-        /* Read key */
-        rsa_key = PEM_read_bio_RSAPrivateKey(key_bio, NULL, NULL, passphrase);
-        if (rsa_key == NULL)
-            return NULL;
+    key->public_key_length = pos - key->public_key;
+    return key;
 
-        /* Allocate key */
-        key = malloc(sizeof(guac_common_ssh_key));
-        key->rsa = rsa_key;
+}
+#endif
 
-        /* Set type */
-        key->type = SSH_KEY_RSA;
+#ifdef HAVE_EVP_PKEY_ED25519
+/**
+ * Allocates a new key wrapping the given Ed25519 private key, encoding its
+ * public key as necessary for SSH.
+ *
+ * @param pkey
+ *     The Ed25519 private key. The new key takes ownership of this key only
+ *     if allocation succeeds.
+ *
+ * @return
+ *     A newly-allocated key having a single reference, or NULL if the public
+ *     key cannot be retrieved.
+ */
+static guac_common_ssh_key* __guac_common_ssh_key_create_ed25519(
+        EVP_PKEY* pkey) {
+
+    unsigned char public_key[32];
+    size_t public_key_length = sizeof(public_key);
+
+    guac_common_ssh_key* key;
+    char* pos;
+
+    /* Retrieve public key */
+    if (EVP_PKEY_get_raw_public_key(pkey, public_key, &public_key_length) != 1)
+        return NULL;
+
+    key = __guac_common_ssh_key_create(SSH_KEY_ED25519);
+    key->pkey = pkey;
+    pos = key->public_key;
+
+    /* Send public key formatted for SSH */
+    guac_common_ssh_buffer_write_string(&pos, "ssh-ed25519",
+            sizeof("ssh-ed25519")-1);
+    guac_common_ssh_buffer_write_string(&pos, (char*) public_key,
+            public_key_length);
+
+    key->public_key_length = pos - key->public_key;
+    return key;
 
-        /* Allocate space for public key */
-        public_key = malloc(4096);
-        pos = public_key;
+}
 
-        /* Retrieve public key */
-        RSA_get0_key(rsa_key, &key_n, &key_e, NULL);
+/**
+ * Reads a four-byte integer from the given buffer, advancing the buffer by
+ * four bytes, verifying that the integer lies within the buffer.
+ *
+ * @param buffer
+ *     The buffer to read from.
+ *
+ * @param end
+ *     The first byte beyond the end of the buffer.
+ *
+ * @param value
+ *     A pointer to the integer which should receive the value read.
+ *
+ * @return
+ *     Zero if the value was read, non-zero if the buffer is too short.
+ */
+static int __guac_common_ssh_key_read_uint32(char** buffer, const char* end,
+        uint32_t* value) {
 
-        /* Send public key formatted for SSH */
-        guac_common_ssh_buffer_write_string(&pos, "ssh-rsa", sizeof("ssh-rsa")-1);
-        guac_common_ssh_buffer_write_bignum(&pos, key_e);
-        guac_common_ssh_buffer_write_bignum(&pos, key_n);
+    if (end - *buffer < 4)
+        return 1;
 
-        /* Save public key to structure */
-        key->public_key = public_key;
-        key->public_key_length = pos - public_key;
+    *value = guac_common_ssh_buffer_read_uint32(buffer);
+    return 0;
 
+}
+
+/**
+ * Parses the given unencrypted Ed25519 key, stored in the OpenSSH private key
+ * format, which is the only format in which OpenSSH stores Ed25519 keys.
+ *
+ * @param data
+ *     The PEM-style text of the key, including header and footer.
+ *
+ * @param length
+ *     The length of the provided data, in bytes.
+ *
+ * @return
+ *     The parsed private key, or NULL if the key could not be parsed, is
+ *     encrypted, or is not an Ed25519 key.
+ */
+static EVP_PKEY* __guac_common_ssh_key_read_openssh(const char* data,
+        int length) {
+
+    EVP_PKEY* pkey = NULL;
+
+    const char* end = data + length;
+    const char* current;
+
+    char* encoded;
+    int encoded_length = 0;
+
+    char* decoded;
+    int decoded_length;
+
+    char* pos;
+    char* decoded_end;
+
+    char* value;
+    int value_length;
+    char* private_section;
+    char* private_section_end;
+    uint32_t count, check1, check2;
+
+    /* Copy base64 content, skipping header, footer and whitespace */
+    encoded = malloc(length);
+    current = data + sizeof(SSH_OPENSSH_KEY_HEADER)-1;
+    for (; current < end && *current != '-'; current++) {
+        if (!isspace((unsigned char) *current))
+            encoded[encoded_length++] = *current;
     }
 
-    /* If DSA key, load DSA */
-    else if (length > sizeof(SSH_DSA_KEY_HEADER)-1
-            && memcmp(SSH_DSA_KEY_HEADER, data,
-                      sizeof(SSH_DSA_KEY_HEADER)-1) == 0) {
+    /* Decode key */
+    decoded = malloc(encoded_length / 4 * 3 + 3);
+    decoded_length = EVP_DecodeBlock((unsigned char*) decoded,
+            (unsigned char*) encoded, encoded_length);
+    free(encoded);
+
+    if (decoded_length < (int) sizeof(SSH_OPENSSH_KEY_MAGIC))
+        goto done;
+
+    pos = decoded;
+    decoded_end = decoded + decoded_length;
+
+    /* Verify magic */
+    if (memcmp(pos, SSH_OPENSSH_KEY_MAGIC, sizeof(SSH_OPENSSH_KEY_MAGIC)) != 0)
+        goto done;
+    pos += sizeof(SSH_OPENSSH_KEY_MAGIC);
+
+    /* Encrypted keys are not supported */
+    value = guac_common_ssh_buffer_read_bounded_string(&pos, decoded_end,
+            &value_length);
+    if (value == NULL || value_length != 4 || memcmp(value, "none", 4) != 0)
+        goto done;
+
+    /* Skip KDF name and options */
+    if (guac_common_ssh_buffer_read_bounded_string(&pos, decoded_end,
+                &value_length) == NULL
+            || guac_common_ssh_buffer_read_bounded_string(&pos, decoded_end,
+                &value_length) == NULL)
+        goto done;
+
+    /* Only files containing a single key are supported */
+    if (__guac_common_ssh_key_read_uint32(&pos, decoded_end, &count)
+            || count != 1)
+        goto done;
+
+    /* Skip public key, which is repeated within the private section */
+    if (guac_common_ssh_buffer_read_bounded_string(&pos, decoded_end,
+                &value_length) == NULL)
+        goto done;
+
+    /* Read private section */
+    private_section = guac_common_ssh_buffer_read_bounded_string(&pos,
+            decoded_end, &value_length);
+    if (private_section == NULL)
+        goto done;
+
+    pos = private_section;
+    private_section_end = private_section + value_length;
+
+    /* Check integers must match */
+    if (__guac_common_ssh_key_read_uint32(&pos, private_section_end, &check1)
+            || __guac_common_ssh_key_read_uint32(&pos, private_section_end,
+                &check2)
+            || check1 != check2)
+        goto done;
+
+    /* Verify key type */
+    value = guac_common_ssh_buffer_read_bounded_string(&pos,
+            private_section_end, &value_length);
+    if (value == NULL || value_length != sizeof("ssh-ed25519")-1
+            || memcmp(value, "ssh-ed25519", value_length) != 0)
+        goto done;
+
+    /* Skip public key */
+    if (guac_common_ssh_buffer_read_bounded_string(&pos, private_section_end,
+                &value_length) == NULL)
+        goto done;
+
+    /* Private key is the 32-byte seed followed by the public key */
+    value = guac_common_ssh_buffer_read_bounded_string(&pos,
+            private_section_end, &value_length);
+    if (value == NULL || value_length != 64)
+        goto done;
+
+    pkey = EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, NULL,
+            (unsigned char*) value, 32);
+
+done:
+    OPENSSL_cleanse(decoded, decoded_length > 0 ? decoded_length : 0);
+    free(decoded);
+    return pkey;
 
-        DSA* dsa_key;
+}
+#endif
+
+/**
+ * Allocates a new key wrapping the given private key of any type supported
+ * by OpenSSL's generic key interface, as read from PKCS#8 or SEC1 PEM.
+ *
+ * @param pkey
+ *     The private key. The new key takes ownership of this key only if
+ *     allocation succeeds.
+ *
+ * @return
+ *     A newly-allocated key having a single reference, or NULL if the type
+ *     of the given key is not supported.
+ */
+static guac_common_ssh_key* __guac_common_ssh_key_create_pkey(EVP_PKEY* pkey) {
+
+    guac_common_ssh_key* key = NULL;
 
-        const BIGNUM* key_p;
-        const BIGNUM* key_q;
-        const BIGNUM* key_g;
-        const BIGNUM* pub_key;
+    switch (EVP_PKEY_base_id(pkey)) {
 
-        /* Read key */
-        dsa_key = PEM_read_bio_DSAPrivateKey(key_bio, NULL, NULL, passphrase);
-        if (dsa_key == NULL)
-            return NULL;
+        case EVP_PKEY_RSA:
+            key = __guac_common_ssh_key_create_rsa(EVP_PKEY_get1_RSA(pkey));
+            EVP_PKEY_free(pkey);
+            break;
 
-        /* Allocate key */
-        key = malloc(sizeof(guac_common_ssh_key));
-        key->dsa = dsa_key;
+        case EVP_PKEY_DSA:
+            key = __guac_common_ssh_key_create_dsa(EVP_PKEY_get1_DSA(pkey));
+            EVP_PKEY_free(pkey);
+            break;
 
-        /* Set type */
-        key->type = SSH_KEY_DSA;
+#ifdef HAVE_ECDSA_SIG_GET0
+        case EVP_PKEY_EC:
+            key = __guac_common_ssh_key_create_ecdsa(pkey);
+            break;
+#endif
 
-        /* Allocate space for public key */
-        public_key = malloc(4096);
-        pos = public_key;
+#ifdef HAVE_EVP_PKEY_ED25519
+        case EVP_PKEY_ED25519:
+            key = __guac_common_ssh_key_create_ed25519(pkey);
+            break;
+#endif
 
-        /* Retrieve public key */
-        DSA_get0_pqg(dsa_key, &key_p, &key_q, &key_g);
-        DSA_get0_key(dsa_key, &pub_key, NULL);
+    }
 
-        /* Send public key formatted for SSH */
-        guac_common_ssh_buffer_write_string(&pos, "ssh-dss", sizeof("ssh-dss")-1);
-        guac_common_ssh_buffer_write_bignum(&pos, key_p);
-        guac_common_ssh_buffer_write_bignum(&pos, key_q);
-        guac_common_ssh_buffer_write_bignum(&pos, key_g);
-        guac_common_ssh_buffer_write_bignum(&pos, pub_key);
+    return key;
 
-        /* Save public key to structure */
-        key->public_key = public_key;
-        key->public_key_length = pos - public_key;
+}
+
+/**
+ * Parses the given private key data, allocating a new key. Unlike
+ * guac_common_ssh_key_alloc(), the key cache is not consulted.
+ *
+ * @param data
+ *     The PEM-encoded data to decode when reading the key.
+ *
+ * @param length
+ *     The length of the provided data, in bytes.
+ *
+ * @param passphrase
+ *     The passphrase to use when decrypting the key, if any, or an empty
+ *     string or NULL if no passphrase is needed.
+ *
+ * @return
+ *     The decoded, decrypted private key having a single reference, or NULL
+ *     if the key could not be decoded.
+ */
+static guac_common_ssh_key* __guac_common_ssh_key_parse(char* data,
+        int length, char* passphrase) {
+
+    guac_common_ssh_key* key = NULL;
+    BIO* key_bio;
+
+    /* Create BIO for reading key from memory */
+    key_bio = BIO_new_mem_buf(data, length);
+
+    /* If RSA key, load RSA */
+    if (length > sizeof(SSH_RSA_KEY_HEADER)-1
+            && memcmp(SSH_RSA_KEY_HEADER, data,
+                      sizeof(SSH_RSA_KEY_HEADER)-1) == 0) {
+
+        RSA* rsa_key = PEM_read_bio_RSAPrivateKey(key_bio, NULL, NULL,
+                passphrase);
+        if (rsa_key != NULL)
+            key = __guac_common_ssh_key_create_rsa(rsa_key);
 
     }
 
-    /* Otherwise, unsupported type */
+    /* If DSA key, load DSA */
+    else if (length > sizeof(SSH_DSA_KEY_HEADER)-1
+            && memcmp(SSH_DSA_KEY_HEADER, data,
+                      sizeof(SSH_DSA_KEY_HEADER)-1) == 0) {
+
+        DSA* dsa_key = PEM_read_bio_DSAPrivateKey(key_bio, NULL, NULL,
+                passphrase);
+        if (dsa_key != NULL)
+            key = __guac_common_ssh_key_create_dsa(dsa_key);
+
+    }
+
+#ifdef HAVE_EVP_PKEY_ED25519
+    /* If OpenSSH key, parse natively (only Ed25519 is supported) */
+    else if (length > sizeof(SSH_OPENSSH_KEY_HEADER)-1
+            && memcmp(SSH_OPENSSH_KEY_HEADER, data,
+                      sizeof(SSH_OPENSSH_KEY_HEADER)-1) == 0) {
+
+        EVP_PKEY* pkey = __guac_common_ssh_key_read_openssh(data, length);
+        if (pkey != NULL) {
+            key = __guac_common_ssh_key_create_ed25519(pkey);
+            if (key == NULL)
+                EVP_PKEY_free(pkey);
+        }
+
+    }
+#endif
+
+    /* Otherwise, attempt to read any other PEM key (PKCS#8 or SEC1) */
     else {
-        BIO_free(key_bio);
-        return NULL;
+
+        EVP_PKEY* pkey = PEM_read_bio_PrivateKey(key_bio, NULL, NULL,
+                passphrase);
+        if (pkey != NULL) {
+            key = __guac_common_ssh_key_create_pkey(pkey);
+            if (key == NULL)
+                EVP_PKEY_free(pkey);
+        }
+
     }
 
+    BIO_free(key_bio);
+
+    if (key == NULL)
+        return NULL;
+
     /* Copy private key to structure */
     key->private_key_length = length;
     key->private_key = malloc(length);
     memcpy(key->private_key, data, length);
 
-    BIO_free(key_bio);
+    return key;
+
+}
+
+guac_common_ssh_key* guac_common_ssh_key_alloc(char* data, int length,
+        char* passphrase) {
+
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    guac_common_ssh_key* key;
+    guac_common_ssh_key* cached;
+
+    /* Parse directly if the key cannot be identified */
+    if (__guac_common_ssh_key_hash(data, length, passphrase, hash))
+        return __guac_common_ssh_key_parse(data, length, passphrase);
+
+    /* Use cached key, if available */
+    pthread_mutex_lock(&__guac_common_ssh_key_cache_lock);
+    key = __guac_common_ssh_key_cache_get(hash);
+    pthread_mutex_unlock(&__guac_common_ssh_key_cache_lock);
+
+    if (key != NULL)
+        return key;
+
+    /* Parse key without holding the lock, such that distinct keys may be
+     * parsed concurrently */
+    key = __guac_common_ssh_key_parse(data, length, passphrase);
+    if (key == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&__guac_common_ssh_key_cache_lock);
+
+    /* Prefer any identical key cached while this key was being parsed */
+    cached = __guac_common_ssh_key_cache_get(hash);
+    if (cached != NULL) {
+        __guac_common_ssh_key_release(key);
+        key = cached;
+    }
+
+    /* Otherwise, cache the newly-parsed key */
+    else
+        __guac_common_ssh_key_cache_put(hash, key);
+
+    pthread_mutex_unlock(&__guac_common_ssh_key_cache_lock);
+
     return key;
 
 }
@@ -358,53 +1031,83 @@ const char* guac_common_ssh_key_error() {
 }
 
 void guac_common_ssh_key_free(guac_common_ssh_key* key) {
-
-    /* Free key-specific data */
-    if (key->type == SSH_KEY_RSA)
-        RSA_free(key->rsa);
-    else if (key->type == SSH_KEY_DSA)
-        DSA_free(key->dsa);
-
-    free(key->private_key);
-    free(key->public_key);
-    free(key);
+    pthread_mutex_lock(&__guac_common_ssh_key_cache_lock);
+    __guac_common_ssh_key_release(key);
+    pthread_mutex_unlock(&__guac_common_ssh_key_cache_lock);
 }
 
-int guac_common_ssh_key_sign(guac_common_ssh_key* key, const char* data,
-        int length, unsigned char* sig) {
+/**
+ * Calculates the digest of the given data using the digest having the given
+ * NID.
+ *
+ * @param md_nid
+ *     The NID of the digest to use.
+ *
+ * @param data
+ *     The arbitrary data to digest.
+ *
+ * @param length
+ *     The length of the arbitrary data, in bytes.
+ *
+ * @param digest
+ *     The buffer into which the digest should be written. This buffer must
+ *     be at least EVP_MAX_MD_SIZE bytes.
+ *
+ * @param dlen
+ *     A pointer to an unsigned int which will receive the length of the
+ *     digest, in bytes.
+ *
+ * @return
+ *     Zero if the digest was calculated, non-zero otherwise.
+ */
+static int __guac_common_ssh_key_digest(int md_nid, const char* data,
+        int length, unsigned char* digest, unsigned int* dlen) {
 
     const EVP_MD* md;
 
-    unsigned char digest[EVP_MAX_MD_SIZE];
-    unsigned int dlen, len;
-
-    /* Get SHA1 digest */
-    if ((md = EVP_get_digestbynid(NID_sha1)) == NULL)
-        return -1;
+    /* Get digest */
+    if ((md = EVP_get_digestbynid(md_nid)) == NULL)
+        return 1;
 
     /* Allocate digest context */
     EVP_MD_CTX* md_ctx = EVP_MD_CTX_create();
     if (md_ctx == NULL)
-        return -1;
+        return 1;
 
     /* Digest data */
     EVP_DigestInit(md_ctx, md);
     EVP_DigestUpdate(md_ctx, data, length);
-    EVP_DigestFinal(md_ctx, digest, &dlen);
+    EVP_DigestFinal(md_ctx, digest, dlen);
 
     /* Digest context no longer needed */
     EVP_MD_CTX_destroy(md_ctx);
+    return 0;
+
+}
+
+int guac_common_ssh_key_sign(guac_common_ssh_key* key, const char* data,
+        int length, unsigned char* sig) {
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int dlen, len;
 
     /* Sign with key */
     switch (key->type) {
 
         case SSH_KEY_RSA:
+            if (__guac_common_ssh_key_digest(NID_sha1, data, length,
+                        digest, &dlen))
+                return -1;
             if (RSA_sign(NID_sha1, digest, dlen, sig, &len, key->rsa) == 1)
                 return len;
             break;
 
         case SSH_KEY_DSA: {
 
+            if (__guac_common_ssh_key_digest(NID_sha1, data, length,
+                        digest, &dlen))
+                return -1;
+
             DSA_SIG* dsa_sig = DSA_do_sign(digest, dlen, key->dsa);
             if (dsa_sig != NULL) {
 
@@ -438,7 +1141,72 @@ int guac_common_ssh_key_sign(guac_common_ssh_key* key, const char* data,
 
             }
 
+            break;
+
+        }
+
+#ifdef HAVE_ECDSA_SIG_GET0
+        case SSH_KEY_ECDSA: {
+
+            const EC_KEY* ec_key = EVP_PKEY_get0_EC_KEY(key->pkey);
+            int md_nid;
+
+            /* Digest depends on curve */
+            if (__guac_common_ssh_key_ecdsa_curve(EC_GROUP_get_curve_name(
+                            EC_KEY_get0_group(ec_key)), &md_nid) == NULL)
+                return -1;
+
+            if (__guac_common_ssh_key_digest(md_nid, data, length,
+                        digest, &dlen))
+                return -1;
+
+            ECDSA_SIG* ecdsa_sig = ECDSA_do_sign(digest, dlen,
+                    (EC_KEY*) ec_key);
+            if (ecdsa_sig != NULL) {
+
+                const BIGNUM* sig_r;
+                const BIGNUM* sig_s;
+                char* pos = (char*) sig;
+
+                /* Signature is R and S, each as an SSH mpint */
+                ECDSA_SIG_get0(ecdsa_sig, &sig_r, &sig_s);
+                guac_common_ssh_buffer_write_bignum(&pos, sig_r);
+                guac_common_ssh_buffer_write_bignum(&pos, sig_s);
+
+                ECDSA_SIG_free(ecdsa_sig);
+                return pos - (char*) sig;
+
+            }
+
+            break;
+
         }
+#endif
+
+#ifdef HAVE_EVP_PKEY_ED25519
+        case SSH_KEY_ED25519: {
+
+            size_t sig_len = ED25519_SIG_SIZE;
+            int result = -1;
+
+            /* Ed25519 signs the data directly, without a separate digest */
+            EVP_MD_CTX* md_ctx = EVP_MD_CTX_create();
+            if (md_ctx == NULL)
+                return -1;
+
+            if (EVP_DigestSignInit(md_ctx, NULL, NULL, NULL, key->pkey) == 1
+                    && EVP_DigestSign(md_ctx, sig, &sig_len,
+                        (const unsigned char*) data, length) == 1)
+                result = sig_len;
+
+            EVP_MD_CTX_destroy(md_ctx);
+            return result;
+
+        }
+#endif
+
+        default:
+            break;
 
     }
 
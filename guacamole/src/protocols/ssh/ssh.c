@@ -31,6 +31,7 @@
 
 #include <libssh2.h>
 #include <guacamole/client.h>
+#include <guacamole/profile.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
@@ -181,6 +182,9 @@ void* ssh_client_thread(void* data) {
 
     pthread_t input_thread;
 
+    /* Allow this thread to be sampled by the native profiler */
+    guac_profile_register_thread(client);
+
     /* Init SSH base libraries */
     if (guac_common_ssh_init(client)) {
         guac_client_abort(client, GUAC_PROTOCOL_STATUS_SERVER_ERROR,
@@ -239,19 +243,31 @@ void* ssh_client_thread(void* data) {
     }
 
 #ifdef ENABLE_SSH_AGENT
-    /* Start SSH agent forwarding, if enabled */
-    if (ssh_client->enable_agent) {
-        libssh2_session_callback_set(ssh_client->session,
-                LIBSSH2_CALLBACK_AUTH_AGENT, (void*) ssh_auth_agent_callback);
-
-        /* Request agent forwarding */
-        if (libssh2_channel_request_auth_agent(ssh_client->term_channel))
-            guac_client_log(client, GUAC_LOG_ERROR, "Agent forwarding request failed");
-        else
-            guac_client_log(client, GUAC_LOG_INFO, "Agent forwarding enabled.");
-    }
-
     ssh_client->auth_agent = NULL;
+
+    /* Start SSH agent forwarding, if enabled and a key is available */
+    if (settings->enable_agent && ssh_client->user->private_key != NULL) {
+
+        ssh_client->auth_agent = ssh_auth_agent_alloc(client,
+                ssh_client->session->session, ssh_client->session->fd,
+                &ssh_client->term_channel_lock,
+                ssh_client->user->private_key);
+
+        if (ssh_client->auth_agent != NULL) {
+
+            libssh2_session_callback_set(ssh_client->session->session,
+                    LIBSSH2_CALLBACK_AUTH_AGENT,
+                    (void*) ssh_auth_agent_callback);
+
+            /* Request agent forwarding */
+            if (libssh2_channel_request_auth_agent(ssh_client->term_channel))
+                guac_client_log(client, GUAC_LOG_ERROR, "Agent forwarding request failed");
+            else
+                guac_client_log(client, GUAC_LOG_INFO, "Agent forwarding enabled.");
+
+        }
+
+    }
 #endif
 
     /* Set up the ttymode array prior to requesting the PTY */
@@ -298,6 +314,14 @@ void* ssh_client_thread(void* data) {
     /* Set non-blocking */
     libssh2_session_set_blocking(ssh_client->session->session, 0);
 
+#ifdef ENABLE_SSH_AGENT
+    /* Serve agent requests independently of terminal output */
+    if (ssh_client->auth_agent != NULL
+            && ssh_auth_agent_start(ssh_client->auth_agent))
+        guac_client_log(client, GUAC_LOG_ERROR, "Unable to start SSH agent "
+                "thread. Agent requests will not be answered.");
+#endif
+
     /* While data available, write to terminal */
     int bytes_read = 0;
     for (;;) {
@@ -351,31 +375,38 @@ void* ssh_client_thread(void* data) {
         else if (bytes_read < 0 && bytes_read != LIBSSH2_ERROR_EAGAIN)
             break;
 
-#ifdef ENABLE_SSH_AGENT
-        /* If agent open, handle any agent packets */
-        if (ssh_client->auth_agent != NULL) {
-            bytes_read = ssh_auth_agent_read(ssh_client->auth_agent);
-            if (bytes_read > 0)
-                total_read += bytes_read;
-            else if (bytes_read < 0 && bytes_read != LIBSSH2_ERROR_EAGAIN)
-                ssh_client->auth_agent = NULL;
-        }
-#endif
-
         /* Wait for more data if reads turn up empty */
         if (total_read == 0) {
 
-            /* Wait on the SSH session file descriptor only */
-            struct pollfd fds[] = {{
-                .fd      = ssh_client->session->fd,
-                .events  = POLLIN,
-                .revents = 0,
-            }};
+            /* Wait on the SSH session file descriptor, as well as for the
+             * agent to read data which may be destined for the terminal */
+            struct pollfd fds[] = {
+                {
+                    .fd      = ssh_client->session->fd,
+                    .events  = POLLIN,
+                    .revents = 0,
+                },
+                {
+                    .fd      = -1,
+                    .events  = POLLIN,
+                    .revents = 0,
+                }
+            };
+
+#ifdef ENABLE_SSH_AGENT
+            if (ssh_client->auth_agent != NULL)
+                fds[1].fd = ssh_client->auth_agent->notify_pipe[0];
+#endif
 
             /* Wait up to computed timeout */
-            if (poll(fds, 1, timeout) < 0)
+            if (poll(fds, 2, timeout) < 0)
                 break;
 
+#ifdef ENABLE_SSH_AGENT
+            if (fds[1].revents & POLLIN)
+                ssh_auth_agent_acknowledge(ssh_client->auth_agent);
+#endif
+
         }
 
     }
@@ -384,6 +415,14 @@ void* ssh_client_thread(void* data) {
     guac_client_stop(client);
     pthread_join(input_thread, NULL);
 
+#ifdef ENABLE_SSH_AGENT
+    /* Stop agent now that no other thread uses the session */
+    if (ssh_client->auth_agent != NULL) {
+        ssh_auth_agent_free(ssh_client->auth_agent);
+        ssh_client->auth_agent = NULL;
+    }
+#endif
+
     pthread_mutex_destroy(&ssh_client->term_channel_lock);
 
     guac_client_log(client, GUAC_LOG_INFO, "SSH connection ended.");
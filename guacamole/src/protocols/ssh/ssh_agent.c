@@ -19,183 +19,622 @@
 
 #include "config.h"
 
-#include "client.h"
+#include "_ssh.h"
+#include "key.h"
+#include "ssh.h"
 #include "ssh_agent.h"
-#include "ssh_buffer.h"
 
 #include <guacamole/client.h>
 #include <libssh2.h>
-#include <openssl/err.h>
-#include <openssl/evp.h>
-#include <openssl/pem.h>
 #include <openssl/rsa.h>
 
-#include <stdio.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
-void ssh_auth_agent_sign(ssh_auth_agent* agent, char* data, int data_length) {
+/**
+ * The maximum size of any signature produced by the agent, in bytes. This is
+ * sufficient for RSA keys of up to 8192 bits, as well as all DSA, ECDSA and
+ * Ed25519 keys.
+ */
+#define SSH_AGENT_MAX_SIGNATURE_SIZE 1024
 
-    LIBSSH2_CHANNEL* channel = agent->channel;
-    ssh_key* key = agent->identity;
+/**
+ * Writes the given data to the given agent channel in its entirety,
+ * acquiring the session lock only for the duration of each libssh2 call.
+ *
+ * @param auth_agent
+ *     The agent which owns the channel.
+ *
+ * @param agent_channel
+ *     The channel to write to.
+ *
+ * @param data
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ *
+ * @return
+ *     Zero if all data was written, non-zero if an error occurred.
+ */
+static int __ssh_auth_agent_write(ssh_auth_agent* auth_agent,
+        ssh_auth_agent_channel* agent_channel, const char* data, int length) {
+
+    while (length > 0) {
+
+        pthread_mutex_lock(auth_agent->session_lock);
+        ssize_t written = libssh2_channel_write(agent_channel->channel,
+                data, length);
+        pthread_mutex_unlock(auth_agent->session_lock);
+
+        /* Wait for the session to become writable if necessary */
+        if (written == LIBSSH2_ERROR_EAGAIN) {
+            struct pollfd fds[] = {{
+                .fd      = auth_agent->fd,
+                .events  = POLLOUT,
+                .revents = 0,
+            }};
+            if (poll(fds, 1, SSH_AGENT_POLL_TIMEOUT) < 0)
+                return 1;
+            continue;
+        }
 
-    char sig[4096];
-    int sig_len;
+        if (written < 0)
+            return 1;
 
-    char buffer[4096];
-    char* pos = buffer;
+        data += written;
+        length -= written;
 
-    /* Sign with key */
-    sig_len = ssh_key_sign(key, data, data_length, (u_char*) sig);
-    if (sig_len < 0)
-        return;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Handles an agent sign request, signing the given data with the agent's
+ * identity if the given key blob refers to that identity.
+ *
+ * @param auth_agent
+ *     The agent which received the request.
+ *
+ * @param agent_channel
+ *     The channel over which the request was received.
+ *
+ * @param data
+ *     The contents of the request, excluding length and type.
+ *
+ * @param data_length
+ *     The length of the request contents, in bytes.
+ *
+ * @return
+ *     Zero if a response was sent, non-zero if an error occurred.
+ */
+static int __ssh_auth_agent_sign(ssh_auth_agent* auth_agent,
+        ssh_auth_agent_channel* agent_channel, char* data, int data_length) {
 
-    buffer_write_uint32(&pos, 1+4 + 4+7 + 4+sig_len);
+    ssh_auth_agent_identity* identity = &auth_agent->identity;
+    guac_common_ssh_key* key = identity->key;
 
-    buffer_write_byte(&pos, SSH2_AGENT_SIGN_RESPONSE);
-    buffer_write_uint32(&pos, 4+7 + 4+sig_len);
+    char* end = data + data_length;
+    char* pos = data;
 
-    /* Write key type */
-    if (key->type == SSH_KEY_RSA)
-        buffer_write_string(&pos, "ssh-rsa", 7);
-    else if (key->type == SSH_KEY_DSA)
-        buffer_write_string(&pos, "ssh-dss", 7);
-    else
-        return;
+    char* key_blob;
+    int key_blob_length;
+    char* sign_data;
+    int sign_data_length;
 
-    /* Write signature */
-    buffer_write_string(&pos, sig, sig_len);
+    unsigned char sig[SSH_AGENT_MAX_SIGNATURE_SIZE];
+    int sig_len;
 
-    libssh2_channel_write(channel, buffer, pos-buffer);
-    libssh2_channel_flush(channel);
+    char buffer[SSH_AGENT_MAX_SIGNATURE_SIZE + 64];
 
-}
+    /* Read key and data, ignore flags */
+    key_blob = guac_common_ssh_buffer_read_bounded_string(&pos, end, &key_blob_length);
+    if (key_blob == NULL)
+        return 1;
 
-void ssh_auth_agent_list_identities(ssh_auth_agent* auth_agent) {
+    sign_data = guac_common_ssh_buffer_read_bounded_string(&pos, end, &sign_data_length);
+    if (sign_data == NULL)
+        return 1;
 
-    LIBSSH2_CHANNEL* channel = auth_agent->channel;
-    ssh_key* key = auth_agent->identity;
+    /* Refuse to sign with any key other than our own */
+    if (key_blob_length != key->public_key_length
+            || memcmp(key_blob, key->public_key, key_blob_length) != 0)
+        return __ssh_auth_agent_write(auth_agent, agent_channel,
+                SSH_AGENT_FAILURE_PACKET, sizeof(SSH_AGENT_FAILURE_PACKET)-1);
 
-    char buffer[4096];
-    char* pos = buffer;
+    /* Sign with key, without holding the session lock */
+    sig_len = guac_common_ssh_key_sign(key, sign_data, sign_data_length, sig);
+    if (sig_len < 0)
+        return __ssh_auth_agent_write(auth_agent, agent_channel,
+                SSH_AGENT_FAILURE_PACKET, sizeof(SSH_AGENT_FAILURE_PACKET)-1);
 
-    buffer_write_uint32(&pos, 1+4
-                              + key->public_key_length+4
-                              + sizeof(SSH_AGENT_COMMENT)+3);
+    pos = buffer;
+    guac_common_ssh_buffer_write_uint32(&pos,
+            1 + 4 + 4 + identity->type_name_length + 4 + sig_len);
 
-    buffer_write_byte(&pos, SSH2_AGENT_IDENTITIES_ANSWER);
-    buffer_write_uint32(&pos, 1);
+    guac_common_ssh_buffer_write_byte(&pos, SSH2_AGENT_SIGN_RESPONSE);
+    guac_common_ssh_buffer_write_uint32(&pos,
+            4 + identity->type_name_length + 4 + sig_len);
 
-    buffer_write_string(&pos, key->public_key, key->public_key_length);
-    buffer_write_string(&pos, SSH_AGENT_COMMENT, sizeof(SSH_AGENT_COMMENT)-1);
+    /* Write key type and signature */
+    guac_common_ssh_buffer_write_string(&pos, identity->type_name,
+            identity->type_name_length);
+    guac_common_ssh_buffer_write_string(&pos, (char*) sig, sig_len);
 
-    libssh2_channel_write(channel, buffer, pos-buffer);
-    libssh2_channel_flush(channel);
+    return __ssh_auth_agent_write(auth_agent, agent_channel,
+            buffer, pos - buffer);
 
 }
 
-void ssh_auth_agent_handle_packet(ssh_auth_agent* auth_agent, uint8_t type,
-        char* data, int data_length) {
+/**
+ * Generic handler for all packets received over an auth agent channel.
+ *
+ * @param auth_agent
+ *     The agent which received the packet.
+ *
+ * @param agent_channel
+ *     The channel over which the packet was received.
+ *
+ * @param type
+ *     The type of the packet.
+ *
+ * @param data
+ *     The contents of the packet, excluding length and type.
+ *
+ * @param data_length
+ *     The length of the packet contents, in bytes.
+ *
+ * @return
+ *     Zero if the packet was handled, non-zero if an error occurred and the
+ *     channel should be closed.
+ */
+static int __ssh_auth_agent_handle_packet(ssh_auth_agent* auth_agent,
+        ssh_auth_agent_channel* agent_channel, uint8_t type, char* data,
+        int data_length) {
 
     switch (type) {
 
         /* List identities */
         case SSH2_AGENT_REQUEST_IDENTITIES:
-            ssh_auth_agent_list_identities(auth_agent);
-            break;
+            return __ssh_auth_agent_write(auth_agent, agent_channel,
+                    auth_agent->identity.identities_answer,
+                    auth_agent->identity.identities_answer_length);
 
         /* Sign request */
-        case SSH2_AGENT_SIGN_REQUEST: {
+        case SSH2_AGENT_SIGN_REQUEST:
+            return __ssh_auth_agent_sign(auth_agent, agent_channel,
+                    data, data_length);
+
+        /* Otherwise, return failure */
+        default:
+            return __ssh_auth_agent_write(auth_agent, agent_channel,
+                    SSH_AGENT_FAILURE_PACKET,
+                    sizeof(SSH_AGENT_FAILURE_PACKET)-1);
+
+    }
+
+}
+
+/**
+ * Handles all complete packets within the buffer of the given agent channel,
+ * shifting any remaining partial packet to the beginning of the buffer.
+ *
+ * @param auth_agent
+ *     The agent which owns the channel.
+ *
+ * @param agent_channel
+ *     The channel whose buffered packets should be handled.
+ *
+ * @return
+ *     Zero if all complete packets were handled, non-zero if an error
+ *     occurred and the channel should be closed.
+ */
+static int __ssh_auth_agent_process(ssh_auth_agent* auth_agent,
+        ssh_auth_agent_channel* agent_channel) {
+
+    unsigned char* buffer = (unsigned char*) agent_channel->buffer;
+    int offset = 0;
 
-            char* pos = data;
+    /* Handle each complete packet */
+    while (agent_channel->buffer_length - offset >= 5) {
 
-            int key_blob_length;
-            int sign_data_length;
-            char* sign_data;
+        unsigned char* packet = buffer + offset;
+        uint32_t length = (packet[0] << 24) | (packet[1] << 16)
+                        | (packet[2] << 8)  |  packet[3];
 
-            /* Skip past key, read data, ignore flags */
-            buffer_read_string(&pos, &key_blob_length);
-            sign_data = buffer_read_string(&pos, &sign_data_length);
+        /* Packets which can never fit within the buffer are invalid */
+        if (length < 1 || length > sizeof(agent_channel->buffer) - 4)
+            return 1;
 
-            /* Sign given data */
-            ssh_auth_agent_sign(auth_agent, sign_data, sign_data_length);
+        /* Wait for remainder of packet */
+        if (agent_channel->buffer_length - offset < (int) length + 4)
             break;
-        }
 
-        /* Otherwise, return failure */
-        default:
-            libssh2_channel_write(auth_agent->channel,
-                    UNSUPPORTED, sizeof(UNSUPPORTED)-1);
+        if (__ssh_auth_agent_handle_packet(auth_agent, agent_channel,
+                    packet[4], (char*) packet + 5, length - 1))
+            return 1;
+
+        offset += length + 4;
 
     }
 
+    /* Shift any partial packet to beginning of buffer */
+    agent_channel->buffer_length -= offset;
+    memmove(buffer, buffer + offset, agent_channel->buffer_length);
+
+    return 0;
+
+}
+
+/**
+ * Closes and frees the agent channel within the given slot, releasing that
+ * slot for use by future channels. This function may only be invoked by the
+ * worker thread or after the worker thread has stopped.
+ *
+ * @param auth_agent
+ *     The agent which owns the channel.
+ *
+ * @param index
+ *     The index of the slot containing the channel.
+ */
+static void __ssh_auth_agent_close(ssh_auth_agent* auth_agent, int index) {
+
+    ssh_auth_agent_channel* agent_channel = auth_agent->channels[index];
+
+    pthread_mutex_lock(auth_agent->session_lock);
+    libssh2_channel_free(agent_channel->channel);
+    pthread_mutex_unlock(auth_agent->session_lock);
+
+    __atomic_store_n(&auth_agent->channels[index], NULL, __ATOMIC_RELEASE);
+    free(agent_channel);
+
 }
 
-int ssh_auth_agent_read(ssh_auth_agent* auth_agent) {
+/**
+ * Reads any available data from the agent channel within the given slot,
+ * handling all complete packets. The session lock is held only while
+ * reading, such that handling requests never delays the SSH session.
+ *
+ * @param auth_agent
+ *     The agent which owns the channel.
+ *
+ * @param index
+ *     The index of the slot containing the channel.
+ *
+ * @return
+ *     The number of bytes read, zero if no data was available, or a
+ *     negative value if the channel was closed.
+ */
+static int __ssh_auth_agent_read(ssh_auth_agent* auth_agent, int index) {
+
+    ssh_auth_agent_channel* agent_channel = auth_agent->channels[index];
+    ssize_t bytes_read;
+    int eof;
 
-    LIBSSH2_CHANNEL* channel = auth_agent->channel;
+    pthread_mutex_lock(auth_agent->session_lock);
+    bytes_read = libssh2_channel_read(agent_channel->channel,
+            agent_channel->buffer + agent_channel->buffer_length,
+            sizeof(agent_channel->buffer) - agent_channel->buffer_length);
+    eof = libssh2_channel_eof(agent_channel->channel);
+    pthread_mutex_unlock(auth_agent->session_lock);
 
-    int bytes_read;
+    if (bytes_read == LIBSSH2_ERROR_EAGAIN)
+        bytes_read = 0;
 
-    if (libssh2_channel_eof(channel))
+    /* Close channel upon error or once no further requests can arrive */
+    if (bytes_read < 0 || (bytes_read == 0 && eof)) {
+        __ssh_auth_agent_close(auth_agent, index);
         return -1;
+    }
 
-    /* Read header if available */
-    if (auth_agent->buffer_length >= 5) {
+    agent_channel->buffer_length += bytes_read;
 
-        uint32_t length =
-              (((unsigned char*) auth_agent->buffer)[0] << 24)
-            | (((unsigned char*) auth_agent->buffer)[1] << 16)
-            | (((unsigned char*) auth_agent->buffer)[2] <<  8)
-            |  ((unsigned char*) auth_agent->buffer)[3];
+    /* Close channel if the request cannot be handled */
+    if (bytes_read > 0 && __ssh_auth_agent_process(auth_agent, agent_channel)) {
+        guac_client_log(auth_agent->client, GUAC_LOG_WARNING,
+                "Closing SSH agent channel due to invalid request.");
+        __ssh_auth_agent_close(auth_agent, index);
+        return -1;
+    }
 
-        uint8_t type = ((unsigned char*) auth_agent->buffer)[4];
+    return bytes_read;
 
-        /* If enough data read, call handler, shift data */
-        if (auth_agent->buffer_length >= length+4) {
+}
 
-            ssh_auth_agent_handle_packet(auth_agent, type,
-                    auth_agent->buffer+5, length-1);
+/**
+ * Signals the given pipe, waking any thread polling its read end. The pipe
+ * must be non-blocking, such that signalling never blocks even if the pipe
+ * is full, in which case the pipe is already signalled.
+ *
+ * @param fd
+ *     The write end of the pipe to signal.
+ */
+static void __ssh_auth_agent_notify(int fd) {
+    if (write(fd, "", 1) < 0) {
+        /* Pipe is already full, thus already signalled */
+    }
+}
+
+/**
+ * Discards all data within the given non-blocking pipe, clearing any
+ * pending signal.
+ *
+ * @param fd
+ *     The read end of the pipe to drain.
+ */
+static void __ssh_auth_agent_drain(int fd) {
+    char buffer[64];
+    while (read(fd, buffer, sizeof(buffer)) > 0);
+}
+
+/**
+ * Creates a pipe whose ends are both non-blocking.
+ *
+ * @param fds
+ *     The array into which the read and write ends of the pipe should be
+ *     stored, as with pipe().
+ *
+ * @return
+ *     Zero if the pipe was created, non-zero otherwise.
+ */
+static int __ssh_auth_agent_pipe(int fds[2]) {
+
+    if (pipe(fds))
+        return 1;
+
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    return 0;
+
+}
+
+/**
+ * Worker thread which serves all agent channels until the agent is stopped.
+ *
+ * @param data
+ *     The ssh_auth_agent to serve.
+ *
+ * @return
+ *     NULL in all cases.
+ */
+static void* __ssh_auth_agent_worker(void* data) {
+
+    ssh_auth_agent* auth_agent = (ssh_auth_agent*) data;
+    int i;
+
+    while (!__atomic_load_n(&auth_agent->stopping, __ATOMIC_ACQUIRE)) {
+
+        int total_read = 0;
+        int open_channels = 0;
+
+        /* Serve every open channel */
+        for (i = 0; i < SSH_AGENT_MAX_CHANNELS; i++) {
+
+            if (__atomic_load_n(&auth_agent->channels[i],
+                        __ATOMIC_ACQUIRE) == NULL)
+                continue;
+
+            int bytes_read = __ssh_auth_agent_read(auth_agent, i);
+            if (bytes_read >= 0)
+                open_channels++;
+            if (bytes_read > 0)
+                total_read += bytes_read;
+
+        }
+
+        /* Reading any channel may have consumed data for other channels of
+         * the session, which the session file descriptor no longer signals */
+        if (open_channels > 0 || total_read > 0)
+            __ssh_auth_agent_notify(auth_agent->notify_pipe[1]);
+
+        /* Wait for more data if reads turn up empty */
+        if (total_read == 0) {
+
+            struct pollfd fds[] = {
+                {
+                    .fd      = auth_agent->wake_pipe[0],
+                    .events  = POLLIN,
+                    .revents = 0,
+                },
+                {
+                    .fd      = auth_agent->fd,
+                    .events  = POLLIN,
+                    .revents = 0,
+                }
+            };
+
+            /* Poll the session only while channels are open, otherwise
+             * sleeping until a channel is opened or the agent stops */
+            if (open_channels > 0) {
+                if (poll(fds, 2, SSH_AGENT_POLL_TIMEOUT) < 0)
+                    break;
+            }
+            else if (poll(fds, 1, -1) < 0)
+                break;
+
+            __ssh_auth_agent_drain(auth_agent->wake_pipe[0]);
 
-            auth_agent->buffer_length -= length+4;
-            memmove(auth_agent->buffer,
-                    auth_agent->buffer+length+4, auth_agent->buffer_length);
-            return length+4;
         }
 
     }
 
-    /* Read data into buffer */
-    bytes_read = libssh2_channel_read(channel,
-            auth_agent->buffer+auth_agent->buffer_length,
-            sizeof(auth_agent->buffer)-auth_agent->buffer_length);
+    return NULL;
 
-    /* If unsuccessful, return error */
-    if (bytes_read < 0)
-        return bytes_read;
+}
 
-    /* Update buffer length */
-    auth_agent->buffer_length += bytes_read;
-    return bytes_read;
+/**
+ * Initializes the given identity, precomputing the key type name and the
+ * SSH2_AGENT_IDENTITIES_ANSWER packet listing the identity.
+ *
+ * @param identity
+ *     The identity to initialize.
+ *
+ * @param key
+ *     The key to expose via the identity.
+ *
+ * @return
+ *     Zero if the identity was initialized, non-zero if the key is not
+ *     supported.
+ */
+static int __ssh_auth_agent_identity_init(ssh_auth_agent_identity* identity,
+        guac_common_ssh_key* key) {
+
+    char* pos = key->public_key;
+
+    /* Reject keys with oversized signatures */
+    if (key->type == SSH_KEY_RSA
+            && RSA_size(key->rsa) > SSH_AGENT_MAX_SIGNATURE_SIZE)
+        return 1;
+
+    /* The key type name is the first string within the public key */
+    identity->type_name = guac_common_ssh_buffer_read_bounded_string(&pos,
+            key->public_key + key->public_key_length,
+            &identity->type_name_length);
+    if (identity->type_name == NULL)
+        return 1;
+
+    identity->key = key;
+
+    identity->identities_answer_length = 4 + 1 + 4
+        + 4 + key->public_key_length
+        + 4 + sizeof(SSH_AGENT_COMMENT)-1;
+    identity->identities_answer = malloc(identity->identities_answer_length);
+
+    pos = identity->identities_answer;
+    guac_common_ssh_buffer_write_uint32(&pos,
+            identity->identities_answer_length - 4);
+
+    guac_common_ssh_buffer_write_byte(&pos, SSH2_AGENT_IDENTITIES_ANSWER);
+    guac_common_ssh_buffer_write_uint32(&pos, 1);
+
+    guac_common_ssh_buffer_write_string(&pos, key->public_key,
+            key->public_key_length);
+    guac_common_ssh_buffer_write_string(&pos, SSH_AGENT_COMMENT,
+            sizeof(SSH_AGENT_COMMENT)-1);
+
+    return 0;
+
+}
+
+ssh_auth_agent* ssh_auth_agent_alloc(guac_client* client,
+        LIBSSH2_SESSION* session, int fd, pthread_mutex_t* session_lock,
+        guac_common_ssh_key* key) {
+
+    ssh_auth_agent* auth_agent = calloc(1, sizeof(ssh_auth_agent));
+    auth_agent->client = client;
+    auth_agent->session = session;
+    auth_agent->fd = fd;
+    auth_agent->session_lock = session_lock;
+
+    if (__ssh_auth_agent_identity_init(&auth_agent->identity, key)) {
+        guac_client_log(client, GUAC_LOG_WARNING, "Private key type is not "
+                "supported by SSH agent forwarding.");
+        free(auth_agent);
+        return NULL;
+    }
+
+    /* Allocate pipes for waking the worker thread and the session reader */
+    if (__ssh_auth_agent_pipe(auth_agent->wake_pipe)) {
+        free(auth_agent->identity.identities_answer);
+        free(auth_agent);
+        return NULL;
+    }
+
+    if (__ssh_auth_agent_pipe(auth_agent->notify_pipe)) {
+        close(auth_agent->wake_pipe[0]);
+        close(auth_agent->wake_pipe[1]);
+        free(auth_agent->identity.identities_answer);
+        free(auth_agent);
+        return NULL;
+    }
+
+    return auth_agent;
 
 }
 
+int ssh_auth_agent_start(ssh_auth_agent* auth_agent) {
+
+    if (pthread_create(&auth_agent->worker, NULL, __ssh_auth_agent_worker,
+                (void*) auth_agent))
+        return 1;
+
+    auth_agent->worker_started = 1;
+    return 0;
+
+}
+
+void ssh_auth_agent_free(ssh_auth_agent* auth_agent) {
+
+    int i;
+
+    /* Stop and wait for worker */
+    if (auth_agent->worker_started) {
+        __atomic_store_n(&auth_agent->stopping, 1, __ATOMIC_RELEASE);
+        __ssh_auth_agent_notify(auth_agent->wake_pipe[1]);
+        pthread_join(auth_agent->worker, NULL);
+    }
+
+    /* Close any remaining channels */
+    for (i = 0; i < SSH_AGENT_MAX_CHANNELS; i++) {
+        if (auth_agent->channels[i] != NULL)
+            __ssh_auth_agent_close(auth_agent, i);
+    }
+
+    close(auth_agent->wake_pipe[0]);
+    close(auth_agent->wake_pipe[1]);
+    close(auth_agent->notify_pipe[0]);
+    close(auth_agent->notify_pipe[1]);
+
+    free(auth_agent->identity.identities_answer);
+    free(auth_agent);
+
+}
+
+void ssh_auth_agent_acknowledge(ssh_auth_agent* auth_agent) {
+    __ssh_auth_agent_drain(auth_agent->notify_pipe[0]);
+}
+
 void ssh_auth_agent_callback(LIBSSH2_SESSION *session,
         LIBSSH2_CHANNEL *channel, void **abstract) {
 
     /* Get client data */
-    guac_client* client = (guac_client*) *abstract;
-    ssh_guac_client_data* client_data = (ssh_guac_client_data*) client->data;
-
-    /* Init auth agent */
-    ssh_auth_agent* auth_agent = malloc(sizeof(ssh_auth_agent));
-    auth_agent->channel = channel;
-    auth_agent->identity = client_data->key;
-    auth_agent->buffer_length = 0;
+    guac_common_ssh_session* common_session =
+        (guac_common_ssh_session*) *abstract;
+    guac_client* client = common_session->client;
+    guac_ssh_client* ssh_client = (guac_ssh_client*) client->data;
+    ssh_auth_agent* auth_agent = ssh_client->auth_agent;
+
+    int i;
+
+    /* Init agent channel */
+    ssh_auth_agent_channel* agent_channel =
+        malloc(sizeof(ssh_auth_agent_channel));
+    agent_channel->channel = channel;
+    agent_channel->buffer_length = 0;
+
+    /* Claim first free slot (the session lock is already held by whichever
+     * thread caused libssh2 to invoke this callback, hence no locking) */
+    for (i = 0; i < SSH_AGENT_MAX_CHANNELS; i++) {
+        ssh_auth_agent_channel* expected = NULL;
+        if (__atomic_compare_exchange_n(&auth_agent->channels[i], &expected,
+                    agent_channel, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __ssh_auth_agent_notify(auth_agent->wake_pipe[1]);
+            return;
+        }
+    }
 
-    /* Store auth agent */
-    client_data->auth_agent = auth_agent;
+    /* Refuse channel if no slots remain */
+    guac_client_log(client, GUAC_LOG_WARNING, "Too many simultaneous SSH "
+            "agent channels. Closing new channel.");
+    libssh2_channel_free(channel);
+    free(agent_channel);
 
 }
 
@@ -23,7 +23,17 @@
 
 #include "config.h"
 
-#include "ssh_key.h"
+#include "key.h"
+
+#include <guacamole/client.h>
+#include <libssh2.h>
+
+#include <pthread.h>
+
+/**
+ * Packet type of an agent failure response.
+ */
+#define SSH2_AGENT_FAILURE 0x05
 
 /**
  * Packet type of an agent identity request.
@@ -51,63 +61,231 @@
 #define SSH_AGENT_COMMENT "Guacamole SSH Agent"
 
 /**
- * The packet sent by the SSH agent when an operation is not supported.
+ * The packet sent by the SSH agent when an operation is not supported or
+ * fails.
  */
-#define UNSUPPORTED "\x00\x00\x00\x0C\x05Unsupported"
+#define SSH_AGENT_FAILURE_PACKET "\x00\x00\x00\x01\x05"
 
 /**
- * Data representing an SSH auth agent.
+ * The maximum number of agent channels which may be open simultaneously.
  */
-typedef struct ssh_auth_agent {
+#define SSH_AGENT_MAX_CHANNELS 16
+
+/**
+ * The size of the buffer used to store data read from each agent channel,
+ * in bytes. This is the maximum size of any single agent request.
+ */
+#define SSH_AGENT_BUFFER_SIZE 8192
+
+/**
+ * The maximum amount of time to wait for activity on the SSH session before
+ * checking open agent channels for data regardless, in milliseconds. Data
+ * for agent channels may be received by other threads using the same
+ * session, in which case the session file descriptor will not wake the
+ * agent.
+ */
+#define SSH_AGENT_POLL_TIMEOUT 50
+
+/**
+ * The single identity exposed by the SSH agent, along with everything
+ * derived from its key which is needed to answer requests. All of this is
+ * computed once when the agent is created, such that no request requires the
+ * key to be inspected or re-encoded.
+ */
+typedef struct ssh_auth_agent_identity {
 
     /**
-     * The SSH channel being used for SSH agent protocol.
+     * The private key to use for signing.
      */
-    LIBSSH2_CHANNEL* channel;
+    guac_common_ssh_key* key;
+
+    /**
+     * The SSH name of the key type, such as "ssh-rsa", as stored within the
+     * public key of the identity. This name is not null-terminated.
+     */
+    const char* type_name;
+
+    /**
+     * The length of type_name, in bytes.
+     */
+    int type_name_length;
 
     /**
-     * The single private key to use for authentication.
+     * The complete SSH2_AGENT_IDENTITIES_ANSWER packet, including its length
+     * prefix, listing this identity.
      */
-    ssh_key* identity;
+    char* identities_answer;
+
+    /**
+     * The length of identities_answer, in bytes.
+     */
+    int identities_answer_length;
+
+} ssh_auth_agent_identity;
+
+/**
+ * A single agent channel opened by the SSH server, along with any partial
+ * request read from that channel.
+ */
+typedef struct ssh_auth_agent_channel {
+
+    /**
+     * The SSH channel being used for SSH agent protocol.
+     */
+    LIBSSH2_CHANNEL* channel;
 
     /**
      * Data read from the agent channel.
      */
-    char buffer[4096];
+    char buffer[SSH_AGENT_BUFFER_SIZE];
 
     /**
      * The number of bytes of data currently stored in the buffer.
      */
     int buffer_length;
 
+} ssh_auth_agent_channel;
+
+/**
+ * Data representing an SSH auth agent. Agent requests are served by a
+ * dedicated worker thread, such that signing never blocks terminal output.
+ */
+typedef struct ssh_auth_agent {
+
+    /**
+     * The client which owns the SSH session.
+     */
+    guac_client* client;
+
+    /**
+     * The SSH session over which agent channels are opened.
+     */
+    LIBSSH2_SESSION* session;
+
+    /**
+     * The file descriptor of the socket underlying the SSH session.
+     */
+    int fd;
+
+    /**
+     * Lock which must be held while invoking any libssh2 function against
+     * the SSH session. This lock is owned by the caller of
+     * ssh_auth_agent_alloc() and is never acquired by
+     * ssh_auth_agent_callback(), which libssh2 invokes while the lock is
+     * already held.
+     */
+    pthread_mutex_t* session_lock;
+
+    /**
+     * The identity exposed by this agent.
+     */
+    ssh_auth_agent_identity identity;
+
+    /**
+     * All open agent channels. Slots are claimed by ssh_auth_agent_callback()
+     * using atomic compare-and-swap and released only by the worker thread,
+     * thus no lock is needed to open a channel. Unused slots are NULL.
+     */
+    ssh_auth_agent_channel* channels[SSH_AGENT_MAX_CHANNELS];
+
+    /**
+     * The worker thread serving all agent channels.
+     */
+    pthread_t worker;
+
+    /**
+     * Whether the worker thread has been started.
+     */
+    int worker_started;
+
+    /**
+     * Non-zero if the worker thread should stop.
+     */
+    int stopping;
+
+    /**
+     * Pipe used to wake the worker thread when a channel is opened or the
+     * agent is stopping. The read end is polled by the worker alongside the
+     * SSH session.
+     */
+    int wake_pipe[2];
+
+    /**
+     * Pipe signalled by the worker thread after reading from the SSH
+     * session. Reading any channel may consume data destined for other
+     * channels of the session, which will then no longer be signalled by the
+     * session file descriptor. Threads polling the session for data must
+     * poll the read end of this pipe as well, invoking
+     * ssh_auth_agent_acknowledge() once it is readable.
+     */
+    int notify_pipe[2];
+
 } ssh_auth_agent;
 
 /**
- * Handler for an agent sign request.
+ * Allocates a new SSH auth agent exposing the given key. The agent does not
+ * begin serving requests until ssh_auth_agent_start() is invoked.
+ *
+ * @param client
+ *     The client which owns the SSH session.
+ *
+ * @param session
+ *     The SSH session over which agent channels will be opened.
+ *
+ * @param fd
+ *     The file descriptor of the socket underlying the SSH session.
+ *
+ * @param session_lock
+ *     The lock which must be held while invoking libssh2 functions against
+ *     the SSH session.
+ *
+ * @param key
+ *     The key to expose via the agent. The key must remain allocated until
+ *     the agent is freed.
+ *
+ * @return
+ *     A newly-allocated SSH auth agent, or NULL if the agent could not be
+ *     allocated or the key type is not supported.
  */
-void ssh_auth_agent_sign(ssh_auth_agent* auth_agent,
-        char* data, int data_length);
+ssh_auth_agent* ssh_auth_agent_alloc(guac_client* client,
+        LIBSSH2_SESSION* session, int fd, pthread_mutex_t* session_lock,
+        guac_common_ssh_key* key);
 
 /**
- * Handler for an agent identity request.
+ * Starts the worker thread which serves all agent channels.
+ *
+ * @param auth_agent
+ *     The agent to start.
+ *
+ * @return
+ *     Zero if the worker thread was started successfully, non-zero
+ *     otherwise.
  */
-void ssh_auth_agent_list_identities(ssh_auth_agent* auth_agent);
+int ssh_auth_agent_start(ssh_auth_agent* auth_agent);
 
 /**
- * Generic handler for all packets received over the auth agent channel.
+ * Stops the worker thread of the given agent, if running, and frees the
+ * agent along with all of its channels. The session lock must not be held
+ * by the caller.
+ *
+ * @param auth_agent
+ *     The agent to free.
  */
-void ssh_auth_agent_handle_packet(ssh_auth_agent* auth_agent,
-        uint8_t type, char* data, int data_length);
+void ssh_auth_agent_free(ssh_auth_agent* auth_agent);
 
 /**
- * Reads and handles a single packet from the SSH agent channel associated
- * with the given ssh_auth_agent, returning the size of that packet, the size
- * of the partial packet read, or a negative value if an error occurs.
+ * Clears the signal of the notify pipe of the given agent, acknowledging
+ * that the caller will read from the SSH session.
+ *
+ * @param auth_agent
+ *     The agent whose notify pipe should be cleared.
  */
-int ssh_auth_agent_read(ssh_auth_agent* auth_agent);
+void ssh_auth_agent_acknowledge(ssh_auth_agent* auth_agent);
 
 /**
- * Libssh2 callback, invoked when the auth agent channel is opened.
+ * Libssh2 callback, invoked when the auth agent channel is opened. The
+ * abstract parameter must point to the guac_common_ssh_session associated
+ * with the guac_client whose guac_ssh_client has an agent.
  */
 void ssh_auth_agent_callback(LIBSSH2_SESSION *session,
         LIBSSH2_CHANNEL *channel, void **abstract);
@@ -54,12 +54,18 @@
 static void __guac_terminal_set_columns(guac_terminal* terminal, int row,
         int start_column, int end_column, guac_terminal_char* character) {
 
-    guac_terminal_display_set_columns(terminal->display, row + terminal->scroll_offset,
-            start_column, end_column, character);
+    if (!terminal->skip_display)
+        guac_terminal_display_set_columns(terminal->display,
+                row + terminal->scroll_offset, start_column, end_column,
+                character);
 
     guac_terminal_buffer_set_columns(terminal->buffer, row,
             start_column, end_column, character);
 
+    /* Any cached copy of the row is now out of date */
+    guac_terminal_display_invalidate_line(terminal->display,
+            terminal->lines_scrolled + row);
+
 }
 
 /**
@@ -145,6 +151,16 @@ static void __guac_terminal_force_break(guac_terminal* terminal, int row, int ed
 
 }
 
+void guac_terminal_clear_sgr_cache(guac_terminal* term) {
+
+    int i;
+
+    /* Mark all cached transitions as unused */
+    for (i = 0; i < GUAC_TERMINAL_SGR_CACHE_SIZE; i++)
+        term->sgr_cache[i].argc = 0;
+
+}
+
 void guac_terminal_reset(guac_terminal* term) {
 
     int row;
@@ -166,6 +182,9 @@ void guac_terminal_reset(guac_terminal* term) {
     term->scroll_end = term->term_height - 1;
     term->scroll_offset = 0;
 
+    /* Previously-rendered rows no longer correspond to the buffer */
+    guac_terminal_display_clear_cache(term->display);
+
     /* Reset scrollbar bounds */
     guac_terminal_scrollbar_set_bounds(term->scrollbar, term->term_height - term->buffer->length, 0);
     guac_terminal_scrollbar_set_value(term->scrollbar, -term->scroll_offset);
@@ -185,6 +204,7 @@ void guac_terminal_reset(guac_terminal* term) {
 
     /* Reset display palette */
     guac_terminal_display_reset_palette(term->display);
+    guac_terminal_clear_sgr_cache(term);
 
     /* Clear terminal */
     for (row=0; row<term->term_height; row++)
@@ -555,11 +575,19 @@ guac_terminal* guac_terminal_create(guac_client* client,
     term->upload_path_handler = NULL;
     term->file_download_handler = NULL;
 
+    /* No rows have yet scrolled into the scrollback buffer */
+    term->lines_scrolled = 0;
+
     /* Init modified flag and conditional */
     term->modified = 0;
     pthread_cond_init(&(term->modified_cond), NULL);
     pthread_mutex_init(&(term->modified_lock), NULL);
 
+    /* No frames have yet been rendered */
+    term->frame_bytes = 0;
+    term->last_frame_end = guac_timestamp_current();
+    term->skip_display = false;
+
     /* Init buffer */
     term->buffer = guac_terminal_buffer_alloc(1000, &default_char);
 
@@ -774,6 +802,29 @@ wait_complete:
 
 }
 
+/**
+ * Returns the number of bytes written to the given terminal since the last
+ * frame was flushed.
+ *
+ * @param terminal
+ *     The terminal to query.
+ *
+ * @return
+ *     The number of bytes written to the given terminal since the last frame
+ *     was flushed.
+ */
+static int guac_terminal_get_frame_bytes(guac_terminal* terminal) {
+
+    int frame_bytes;
+
+    guac_terminal_lock(terminal);
+    frame_bytes = terminal->frame_bytes;
+    guac_terminal_unlock(terminal);
+
+    return frame_bytes;
+
+}
+
 int guac_terminal_render_frame(guac_terminal* terminal) {
 
     int wait_result;
@@ -782,14 +833,42 @@ int guac_terminal_render_frame(guac_terminal* terminal) {
     wait_result = guac_terminal_wait(terminal, 1000);
     if (wait_result) {
 
+        int processing_lag = guac_client_get_processing_lag(terminal->client);
         guac_timestamp frame_start = guac_timestamp_current();
 
+        /* Output which follows a full frame of inactivity is likely the
+         * response to user input */
+        bool interactive = frame_start - terminal->last_frame_end
+                         >= GUAC_TERMINAL_FRAME_DURATION;
+
         do {
 
-            /* Calculate time remaining in frame */
             guac_timestamp frame_end = guac_timestamp_current();
-            int frame_remaining = frame_start + GUAC_TERMINAL_FRAME_DURATION
-                                - frame_end;
+            int frame_bytes = guac_terminal_get_frame_bytes(terminal);
+
+            /* Calculate time that client needs to catch up */
+            int time_elapsed = frame_end - terminal->last_frame_end;
+            int required_wait = processing_lag - time_elapsed;
+
+            /* Increase the duration of this frame if client is lagging */
+            if (required_wait > GUAC_TERMINAL_FRAME_TIMEOUT) {
+                wait_result = guac_terminal_wait(terminal, required_wait);
+                continue;
+            }
+
+            /* Flush small interactive updates (echoed keystrokes) without
+             * waiting for further output */
+            if (interactive
+                    && frame_bytes <= GUAC_TERMINAL_INTERACTIVE_FRAME_BYTES)
+                break;
+
+            /* Coalesce bulk output into longer frames */
+            int frame_duration = GUAC_TERMINAL_FRAME_DURATION;
+            if (frame_bytes > GUAC_TERMINAL_BULK_FRAME_BYTES)
+                frame_duration = GUAC_TERMINAL_BULK_FRAME_DURATION;
+
+            /* Calculate time remaining in frame */
+            int frame_remaining = frame_start + frame_duration - frame_end;
 
             /* Wait again if frame remaining */
             if (frame_remaining > 0)
@@ -803,8 +882,11 @@ int guac_terminal_render_frame(guac_terminal* terminal) {
         /* Flush terminal */
         guac_terminal_lock(terminal);
         guac_terminal_flush(terminal);
+        terminal->frame_bytes = 0;
         guac_terminal_unlock(terminal);
 
+        terminal->last_frame_end = guac_timestamp_current();
+
     }
 
     return 0;
@@ -948,14 +1030,20 @@ void guac_terminal_commit_cursor(guac_terminal* term) {
     /* Clear cursor */
     guac_char = &(old_row->characters[term->visible_cursor_col]);
     guac_char->attributes.cursor = false;
-    guac_terminal_display_set_columns(term->display, term->visible_cursor_row + term->scroll_offset,
-            term->visible_cursor_col, term->visible_cursor_col, guac_char);
+    if (!term->skip_display)
+        guac_terminal_display_set_columns(term->display, term->visible_cursor_row + term->scroll_offset,
+                term->visible_cursor_col, term->visible_cursor_col, guac_char);
+    guac_terminal_display_invalidate_line(term->display,
+            term->lines_scrolled + term->visible_cursor_row);
 
     /* Set cursor */
     guac_char = &(new_row->characters[term->cursor_col]);
     guac_char->attributes.cursor = true;
-    guac_terminal_display_set_columns(term->display, term->cursor_row + term->scroll_offset,
-            term->cursor_col, term->cursor_col, guac_char);
+    if (!term->skip_display)
+        guac_terminal_display_set_columns(term->display, term->cursor_row + term->scroll_offset,
+                term->cursor_col, term->cursor_col, guac_char);
+    guac_terminal_display_invalidate_line(term->display,
+            term->lines_scrolled + term->cursor_row);
 
     term->visible_cursor_row = term->cursor_row;
     term->visible_cursor_col = term->cursor_col;
@@ -967,6 +1055,13 @@ void guac_terminal_commit_cursor(guac_terminal* term) {
 int guac_terminal_write(guac_terminal* term, const char* c, int size) {
 
     guac_terminal_lock(term);
+    term->frame_bytes += size;
+
+    /* If output is outrunning the frame rate, update only the buffer until
+     * the next frame, skipping screens which would never be seen */
+    if (term->frame_bytes > GUAC_TERMINAL_BULK_FRAME_BYTES)
+        term->skip_display = true;
+
     while (size > 0) {
 
         /* Read and advance to next character */
@@ -978,8 +1073,28 @@ int guac_terminal_write(guac_terminal* term, const char* c, int size) {
             guac_terminal_typescript_write(term->typescript, current);
 
         /* Handle character and its meaning */
+        guac_terminal_char_handler* previous_handler = term->char_handler;
         term->char_handler(term, current);
 
+        /* If a CSI sequence has just begun and is wholly contained within the
+         * remaining data, parse it in one pass */
+        if (term->char_handler == guac_terminal_csi
+                && previous_handler != guac_terminal_csi) {
+
+            int length = guac_terminal_csi_sequence(term, c, size);
+
+            /* Write parsed sequence to typescript, if any */
+            if (term->typescript != NULL) {
+                int i;
+                for (i = 0; i < length; i++)
+                    guac_terminal_typescript_write(term->typescript, c[i]);
+            }
+
+            c += length;
+            size -= length;
+
+        }
+
     }
     guac_terminal_unlock(term);
 
@@ -995,13 +1110,17 @@ int guac_terminal_scroll_up(guac_terminal* term,
     if (start_row == 0 && end_row == term->term_height - 1) {
 
         /* Scroll up visibly */
-        guac_terminal_display_copy_rows(term->display, start_row + amount, end_row, -amount);
+        if (!term->skip_display)
+            guac_terminal_display_copy_rows(term->display,
+                    start_row + amount, end_row, -amount);
 
         /* Advance by scroll amount */
         term->buffer->top += amount;
         if (term->buffer->top >= term->buffer->available)
             term->buffer->top -= term->buffer->available;
 
+        term->lines_scrolled += amount;
+
         term->buffer->length += amount;
         if (term->buffer->length > term->buffer->available)
             term->buffer->length = term->buffer->available;
@@ -1141,12 +1260,86 @@ static bool guac_terminal_is_visible(guac_terminal* term,
 
 }
 
+/**
+ * Redraws a single row of the display using the contents of the given row of
+ * the terminal buffer. If that row was previously rendered and is still
+ * present within the display's off-screen row cache, the row is restored from
+ * the cache rather than rendered again.
+ *
+ * @param terminal
+ *     The terminal whose display should be redrawn.
+ *
+ * @param row
+ *     The row of the terminal buffer to draw, where negative values refer to
+ *     rows within the scrollback buffer.
+ *
+ * @param dest_row
+ *     The row of the display which should contain the drawn row.
+ */
+static void __guac_terminal_redraw_row(guac_terminal* terminal, int row,
+        int dest_row) {
+
+    int column;
+
+    /* Copy row from cache if it has already been rendered */
+    if (!guac_terminal_display_restore_row(terminal->display, dest_row,
+                terminal->lines_scrolled + row))
+        return;
+
+    /* Get row from scrollback */
+    guac_terminal_buffer_row* buffer_row =
+        guac_terminal_buffer_get_row(terminal->buffer, row, 0);
+
+    /* Clear row */
+    guac_terminal_display_set_columns(terminal->display,
+            dest_row, 0, terminal->display->width, &(terminal->default_char));
+
+    /* Draw row */
+    guac_terminal_char* current = buffer_row->characters;
+    for (column=0; column<buffer_row->length; column++) {
+
+        /* Only draw if not blank */
+        if (guac_terminal_is_visible(terminal, current))
+            guac_terminal_display_set_columns(terminal->display, dest_row, column, column, current);
+
+        current++;
+
+    }
+
+}
+
+/**
+ * Resumes updates to the terminal display if they were being skipped due to
+ * an output flood, redrawing every visible row from the terminal buffer such
+ * that the display reflects only the final state of the terminal. If display
+ * updates were not being skipped, this function has no effect.
+ *
+ * @param terminal
+ *     The terminal whose display updates should be resumed.
+ */
+static void __guac_terminal_resume_display(guac_terminal* terminal) {
+
+    int row;
+
+    /* Nothing to do if display is up to date */
+    if (!terminal->skip_display)
+        return;
+
+    terminal->skip_display = false;
+
+    /* Redraw all visible rows from buffer */
+    for (row = 0; row < terminal->term_height; row++)
+        __guac_terminal_redraw_row(terminal, row - terminal->scroll_offset,
+                row);
+
+}
+
 void guac_terminal_scroll_display_down(guac_terminal* terminal,
         int scroll_amount) {
 
     int start_row, end_row;
     int dest_row;
-    int row, column;
+    int row;
 
     /* Limit scroll amount by size of scrollback buffer */
     if (scroll_amount > terminal->scroll_offset)
@@ -1173,30 +1366,8 @@ void guac_terminal_scroll_display_down(guac_terminal* terminal,
 
     /* Draw new rows from scrollback */
     for (row=start_row; row<=end_row; row++) {
-
-        /* Get row from scrollback */
-        guac_terminal_buffer_row* buffer_row =
-            guac_terminal_buffer_get_row(terminal->buffer, row, 0);
-
-        /* Clear row */
-        guac_terminal_display_set_columns(terminal->display,
-                dest_row, 0, terminal->display->width, &(terminal->default_char));
-
-        /* Draw row */
-        guac_terminal_char* current = buffer_row->characters;
-        for (column=0; column<buffer_row->length; column++) {
-
-            /* Only draw if not blank */
-            if (guac_terminal_is_visible(terminal, current))
-                guac_terminal_display_set_columns(terminal->display, dest_row, column, column, current);
-
-            current++;
-
-        }
-
-        /* Next row */
+        __guac_terminal_redraw_row(terminal, row, dest_row);
         dest_row++;
-
     }
 
     guac_terminal_notify(terminal);
@@ -1208,7 +1379,7 @@ void guac_terminal_scroll_display_up(guac_terminal* terminal,
 
     int start_row, end_row;
     int dest_row;
-    int row, column;
+    int row;
 
     /* Limit scroll amount by size of scrollback buffer */
     if (terminal->scroll_offset + scroll_amount > terminal->buffer->length - terminal->term_height)
@@ -1235,30 +1406,8 @@ void guac_terminal_scroll_display_up(guac_terminal* terminal,
 
     /* Draw new rows from scrollback */
     for (row=start_row; row<=end_row; row++) {
-
-        /* Get row from scrollback */
-        guac_terminal_buffer_row* buffer_row = 
-            guac_terminal_buffer_get_row(terminal->buffer, row, 0);
-
-        /* Clear row */
-        guac_terminal_display_set_columns(terminal->display,
-                dest_row, 0, terminal->display->width, &(terminal->default_char));
-
-        /* Draw row */
-        guac_terminal_char* current = buffer_row->characters;
-        for (column=0; column<buffer_row->length; column++) {
-
-            /* Only draw if not blank */
-            if (guac_terminal_is_visible(terminal, current))
-                guac_terminal_display_set_columns(terminal->display, dest_row, column, column, current);
-
-            current++;
-
-        }
-
-        /* Next row */
+        __guac_terminal_redraw_row(terminal, row, dest_row);
         dest_row++;
-
     }
 
     guac_terminal_notify(terminal);
@@ -1446,12 +1595,17 @@ void guac_terminal_select_end(guac_terminal* terminal, char* string) {
 void guac_terminal_copy_columns(guac_terminal* terminal, int row,
         int start_column, int end_column, int offset) {
 
-    guac_terminal_display_copy_columns(terminal->display, row + terminal->scroll_offset,
-            start_column, end_column, offset);
+    if (!terminal->skip_display)
+        guac_terminal_display_copy_columns(terminal->display,
+                row + terminal->scroll_offset, start_column, end_column,
+                offset);
 
     guac_terminal_buffer_copy_columns(terminal->buffer, row,
             start_column, end_column, offset);
 
+    guac_terminal_display_invalidate_line(terminal->display,
+            terminal->lines_scrolled + row);
+
     /* Update cursor location if within region */
     if (row == terminal->visible_cursor_row &&
             terminal->visible_cursor_col >= start_column &&
@@ -1467,12 +1621,21 @@ void guac_terminal_copy_columns(guac_terminal* terminal, int row,
 void guac_terminal_copy_rows(guac_terminal* terminal,
         int start_row, int end_row, int offset) {
 
-    guac_terminal_display_copy_rows(terminal->display,
-            start_row + terminal->scroll_offset, end_row + terminal->scroll_offset, offset);
+    int row;
+
+    if (!terminal->skip_display)
+        guac_terminal_display_copy_rows(terminal->display,
+                start_row + terminal->scroll_offset,
+                end_row + terminal->scroll_offset, offset);
 
     guac_terminal_buffer_copy_rows(terminal->buffer,
             start_row, end_row, offset);
 
+    /* Any cached copies of the destination rows are now out of date */
+    for (row = start_row + offset; row <= end_row + offset; row++)
+        guac_terminal_display_invalidate_line(terminal->display,
+                terminal->lines_scrolled + row);
+
     /* Update cursor location if within region */
     if (terminal->visible_cursor_row >= start_row &&
         terminal->visible_cursor_row <= end_row)
@@ -1539,6 +1702,9 @@ static void __guac_terminal_redraw_rect(guac_terminal* term, int start_row, int
  */
 static void __guac_terminal_resize(guac_terminal* term, int width, int height) {
 
+    /* Bring display up to date before resizing */
+    __guac_terminal_resume_display(term);
+
     /* If height is decreasing, shift display up */
     if (height < term->term_height) {
 
@@ -1559,6 +1725,7 @@ static void __guac_terminal_resize(guac_terminal* term, int width, int height) {
 
             /* Update buffer top and cursor row based on shift */
             term->buffer->top += shift_amount;
+            term->lines_scrolled += shift_amount;
             term->cursor_row  -= shift_amount;
             term->visible_cursor_row  -= shift_amount;
 
@@ -1570,6 +1737,7 @@ static void __guac_terminal_resize(guac_terminal* term, int width, int height) {
     }
 
     /* Resize display */
+    term->display->top_line = term->lines_scrolled - term->scroll_offset;
     guac_terminal_display_flush(term->display);
     guac_terminal_display_resize(term->display, width, height);
 
@@ -1594,6 +1762,7 @@ static void __guac_terminal_resize(guac_terminal* term, int width, int height) {
 
             /* Update buffer top and cursor row based on shift */
             term->buffer->top -= shift_amount;
+            term->lines_scrolled -= shift_amount;
             term->cursor_row  += shift_amount;
             term->visible_cursor_row  += shift_amount;
 
@@ -1704,8 +1873,12 @@ void guac_terminal_flush(guac_terminal* terminal) {
     if (terminal->typescript != NULL)
         guac_terminal_typescript_flush(terminal->typescript);
 
-    /* Flush display state */
+    /* Flush display state, redrawing the final screen if display updates
+     * were skipped during this frame */
     guac_terminal_commit_cursor(terminal);
+    __guac_terminal_resume_display(terminal);
+    terminal->display->top_line = terminal->lines_scrolled
+                                - terminal->scroll_offset;
     guac_terminal_display_flush(terminal->display);
     guac_terminal_scrollbar_flush(terminal->scrollbar);
 
@@ -1810,12 +1983,12 @@ static int __guac_terminal_send_key(guac_terminal* term, int keysym, int pressed
         }
 
         /* Translate Unicode to UTF-8 */
-        else if ((keysym >= 0x00 && keysym <= 0xFF) || ((keysym & 0xFFFF0000) == 0x01000000)) {
+        else if ((keysym >= 0x00 && keysym <= 0xFF) || ((keysym & 0xFF000000) == 0x01000000)) {
 
             int length;
             char data[5];
 
-            length = guac_terminal_encode_utf8(keysym & 0xFFFF, data);
+            length = guac_terminal_encode_utf8(keysym & 0xFFFFFF, data);
             return guac_terminal_send_data(term, data, length);
 
         }
@@ -1899,6 +2072,32 @@ int guac_terminal_send_key(guac_terminal* term, int keysym, int pressed) {
 
 }
 
+int guac_terminal_send_text(guac_terminal* term, const char* text) {
+
+    int result;
+
+    guac_terminal_lock(term);
+
+    /* Hide mouse cursor if not already hidden */
+    if (term->current_cursor != GUAC_TERMINAL_CURSOR_BLANK) {
+        term->current_cursor = GUAC_TERMINAL_CURSOR_BLANK;
+        guac_common_cursor_set_blank(term->cursor);
+        guac_terminal_notify(term);
+    }
+
+    /* Reset scroll */
+    if (term->scroll_offset != 0)
+        guac_terminal_scroll_display_down(term, term->scroll_offset);
+
+    /* Write entire text with a single write */
+    result = guac_terminal_send_string(term, text);
+
+    guac_terminal_unlock(term);
+
+    return result;
+
+}
+
 static int __guac_terminal_send_mouse(guac_terminal* term, guac_user* user,
         int x, int y, int mask) {
 
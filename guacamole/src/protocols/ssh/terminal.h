@@ -33,9 +33,11 @@
 
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <guacamole/client.h>
 #include <guacamole/stream.h>
+#include <guacamole/timestamp.h>
 
 /**
  * The maximum duration of a single frame, in milliseconds.
@@ -48,6 +50,27 @@
  */
 #define GUAC_TERMINAL_FRAME_TIMEOUT 10
 
+/**
+ * The maximum duration of a single frame while the terminal is receiving
+ * bulk output, in milliseconds. Intermediate screens which would otherwise
+ * be rendered within this period are never sent.
+ */
+#define GUAC_TERMINAL_BULK_FRAME_DURATION 200
+
+/**
+ * The number of bytes which must be written to the terminal within a single
+ * frame for that output to be considered bulk output.
+ */
+#define GUAC_TERMINAL_BULK_FRAME_BYTES 16384
+
+/**
+ * The maximum number of bytes which may be written to the terminal within a
+ * single frame for that output to be considered interactive (such as the
+ * echo of a keystroke). Interactive output which follows a period of
+ * inactivity is flushed immediately.
+ */
+#define GUAC_TERMINAL_INTERACTIVE_FRAME_BYTES 256
+
 /**
  * The maximum number of custom tab stops.
  */
@@ -58,6 +81,61 @@
  */
 #define GUAC_TERMINAL_WHEEL_SCROLL_AMOUNT 3
 
+/**
+ * The maximum number of numeric arguments which may be given to a single CSI
+ * sequence. Any additional arguments are ignored.
+ */
+#define GUAC_TERMINAL_MAX_CSI_ARGS 16
+
+/**
+ * The number of distinct SGR argument lists whose effect on the current
+ * character attributes is remembered by each terminal. This MUST be a power
+ * of two.
+ */
+#define GUAC_TERMINAL_SGR_CACHE_SIZE 64
+
+/**
+ * Flag set within a guac_terminal_sgr_transition if the "bold" attribute is
+ * assigned by the corresponding SGR sequence.
+ */
+#define GUAC_TERMINAL_SGR_BOLD        0x01
+
+/**
+ * Flag set within a guac_terminal_sgr_transition if the "half_bright"
+ * attribute is assigned by the corresponding SGR sequence.
+ */
+#define GUAC_TERMINAL_SGR_HALF_BRIGHT 0x02
+
+/**
+ * Flag set within a guac_terminal_sgr_transition if the "reverse" attribute
+ * is assigned by the corresponding SGR sequence.
+ */
+#define GUAC_TERMINAL_SGR_REVERSE     0x04
+
+/**
+ * Flag set within a guac_terminal_sgr_transition if the "cursor" attribute is
+ * assigned by the corresponding SGR sequence.
+ */
+#define GUAC_TERMINAL_SGR_CURSOR      0x08
+
+/**
+ * Flag set within a guac_terminal_sgr_transition if the "underscore"
+ * attribute is assigned by the corresponding SGR sequence.
+ */
+#define GUAC_TERMINAL_SGR_UNDERSCORE  0x10
+
+/**
+ * Flag set within a guac_terminal_sgr_transition if the foreground color is
+ * assigned by the corresponding SGR sequence.
+ */
+#define GUAC_TERMINAL_SGR_FOREGROUND  0x20
+
+/**
+ * Flag set within a guac_terminal_sgr_transition if the background color is
+ * assigned by the corresponding SGR sequence.
+ */
+#define GUAC_TERMINAL_SGR_BACKGROUND  0x40
+
 /**
  * The name of the color scheme having black foreground and white background.
  */
@@ -124,6 +202,40 @@ typedef enum guac_terminal_cursor_type {
  */
 typedef int guac_terminal_char_handler(guac_terminal* term, unsigned char c);
 
+/**
+ * The effect of a specific list of SGR (Select Graphic Rendition) arguments
+ * on the current character attributes. As SGR sequences only ever assign
+ * attributes, never read them, this effect is independent of the attributes
+ * in effect at the time the sequence is received and can be reused for every
+ * later occurrence of the same sequence.
+ */
+typedef struct guac_terminal_sgr_transition {
+
+    /**
+     * The number of arguments within argv, or zero if this transition is
+     * unused.
+     */
+    int argc;
+
+    /**
+     * The SGR arguments which produce this transition.
+     */
+    int argv[GUAC_TERMINAL_MAX_CSI_ARGS];
+
+    /**
+     * Bitwise OR of all GUAC_TERMINAL_SGR_* flags corresponding to the
+     * attributes assigned by this transition.
+     */
+    int mask;
+
+    /**
+     * The values of all attributes assigned by this transition. Only the
+     * attributes whose flags are set within mask are meaningful.
+     */
+    guac_terminal_attributes attributes;
+
+} guac_terminal_sgr_transition;
+
 /**
  * Handler for setting the destination path for file uploads.
  */
@@ -188,6 +300,27 @@ struct guac_terminal {
      */
     pthread_cond_t modified_cond;
 
+    /**
+     * The number of bytes written to the terminal via guac_terminal_write()
+     * since the last frame was flushed, used to determine whether output is
+     * interactive or bulk. The terminal lock must be acquired before this
+     * value is read or altered.
+     */
+    int frame_bytes;
+
+    /**
+     * The time at which the last frame was flushed.
+     */
+    guac_timestamp last_frame_end;
+
+    /**
+     * Whether updates to the terminal display are currently being skipped
+     * because output is arriving faster than frames can be rendered. While
+     * set, only the terminal buffer is updated, and the visible portion of
+     * the buffer is redrawn in its entirety when the next frame is flushed.
+     */
+    bool skip_display;
+
     /**
      * Pipe which will be the source of user input. When a terminal code
      * generates synthesized user input, that data will be written to
@@ -238,6 +371,14 @@ struct guac_terminal {
      */
     int scroll_offset;
 
+    /**
+     * The total number of rows which have scrolled off the top of the
+     * terminal and into the scrollback buffer. The absolute line number of
+     * any row of the terminal is this value plus the row index, and remains
+     * constant as that row moves into the scrollback buffer.
+     */
+    int64_t lines_scrolled;
+
     /**
      * The width of the terminal, in pixels.
      */
@@ -309,6 +450,14 @@ struct guac_terminal {
      */
     guac_terminal_attributes current_attributes;
 
+    /**
+     * Recently-received SGR argument lists and their effect on
+     * current_attributes, indexed by a hash of those arguments. As SGR colors
+     * are copied from the palette, this cache must be cleared with
+     * guac_terminal_clear_sgr_cache() whenever the palette changes.
+     */
+    guac_terminal_sgr_transition sgr_cache[GUAC_TERMINAL_SGR_CACHE_SIZE];
+
     /**
      * The character whose attributes dictate the default attributes
      * of all characters. When new screen space is allocated, this
@@ -578,6 +727,12 @@ int guac_terminal_printf(guac_terminal* terminal, const char* format, ...);
  */
 int guac_terminal_send_key(guac_terminal* term, int keysym, int pressed);
 
+/**
+ * Handles the given text event, sending the entire UTF-8 text as if typed by
+ * the user, and scrolling to the bottom of the terminal as necessary.
+ */
+int guac_terminal_send_text(guac_terminal* term, const char* text);
+
 /**
  * Handles the given mouse event, sending data, scrolling, pasting clipboard
  * data, etc. as necessary.
@@ -636,6 +791,16 @@ void guac_terminal_unlock(guac_terminal* terminal);
  */
 void guac_terminal_reset(guac_terminal* term);
 
+/**
+ * Discards all cached SGR transitions. This must be invoked whenever the
+ * palette changes, as cached transitions contain colors copied from the
+ * palette at the time they were computed.
+ *
+ * @param term
+ *     The terminal whose SGR transition cache should be cleared.
+ */
+void guac_terminal_clear_sgr_cache(guac_terminal* term);
+
 /**
  * Writes the given string of characters to the terminal.
  */
@@ -85,6 +85,29 @@ static bool __guac_terminal_display_selected_contains(guac_terminal_display* dis
 
 }
 
+/**
+ * Returns the row of the off-screen row cache which stores the line having
+ * the given absolute line number.
+ *
+ * @param line
+ *     The absolute line number of the line to locate within the cache.
+ *
+ * @return
+ *     The row of the off-screen row cache which stores the given line, if
+ *     that line is cached.
+ */
+static int __guac_terminal_display_cache_row(int64_t line) {
+
+    int row = line % GUAC_TERMINAL_ROW_CACHE_SIZE;
+
+    /* Wrap negative line numbers around to the end of the cache */
+    if (row < 0)
+        row += GUAC_TERMINAL_ROW_CACHE_SIZE;
+
+    return row;
+
+}
+
 /* Maps any codepoint onto a number between 0 and 511 inclusive */
 int __guac_terminal_hash_codepoint(int codepoint) {
 
@@ -268,6 +291,13 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
     guac_protocol_send_move(client->socket, display->select_layer,
             display->display_layer, 0, 0, 0);
 
+    /* Create initially-empty off-screen row cache */
+    display->cache_layer = guac_client_alloc_buffer(client);
+    display->cache_surface = guac_common_surface_alloc(client,
+            client->socket, display->cache_layer, 0, 0);
+    guac_terminal_display_clear_cache(display);
+    display->top_line = 0;
+
     /* Get font */
     display->font_desc = pango_font_description_new();
     pango_font_description_set_family(display->font_desc, font_name);
@@ -325,6 +355,10 @@ void guac_terminal_display_free(guac_terminal_display* display) {
     /* Free operations buffers */
     free(display->operations);
 
+    /* Free off-screen row cache */
+    guac_common_surface_free(display->cache_surface);
+    guac_client_free_buffer(display->client, display->cache_layer);
+
     /* Free display */
     free(display);
 
@@ -509,6 +543,65 @@ void guac_terminal_display_set_columns(guac_terminal_display* display, int row,
 
 }
 
+int guac_terminal_display_restore_row(guac_terminal_display* display,
+        int row, int64_t line) {
+
+    int col;
+    guac_terminal_operation* current;
+
+    /* Ignore operations outside display bounds */
+    if (row < 0 || row >= display->height)
+        return 1;
+
+    /* Row cannot be restored unless the line is cached */
+    int cache_row = __guac_terminal_display_cache_row(line);
+    if (display->cached_lines[cache_row] != line)
+        return 1;
+
+    current = &(display->operations[row * display->width]);
+
+    /* Copy entire row from cache */
+    for (col=0; col<display->width; col++) {
+
+        current->type   = GUAC_CHAR_RESTORE;
+        current->row    = cache_row;
+        current->column = col;
+
+        /* Next column */
+        current++;
+
+    }
+
+    /* If selection visible and committed, clear if update touches selection */
+    if (display->text_selected && display->selection_committed &&
+        __guac_terminal_display_selected_contains(display, row, 0, row, display->width - 1))
+            __guac_terminal_display_clear_select(display);
+
+    return 0;
+
+}
+
+void guac_terminal_display_invalidate_line(guac_terminal_display* display,
+        int64_t line) {
+
+    int cache_row = __guac_terminal_display_cache_row(line);
+
+    /* Remove line from cache only if actually present */
+    if (display->cached_lines[cache_row] == line)
+        display->cached_lines[cache_row] = -1;
+
+}
+
+void guac_terminal_display_clear_cache(guac_terminal_display* display) {
+
+    int i;
+
+    /* Mark all rows of the cache as unused */
+    for (i=0; i<GUAC_TERMINAL_ROW_CACHE_SIZE; i++)
+        display->cached_lines[i] = -1;
+
+}
+
 void guac_terminal_display_resize(guac_terminal_display* display, int width, int height) {
 
     guac_terminal_operation* current;
@@ -570,13 +663,38 @@ void guac_terminal_display_resize(guac_terminal_display* display, int width, int
             display->char_width  * width,
             display->char_height * height);
 
+    /* Previously-cached rows no longer match the width of the display */
+    guac_common_surface_resize(
+            display->cache_surface,
+            display->char_width  * width,
+            display->char_height * GUAC_TERMINAL_ROW_CACHE_SIZE);
+
+    guac_terminal_display_clear_cache(display);
+
     /* If selection visible and committed, clear */
     if (display->text_selected && display->selection_committed)
         __guac_terminal_display_clear_select(display);
 
 }
 
-void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
+/**
+ * Flushes all pending operations of the given type which copy characters
+ * from the given surface, combining the copied characters into as few
+ * rectangles as possible.
+ *
+ * @param display
+ *     The display whose operations should be flushed.
+ *
+ * @param type
+ *     The type of copy operation to flush. This must be either GUAC_CHAR_COPY
+ *     or GUAC_CHAR_RESTORE.
+ *
+ * @param source
+ *     The surface that characters are copied from by operations of the given
+ *     type.
+ */
+static void __guac_terminal_display_flush_copies(guac_terminal_display* display,
+        guac_terminal_operation_type type, guac_common_surface* source) {
 
     guac_terminal_operation* current = display->operations;
     int row, col;
@@ -585,8 +703,8 @@ void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
     for (row=0; row<display->height; row++) {
         for (col=0; col<display->width; col++) {
 
-            /* If operation is a copy operation */
-            if (current->type == GUAC_CHAR_COPY) {
+            /* If operation is a copy operation of the requested type */
+            if (current->type == type) {
 
                 /* The determined bounds of the rectangle of contiguous
                  * operations */
@@ -618,7 +736,7 @@ void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
                     for (rect_col=col; rect_col<display->width; rect_col++) {
 
                         /* If not identical operation, stop */
-                        if (rect_current->type != GUAC_CHAR_COPY
+                        if (rect_current->type != type
                                 || rect_current->row != expected_row
                                 || rect_current->column != expected_col)
                             break;
@@ -661,7 +779,7 @@ void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
                     for (rect_col=0; rect_col<rect_width; rect_col++) {
 
                         /* Mark copy operations as NOP */
-                        if (rect_current->type == GUAC_CHAR_COPY
+                        if (rect_current->type == type
                                 && rect_current->row == expected_row
                                 && rect_current->column == expected_col)
                             rect_current->type = GUAC_CHAR_NOP;
@@ -681,7 +799,7 @@ void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
                 /* Send copy */
                 guac_common_surface_copy(
 
-                        display->display_surface,
+                        source,
                         current->column * display->char_width,
                         current->row * display->char_height,
                         rect_width * display->char_width,
@@ -701,6 +819,16 @@ void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
 
 }
 
+void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
+    __guac_terminal_display_flush_copies(display, GUAC_CHAR_COPY,
+            display->display_surface);
+}
+
+void __guac_terminal_display_flush_restore(guac_terminal_display* display) {
+    __guac_terminal_display_flush_copies(display, GUAC_CHAR_RESTORE,
+            display->cache_surface);
+}
+
 void __guac_terminal_display_flush_clear(guac_terminal_display* display) {
 
     guac_terminal_operation* current = display->operations;
@@ -870,16 +998,135 @@ void __guac_terminal_display_flush_set(guac_terminal_display* display) {
 
 }
 
+/**
+ * Locates the first and last rows of the display having pending operations.
+ * If no operations are pending, the last row located will be before the
+ * first.
+ *
+ * @param display
+ *     The display to search.
+ *
+ * @param first_row
+ *     Pointer to an int which will receive the first row having pending
+ *     operations.
+ *
+ * @param last_row
+ *     Pointer to an int which will receive the last row having pending
+ *     operations.
+ */
+static void __guac_terminal_display_find_modified(guac_terminal_display* display,
+        int* first_row, int* last_row) {
+
+    guac_terminal_operation* current = display->operations;
+    int row, col;
+
+    *first_row = display->height;
+    *last_row = -1;
+
+    /* For each operation */
+    for (row=0; row<display->height; row++) {
+        for (col=0; col<display->width; col++) {
+
+            /* Update bounds if anything will change within this row */
+            if (current->type != GUAC_CHAR_NOP) {
+
+                if (row < *first_row)
+                    *first_row = row;
+
+                *last_row = row;
+
+                /* Skip remainder of row */
+                current += display->width - col;
+                break;
+
+            }
+
+            /* Next operation */
+            current++;
+
+        }
+    }
+
+}
+
+/**
+ * Stores the given range of rows within the off-screen row cache, copying
+ * their current contents from the display surface. The display surface must
+ * already have been flushed. If more rows are given than can be stored, only
+ * the last rows of the range are stored.
+ *
+ * @param display
+ *     The display whose rows should be cached.
+ *
+ * @param start_row
+ *     The first row of the display to store.
+ *
+ * @param end_row
+ *     The last row of the display to store.
+ */
+static void __guac_terminal_display_cache_rows(guac_terminal_display* display,
+        int start_row, int end_row) {
+
+    int i;
+
+    /* Only the last rows of the range will fit within the cache */
+    if (end_row - start_row + 1 > GUAC_TERMINAL_ROW_CACHE_SIZE)
+        start_row = end_row - GUAC_TERMINAL_ROW_CACHE_SIZE + 1;
+
+    int row = start_row;
+    while (row <= end_row) {
+
+        int64_t line = display->top_line + row;
+        int cache_row = __guac_terminal_display_cache_row(line);
+
+        /* Store as many rows as are contiguous within the cache */
+        int rows = end_row - row + 1;
+        if (rows > GUAC_TERMINAL_ROW_CACHE_SIZE - cache_row)
+            rows = GUAC_TERMINAL_ROW_CACHE_SIZE - cache_row;
+
+        guac_common_surface_copy(
+
+                display->display_surface,
+                0,
+                row * display->char_height,
+                display->width * display->char_width,
+                rows * display->char_height,
+
+                display->cache_surface,
+                0,
+                cache_row * display->char_height);
+
+        for (i=0; i<rows; i++)
+            display->cached_lines[cache_row + i] = line + i;
+
+        row += rows;
+
+    }
+
+}
+
 void guac_terminal_display_flush(guac_terminal_display* display) {
 
-    /* Flush operations, copies first, then clears, then sets. */
+    int first_row, last_row;
+
+    /* Note which rows are changing, such that they can be cached */
+    __guac_terminal_display_find_modified(display, &first_row, &last_row);
+
+    /* Flush operations, copies first, then restores from cache, then clears,
+     * then sets. */
     __guac_terminal_display_flush_copy(display);
+    __guac_terminal_display_flush_restore(display);
     __guac_terminal_display_flush_clear(display);
     __guac_terminal_display_flush_set(display);
 
     /* Flush surface */
     guac_common_surface_flush(display->display_surface);
 
+    /* Retain changed rows off-screen in case they are scrolled back into
+     * view later */
+    if (first_row <= last_row)
+        __guac_terminal_display_cache_rows(display, first_row, last_row);
+
 }
 
 void guac_terminal_display_dup(guac_terminal_display* display, guac_user* user,
@@ -888,6 +1135,9 @@ void guac_terminal_display_dup(guac_terminal_display* display, guac_user* user,
     /* Create default surface */
     guac_common_surface_dup(display->display_surface, user, socket);
 
+    /* Synchronize off-screen row cache */
+    guac_common_surface_dup(display->cache_surface, user, socket);
+
     /* Select layer is a child of the display layer */
     guac_protocol_send_move(socket, display->select_layer,
             display->display_layer, 0, 0, 0);
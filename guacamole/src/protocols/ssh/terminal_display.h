@@ -39,6 +39,13 @@
  */
 #define GUAC_TERMINAL_MAX_CHAR_WIDTH 2
 
+/**
+ * The number of rows retained within the off-screen row cache. Each cached
+ * row occupies one row of an off-screen buffer, both on the client and within
+ * the server-side copy of that buffer.
+ */
+#define GUAC_TERMINAL_ROW_CACHE_SIZE 128
+
 /**
  * All available terminal operations which affect character cells.
  */
@@ -57,7 +64,13 @@ typedef enum guac_terminal_operation_type {
     /**
      * Operation which sets the character and attributes.
      */
-    GUAC_CHAR_SET
+    GUAC_CHAR_SET,
+
+    /**
+     * Operation which copies a character from a given row/column coordinate
+     * of the off-screen row cache.
+     */
+    GUAC_CHAR_RESTORE
 
 } guac_terminal_operation_type;
 
@@ -80,13 +93,14 @@ typedef struct guac_terminal_operation {
 
     /**
      * The row to copy a character from. This is only applicable to
-     * GUAC_CHAR_COPY.
+     * GUAC_CHAR_COPY and GUAC_CHAR_RESTORE. For GUAC_CHAR_RESTORE, this is
+     * the row within the off-screen row cache.
      */
     int row;
 
     /**
      * The column to copy a character from. This is only applicable to
-     * GUAC_CHAR_COPY.
+     * GUAC_CHAR_COPY and GUAC_CHAR_RESTORE.
      */
     int column;
 
@@ -181,6 +195,34 @@ typedef struct guac_terminal_display {
      */
     guac_layer* select_layer;
 
+    /**
+     * Off-screen buffer containing recently-rendered rows of the terminal,
+     * one row of characters per row of the cache. Rows scrolled back into
+     * view are restored from this buffer with "copy" instead of being
+     * rendered and sent again.
+     */
+    guac_layer* cache_layer;
+
+    /**
+     * The surface backing the off-screen row cache.
+     */
+    guac_common_surface* cache_surface;
+
+    /**
+     * The absolute line number currently stored within each row of the
+     * off-screen row cache, or -1 if that row of the cache is unused. A line
+     * is always stored within the row of the cache given by its line number
+     * modulo GUAC_TERMINAL_ROW_CACHE_SIZE.
+     */
+    int64_t cached_lines[GUAC_TERMINAL_ROW_CACHE_SIZE];
+
+    /**
+     * The absolute line number of the first row of the display. This value
+     * is maintained by the terminal, and determines the line number under
+     * which each flushed row is stored within the off-screen row cache.
+     */
+    int64_t top_line;
+
     /**
      * Whether text is being selected.
      */
@@ -299,6 +341,49 @@ void guac_terminal_display_copy_rows(guac_terminal_display* display,
 void guac_terminal_display_set_columns(guac_terminal_display* display, int row,
         int start_column, int end_column, guac_terminal_char* character);
 
+/**
+ * Replaces the contents of the given row with the contents of the given line,
+ * as previously stored within the off-screen row cache. If the line is not
+ * present within the cache, the display is not modified.
+ *
+ * @param display
+ *     The display whose row should be restored from the cache.
+ *
+ * @param row
+ *     The row of the display to replace.
+ *
+ * @param line
+ *     The absolute line number of the line to restore.
+ *
+ * @return
+ *     Zero if the row will be restored from the cache, non-zero if the line
+ *     is not cached and the row must instead be redrawn.
+ */
+int guac_terminal_display_restore_row(guac_terminal_display* display,
+        int row, int64_t line);
+
+/**
+ * Removes the given line from the off-screen row cache, if present. This
+ * must be invoked whenever the contents of a line change, as the cached copy
+ * of that line would otherwise be restored later.
+ *
+ * @param display
+ *     The display whose row cache should be updated.
+ *
+ * @param line
+ *     The absolute line number of the line whose contents have changed.
+ */
+void guac_terminal_display_invalidate_line(guac_terminal_display* display,
+        int64_t line);
+
+/**
+ * Removes all lines from the off-screen row cache.
+ *
+ * @param display
+ *     The display whose row cache should be cleared.
+ */
+void guac_terminal_display_clear_cache(guac_terminal_display* display);
+
 /**
  * Resize the terminal to the given dimensions.
  */
@@ -30,8 +30,10 @@
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wchar.h>
 
 /**
@@ -49,6 +51,12 @@
  */
 #define GUAC_TERMINAL_OK          "\x1B[0n"
 
+/**
+ * Palette index which is never used by any valid color, used to detect
+ * whether an xterm 256-color SGR sequence actually specified a color.
+ */
+#define GUAC_TERMINAL_SGR_NO_COLOR -2
+
 /**
  * Advances the cursor to the next row, scrolling if the cursor would otherwise
  * leave the scrolling region. If the cursor is already outside the scrolling
@@ -581,490 +589,677 @@ static int guac_terminal_parse_xterm256(guac_terminal* terminal,
 
 }
 
-int guac_terminal_csi(guac_terminal* term, unsigned char c) {
+/**
+ * Appends the given decimal digit to the value of a numeric CSI argument.
+ * Digits which would cause the value to overflow are ignored.
+ *
+ * @param value
+ *     The value of the argument parsed thus far.
+ *
+ * @param c
+ *     The decimal digit character ('0' through '9') to append.
+ *
+ * @return
+ *     The value of the argument after appending the given digit.
+ */
+static int __guac_terminal_csi_append_digit(int value, unsigned char c) {
 
-    /* CSI function arguments */
-    static int argc = 0;
-    static int argv[16] = {0};
+    /* Ignore digits beyond the representable range */
+    if (value > (INT_MAX - 9) / 10)
+        return value;
 
-    /* Sequence prefix, if any */
-    static char private_mode_character = 0;
+    return value * 10 + (c - '0');
 
-    /* Argument building counter and buffer */
-    static int argv_length = 0;
-    static char argv_buffer[256];
+}
 
-    /* Digits get concatenated into argv */
-    if (c >= '0' && c <= '9') {
+/**
+ * Computes the effect of the given list of SGR arguments on the current
+ * character attributes, storing that effect within the given transition.
+ *
+ * @param term
+ *     The terminal whose default attributes and palette should be used to
+ *     interpret the SGR arguments.
+ *
+ * @param argc
+ *     The number of arguments within the argv array.
+ *
+ * @param argv
+ *     The SGR arguments to interpret.
+ *
+ * @param transition
+ *     The guac_terminal_sgr_transition which should receive the arguments
+ *     and their effect.
+ */
+static void __guac_terminal_sgr_transition(guac_terminal* term,
+        int argc, const int* argv, guac_terminal_sgr_transition* transition) {
 
-        /* Concatenate digit if there is space in buffer */
-        if (argv_length < sizeof(argv_buffer)-1)
-            argv_buffer[argv_length++] = c;
+    int i;
 
-    }
+    guac_terminal_attributes* attributes = &transition->attributes;
+    int mask = 0;
 
-    /* Specific non-digits stop the parameter, and possibly the sequence */
-    else if ((c >= 0x40 && c <= 0x7E) || c == ';') {
+    for (i=0; i<argc; i++) {
 
-        int i, row, col, amount;
-        bool* flag;
+        int value = argv[i];
 
-        /* At most 16 parameters */
-        if (argc < 16) {
+        /* Reset attributes */
+        if (value == 0) {
+            *attributes = term->default_char.attributes;
+            mask = GUAC_TERMINAL_SGR_BOLD | GUAC_TERMINAL_SGR_HALF_BRIGHT
+                 | GUAC_TERMINAL_SGR_REVERSE | GUAC_TERMINAL_SGR_CURSOR
+                 | GUAC_TERMINAL_SGR_UNDERSCORE | GUAC_TERMINAL_SGR_FOREGROUND
+                 | GUAC_TERMINAL_SGR_BACKGROUND;
+        }
 
-            /* Finish parameter */
-            argv_buffer[argv_length] = 0;
-            argv[argc++] = atoi(argv_buffer);
+        /* Bold */
+        else if (value == 1) {
+            attributes->bold = true;
+            mask |= GUAC_TERMINAL_SGR_BOLD;
+        }
 
-            /* Prepare for next parameter */
-            argv_length = 0;
+        /* Faint (low intensity) */
+        else if (value == 2) {
+            attributes->half_bright = true;
+            mask |= GUAC_TERMINAL_SGR_HALF_BRIGHT;
+        }
 
+        /* Underscore on */
+        else if (value == 4) {
+            attributes->underscore = true;
+            mask |= GUAC_TERMINAL_SGR_UNDERSCORE;
         }
 
-        /* Handle CSI functions */ 
-        switch (c) {
+        /* Reverse video */
+        else if (value == 7) {
+            attributes->reverse = true;
+            mask |= GUAC_TERMINAL_SGR_REVERSE;
+        }
 
-            /* @: Insert characters (scroll right) */
-            case '@':
+        /* Normal intensity (not bold) */
+        else if (value == 21 || value == 22) {
+            attributes->bold = false;
+            attributes->half_bright = false;
+            mask |= GUAC_TERMINAL_SGR_BOLD | GUAC_TERMINAL_SGR_HALF_BRIGHT;
+        }
 
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+        /* Reset underscore */
+        else if (value == 24) {
+            attributes->underscore = false;
+            mask |= GUAC_TERMINAL_SGR_UNDERSCORE;
+        }
 
-                /* Scroll right by amount */
-                if (term->cursor_col + amount < term->term_width)
-                    guac_terminal_copy_columns(term, term->cursor_row,
-                            term->cursor_col, term->term_width - amount - 1,
-                            amount);
+        /* Reset reverse video */
+        else if (value == 27) {
+            attributes->reverse = false;
+            mask |= GUAC_TERMINAL_SGR_REVERSE;
+        }
 
-                /* Clear left */
-                guac_terminal_clear_columns(term, term->cursor_row,
-                        term->cursor_col, term->cursor_col + amount - 1);
+        /* Foreground */
+        else if (value >= 30 && value <= 37) {
+            guac_terminal_display_lookup_color(term->display,
+                    value - 30, &attributes->foreground);
+            mask |= GUAC_TERMINAL_SGR_FOREGROUND;
+        }
 
-                break;
+        /* Underscore on, default foreground OR 256-color foreground */
+        else if (value == 38) {
 
-            /* A: Move up */
-            case 'A':
+            /* Attempt to read foreground from 256-color entry */
+            guac_terminal_color color = {
+                .palette_index = GUAC_TERMINAL_SGR_NO_COLOR
+            };
 
-                /* Get move amount */
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+            int xterm256_length = guac_terminal_parse_xterm256(term,
+                    argc - i - 1, &argv[i + 1], &color);
 
-                /* Move cursor */
-                guac_terminal_move_cursor(term,
-                        term->cursor_row - amount,
-                        term->cursor_col);
+            /* If valid 256-color entry, skip its arguments, setting the
+             * foreground only if the color itself was in range */
+            if (xterm256_length > 0) {
 
-                break;
+                i += xterm256_length;
 
-            /* B: Move down */
-            case 'e':
-            case 'B':
+                if (color.palette_index != GUAC_TERMINAL_SGR_NO_COLOR) {
+                    attributes->foreground = color;
+                    mask |= GUAC_TERMINAL_SGR_FOREGROUND;
+                }
 
-                /* Get move amount */
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+            }
 
-                /* Move cursor */
-                guac_terminal_move_cursor(term,
-                        term->cursor_row + amount,
-                        term->cursor_col);
+            /* Otherwise interpret as underscore and default foreground */
+            else {
+                attributes->underscore = true;
+                attributes->foreground =
+                    term->default_char.attributes.foreground;
+                mask |= GUAC_TERMINAL_SGR_UNDERSCORE
+                      | GUAC_TERMINAL_SGR_FOREGROUND;
+            }
 
-                break;
+        }
 
-            /* C: Move right */
-            case 'a':
-            case 'C':
+        /* Underscore off, default foreground */
+        else if (value == 39) {
+            attributes->underscore = false;
+            attributes->foreground = term->default_char.attributes.foreground;
+            mask |= GUAC_TERMINAL_SGR_UNDERSCORE
+                  | GUAC_TERMINAL_SGR_FOREGROUND;
+        }
 
-                /* Get move amount */
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+        /* Background */
+        else if (value >= 40 && value <= 47) {
+            guac_terminal_display_lookup_color(term->display,
+                    value - 40, &attributes->background);
+            mask |= GUAC_TERMINAL_SGR_BACKGROUND;
+        }
 
-                /* Move cursor */
-                guac_terminal_move_cursor(term,
-                        term->cursor_row,
-                        term->cursor_col + amount);
+        /* 256-color background */
+        else if (value == 48) {
 
-                break;
+            guac_terminal_color color = {
+                .palette_index = GUAC_TERMINAL_SGR_NO_COLOR
+            };
 
-            /* D: Move left */
-            case 'D':
+            i += guac_terminal_parse_xterm256(term,
+                    argc - i - 1, &argv[i + 1], &color);
 
-                /* Get move amount */
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+            /* Set background only if the color was in range */
+            if (color.palette_index != GUAC_TERMINAL_SGR_NO_COLOR) {
+                attributes->background = color;
+                mask |= GUAC_TERMINAL_SGR_BACKGROUND;
+            }
 
-                /* Move cursor */
-                guac_terminal_move_cursor(term,
-                        term->cursor_row,
-                        term->cursor_col - amount);
+        }
 
-                break;
+        /* Reset background */
+        else if (value == 49) {
+            attributes->background = term->default_char.attributes.background;
+            mask |= GUAC_TERMINAL_SGR_BACKGROUND;
+        }
 
-            /* E: Move cursor down given number rows, column 1 */
-            case 'E':
+        /* Intense foreground */
+        else if (value >= 90 && value <= 97) {
+            guac_terminal_display_lookup_color(term->display,
+                    value - 90 + GUAC_TERMINAL_FIRST_INTENSE,
+                    &attributes->foreground);
+            mask |= GUAC_TERMINAL_SGR_FOREGROUND;
+        }
 
-                /* Get move amount */
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+        /* Intense background */
+        else if (value >= 100 && value <= 107) {
+            guac_terminal_display_lookup_color(term->display,
+                    value - 100 + GUAC_TERMINAL_FIRST_INTENSE,
+                    &attributes->background);
+            mask |= GUAC_TERMINAL_SGR_BACKGROUND;
+        }
 
-                /* Move cursor down, reset to column 1 */
-                guac_terminal_move_cursor(term,
-                        term->cursor_row + amount,
-                        0);
+    }
 
-                break;
+    /* Store arguments producing this transition */
+    for (i=0; i<argc; i++)
+        transition->argv[i] = argv[i];
 
-            /* F: Move cursor up given number rows, column 1 */
-            case 'F':
+    transition->argc = argc;
+    transition->mask = mask;
 
-                /* Get move amount */
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+}
 
-                /* Move cursor up , reset to column 1 */
-                guac_terminal_move_cursor(term,
-                        term->cursor_row - amount,
-                        0);
+/**
+ * Handles an SGR (Select Graphic Rendition) sequence, updating the current
+ * character attributes of the given terminal. The effect of each distinct
+ * list of SGR arguments is cached within the terminal, such that repeated
+ * sequences (as are common in colorized output) need not be reinterpreted.
+ *
+ * @param term
+ *     The terminal that received the SGR sequence.
+ *
+ * @param argc
+ *     The number of arguments within the argv array.
+ *
+ * @param argv
+ *     The SGR arguments received.
+ */
+static void __guac_terminal_sgr(guac_terminal* term, int argc,
+        const int* argv) {
 
-                break;
+    int i;
+    unsigned int hash = argc;
 
-            /* G: Move cursor, current row */
-            case '`':
-            case 'G':
-                col = argv[0]; if (col != 0) col--;
-                guac_terminal_move_cursor(term, term->cursor_row, col);
-                break;
+    /* Locate cache entry for the given arguments */
+    for (i=0; i<argc; i++)
+        hash = hash * 31 + argv[i];
 
-            /* H: Move cursor */
-            case 'f':
-            case 'H':
+    guac_terminal_sgr_transition* transition =
+        &term->sgr_cache[hash & (GUAC_TERMINAL_SGR_CACHE_SIZE - 1)];
 
-                row = argv[0]; if (row != 0) row--;
-                col = argv[1]; if (col != 0) col--;
+    /* Interpret arguments only if not already cached */
+    if (transition->argc != argc
+            || memcmp(transition->argv, argv, argc * sizeof(int)) != 0)
+        __guac_terminal_sgr_transition(term, argc, argv, transition);
 
-                guac_terminal_move_cursor(term, row, col);
-                break;
+    guac_terminal_attributes* attributes = &term->current_attributes;
+    int mask = transition->mask;
 
-            /* J: Erase display */
-            case 'J':
- 
-                /* Erase from cursor to end of display */
-                if (argv[0] == 0)
-                    guac_terminal_clear_range(term,
-                            term->cursor_row, term->cursor_col,
-                            term->term_height-1, term->term_width-1);
-                
-                /* Erase from start to cursor */
-                else if (argv[0] == 1)
-                    guac_terminal_clear_range(term,
-                            0, 0,
-                            term->cursor_row, term->cursor_col);
-
-                /* Entire screen */
-                else if (argv[0] == 2 || argv[0] == 3)
-                    guac_terminal_clear_range(term,
-                            0, 0, term->term_height - 1, term->term_width - 1);
+    /* Apply only those attributes assigned by the transition */
+    if (mask & GUAC_TERMINAL_SGR_BOLD)
+        attributes->bold = transition->attributes.bold;
 
-                break;
+    if (mask & GUAC_TERMINAL_SGR_HALF_BRIGHT)
+        attributes->half_bright = transition->attributes.half_bright;
 
-            /* K: Erase line */
-            case 'K':
+    if (mask & GUAC_TERMINAL_SGR_REVERSE)
+        attributes->reverse = transition->attributes.reverse;
 
-                /* Erase from cursor to end of line */
-                if (argv[0] == 0)
-                    guac_terminal_clear_columns(term, term->cursor_row,
-                            term->cursor_col, term->term_width - 1);
+    if (mask & GUAC_TERMINAL_SGR_CURSOR)
+        attributes->cursor = transition->attributes.cursor;
 
-                /* Erase from start to cursor */
-                else if (argv[0] == 1)
-                    guac_terminal_clear_columns(term, term->cursor_row,
-                            0, term->cursor_col);
+    if (mask & GUAC_TERMINAL_SGR_UNDERSCORE)
+        attributes->underscore = transition->attributes.underscore;
 
-                /* Erase line */
-                else if (argv[0] == 2)
-                    guac_terminal_clear_columns(term, term->cursor_row,
-                            0, term->term_width - 1);
+    if (mask & GUAC_TERMINAL_SGR_FOREGROUND)
+        attributes->foreground = transition->attributes.foreground;
 
-                break;
+    if (mask & GUAC_TERMINAL_SGR_BACKGROUND)
+        attributes->background = transition->attributes.background;
 
-            /* L: Insert blank lines (scroll down) */
-            case 'L':
+}
 
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+/**
+ * Handles a complete CSI sequence, performing the function specified by its
+ * final character.
+ *
+ * @param term
+ *     The terminal that received the CSI sequence.
+ *
+ * @param c
+ *     The final character of the CSI sequence, identifying the function to
+ *     perform.
+ *
+ * @param private_mode_character
+ *     The private mode character (one of ':', '<', '=', '>', or '?') given
+ *     within the sequence, or zero if none was given.
+ *
+ * @param argc
+ *     The number of arguments within the argv array.
+ *
+ * @param argv
+ *     The numeric arguments of the CSI sequence. At least
+ *     GUAC_TERMINAL_MAX_CSI_ARGS elements must be present, with any elements
+ *     beyond argc set to zero.
+ */
+static void __guac_terminal_csi_dispatch(guac_terminal* term, unsigned char c,
+        char private_mode_character, int argc, const int* argv) {
 
-                guac_terminal_scroll_down(term,
-                        term->cursor_row, term->scroll_end, amount);
+    int i, row, col, amount;
+    bool* flag;
 
-                break;
+    /* Handle CSI functions */ 
+    switch (c) {
 
-            /* M: Delete lines (scroll up) */
-            case 'M':
+        /* @: Insert characters (scroll right) */
+        case '@':
 
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+            amount = argv[0];
+            if (amount == 0) amount = 1;
 
-                guac_terminal_scroll_up(term,
-                        term->cursor_row, term->scroll_end, amount);
+            /* Scroll right by amount */
+            if (term->cursor_col + amount < term->term_width)
+                guac_terminal_copy_columns(term, term->cursor_row,
+                        term->cursor_col, term->term_width - amount - 1,
+                        amount);
 
-                break;
+            /* Clear left */
+            guac_terminal_clear_columns(term, term->cursor_row,
+                    term->cursor_col, term->cursor_col + amount - 1);
 
-            /* P: Delete characters (scroll left) */
-            case 'P':
+            break;
 
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+        /* A: Move up */
+        case 'A':
 
-                /* Scroll left by amount */
-                if (term->cursor_col + amount < term->term_width)
-                    guac_terminal_copy_columns(term, term->cursor_row,
-                            term->cursor_col + amount, term->term_width - 1,
-                            -amount);
+            /* Get move amount */
+            amount = argv[0];
+            if (amount == 0) amount = 1;
 
-                /* Clear right */
-                guac_terminal_clear_columns(term, term->cursor_row,
-                        term->term_width - amount, term->term_width - 1);
+            /* Move cursor */
+            guac_terminal_move_cursor(term,
+                    term->cursor_row - amount,
+                    term->cursor_col);
 
-                break;
+            break;
+
+        /* B: Move down */
+        case 'e':
+        case 'B':
+
+            /* Get move amount */
+            amount = argv[0];
+            if (amount == 0) amount = 1;
+
+            /* Move cursor */
+            guac_terminal_move_cursor(term,
+                    term->cursor_row + amount,
+                    term->cursor_col);
+
+            break;
 
-            /* X: Erase characters (no scroll) */
-            case 'X':
+        /* C: Move right */
+        case 'a':
+        case 'C':
 
-                amount = argv[0];
-                if (amount == 0) amount = 1;
+            /* Get move amount */
+            amount = argv[0];
+            if (amount == 0) amount = 1;
 
-                /* Clear characters */
+            /* Move cursor */
+            guac_terminal_move_cursor(term,
+                    term->cursor_row,
+                    term->cursor_col + amount);
+
+            break;
+
+        /* D: Move left */
+        case 'D':
+
+            /* Get move amount */
+            amount = argv[0];
+            if (amount == 0) amount = 1;
+
+            /* Move cursor */
+            guac_terminal_move_cursor(term,
+                    term->cursor_row,
+                    term->cursor_col - amount);
+
+            break;
+
+        /* E: Move cursor down given number rows, column 1 */
+        case 'E':
+
+            /* Get move amount */
+            amount = argv[0];
+            if (amount == 0) amount = 1;
+
+            /* Move cursor down, reset to column 1 */
+            guac_terminal_move_cursor(term,
+                    term->cursor_row + amount,
+                    0);
+
+            break;
+
+        /* F: Move cursor up given number rows, column 1 */
+        case 'F':
+
+            /* Get move amount */
+            amount = argv[0];
+            if (amount == 0) amount = 1;
+
+            /* Move cursor up , reset to column 1 */
+            guac_terminal_move_cursor(term,
+                    term->cursor_row - amount,
+                    0);
+
+            break;
+
+        /* G: Move cursor, current row */
+        case '`':
+        case 'G':
+            col = argv[0]; if (col != 0) col--;
+            guac_terminal_move_cursor(term, term->cursor_row, col);
+            break;
+
+        /* H: Move cursor */
+        case 'f':
+        case 'H':
+
+            row = argv[0]; if (row != 0) row--;
+            col = argv[1]; if (col != 0) col--;
+
+            guac_terminal_move_cursor(term, row, col);
+            break;
+
+        /* J: Erase display */
+        case 'J':
+ 
+            /* Erase from cursor to end of display */
+            if (argv[0] == 0)
+                guac_terminal_clear_range(term,
+                        term->cursor_row, term->cursor_col,
+                        term->term_height-1, term->term_width-1);
+            
+            /* Erase from start to cursor */
+            else if (argv[0] == 1)
+                guac_terminal_clear_range(term,
+                        0, 0,
+                        term->cursor_row, term->cursor_col);
+
+            /* Entire screen */
+            else if (argv[0] == 2 || argv[0] == 3)
+                guac_terminal_clear_range(term,
+                        0, 0, term->term_height - 1, term->term_width - 1);
+
+            break;
+
+        /* K: Erase line */
+        case 'K':
+
+            /* Erase from cursor to end of line */
+            if (argv[0] == 0)
                 guac_terminal_clear_columns(term, term->cursor_row,
-                        term->cursor_col, term->cursor_col + amount - 1);
+                        term->cursor_col, term->term_width - 1);
 
-                break;
+            /* Erase from start to cursor */
+            else if (argv[0] == 1)
+                guac_terminal_clear_columns(term, term->cursor_row,
+                        0, term->cursor_col);
 
-            /* ]: Linux Private CSI */
-            case ']':
-                /* Explicitly ignored */
-                break;
+            /* Erase line */
+            else if (argv[0] == 2)
+                guac_terminal_clear_columns(term, term->cursor_row,
+                        0, term->term_width - 1);
 
-            /* c: Identify */
-            case 'c':
-                if (argv[0] == 0 && private_mode_character == 0)
-                    guac_terminal_send_string(term, GUAC_TERMINAL_VT102_ID);
-                break;
+            break;
 
-            /* d: Move cursor, current col */
-            case 'd':
-                row = argv[0]; if (row != 0) row--;
-                guac_terminal_move_cursor(term, row, term->cursor_col);
-                break;
+        /* L: Insert blank lines (scroll down) */
+        case 'L':
 
-            /* g: Clear tab */
-            case 'g':
+            amount = argv[0];
+            if (amount == 0) amount = 1;
 
-                /* Clear tab at current location */
-                if (argv[0] == 0)
-                    guac_terminal_unset_tab(term, term->cursor_col);
+            guac_terminal_scroll_down(term,
+                    term->cursor_row, term->scroll_end, amount);
 
-                /* Clear all tabs */
-                else if (argv[0] == 3)
-                    guac_terminal_clear_tabs(term);
+            break;
 
-                break;
+        /* M: Delete lines (scroll up) */
+        case 'M':
 
-            /* h: Set Mode */
-            case 'h':
-             
-                /* Look up flag and set */ 
-                flag = __guac_terminal_get_flag(term, argv[0], private_mode_character);
-                if (flag != NULL)
-                    *flag = true;
+            amount = argv[0];
+            if (amount == 0) amount = 1;
 
-                break;
+            guac_terminal_scroll_up(term,
+                    term->cursor_row, term->scroll_end, amount);
 
-            /* l: Reset Mode */
-            case 'l':
-              
-                /* Look up flag and clear */ 
-                flag = __guac_terminal_get_flag(term, argv[0], private_mode_character);
-                if (flag != NULL)
-                    *flag = false;
+            break;
 
-                break;
+        /* P: Delete characters (scroll left) */
+        case 'P':
 
-            /* m: Set graphics rendition */
-            case 'm':
-
-                for (i=0; i<argc; i++) {
-
-                    int value = argv[i];
-
-                    /* Reset attributes */
-                    if (value == 0)
-                        term->current_attributes = term->default_char.attributes;
-
-                    /* Bold */
-                    else if (value == 1)
-                        term->current_attributes.bold = true;
-
-                    /* Faint (low intensity) */
-                    else if (value == 2)
-                        term->current_attributes.half_bright = true;
-
-                    /* Underscore on */
-                    else if (value == 4)
-                        term->current_attributes.underscore = true;
-
-                    /* Reverse video */
-                    else if (value == 7)
-                        term->current_attributes.reverse = true;
-
-                    /* Normal intensity (not bold) */
-                    else if (value == 21 || value == 22) {
-                        term->current_attributes.bold = false;
-                        term->current_attributes.half_bright = false;
-                    }
-
-                    /* Reset underscore */
-                    else if (value == 24)
-                        term->current_attributes.underscore = false;
-
-                    /* Reset reverse video */
-                    else if (value == 27)
-                        term->current_attributes.reverse = false;
-
-                    /* Foreground */
-                    else if (value >= 30 && value <= 37)
-                        guac_terminal_display_lookup_color(term->display,
-                                value - 30,
-                                &term->current_attributes.foreground);
-
-                    /* Underscore on, default foreground OR 256-color
-                     * foreground */
-                    else if (value == 38) {
-
-                        /* Attempt to set foreground with 256-color entry */
-                        int xterm256_length =
-                            guac_terminal_parse_xterm256(term,
-                                    argc - i - 1, &argv[i + 1],
-                                    &term->current_attributes.foreground);
-
-                        /* If valid 256-color entry, foreground has been set */
-                        if (xterm256_length > 0)
-                            i += xterm256_length;
-
-                        /* Otherwise interpret as underscore and default
-                         * foreground  */
-                        else {
-                            term->current_attributes.underscore = true;
-                            term->current_attributes.foreground =
-                                term->default_char.attributes.foreground;
-                        }
-
-                    }
-
-                    /* Underscore off, default foreground */
-                    else if (value == 39) {
-                        term->current_attributes.underscore = false;
-                        term->current_attributes.foreground =
-                            term->default_char.attributes.foreground;
-                    }
-
-                    /* Background */
-                    else if (value >= 40 && value <= 47)
-                        guac_terminal_display_lookup_color(term->display,
-                                value - 40,
-                                &term->current_attributes.background);
-
-                    /* 256-color background */
-                    else if (value == 48)
-                        i += guac_terminal_parse_xterm256(term,
-                                argc - i - 1, &argv[i + 1],
-                                &term->current_attributes.background);
-
-                    /* Reset background */
-                    else if (value == 49)
-                        term->current_attributes.background =
-                            term->default_char.attributes.background;
-
-                    /* Intense foreground */
-                    else if (value >= 90 && value <= 97)
-                        guac_terminal_display_lookup_color(term->display,
-                                value - 90 + GUAC_TERMINAL_FIRST_INTENSE,
-                                &term->current_attributes.foreground);
-
-                    /* Intense background */
-                    else if (value >= 100 && value <= 107)
-                        guac_terminal_display_lookup_color(term->display,
-                                value - 100 + GUAC_TERMINAL_FIRST_INTENSE,
-                                &term->current_attributes.background);
+            amount = argv[0];
+            if (amount == 0) amount = 1;
 
-                }
+            /* Scroll left by amount */
+            if (term->cursor_col + amount < term->term_width)
+                guac_terminal_copy_columns(term, term->cursor_row,
+                        term->cursor_col + amount, term->term_width - 1,
+                        -amount);
 
-                break;
+            /* Clear right */
+            guac_terminal_clear_columns(term, term->cursor_row,
+                    term->term_width - amount, term->term_width - 1);
 
-            /* n: Status report */
-            case 'n':
+            break;
 
-                /* Device status report */
-                if (argv[0] == 5 && private_mode_character == 0)
-                    guac_terminal_send_string(term, GUAC_TERMINAL_OK);
+        /* X: Erase characters (no scroll) */
+        case 'X':
 
-                /* Cursor position report */
-                else if (argv[0] == 6 && private_mode_character == 0)
-                    guac_terminal_sendf(term, "\x1B[%i;%iR", term->cursor_row+1, term->cursor_col+1);
+            amount = argv[0];
+            if (amount == 0) amount = 1;
 
-                break;
+            /* Clear characters */
+            guac_terminal_clear_columns(term, term->cursor_row,
+                    term->cursor_col, term->cursor_col + amount - 1);
 
-            /* q: Set keyboard LEDs */
-            case 'q':
-                /* Explicitly ignored */
-                break;
+            break;
 
-            /* r: Set scrolling region */
-            case 'r':
+        /* ]: Linux Private CSI */
+        case ']':
+            /* Explicitly ignored */
+            break;
 
-                /* If parameters given, set region */
-                if (argc == 2) {
-                    term->scroll_start = argv[0]-1;
-                    term->scroll_end   = argv[1]-1;
-                }
+        /* c: Identify */
+        case 'c':
+            if (argv[0] == 0 && private_mode_character == 0)
+                guac_terminal_send_string(term, GUAC_TERMINAL_VT102_ID);
+            break;
 
-                /* Otherwise, reset scrolling region */
-                else {
-                    term->scroll_start = 0;
-                    term->scroll_end = term->term_height - 1;
-                }
+        /* d: Move cursor, current col */
+        case 'd':
+            row = argv[0]; if (row != 0) row--;
+            guac_terminal_move_cursor(term, row, term->cursor_col);
+            break;
 
-                break;
+        /* g: Clear tab */
+        case 'g':
 
-            /* Save Cursor */
-            case 's':
-                term->saved_cursor_row = term->cursor_row;
-                term->saved_cursor_col = term->cursor_col;
-                break;
+            /* Clear tab at current location */
+            if (argv[0] == 0)
+                guac_terminal_unset_tab(term, term->cursor_col);
 
-            /* Restore Cursor */
-            case 'u':
-                guac_terminal_move_cursor(term,
-                        term->saved_cursor_row,
-                        term->saved_cursor_col);
-                break;
+            /* Clear all tabs */
+            else if (argv[0] == 3)
+                guac_terminal_clear_tabs(term);
 
-            /* Warn of unhandled codes */
-            default:
-                if (c != ';') {
+            break;
 
-                    guac_client_log(term->client, GUAC_LOG_DEBUG,
-                            "Unhandled CSI sequence: %c", c);
+        /* h: Set Mode */
+        case 'h':
+         
+            /* Look up flag and set */ 
+            flag = __guac_terminal_get_flag(term, argv[0], private_mode_character);
+            if (flag != NULL)
+                *flag = true;
 
-                    for (i=0; i<argc; i++)
-                        guac_client_log(term->client, GUAC_LOG_DEBUG,
-                                " -> argv[%i] = %i", i, argv[i]);
+            break;
 
-                }
+        /* l: Reset Mode */
+        case 'l':
+          
+            /* Look up flag and clear */ 
+            flag = __guac_terminal_get_flag(term, argv[0], private_mode_character);
+            if (flag != NULL)
+                *flag = false;
 
-        }
+            break;
+
+        /* m: Set graphics rendition */
+        case 'm':
+            __guac_terminal_sgr(term, argc, argv);
+            break;
+
+        /* n: Status report */
+        case 'n':
+
+            /* Device status report */
+            if (argv[0] == 5 && private_mode_character == 0)
+                guac_terminal_send_string(term, GUAC_TERMINAL_OK);
+
+            /* Cursor position report */
+            else if (argv[0] == 6 && private_mode_character == 0)
+                guac_terminal_sendf(term, "\x1B[%i;%iR", term->cursor_row+1, term->cursor_col+1);
+
+            break;
+
+        /* q: Set keyboard LEDs */
+        case 'q':
+            /* Explicitly ignored */
+            break;
+
+        /* r: Set scrolling region */
+        case 'r':
+
+            /* If parameters given, set region */
+            if (argc == 2) {
+                term->scroll_start = argv[0]-1;
+                term->scroll_end   = argv[1]-1;
+            }
+
+            /* Otherwise, reset scrolling region */
+            else {
+                term->scroll_start = 0;
+                term->scroll_end = term->term_height - 1;
+            }
+
+            break;
+
+        /* Save Cursor */
+        case 's':
+            term->saved_cursor_row = term->cursor_row;
+            term->saved_cursor_col = term->cursor_col;
+            break;
+
+        /* Restore Cursor */
+        case 'u':
+            guac_terminal_move_cursor(term,
+                    term->saved_cursor_row,
+                    term->saved_cursor_col);
+            break;
+
+        /* Warn of unhandled codes */
+        default:
+
+            guac_client_log(term->client, GUAC_LOG_DEBUG,
+                    "Unhandled CSI sequence: %c", c);
+
+            for (i=0; i<argc; i++)
+                guac_client_log(term->client, GUAC_LOG_DEBUG,
+                        " -> argv[%i] = %i", i, argv[i]);
+
+    }
+
+}
+
+int guac_terminal_csi(guac_terminal* term, unsigned char c) {
+
+    /* CSI function arguments */
+    static int argc = 0;
+    static int argv[GUAC_TERMINAL_MAX_CSI_ARGS] = {0};
+
+    /* Sequence prefix, if any */
+    static char private_mode_character = 0;
+
+    /* Value of argument currently being built */
+    static int value = 0;
+
+    /* Digits get concatenated into argv */
+    if (c >= '0' && c <= '9')
+        value = __guac_terminal_csi_append_digit(value, c);
+
+    /* Specific non-digits stop the parameter, and possibly the sequence */
+    else if ((c >= 0x40 && c <= 0x7E) || c == ';') {
+
+        int i;
+
+        /* Finish parameter, storing at most GUAC_TERMINAL_MAX_CSI_ARGS */
+        if (argc < GUAC_TERMINAL_MAX_CSI_ARGS)
+            argv[argc++] = value;
+
+        /* Prepare for next parameter */
+        value = 0;
 
         /* If not a semicolon, end of CSI sequence */
         if (c != ';') {
+
+            __guac_terminal_csi_dispatch(term, c, private_mode_character,
+                    argc, argv);
+
             term->char_handler = guac_terminal_echo;
 
             /* Reset parameters */
@@ -1074,9 +1269,9 @@ int guac_terminal_csi(guac_terminal* term, unsigned char c) {
             /* Reset private mode character */
             private_mode_character = 0;
 
-            /* Reset argument counters */
+            /* Reset argument counter */
             argc = 0;
-            argv_length = 0;
+
         }
 
     }
@@ -1089,6 +1284,65 @@ int guac_terminal_csi(guac_terminal* term, unsigned char c) {
 
 }
 
+int guac_terminal_csi_sequence(guac_terminal* term, const char* buffer,
+        int length) {
+
+    int i;
+
+    /* CSI function arguments */
+    int argc = 0;
+    int argv[GUAC_TERMINAL_MAX_CSI_ARGS] = {0};
+
+    /* Sequence prefix, if any */
+    char private_mode_character = 0;
+
+    /* Value of argument currently being built */
+    int value = 0;
+
+    /* Interpret characters exactly as guac_terminal_csi() would */
+    for (i = 0; i < length; i++) {
+
+        unsigned char c = buffer[i];
+
+        /* Digits get concatenated into argv */
+        if (c >= '0' && c <= '9')
+            value = __guac_terminal_csi_append_digit(value, c);
+
+        /* Semicolons stop the parameter */
+        else if (c == ';') {
+
+            if (argc < GUAC_TERMINAL_MAX_CSI_ARGS)
+                argv[argc++] = value;
+
+            value = 0;
+
+        }
+
+        /* Final characters stop both the parameter and the sequence */
+        else if (c >= 0x40 && c <= 0x7E) {
+
+            if (argc < GUAC_TERMINAL_MAX_CSI_ARGS)
+                argv[argc++] = value;
+
+            __guac_terminal_csi_dispatch(term, c, private_mode_character,
+                    argc, argv);
+
+            term->char_handler = guac_terminal_echo;
+            return i + 1;
+
+        }
+
+        /* Set private mode character if given and unset */
+        else if (c >= 0x3A && c <= 0x3F && private_mode_character == 0)
+            private_mode_character = c;
+
+    }
+
+    /* Sequence is not yet complete */
+    return 0;
+
+}
+
 int guac_terminal_set_directory(guac_terminal* term, unsigned char c) {
 
     static char filename[2048];
@@ -1266,9 +1520,11 @@ int guac_terminal_xterm_palette(guac_terminal* term, unsigned char c) {
             color_spec[color_spec_pos] = '\0';
 
             /* Modify palette if color spec is valid */
-            if (!guac_terminal_xparsecolor(color_spec, &color))
+            if (!guac_terminal_xparsecolor(color_spec, &color)) {
                 guac_terminal_display_assign_color(term->display,
                         index, &color);
+                guac_terminal_clear_sgr_cache(term);
+            }
             else
                 guac_client_log(term->client, GUAC_LOG_DEBUG,
                         "Invalid XParseColor() color spec: \"%s\"",
@@ -85,6 +85,33 @@ int guac_terminal_g1_charset(guac_terminal* term, unsigned char c);
  */
 int guac_terminal_csi(guac_terminal* term, unsigned char c);
 
+/**
+ * Parses and handles an entire CSI sequence at once, without passing through
+ * guac_terminal_csi() one character at a time. This function may only be
+ * invoked immediately after the character handler of the terminal has
+ * changed to guac_terminal_csi(), before any characters of the sequence have
+ * been handled. If the sequence is not wholly contained within the given
+ * buffer, nothing is parsed, and the remaining characters must be passed
+ * through guac_terminal_csi() as usual.
+ *
+ * @param term
+ *     The terminal that received the given data.
+ *
+ * @param buffer
+ *     The data received by the terminal, beginning with the first character
+ *     following the CSI sequence introducer.
+ *
+ * @param length
+ *     The number of bytes within the given buffer.
+ *
+ * @return
+ *     The number of bytes of the given buffer which were parsed and handled
+ *     as a complete CSI sequence, or zero if the buffer does not contain a
+ *     complete CSI sequence.
+ */
+int guac_terminal_csi_sequence(guac_terminal* term, const char* buffer,
+        int length);
+
 /**
  * Parses the remainder of the download initiation OSC specific to the
  * Guacamole terminal emulator. A download will be initiated for the specified
@@ -53,6 +53,7 @@ guac_terminal_scrollbar* guac_terminal_scrollbar_alloc(guac_client* client,
     scrollbar->render_state.handle_y      = 0;
     scrollbar->render_state.handle_width  = 0;
     scrollbar->render_state.handle_height = 0;
+    scrollbar->render_state.handle_fill_height = 0;
 
     /* Init container render state */
     scrollbar->render_state.container_x      = 0;
@@ -61,8 +62,9 @@ guac_terminal_scrollbar* guac_terminal_scrollbar_alloc(guac_client* client,
     scrollbar->render_state.container_height = 0;
 
     /* Allocate and init layers */
-    scrollbar->container = guac_client_alloc_layer(client);
-    scrollbar->handle    = guac_client_alloc_layer(client);
+    scrollbar->container   = guac_client_alloc_layer(client);
+    scrollbar->handle      = guac_client_alloc_layer(client);
+    scrollbar->handle_fill = guac_client_alloc_layer(client);
 
     /* Init mouse event state tracking */
     scrollbar->dragging_handle = 0;
@@ -78,6 +80,7 @@ guac_terminal_scrollbar* guac_terminal_scrollbar_alloc(guac_client* client,
 void guac_terminal_scrollbar_free(guac_terminal_scrollbar* scrollbar) {
 
     /* Free layers */
+    guac_client_free_layer(scrollbar->client, scrollbar->handle_fill);
     guac_client_free_layer(scrollbar->client, scrollbar->handle);
     guac_client_free_layer(scrollbar->client, scrollbar->container);
 
@@ -185,24 +188,25 @@ static void guac_terminal_scrollbar_move_handle(
 }
 
 /**
- * Resizes and redraws the handle layer of the scrollbar according to the given
- * scrollbar render state, sending any necessary Guacamole instructions over
- * the given socket. The handle is the portion of the scrollbar that indicates
- * the current scroll value and which the user can click and drag to change the
- * value.
+ * Resizes the handle layer of the scrollbar according to the given scrollbar
+ * render state, sending any necessary Guacamole instructions over the given
+ * socket. The handle is the portion of the scrollbar that indicates the
+ * current scroll value and which the user can click and drag to change the
+ * value. As the handle layer only clips the handle's fill, which is drawn
+ * separately, no redraw is needed.
  *
  * @param scrollbar
- *     The scrollbar associated with the handle being resized and redrawn.
+ *     The scrollbar associated with the handle being resized.
  *
  * @param state
  *     The guac_terminal_scrollbar_render_state describing the new scrollbar
- *     handle size and appearance.
+ *     handle size.
  *
  * @param socket
  *     The guac_socket over which any instructions necessary to perform the
  *     render operation should be sent.
  */
-static void guac_terminal_scrollbar_draw_handle(
+static void guac_terminal_scrollbar_resize_handle(
         guac_terminal_scrollbar* scrollbar,
         guac_terminal_scrollbar_render_state* state,
         guac_socket* socket) {
@@ -212,14 +216,48 @@ static void guac_terminal_scrollbar_draw_handle(
             state->handle_width,
             state->handle_height);
 
-    /* Fill handle with solid color */
-    guac_protocol_send_rect(socket, scrollbar->handle, 0, 0,
+}
+
+/**
+ * Resizes and redraws the fill of the scrollbar handle according to the given
+ * scrollbar render state, sending any necessary Guacamole instructions over
+ * the given socket. The fill is drawn at the largest height the handle may
+ * have, and thus need only be redrawn if the scrollbar itself is resized.
+ *
+ * @param scrollbar
+ *     The scrollbar associated with the handle fill being redrawn.
+ *
+ * @param state
+ *     The guac_terminal_scrollbar_render_state describing the new scrollbar
+ *     handle size and appearance.
+ *
+ * @param socket
+ *     The guac_socket over which any instructions necessary to perform the
+ *     render operation should be sent.
+ */
+static void guac_terminal_scrollbar_draw_handle_fill(
+        guac_terminal_scrollbar* scrollbar,
+        guac_terminal_scrollbar_render_state* state,
+        guac_socket* socket) {
+
+    /* Set fill size */
+    guac_protocol_send_size(socket, scrollbar->handle_fill,
             state->handle_width,
-            state->handle_height);
+            state->handle_fill_height);
 
-    guac_protocol_send_cfill(socket, GUAC_COMP_SRC, scrollbar->handle,
+    /* Fill with solid color */
+    guac_protocol_send_rect(socket, scrollbar->handle_fill, 0, 0,
+            state->handle_width,
+            state->handle_fill_height);
+
+    guac_protocol_send_cfill(socket, GUAC_COMP_SRC, scrollbar->handle_fill,
             0xA0, 0xA0, 0xA0, 0x8F);
 
+    /* Fill is always at upper-left corner of handle */
+    guac_protocol_send_move(socket,
+            scrollbar->handle_fill, scrollbar->handle,
+            0, 0, 0);
+
 }
 
 /**
@@ -287,6 +325,9 @@ static void calculate_state(guac_terminal_scrollbar* scrollbar,
     if (render_state->handle_height > max_handle_height)
         render_state->handle_height = max_handle_height;
 
+    /* Fill must cover handle at any height */
+    render_state->handle_fill_height = max_handle_height;
+
     /* Calculate handle X position */
     render_state->handle_x = GUAC_TERMINAL_SCROLLBAR_PADDING;
 
@@ -343,8 +384,9 @@ void guac_terminal_scrollbar_dup(guac_terminal_scrollbar* scrollbar,
     guac_terminal_scrollbar_move_container(scrollbar, state, socket);
 
     /* Send handle */
-    guac_terminal_scrollbar_draw_handle(scrollbar, state, socket);
+    guac_terminal_scrollbar_resize_handle(scrollbar, state, socket);
     guac_terminal_scrollbar_move_handle(scrollbar, state, socket);
+    guac_terminal_scrollbar_draw_handle_fill(scrollbar, state, socket);
 
 }
 
@@ -383,10 +425,17 @@ void guac_terminal_scrollbar_flush(guac_terminal_scrollbar* scrollbar) {
         guac_terminal_scrollbar_move_handle(scrollbar, &new_state, socket);
     }
 
-    /* Resize and redraw handle if size changed */
+    /* Resize handle if size changed */
     if (old_state->handle_width  != new_state.handle_width
      || old_state->handle_height != new_state.handle_height) {
-        guac_terminal_scrollbar_draw_handle(scrollbar, &new_state, socket);
+        guac_terminal_scrollbar_resize_handle(scrollbar, &new_state, socket);
+    }
+
+    /* Redraw handle fill only if the largest possible handle changed, which
+     * happens only when the scrollbar itself is resized */
+    if (old_state->handle_width       != new_state.handle_width
+     || old_state->handle_fill_height != new_state.handle_fill_height) {
+        guac_terminal_scrollbar_draw_handle_fill(scrollbar, &new_state, socket);
     }
 
     /* Store current render state */
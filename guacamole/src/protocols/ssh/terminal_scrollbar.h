@@ -69,6 +69,13 @@ typedef struct guac_terminal_scrollbar_render_state {
      */
     int handle_height;
 
+    /**
+     * The height of the solid fill within the scrollbar's handle. This is the
+     * largest height the handle may have given the current container size,
+     * such that the handle may be resized without redrawing its fill.
+     */
+    int handle_fill_height;
+
     /**
      * The current X-coordinate of the upper-left corner of the scrollbar's
      * containing layer.
@@ -136,10 +143,18 @@ struct guac_terminal_scrollbar {
 
     /**
      * The draggable handle within the scrollbar, representing the current
-     * scroll value.
+     * scroll value. This layer contains no graphical content of its own,
+     * serving only to clip handle_fill to the current size of the handle.
      */
     guac_layer* handle;
 
+    /**
+     * The solid fill of the handle, drawn once at the largest height the
+     * handle may have and clipped by the handle layer. As the scrollback
+     * grows, the handle is thus resized and moved without being redrawn.
+     */
+    guac_layer* handle_fill;
+
     /**
      * The minimum scroll value.
      */
@@ -0,0 +1,195 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Standalone benchmark of SSH private key parsing. The same PEM-encoded key
+ * is parsed the given number of times, first bypassing the key cache (cold,
+ * as every connection did before keys were cached), then through
+ * guac_common_ssh_key_alloc() (cached). The key parser is included as source
+ * to reach its uncached parser.
+ *
+ * Build from this directory of a configured source tree:
+ *
+ *     gcc -std=gnu99 -O2 -Wall -I.. -I../../.. -I../../../libguac \
+ *         bench_ssh_key.c ../dsa-compat.c ../rsa-compat.c \
+ *         -L../../../libguac/.libs -lguac -lssh2 -lcrypto -lpthread \
+ *         -o bench_ssh_key
+ *
+ * Usage:
+ *
+ *     ./bench_ssh_key [ITERATIONS [KEY_FILE [PASSPHRASE]]]
+ *
+ * If no key file is given, a 2048-bit RSA key is generated and encoded in
+ * the traditional "BEGIN RSA PRIVATE KEY" format.
+ */
+
+#include "config.h"
+
+#include "key.c"
+
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The number of times the key is parsed in each pass if not specified.
+ */
+#define BENCH_DEFAULT_ITERATIONS 1000
+
+/**
+ * The maximum size of any key file read, in bytes.
+ */
+#define BENCH_MAX_KEY_SIZE 65536
+
+/**
+ * Returns the current value of the monotonic clock, in seconds.
+ */
+static double __bench_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Reads the key within the given file into the given buffer, returning its
+ * length, or a negative value if the file cannot be read.
+ */
+static int __bench_read_key(const char* path, char* buffer) {
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    int length = fread(buffer, 1, BENCH_MAX_KEY_SIZE, file);
+    fclose(file);
+    return length;
+
+}
+
+/**
+ * Generates a new 2048-bit RSA key, writing it in PEM format to the given
+ * buffer and returning its length, or a negative value if generation fails.
+ */
+static int __bench_generate_key(char* buffer) {
+
+    EVP_PKEY* pkey = NULL;
+    char* data;
+    int length = -1;
+
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    if (ctx == NULL || EVP_PKEY_keygen_init(ctx) != 1
+            || EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) != 1
+            || EVP_PKEY_keygen(ctx, &pkey) != 1) {
+        EVP_PKEY_CTX_free(ctx);
+        return -1;
+    }
+
+    BIO* bio = BIO_new(BIO_s_mem());
+    if (PEM_write_bio_PrivateKey_traditional(bio, pkey, NULL, NULL, 0,
+                NULL, NULL) == 1) {
+        length = BIO_get_mem_data(bio, &data);
+        if (length > BENCH_MAX_KEY_SIZE)
+            length = -1;
+        else
+            memcpy(buffer, data, length);
+    }
+
+    BIO_free(bio);
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_CTX_free(ctx);
+    return length;
+
+}
+
+/**
+ * Reports that the key could not be parsed, returning the exit status of
+ * the benchmark. Keys in OpenSSH format are only supported for Ed25519.
+ */
+static int __bench_parse_failed() {
+
+    const char* error = guac_common_ssh_key_error();
+    if (error == NULL)
+        error = "unsupported key type or format";
+
+    fprintf(stderr, "Unable to parse key: %s\n", error);
+    return EXIT_FAILURE;
+
+}
+
+int main(int argc, char** argv) {
+
+    static char data[BENCH_MAX_KEY_SIZE];
+
+    int iterations = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+    char* passphrase = argc > 3 ? argv[3] : "";
+    int length;
+    int i;
+
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [ITERATIONS [KEY_FILE [PASSPHRASE]]]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc > 2)
+        length = __bench_read_key(argv[2], data);
+    else
+        length = __bench_generate_key(data);
+
+    if (length <= 0) {
+        fprintf(stderr, "Unable to read or generate key.\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Cold: parse the key on every iteration */
+    double start = __bench_now();
+    for (i = 0; i < iterations; i++) {
+        guac_common_ssh_key* key = __guac_common_ssh_key_parse(data, length,
+                passphrase);
+        if (key == NULL)
+            return __bench_parse_failed();
+        guac_common_ssh_key_free(key);
+    }
+    double cold = (__bench_now() - start) / iterations;
+
+    /* Cached: parse the key once, then reuse the cached key */
+    start = __bench_now();
+    for (i = 0; i < iterations; i++) {
+        guac_common_ssh_key* key = guac_common_ssh_key_alloc(data, length,
+                passphrase);
+        if (key == NULL)
+            return __bench_parse_failed();
+        guac_common_ssh_key_free(key);
+    }
+    double cached = (__bench_now() - start) / iterations;
+
+    printf("iterations: %i\n", iterations);
+    printf("cold:       %10.2f us/key\n", cold * 1e6);
+    printf("cached:     %10.2f us/key\n", cached * 1e6);
+    printf("speedup:    %10.1fx\n", cold / cached);
+
+    return EXIT_SUCCESS;
+
+}
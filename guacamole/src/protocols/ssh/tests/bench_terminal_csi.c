@@ -0,0 +1,345 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Standalone benchmark of CSI parsing and SGR handling. The SGR sequences of
+ * a recorded terminal log are replayed through:
+ *
+ *     per-char   guac_terminal_csi(), one character at a time, with the SGR
+ *                cache cleared before each sequence (the path of every
+ *                sequence before sequences were parsed in one pass)
+ *
+ *     one-pass   guac_terminal_csi_sequence(), with the SGR cache cleared
+ *                before each sequence
+ *
+ *     cached     guac_terminal_csi_sequence(), with the SGR cache in effect
+ *
+ * The cost of clearing the cache is measured separately and subtracted from
+ * the uncached paths. Only SGR sequences are replayed, as other sequences
+ * require a full terminal and display. Costs are reported per byte of SGR
+ * sequence and per byte of the whole log. The handlers are included as
+ * source to reach the terminal structures they use.
+ *
+ * Build from this directory of a configured and built source tree:
+ *
+ *     gcc -std=gnu99 -O2 -Wall -I.. -I../../.. -I../../../common \
+ *         -I../../../libguac $(pkg-config --cflags pangocairo) \
+ *         bench_terminal_csi.c -L../.libs -lguac-client-ssh \
+ *         -L../../../libguac/.libs -lguac \
+ *         $(pkg-config --libs pangocairo) -o bench_terminal_csi
+ *
+ * Usage:
+ *
+ *     ./bench_terminal_csi [ROUNDS [LOG_FILE]]
+ *
+ * LOG_FILE may be any recording of terminal output, such as that written by
+ * "script". If no log is given, one is generated resembling the output of
+ * "ls --color" and of compiler diagnostics.
+ */
+
+#include "config.h"
+
+#include "terminal_handlers.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The number of times the log is replayed in each pass if not specified.
+ */
+#define BENCH_DEFAULT_ROUNDS 200
+
+/**
+ * The maximum size of any log read, in bytes.
+ */
+#define BENCH_MAX_LOG_SIZE (16 * 1024 * 1024)
+
+/**
+ * The number of measurements taken of each path, of which the fastest is
+ * reported.
+ */
+#define BENCH_SAMPLES 5
+
+/**
+ * The SGR sequences of the generated log, with the leading ESC and '['
+ * omitted. Each line of generated output uses several of these, in the
+ * proportions seen in colorized directory listings and compiler output.
+ */
+static const char* __bench_sgr_sequences[] = {
+    "0m", "01;34m", "0m", "01;32m", "0m", "01;36m", "0m", "40;33;01m",
+    "m", "01m", "m", "01;35m", "m", "01;31m", "m", "32m",
+    "38;5;208m", "0m", "38;2;255;128;0m", "48;5;236m", "0m", "1;4m",
+    "22;24m", "7m", "27m", "39;49m"
+};
+
+/**
+ * The recorded or generated log, and the offsets and lengths of each SGR
+ * sequence within it, excluding the leading ESC and '['.
+ */
+typedef struct bench_log {
+
+    /**
+     * The contents of the log.
+     */
+    char* data;
+
+    /**
+     * The length of the log, in bytes.
+     */
+    int length;
+
+    /**
+     * The offset of each SGR sequence, following its ESC and '['.
+     */
+    int* offsets;
+
+    /**
+     * The length of each SGR sequence, excluding its ESC and '['.
+     */
+    int* lengths;
+
+    /**
+     * The number of SGR sequences within the log.
+     */
+    int count;
+
+    /**
+     * The total length of all SGR sequences, including each ESC and '['.
+     */
+    int sgr_bytes;
+
+} bench_log;
+
+/**
+ * Returns the current value of the monotonic clock, in seconds.
+ */
+static double __bench_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Reads the log within the given file into the given buffer, returning its
+ * length, or a negative value if the file cannot be read.
+ */
+static int __bench_read_log(const char* path, char* buffer) {
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    int length = fread(buffer, 1, BENCH_MAX_LOG_SIZE, file);
+    fclose(file);
+    return length;
+
+}
+
+/**
+ * Generates a log of colorized output, writing it to the given buffer and
+ * returning its length.
+ */
+static int __bench_generate_log(char* buffer) {
+
+    int count = sizeof(__bench_sgr_sequences) / sizeof(char*);
+    int length = 0;
+    int i;
+
+    for (i = 0; i < 20000; i++) {
+        length += sprintf(buffer + length, "\x1B[%sentry-%i\x1B[%s  ",
+                __bench_sgr_sequences[i % count], i,
+                __bench_sgr_sequences[(i * 7 + 3) % count]);
+        if (i % 4 == 3)
+            length += sprintf(buffer + length, "\r\n");
+    }
+
+    return length;
+
+}
+
+/**
+ * Locates every complete SGR sequence within the given log. Sequences with
+ * any other final character are skipped.
+ */
+static void __bench_index_log(bench_log* log) {
+
+    int i;
+
+    log->offsets = malloc(log->length * sizeof(int));
+    log->lengths = malloc(log->length * sizeof(int));
+    log->count = 0;
+    log->sgr_bytes = 0;
+
+    for (i = 0; i + 1 < log->length; i++) {
+
+        if (log->data[i] != 0x1B || log->data[i + 1] != '[')
+            continue;
+
+        /* Find final character of sequence */
+        int start = i + 2;
+        int end = start;
+        while (end < log->length && !(log->data[end] >= 0x40
+                    && log->data[end] <= 0x7E))
+            end++;
+
+        if (end < log->length && log->data[end] == 'm') {
+            log->offsets[log->count] = start;
+            log->lengths[log->count] = end - start + 1;
+            log->sgr_bytes += end - start + 3;
+            log->count++;
+        }
+
+        i = end;
+
+    }
+
+}
+
+/**
+ * Replays every SGR sequence of the given log the given number of times,
+ * returning the time taken in seconds. Sequences are handled one character
+ * at a time if per_char is non-zero, and the SGR cache is cleared before
+ * each sequence if clear is non-zero. If replay is zero, only the cache is
+ * cleared.
+ */
+static double __bench_replay(guac_terminal* term, bench_log* log, int rounds,
+        int per_char, int clear, int replay) {
+
+    int round, i, j;
+    double start = __bench_now();
+
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < log->count; i++) {
+
+            const char* sequence = log->data + log->offsets[i];
+            int length = log->lengths[i];
+
+            if (clear)
+                guac_terminal_clear_sgr_cache(term);
+
+            if (!replay)
+                continue;
+
+            if (per_char) {
+                for (j = 0; j < length; j++)
+                    guac_terminal_csi(term, sequence[j]);
+            }
+
+            else if (guac_terminal_csi_sequence(term, sequence,
+                        length) != length) {
+                fprintf(stderr, "Sequence %i was not parsed in full.\n", i);
+                exit(EXIT_FAILURE);
+            }
+
+        }
+    }
+
+    return __bench_now() - start;
+
+}
+
+/**
+ * Measures __bench_replay() with the given arguments BENCH_SAMPLES times,
+ * returning the fastest time taken in seconds.
+ */
+static double __bench_measure(guac_terminal* term, bench_log* log,
+        int rounds, int per_char, int clear, int replay) {
+
+    double best = -1;
+    int sample;
+
+    for (sample = 0; sample < BENCH_SAMPLES; sample++) {
+        double elapsed = __bench_replay(term, log, rounds, per_char, clear,
+                replay);
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+
+}
+
+int main(int argc, char** argv) {
+
+    int rounds = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_ROUNDS;
+    bench_log log = { .data = malloc(BENCH_MAX_LOG_SIZE) };
+
+    if (rounds <= 0) {
+        fprintf(stderr, "Usage: %s [ROUNDS [LOG_FILE]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (argc > 2)
+        log.length = __bench_read_log(argv[2], log.data);
+    else
+        log.length = __bench_generate_log(log.data);
+
+    if (log.length <= 0) {
+        fprintf(stderr, "Unable to read or generate log.\n");
+        return EXIT_FAILURE;
+    }
+
+    __bench_index_log(&log);
+    if (log.count == 0) {
+        fprintf(stderr, "Log contains no SGR sequences.\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Terminal with just enough state for SGR sequences */
+    guac_terminal_display* display = calloc(1, sizeof(guac_terminal_display));
+    memcpy(display->palette, GUAC_TERMINAL_INITIAL_PALETTE,
+            sizeof(display->palette));
+
+    guac_terminal* term = calloc(1, sizeof(guac_terminal));
+    term->display = display;
+
+    /* Warm up all paths */
+    __bench_replay(term, &log, 1, 1, 1, 1);
+    __bench_replay(term, &log, 1, 0, 0, 1);
+
+    double clear = __bench_measure(term, &log, rounds, 0, 1, 0);
+    double per_char = __bench_measure(term, &log, rounds, 1, 1, 1) - clear;
+    double one_pass = __bench_measure(term, &log, rounds, 0, 1, 1) - clear;
+    double cached = __bench_measure(term, &log, rounds, 0, 0, 1);
+
+    double sgr_bytes = (double) log.sgr_bytes * rounds;
+    double log_bytes = (double) log.length * rounds;
+
+    printf("log:        %i bytes, %i SGR sequences (%i bytes)\n",
+            log.length, log.count, log.sgr_bytes);
+    printf("rounds:     %i\n", rounds);
+    printf("%-10s %10s %10s\n", "", "ns/SGR B", "ns/log B");
+    printf("%-10s %10.2f %10.2f\n", "per-char:",
+            per_char * 1e9 / sgr_bytes, per_char * 1e9 / log_bytes);
+    printf("%-10s %10.2f %10.2f\n", "one-pass:",
+            one_pass * 1e9 / sgr_bytes, one_pass * 1e9 / log_bytes);
+    printf("%-10s %10.2f %10.2f\n", "cached:",
+            cached * 1e9 / sgr_bytes, cached * 1e9 / log_bytes);
+    printf("speedup:    %10.1fx\n", per_char / cached);
+
+    free(term);
+    free(display);
+    free(log.offsets);
+    free(log.lengths);
+    free(log.data);
+    return EXIT_SUCCESS;
+
+}
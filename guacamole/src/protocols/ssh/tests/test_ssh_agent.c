@@ -0,0 +1,395 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Standalone test of the request framing and parsing of the SSH agent. Framed
+ * requests are fed directly to the buffer of an agent channel, and responses
+ * are captured in place of libssh2_channel_write(), such that no SSH server
+ * is needed. The agent is included as source to reach its static handlers.
+ *
+ * Build and run from this directory of a configured source tree:
+ *
+ *     gcc -std=gnu99 -Wall -DENABLE_SSH_AGENT -I.. -I../../.. \
+ *         -I../../../common -I../../../libguac \
+ *         $(pkg-config --cflags pangocairo) \
+ *         test_ssh_agent.c ../key.c ../dsa-compat.c ../rsa-compat.c \
+ *         -L../../../libguac/.libs -lguac -lssh2 -lcrypto -lpthread \
+ *         -o test_ssh_agent && ./test_ssh_agent
+ */
+
+#include "config.h"
+
+#include "key.h"
+#include "ssh_agent.c"
+
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Fails the test currently running, printing the given message and the line
+ * of the failed check.
+ */
+#define TEST_ASSERT(condition, message)                                     \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "%s:%i: %s\n", __func__, __LINE__, message);    \
+            exit(EXIT_FAILURE);                                             \
+        }                                                                   \
+    } while (0)
+
+/**
+ * A request for the list of identities held by the agent.
+ */
+#define TEST_IDENTITIES_REQUEST "\x00\x00\x00\x01\x0B"
+
+/**
+ * All data written to any agent channel since the last call to
+ * __test_reset().
+ */
+static char __test_output[SSH_AGENT_BUFFER_SIZE * 4];
+
+/**
+ * The number of bytes stored within __test_output.
+ */
+static int __test_output_length;
+
+/**
+ * The key generated for the agent, used to verify signatures.
+ */
+static EVP_PKEY* __test_pkey;
+
+/**
+ * Captures all data written to agent channels within __test_output, in
+ * place of the libssh2 function of the same name, through which
+ * libssh2_channel_write() writes.
+ */
+ssize_t libssh2_channel_write_ex(LIBSSH2_CHANNEL* channel, int stream_id,
+        const char* data, size_t length) {
+
+    if (__test_output_length + length > sizeof(__test_output))
+        return -1;
+
+    memcpy(__test_output + __test_output_length, data, length);
+    __test_output_length += length;
+    return length;
+
+}
+
+/**
+ * Discards all captured output, along with any data buffered within the
+ * given channel.
+ *
+ * @param agent_channel
+ *     The channel to reset.
+ */
+static void __test_reset(ssh_auth_agent_channel* agent_channel) {
+    __test_output_length = 0;
+    agent_channel->buffer_length = 0;
+}
+
+/**
+ * Appends the given data to the buffer of the given channel, as if read from
+ * the SSH session, and handles all complete requests within that buffer.
+ *
+ * @param auth_agent
+ *     The agent which owns the channel.
+ *
+ * @param agent_channel
+ *     The channel receiving the data.
+ *
+ * @param data
+ *     The data received.
+ *
+ * @param length
+ *     The number of bytes received.
+ *
+ * @return
+ *     The value returned by __ssh_auth_agent_process().
+ */
+static int __test_feed(ssh_auth_agent* auth_agent,
+        ssh_auth_agent_channel* agent_channel, const char* data, int length) {
+
+    memcpy(agent_channel->buffer + agent_channel->buffer_length, data, length);
+    agent_channel->buffer_length += length;
+    return __ssh_auth_agent_process(auth_agent, agent_channel);
+
+}
+
+/**
+ * Reads the 32-bit big-endian integer at the given location.
+ */
+static int __test_read_uint32(const char* data) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    return (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+}
+
+/**
+ * Writes a sign request for the given key blob and data to the given
+ * buffer, returning its length.
+ */
+static int __test_sign_request(char* buffer, const char* key_blob,
+        int key_blob_length, const char* data, int data_length) {
+
+    char* pos = buffer;
+
+    guac_common_ssh_buffer_write_uint32(&pos,
+            1 + 4 + key_blob_length + 4 + data_length + 4);
+    guac_common_ssh_buffer_write_byte(&pos, SSH2_AGENT_SIGN_REQUEST);
+    guac_common_ssh_buffer_write_string(&pos, key_blob, key_blob_length);
+    guac_common_ssh_buffer_write_string(&pos, data, data_length);
+    guac_common_ssh_buffer_write_uint32(&pos, 0);
+
+    return pos - buffer;
+
+}
+
+/**
+ * Generates a new RSA key, returning it as SSH key parsed from PEM.
+ */
+static guac_common_ssh_key* __test_generate_key() {
+
+    char* data;
+    long length;
+
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    TEST_ASSERT(ctx != NULL && EVP_PKEY_keygen_init(ctx) == 1
+            && EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) == 1
+            && EVP_PKEY_keygen(ctx, &__test_pkey) == 1,
+            "RSA key generation failed");
+    EVP_PKEY_CTX_free(ctx);
+
+    BIO* bio = BIO_new(BIO_s_mem());
+    TEST_ASSERT(PEM_write_bio_PrivateKey(bio, __test_pkey, NULL, NULL, 0,
+                NULL, NULL) == 1, "PEM encoding failed");
+
+    length = BIO_get_mem_data(bio, &data);
+    guac_common_ssh_key* key = guac_common_ssh_key_alloc(data, length, "");
+    BIO_free(bio);
+
+    TEST_ASSERT(key != NULL, "generated key could not be parsed");
+    return key;
+
+}
+
+/**
+ * Verifies that identity requests are answered, whether received whole, in
+ * pieces, or several at once.
+ */
+static void test_identities(ssh_auth_agent* auth_agent,
+        ssh_auth_agent_channel* agent_channel) {
+
+    const char* answer = auth_agent->identity.identities_answer;
+    int answer_length = auth_agent->identity.identities_answer_length;
+
+    /* Single complete request */
+    __test_reset(agent_channel);
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel,
+                TEST_IDENTITIES_REQUEST, 5) == 0, "request rejected");
+    TEST_ASSERT(__test_output_length == answer_length
+            && memcmp(__test_output, answer, answer_length) == 0,
+            "wrong identities answer");
+    TEST_ASSERT(agent_channel->buffer_length == 0, "request not consumed");
+
+    /* Request split within its length and within its contents */
+    __test_reset(agent_channel);
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel,
+                TEST_IDENTITIES_REQUEST, 3) == 0, "partial length rejected");
+    TEST_ASSERT(__test_output_length == 0 && agent_channel->buffer_length == 3,
+            "partial length not retained");
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel,
+                TEST_IDENTITIES_REQUEST + 3, 2) == 0, "remainder rejected");
+    TEST_ASSERT(__test_output_length == answer_length,
+            "split request not answered");
+    TEST_ASSERT(agent_channel->buffer_length == 0, "request not consumed");
+
+    /* Two complete requests followed by a partial request */
+    __test_reset(agent_channel);
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel,
+                TEST_IDENTITIES_REQUEST TEST_IDENTITIES_REQUEST
+                TEST_IDENTITIES_REQUEST, 14) == 0, "requests rejected");
+    TEST_ASSERT(__test_output_length == answer_length * 2,
+            "each complete request must be answered once");
+    TEST_ASSERT(agent_channel->buffer_length == 4
+            && memcmp(agent_channel->buffer, TEST_IDENTITIES_REQUEST, 4) == 0,
+            "partial request not shifted to start of buffer");
+
+}
+
+/**
+ * Verifies that sign requests are answered with a valid signature only for
+ * the key of the agent.
+ */
+static void test_sign(ssh_auth_agent* auth_agent,
+        ssh_auth_agent_channel* agent_channel) {
+
+    guac_common_ssh_key* key = auth_agent->identity.key;
+    const char data[] = "session identifier and userauth request";
+    char request[SSH_AGENT_BUFFER_SIZE];
+    int length;
+
+    char* pos;
+    char* end;
+    char* blob;
+    char* name;
+    char* sig;
+    int blob_length, name_length, sig_length;
+
+    /* Sign with own key */
+    __test_reset(agent_channel);
+    length = __test_sign_request(request, key->public_key,
+            key->public_key_length, data, sizeof(data));
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel, request, length) == 0,
+            "sign request rejected");
+
+    pos = __test_output;
+    end = __test_output + __test_output_length;
+    TEST_ASSERT(__test_output_length > 5
+            && __test_read_uint32(pos) == __test_output_length - 4,
+            "wrong response length");
+    TEST_ASSERT(pos[4] == SSH2_AGENT_SIGN_RESPONSE, "wrong response type");
+    pos += 5;
+
+    blob = guac_common_ssh_buffer_read_bounded_string(&pos, end, &blob_length);
+    TEST_ASSERT(blob != NULL && blob + blob_length == end,
+            "malformed signature blob");
+
+    pos = blob;
+    name = guac_common_ssh_buffer_read_bounded_string(&pos, end, &name_length);
+    sig = guac_common_ssh_buffer_read_bounded_string(&pos, end, &sig_length);
+    TEST_ASSERT(name != NULL && name_length == 7
+            && memcmp(name, "ssh-rsa", 7) == 0, "wrong signature type");
+    TEST_ASSERT(sig != NULL && pos == end, "malformed signature");
+
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    TEST_ASSERT(EVP_DigestVerifyInit(ctx, NULL, EVP_sha1(), NULL,
+                __test_pkey) == 1
+            && EVP_DigestVerify(ctx, (unsigned char*) sig, sig_length,
+                (const unsigned char*) data, sizeof(data)) == 1,
+            "signature does not verify");
+    EVP_MD_CTX_free(ctx);
+
+    /* Refuse any other key */
+    __test_reset(agent_channel);
+    length = __test_sign_request(request, "other key", 9, data, sizeof(data));
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel, request, length) == 0,
+            "sign request for other key rejected");
+    TEST_ASSERT(__test_output_length == sizeof(SSH_AGENT_FAILURE_PACKET)-1
+            && memcmp(__test_output, SSH_AGENT_FAILURE_PACKET,
+                __test_output_length) == 0, "other key not refused");
+
+}
+
+/**
+ * Verifies that malformed and unsupported requests are refused, and that
+ * no string is read beyond the end of its request.
+ */
+static void test_invalid(ssh_auth_agent* auth_agent,
+        ssh_auth_agent_channel* agent_channel) {
+
+    guac_common_ssh_key* key = auth_agent->identity.key;
+    char request[SSH_AGENT_BUFFER_SIZE];
+    char* pos;
+    int length;
+
+    /* Unsupported request type */
+    __test_reset(agent_channel);
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel,
+                "\x00\x00\x00\x01\x1B", 5) == 0, "unsupported type rejected");
+    TEST_ASSERT(__test_output_length == sizeof(SSH_AGENT_FAILURE_PACKET)-1
+            && memcmp(__test_output, SSH_AGENT_FAILURE_PACKET,
+                __test_output_length) == 0, "unsupported type not refused");
+
+    /* Empty request */
+    __test_reset(agent_channel);
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel,
+                "\x00\x00\x00\x00\x0B", 5) != 0, "empty request accepted");
+
+    /* Requests which can never fit within the buffer */
+    __test_reset(agent_channel);
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel,
+                "\xFF\xFF\xFF\xFF\x0B", 5) != 0, "oversized request accepted");
+
+    __test_reset(agent_channel);
+    pos = request;
+    guac_common_ssh_buffer_write_uint32(&pos, SSH_AGENT_BUFFER_SIZE - 3);
+    guac_common_ssh_buffer_write_byte(&pos, SSH2_AGENT_SIGN_REQUEST);
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel, request, 5) != 0,
+            "request larger than buffer accepted");
+
+    /* The largest request which fits must be awaited */
+    __test_reset(agent_channel);
+    pos = request;
+    guac_common_ssh_buffer_write_uint32(&pos, SSH_AGENT_BUFFER_SIZE - 4);
+    guac_common_ssh_buffer_write_byte(&pos, SSH2_AGENT_SIGN_REQUEST);
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel, request, 5) == 0
+            && __test_output_length == 0, "largest request not awaited");
+
+    /* Sign request whose data string extends past the end of the request
+     * and into the request which follows */
+    __test_reset(agent_channel);
+    length = __test_sign_request(request, key->public_key,
+            key->public_key_length, "data", 4);
+    pos = request + 4 + 1 + 4 + key->public_key_length;
+    guac_common_ssh_buffer_write_uint32(&pos, 4 + 5);
+    memcpy(request + length, TEST_IDENTITIES_REQUEST, 5);
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel, request,
+                length + 5) != 0, "unbounded sign request accepted");
+    TEST_ASSERT(__test_output_length == 0, "unbounded sign request answered");
+
+    /* Sign request truncated within the key blob */
+    __test_reset(agent_channel);
+    pos = request;
+    guac_common_ssh_buffer_write_uint32(&pos, 1 + 4 + 2);
+    guac_common_ssh_buffer_write_byte(&pos, SSH2_AGENT_SIGN_REQUEST);
+    guac_common_ssh_buffer_write_uint32(&pos, 64);
+    guac_common_ssh_buffer_write_byte(&pos, 0);
+    guac_common_ssh_buffer_write_byte(&pos, 0);
+    TEST_ASSERT(__test_feed(auth_agent, agent_channel, request,
+                pos - request) != 0, "truncated sign request accepted");
+
+}
+
+int main() {
+
+    pthread_mutex_t session_lock = PTHREAD_MUTEX_INITIALIZER;
+    ssh_auth_agent_channel agent_channel = { 0 };
+
+    guac_common_ssh_key* key = __test_generate_key();
+    ssh_auth_agent* auth_agent = ssh_auth_agent_alloc(NULL, NULL, -1,
+            &session_lock, key);
+    TEST_ASSERT(auth_agent != NULL, "agent allocation failed");
+
+    test_identities(auth_agent, &agent_channel);
+    test_sign(auth_agent, &agent_channel);
+    test_invalid(auth_agent, &agent_channel);
+
+    ssh_auth_agent_free(auth_agent);
+    guac_common_ssh_key_free(key);
+    EVP_PKEY_free(__test_pkey);
+
+    printf("All SSH agent tests passed.\n");
+    return EXIT_SUCCESS;
+
+}
@@ -86,6 +86,7 @@ int guac_ssh_user_join_handler(guac_user* user, int argc, char** argv) {
 
         /* General mouse/keyboard/clipboard events */
         user->key_handler       = guac_ssh_user_key_handler;
+        user->text_handler      = guac_ssh_user_text_handler;
         user->mouse_handler     = guac_ssh_user_mouse_handler;
         user->clipboard_handler = guac_ssh_clipboard_handler;
 
@@ -31,9 +31,11 @@
 #include <guacamole/layer.h>
 #include <guacamole/client.h>
 #include <guacamole/stream.h>
+#include <guacamole/profile.h>
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
 #include <guacamole/timestamp.h>
+#include <guacamole/trace.h>
 #include <rfb/rfbclient.h>
 #include <rfb/rfbproto.h>
 #include <stdbool.h>
@@ -1217,6 +1219,9 @@ void* guac_vnc_client_thread(void* data) {
     guac_vnc_client* vnc_client = (guac_vnc_client*) client->data;
     guac_vnc_settings* settings = vnc_client->settings;
 
+    /* Allow this thread to be sampled by the native profiler */
+    guac_profile_register_thread(client);
+
     /* Configure clipboard encoding */
     if (guac_vnc_set_clipboard_encoding(client, settings->clipboard_encoding)) {
         guac_client_log(client, GUAC_LOG_INFO, "Using non-standard VNC "
@@ -1283,6 +1288,8 @@ void* guac_vnc_client_thread(void* data) {
             int processing_lag = guac_client_get_processing_lag(client);
             guac_timestamp frame_start = guac_timestamp_current();
 
+            guac_trace_event(client, GUAC_TRACE_BEGIN, "receive", frame_start);
+
             /* Read server messages until frame is built */
             do {
 
@@ -1320,6 +1327,8 @@ void* guac_vnc_client_thread(void* data) {
 
             } while (wait_result > 0);
 
+            guac_trace_event(client, GUAC_TRACE_END, "receive", frame_start);
+
             /* Record end of frame, excluding server-side rendering time (we
              * assume server-side rendering time will be consistent between any
              * two subsequent frames, and that this time should thus be
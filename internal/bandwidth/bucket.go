@@ -0,0 +1,132 @@
+// Copyright 2019 Changkun Ou. All rights reserved.
+// Use of this source code is governed by a MIT
+// license that can be found in the LICENSE file.
+
+// Package bandwidth limits the rate at which output is sent using token
+// buckets.
+package bandwidth
+
+import (
+	"sync"
+	"time"
+)
+
+// Bucket is a token bucket holding one token per byte. Tokens accumulate at
+// a fixed rate up to the size of the burst. Sending more bytes than there
+// are tokens puts the bucket into debt, which must be repaid by waiting
+// before sending further, such that messages larger than the burst are
+// still permitted. A nil Bucket imposes no limit.
+type Bucket struct {
+	mu     sync.Mutex
+	rate   float64 // tokens per second
+	burst  float64
+	tokens float64
+	last   time.Time
+}
+
+// NewBucket returns a full bucket allowing the given number of bytes per
+// second, of which up to burst bytes may be sent at once. A burst of zero
+// or less allows one second of output at once. NewBucket returns nil if the
+// rate is zero or less, disabling the limit.
+func NewBucket(rate, burst int64) *Bucket {
+	if rate <= 0 {
+		return nil
+	}
+	if burst <= 0 {
+		burst = rate
+	}
+	return &Bucket{
+		rate:   float64(rate),
+		burst:  float64(burst),
+		tokens: float64(burst),
+	}
+}
+
+// Reserve takes n tokens from the bucket at the given time and returns how
+// long the caller must wait before sending the n bytes to stay within the
+// limit. Times passed to Reserve should not decrease.
+func (b *Bucket) Reserve(n int, now time.Time) time.Duration {
+	if b == nil {
+		return 0
+	}
+
+	b.mu.Lock()
+	defer b.mu.Unlock()
+
+	if !b.last.IsZero() && now.After(b.last) {
+		b.tokens += now.Sub(b.last).Seconds() * b.rate
+		if b.tokens > b.burst {
+			b.tokens = b.burst
+		}
+	}
+	if b.last.IsZero() || now.After(b.last) {
+		b.last = now
+	}
+
+	b.tokens -= float64(n)
+	if b.tokens >= 0 {
+		return 0
+	}
+	return time.Duration(-b.tokens / b.rate * float64(time.Second))
+}
+
+// Registry shares buckets between all holders of the same key, such that a
+// single limit applies to all of them together. Buckets are freed once the
+// last holder releases them.
+type Registry struct {
+	rate  int64
+	burst int64
+
+	mu      sync.Mutex
+	buckets map[string]*entry
+}
+
+type entry struct {
+	bucket *Bucket
+	refs   int
+}
+
+// NewRegistry returns a registry whose buckets allow the given number of
+// bytes per second and burst, as accepted by NewBucket.
+func NewRegistry(rate, burst int64) *Registry {
+	return &Registry{
+		rate:    rate,
+		burst:   burst,
+		buckets: map[string]*entry{},
+	}
+}
+
+// Acquire returns the bucket of the given key, creating it if no other
+// holder exists. Each call must be paired with a call to Release. Acquire
+// returns nil if the registry imposes no limit.
+func (r *Registry) Acquire(key string) *Bucket {
+	if r.rate <= 0 {
+		return nil
+	}
+
+	r.mu.Lock()
+	defer r.mu.Unlock()
+
+	e, ok := r.buckets[key]
+	if !ok {
+		e = &entry{bucket: NewBucket(r.rate, r.burst)}
+		r.buckets[key] = e
+	}
+	e.refs++
+	return e.bucket
+}
+
+// Release releases a bucket previously acquired with the given key.
+func (r *Registry) Release(key string) {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+
+	e, ok := r.buckets[key]
+	if !ok {
+		return
+	}
+	e.refs--
+	if e.refs <= 0 {
+		delete(r.buckets, key)
+	}
+}
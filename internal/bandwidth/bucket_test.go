@@ -0,0 +1,161 @@
+// Copyright 2019 Changkun Ou. All rights reserved.
+// Use of this source code is governed by a MIT
+// license that can be found in the LICENSE file.
+
+package bandwidth_test
+
+import (
+	"math"
+	"testing"
+	"time"
+
+	"changkun.de/x/occamy/internal/bandwidth"
+)
+
+// send simulates a writer which sleeps for as long as its buckets require
+// before each message, for at least the given duration of virtual time. It
+// returns the number of bytes sent and the virtual time taken.
+func send(d time.Duration, size int, buckets ...*bandwidth.Bucket) (int64, time.Duration) {
+	start := time.Unix(0, 0)
+	now := start
+	var sent int64
+	for now.Sub(start) < d {
+		var wait time.Duration
+		for _, b := range buckets {
+			if w := b.Reserve(size, now); w > wait {
+				wait = w
+			}
+		}
+		now = now.Add(wait)
+		sent += int64(size)
+	}
+	return sent, now.Sub(start)
+}
+
+func TestBucket_Throughput(t *testing.T) {
+	const (
+		rate  = 1 << 20
+		burst = 64 << 10
+		d     = 10 * time.Second
+	)
+	for _, size := range []int{100, 8 << 10, 256 << 10} {
+		sent, elapsed := send(d, size, bandwidth.NewBucket(rate, burst))
+		got := float64(sent-burst) / elapsed.Seconds()
+		if math.Abs(got-rate)/rate > 0.01 {
+			t.Fatalf("size %d: achieved %.0f B/s, want %d B/s", size, got, rate)
+		}
+	}
+}
+
+func TestBucket_Burst(t *testing.T) {
+	b := bandwidth.NewBucket(1000, 500)
+	now := time.Unix(0, 0)
+	if w := b.Reserve(500, now); w != 0 {
+		t.Fatalf("burst must be sent at once, got wait %v", w)
+	}
+	if w := b.Reserve(100, now); w != 100*time.Millisecond {
+		t.Fatalf("wrong wait beyond burst, got %v", w)
+	}
+
+	// idle time must not accumulate more than the burst
+	now = now.Add(time.Hour)
+	if w := b.Reserve(500, now); w != 0 {
+		t.Fatalf("burst must be refilled after idle, got wait %v", w)
+	}
+	if w := b.Reserve(1, now); w == 0 {
+		t.Fatal("tokens accumulated beyond burst")
+	}
+}
+
+func TestBucket_Disabled(t *testing.T) {
+	b := bandwidth.NewBucket(0, 0)
+	if b != nil {
+		t.Fatal("zero rate must disable the bucket")
+	}
+	if w := b.Reserve(1<<30, time.Now()); w != 0 {
+		t.Fatalf("nil bucket must not wait, got %v", w)
+	}
+}
+
+func TestRegistry(t *testing.T) {
+	r := bandwidth.NewRegistry(1000, 0)
+	a := r.Acquire("tenant")
+	b := r.Acquire("tenant")
+	if a == nil || a != b {
+		t.Fatal("holders of the same key must share a bucket")
+	}
+	if c := r.Acquire("other"); c == a {
+		t.Fatal("different keys must not share a bucket")
+	}
+	r.Release("tenant")
+	r.Release("tenant")
+	if c := r.Acquire("tenant"); c == a {
+		t.Fatal("released bucket must be freed")
+	}
+
+	if bandwidth.NewRegistry(0, 0).Acquire("tenant") != nil {
+		t.Fatal("zero rate must disable the registry")
+	}
+}
+
+// BenchmarkBucket_Throughput simulates several sessions of one tenant
+// writing as fast as their limits allow, reporting the sustained throughput
+// achieved by each session and by the tenant as a whole. The initial burst
+// of the tenant is excluded, as it is sent without waiting.
+func BenchmarkBucket_Throughput(b *testing.B) {
+	const (
+		sessions    = 4
+		sessionRate = 4 << 20
+		tenantRate  = 8 << 20
+		tenantBurst = 1 << 20
+		size        = 16 << 10
+		d           = 10 * time.Second
+	)
+	for i := 0; i < b.N; i++ {
+		r := bandwidth.NewRegistry(tenantRate, tenantBurst)
+		buckets := make([]*bandwidth.Bucket, sessions)
+		for j := range buckets {
+			buckets[j] = bandwidth.NewBucket(sessionRate, 0)
+		}
+
+		// interleave sessions in virtual time
+		start := time.Unix(0, 0)
+		next := make([]time.Time, sessions)
+		for j := range next {
+			next[j] = start
+		}
+		tenant := r.Acquire("tenant")
+		var sent int64
+		for {
+			j := 0
+			for k := range next {
+				if next[k].Before(next[j]) {
+					j = k
+				}
+			}
+			if next[j].Sub(start) >= d {
+				break
+			}
+			wait := buckets[j].Reserve(size, next[j])
+			if w := tenant.Reserve(size, next[j]); w > wait {
+				wait = w
+			}
+			next[j] = next[j].Add(wait)
+			sent += size
+		}
+		r.Release("tenant")
+
+		rate := float64(sent-tenantBurst) / d.Seconds() / (1 << 20)
+		b.ReportMetric(rate, "tenant-MB/s")
+		b.ReportMetric(rate/sessions, "session-MB/s")
+	}
+}
+
+func BenchmarkBucket_Reserve(b *testing.B) {
+	bucket := bandwidth.NewBucket(1<<40, 0)
+	b.RunParallel(func(pb *testing.PB) {
+		for pb.Next() {
+			bucket.Reserve(1024, time.Now())
+		}
+	})
+}
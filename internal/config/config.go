@@ -39,7 +39,14 @@ type config struct {
 		JWTSecret    string `yaml:"jwt_secret"`
 		JWTAlgorithm string `yaml:"jwt_alg"`
 	} `yaml:"auth"`
-	Client bool `yaml:"client"`
+	Client    bool `yaml:"client"`
+	Trace     int  `yaml:"trace"`
+	Profile   bool `yaml:"profile"`
+	Bandwidth struct {
+		Session int64 `yaml:"session"`
+		Tenant  int64 `yaml:"tenant"`
+		Burst   int64 `yaml:"burst"`
+	} `yaml:"bandwidth"`
 }
 
 // Runtime configurations
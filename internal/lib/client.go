@@ -7,26 +7,11 @@ package lib
 /*
 #cgo LDFLAGS: -L/usr/local/lib -lguac
 
-#include <stdio.h>
 #include <stdlib.h>
-#include <syslog.h>
 
 #include "../../guacamole/src/libguac/guacamole/client.h"
 
-int max_log_level;
-
-void occamy_client_log(guac_client* client, guac_client_log_level level, const char* format, va_list args) {
-    int priority;
-    char message[2048];
-    if (level > max_log_level) return;
-    vsnprintf(message, sizeof(message), format, args);
-    syslog(priority, "%s", message);
-    fprintf(stderr, "occamy-lib[%li]: %s\n", (unsigned long int)pthread_self(), message);
-}
-void init_client_log(guac_client* client, int level) {
-	client->log_handler = occamy_client_log;
-	max_log_level = level;
-}
+void init_client_log(guac_client* client, int level);
 */
 import "C"
 import (
@@ -0,0 +1,363 @@
+// Copyright 2019 Changkun Ou. All rights reserved.
+// Use of this source code is governed by a MIT
+// license that can be found in the LICENSE file.
+
+package lib
+
+/*
+#cgo LDFLAGS: -L/usr/local/lib -lguac -lpthread
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "../../guacamole/src/libguac/guacamole/client.h"
+#include "../../guacamole/src/libguac/guacamole/user.h"
+
+// Number of entries within the log ring of each thread. Must be a power of two.
+#define OCCAMY_LOG_RING_SIZE 64
+
+// Maximum length of each logged message, including null terminator.
+#define OCCAMY_LOG_MESSAGE_LENGTH 1024
+
+// Maximum length of session and user identifiers, including null terminator.
+#define OCCAMY_LOG_ID_LENGTH 64
+
+// Number of slots in the call site table. Must be a power of two.
+#define OCCAMY_LOG_SITES 1024
+
+// Length of each rate limiting window, in milliseconds.
+#define OCCAMY_LOG_WINDOW 1000
+
+// Number of messages from a single call site logged in full per window.
+#define OCCAMY_LOG_SITE_BURST 20
+
+// Maximum number of bytes of a leading string argument included within the
+// key of a call site.
+#define OCCAMY_LOG_SITE_ARG_LENGTH 64
+
+// Once the burst is exhausted, only one of every this many messages from the
+// same call site is logged for the remainder of the window.
+#define OCCAMY_LOG_SITE_SAMPLE 100
+
+// Interval between passes of the drainer over all log rings, in milliseconds.
+#define OCCAMY_LOG_DRAIN_INTERVAL 50
+
+typedef struct occamy_log_entry {
+	struct timespec time;
+	int level;
+	unsigned long thread;
+	int suppressed;
+	char session[OCCAMY_LOG_ID_LENGTH];
+	char user[OCCAMY_LOG_ID_LENGTH];
+	char message[OCCAMY_LOG_MESSAGE_LENGTH];
+} occamy_log_entry;
+
+// Single-producer, single-consumer ring of log entries. Entries are produced
+// only by the owning thread and consumed only by the drainer.
+typedef struct occamy_log_ring {
+	atomic_uint head;
+	atomic_uint tail;
+	atomic_uint dropped;
+	atomic_int orphaned;
+	unsigned long thread;
+	struct occamy_log_ring* next;
+	occamy_log_entry entries[OCCAMY_LOG_RING_SIZE];
+} occamy_log_ring;
+
+// Rate limiting state of all messages sharing the same call site key. Keys
+// hashing to the same slot share a single budget.
+typedef struct occamy_log_site {
+	atomic_long window;
+	atomic_int count;
+	atomic_int suppressed;
+} occamy_log_site;
+
+int max_log_level;
+
+static occamy_log_site occamy_log_sites[OCCAMY_LOG_SITES];
+static occamy_log_ring* occamy_log_rings = NULL;
+static pthread_mutex_t occamy_log_rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t occamy_log_ring_key;
+static pthread_once_t occamy_log_once = PTHREAD_ONCE_INIT;
+static __thread occamy_log_ring* occamy_log_thread_ring = NULL;
+
+static const char* occamy_log_level_name(int level) {
+	switch (level) {
+	case GUAC_LOG_ERROR:   return "error";
+	case GUAC_LOG_WARNING: return "warning";
+	case GUAC_LOG_INFO:    return "info";
+	case GUAC_LOG_DEBUG:   return "debug";
+	default:               return "trace";
+	}
+}
+
+// Appends the given string to the given buffer as a JSON string literal,
+// returning the number of bytes written. At most length bytes are written.
+static int occamy_log_json_string(char* buffer, int length, const char* str) {
+	int written = 0;
+	if (length < 2)
+		return 0;
+	buffer[written++] = '"';
+	for (; *str != '\0' && written < length - 7; str++) {
+		unsigned char c = (unsigned char) *str;
+		if (c == '"' || c == '\\') {
+			buffer[written++] = '\\';
+			buffer[written++] = c;
+		} else if (c < 0x20)
+			written += snprintf(buffer + written, length - written, "\\u%04x", c);
+		else
+			buffer[written++] = c;
+	}
+	buffer[written++] = '"';
+	return written;
+}
+
+// Writes the given entry to syslog and, as a single line of JSON, to stderr.
+static void occamy_log_write(const occamy_log_entry* entry) {
+	char line[OCCAMY_LOG_MESSAGE_LENGTH * 2 + OCCAMY_LOG_ID_LENGTH * 4 + 256];
+	int length = sizeof(line) - 2;
+	int written;
+	struct tm utc;
+
+	int priority = entry->level > LOG_DEBUG ? LOG_DEBUG : entry->level;
+	syslog(priority, "%s", entry->message);
+
+	gmtime_r(&entry->time.tv_sec, &utc);
+	written = snprintf(line, length,
+		"{\"time\":\"%04d-%02d-%02dT%02d:%02d:%02d.%06ldZ\",\"level\":\"%s\",\"thread\":%lu,\"session\":",
+		utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour,
+		utc.tm_min, utc.tm_sec, entry->time.tv_nsec / 1000,
+		occamy_log_level_name(entry->level), entry->thread);
+	written += occamy_log_json_string(line + written, length - written, entry->session);
+	if (entry->user[0] != '\0') {
+		written += snprintf(line + written, length - written, ",\"user\":");
+		written += occamy_log_json_string(line + written, length - written, entry->user);
+	}
+	written += snprintf(line + written, length - written, ",\"message\":");
+	written += occamy_log_json_string(line + written, length - written - 64, entry->message);
+	if (entry->suppressed > 0)
+		written += snprintf(line + written, length - written,
+			",\"suppressed\":%d", entry->suppressed);
+	line[written++] = '}';
+	line[written++] = '\n';
+	fwrite(line, 1, written, stderr);
+}
+
+// Writes all pending entries of the given ring, returning non-zero if the
+// ring is empty and will never receive further entries.
+static int occamy_log_drain_ring(occamy_log_ring* ring) {
+	unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	unsigned int dropped;
+	int orphaned = atomic_load_explicit(&ring->orphaned, memory_order_acquire);
+
+	for (; tail != head; tail++)
+		occamy_log_write(&ring->entries[tail & (OCCAMY_LOG_RING_SIZE - 1)]);
+	atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+	dropped = atomic_exchange(&ring->dropped, 0);
+	if (dropped > 0)
+		fprintf(stderr, "{\"level\":\"warning\",\"thread\":%lu,"
+			"\"message\":\"log ring full\",\"dropped\":%u}\n",
+			ring->thread, dropped);
+
+	return orphaned && tail == atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+// Repeatedly drains the log rings of all threads, freeing the rings of
+// threads which have exited. The list of rings is detached while its rings
+// are drained, such that threads registering new rings never wait for
+// syslog or stderr. Rings are only ever removed by the drainer.
+static void* occamy_log_drainer(void* data) {
+	struct timespec interval = {
+		.tv_sec = 0,
+		.tv_nsec = OCCAMY_LOG_DRAIN_INTERVAL * 1000000L
+	};
+
+	for (;;) {
+		pthread_mutex_lock(&occamy_log_rings_lock);
+		occamy_log_ring* rings = occamy_log_rings;
+		occamy_log_rings = NULL;
+		pthread_mutex_unlock(&occamy_log_rings_lock);
+
+		occamy_log_ring** current = &rings;
+		while (*current != NULL) {
+			occamy_log_ring* ring = *current;
+			if (occamy_log_drain_ring(ring)) {
+				*current = ring->next;
+				free(ring);
+			} else
+				current = &ring->next;
+		}
+		fflush(stderr);
+
+		// Return remaining rings behind any registered meanwhile
+		pthread_mutex_lock(&occamy_log_rings_lock);
+		*current = occamy_log_rings;
+		occamy_log_rings = rings;
+		pthread_mutex_unlock(&occamy_log_rings_lock);
+
+		nanosleep(&interval, NULL);
+	}
+	return NULL;
+}
+
+// Marks the ring of an exiting thread as orphaned, such that the drainer
+// frees it once all of its entries have been written.
+static void occamy_log_release_ring(void* data) {
+	occamy_log_ring* ring = (occamy_log_ring*) data;
+	atomic_store_explicit(&ring->orphaned, 1, memory_order_release);
+}
+
+static void occamy_log_start(void) {
+	pthread_t drainer;
+	pthread_key_create(&occamy_log_ring_key, occamy_log_release_ring);
+	if (pthread_create(&drainer, NULL, occamy_log_drainer, NULL) == 0)
+		pthread_detach(drainer);
+}
+
+// Returns the log ring of the current thread, allocating and registering it
+// with the drainer if necessary.
+static occamy_log_ring* occamy_log_get_ring(void) {
+	occamy_log_ring* ring = occamy_log_thread_ring;
+	if (ring != NULL)
+		return ring;
+
+	ring = calloc(1, sizeof(occamy_log_ring));
+	if (ring == NULL)
+		return NULL;
+	ring->thread = (unsigned long) pthread_self();
+	pthread_setspecific(occamy_log_ring_key, ring);
+
+	pthread_mutex_lock(&occamy_log_rings_lock);
+	ring->next = occamy_log_rings;
+	occamy_log_rings = ring;
+	pthread_mutex_unlock(&occamy_log_rings_lock);
+
+	occamy_log_thread_ring = ring;
+	return ring;
+}
+
+// Returns the key identifying the call site of a message having the given
+// format string and arguments. Call sites are identified by their format
+// string. If the first conversion of the format string is a plain "%s", the
+// start of its argument is included, such that call sites passing their
+// message through a common format such as "%s" do not share a budget.
+static uintptr_t occamy_log_site_key(const char* format, va_list args) {
+	uintptr_t hash = ((uintptr_t) format >> 3) * 2654435761u;
+	const char* c = format;
+	const char* arg;
+	va_list copy;
+	int i;
+
+	// Find first conversion, skipping escaped percent signs
+	while ((c = strchr(c, '%')) != NULL && c[1] == '%')
+		c += 2;
+	if (c == NULL || c[1] != 's')
+		return hash;
+
+	va_copy(copy, args);
+	arg = va_arg(copy, const char*);
+	va_end(copy);
+
+	// FNV-1a over the start of the argument
+	for (i = 0; arg != NULL && arg[i] != '\0' && i < OCCAMY_LOG_SITE_ARG_LENGTH; i++)
+		hash = (hash ^ (unsigned char) arg[i]) * 16777619u;
+	return hash;
+}
+
+// Applies rate limiting to messages sharing the given call site key.
+// Returns -1 if the message should be suppressed, or the number of messages
+// suppressed since the last message which was logged.
+static int occamy_log_admit(int level, uintptr_t key, const struct timespec* now) {
+	uintptr_t hash = key ^ (key >> 16);
+	occamy_log_site* site = &occamy_log_sites[hash & (OCCAMY_LOG_SITES - 1)];
+	long window = (now->tv_sec * 1000 + now->tv_nsec / 1000000) / OCCAMY_LOG_WINDOW;
+	int count;
+
+	// Errors, warnings and informational messages are never suppressed
+	if (level <= GUAC_LOG_INFO)
+		return atomic_exchange(&site->suppressed, 0);
+
+	// Start new window if the current window has elapsed
+	if (atomic_load_explicit(&site->window, memory_order_relaxed) != window) {
+		atomic_store_explicit(&site->window, window, memory_order_relaxed);
+		atomic_store_explicit(&site->count, 0, memory_order_relaxed);
+	}
+
+	count = atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) + 1;
+	if (count <= OCCAMY_LOG_SITE_BURST || count % OCCAMY_LOG_SITE_SAMPLE == 0)
+		return atomic_exchange(&site->suppressed, 0);
+
+	atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+	return -1;
+}
+
+// Formats the given message into the log ring of the current thread. The
+// message is written by the drainer, never by the calling thread.
+static void occamy_log(guac_client* client, guac_user* user, int level,
+	const char* format, va_list args) {
+	struct timespec now;
+	occamy_log_ring* ring;
+	occamy_log_entry* entry;
+	unsigned int head;
+	int suppressed;
+
+	if (level > max_log_level)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	suppressed = occamy_log_admit(level, occamy_log_site_key(format, args), &now);
+	if (suppressed < 0)
+		return;
+
+	ring = occamy_log_get_ring();
+	if (ring == NULL)
+		return;
+
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= OCCAMY_LOG_RING_SIZE) {
+		atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	entry = &ring->entries[head & (OCCAMY_LOG_RING_SIZE - 1)];
+	entry->time = now;
+	entry->level = level;
+	entry->thread = ring->thread;
+	entry->suppressed = suppressed;
+	snprintf(entry->session, sizeof(entry->session), "%s",
+		client != NULL && client->connection_id != NULL ? client->connection_id : "");
+	snprintf(entry->user, sizeof(entry->user), "%s",
+		user != NULL && user->user_id != NULL ? user->user_id : "");
+	vsnprintf(entry->message, sizeof(entry->message), format, args);
+
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void occamy_client_log(guac_client* client, guac_client_log_level level, const char* format, va_list args) {
+	occamy_log(client, NULL, level, format, args);
+}
+
+void occamy_user_log(guac_user* user, guac_client_log_level level, const char* format, va_list args) {
+	occamy_log(user->client, user, level, format, args);
+}
+
+void init_client_log(guac_client* client, int level) {
+	pthread_once(&occamy_log_once, occamy_log_start);
+	client->log_handler = occamy_client_log;
+	max_log_level = level;
+}
+
+void init_user_log(guac_user* user) {
+	user->log_handler = occamy_user_log;
+}
+*/
+import "C"
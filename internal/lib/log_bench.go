@@ -0,0 +1,28 @@
+// Copyright 2019 Changkun Ou. All rights reserved.
+// Use of this source code is governed by a MIT
+// license that can be found in the LICENSE file.
+
+package lib
+
+/*
+#cgo LDFLAGS: -L/usr/local/lib -lguac
+
+#include <stdlib.h>
+
+#include "../../guacamole/src/libguac/guacamole/client.h"
+
+static void client_log_string(guac_client* client, int level, const char* message) {
+	guac_client_log(client, level, "%s", message);
+}
+*/
+import "C"
+import "unsafe"
+
+// logMessage writes the given message to the log pipeline of the client at
+// the given level, as any native call site would. It exists for
+// BenchmarkClientLog, as cgo cannot be used within tests.
+func (c *Client) logMessage(level clientLogLevel, message string) {
+	cmsg := C.CString(message)
+	defer C.free(unsafe.Pointer(cmsg))
+	C.client_log_string(c.guacClient, C.int(level), cmsg)
+}
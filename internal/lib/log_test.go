@@ -0,0 +1,49 @@
+// Copyright 2019 Changkun Ou. All rights reserved.
+// Use of this source code is governed by a MIT
+// license that can be found in the LICENSE file.
+
+package lib
+
+import "testing"
+
+func BenchmarkClientLog(b *testing.B) {
+	cli, err := NewClient()
+	if err != nil {
+		b.Fatalf("%v", err)
+	}
+	defer cli.Close()
+	cli.InitLogLevel("debug")
+
+	b.Run("filtered", func(b *testing.B) {
+		b.ReportAllocs()
+		b.RunParallel(func(pb *testing.PB) {
+			for pb.Next() {
+				cli.logMessage(clientLogTrace, "filtered message")
+			}
+		})
+	})
+	b.Run("rate-limited", func(b *testing.B) {
+		b.ReportAllocs()
+		b.RunParallel(func(pb *testing.PB) {
+			for pb.Next() {
+				cli.logMessage(clientLogDebug, "rate limited message")
+			}
+		})
+	})
+	b.Run("info", func(b *testing.B) {
+		b.ReportAllocs()
+		b.RunParallel(func(pb *testing.PB) {
+			for pb.Next() {
+				cli.logMessage(clientLogInfo, "info message")
+			}
+		})
+	})
+	b.Run("queued", func(b *testing.B) {
+		b.ReportAllocs()
+		b.RunParallel(func(pb *testing.PB) {
+			for pb.Next() {
+				cli.logMessage(clientLogWarning, "queued message")
+			}
+		})
+	})
+}
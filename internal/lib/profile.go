@@ -0,0 +1,77 @@
+// Copyright 2019 Changkun Ou. All rights reserved.
+// Use of this source code is governed by a MIT
+// license that can be found in the LICENSE file.
+
+package lib
+
+/*
+#cgo LDFLAGS: -L/usr/local/lib -lguac
+#include <stdlib.h>
+#include "../../guacamole/src/libguac/guacamole/profile.h"
+*/
+import "C"
+import (
+	"errors"
+	"time"
+	"unsafe"
+
+	"changkun.de/x/occamy/internal/pprof"
+)
+
+// ProfileSample is a call stack of a native connection thread.
+type ProfileSample struct {
+	Session string        // ID of the client which owns the sampled thread
+	CPUTime time.Duration // CPU time consumed since the previous sample
+	Stack   []uint64      // code addresses, innermost frame first
+}
+
+// CollectProfile samples the call stacks of all native connection threads
+// at the given frequency for the given duration. Only one profile may be
+// collected at a time.
+func CollectProfile(duration time.Duration, hz int) ([]ProfileSample, error) {
+	var p *C.guac_profile_sample
+	n := int(C.guac_profile_collect(C.int(duration/time.Millisecond), C.int(hz), &p))
+	if n < 0 {
+		return nil, errors.New("occamy-lib: cannot collect native profile")
+	}
+	if n == 0 {
+		return nil, nil
+	}
+	defer C.free(unsafe.Pointer(p))
+
+	cs := (*[1 << 28]C.guac_profile_sample)(unsafe.Pointer(p))[:n:n]
+	samples := make([]ProfileSample, n)
+	for i := range cs {
+		stack := make([]uint64, int(cs[i].depth))
+		for j := range stack {
+			stack[j] = uint64(cs[i].stack[j])
+		}
+		samples[i] = ProfileSample{
+			Session: C.GoString(&cs[i].connection_id[0]),
+			CPUTime: time.Duration(cs[i].cpu_time),
+			Stack:   stack,
+		}
+	}
+	return samples, nil
+}
+
+// Symbolize resolves a code address of a profile sample to the nearest
+// preceding dynamic symbol and the shared object containing it.
+func Symbolize(addr uint64) pprof.Symbol {
+	var (
+		name *C.char
+		file *C.char
+		base C.uintptr_t
+	)
+	if C.guac_profile_symbolize(C.uintptr_t(addr), &name, &file, &base) != 0 {
+		return pprof.Symbol{}
+	}
+	sym := pprof.Symbol{Base: uint64(base)}
+	if name != nil {
+		sym.Name = C.GoString(name)
+	}
+	if file != nil {
+		sym.File = C.GoString(file)
+	}
+	return sym
+}
@@ -0,0 +1,66 @@
+// Copyright 2019 Changkun Ou. All rights reserved.
+// Use of this source code is governed by a MIT
+// license that can be found in the LICENSE file.
+
+package lib
+
+/*
+#cgo LDFLAGS: -L/usr/local/lib -lguac
+#include <stdlib.h>
+#include <string.h>
+#include "../../guacamole/src/libguac/guacamole/client.h"
+#include "../../guacamole/src/libguac/guacamole/trace.h"
+
+static void trace_write(guac_client* client, int begin, int64_t bytes) {
+	guac_trace_event(client, begin ? GUAC_TRACE_BEGIN : GUAC_TRACE_END,
+		"websocket-write", bytes);
+}
+*/
+import "C"
+import (
+	"errors"
+	"sync/atomic"
+	"unsafe"
+)
+
+// traceEnabled caches whether tracing is enabled, such that tracing calls
+// from Go need not cross into C while tracing is disabled.
+var traceEnabled int32
+
+// EnableTrace enables frame lifecycle tracing for all clients, retaining the
+// given number of most recent trace events. A size of zero disables tracing.
+func EnableTrace(size int) error {
+	if C.guac_trace_enable(C.int(size)) != 0 {
+		return errors.New("occamy-lib: cannot allocate trace buffer")
+	}
+	if size > 0 {
+		atomic.StoreInt32(&traceEnabled, 1)
+	} else {
+		atomic.StoreInt32(&traceEnabled, 0)
+	}
+	return nil
+}
+
+// DumpTrace returns all retained trace events as Chrome trace event JSON.
+func DumpTrace() ([]byte, error) {
+	json := C.guac_trace_dump()
+	if json == nil {
+		return nil, errors.New("occamy-lib: cannot allocate trace dump")
+	}
+	defer C.free(unsafe.Pointer(json))
+	return C.GoBytes(unsafe.Pointer(json), C.int(C.strlen(json))), nil
+}
+
+// TraceWrite records the beginning or end of writing the given number of
+// bytes of this client's instructions to a websocket. The beginning and end
+// must be recorded from the same OS thread.
+func (c *Client) TraceWrite(begin bool, n int) {
+	if atomic.LoadInt32(&traceEnabled) == 0 {
+		return
+	}
+	b := C.int(0)
+	if begin {
+		b = 1
+	}
+	C.trace_write(c.guacClient, b, C.int64_t(n))
+}
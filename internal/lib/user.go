@@ -13,11 +13,16 @@ package lib
 #include "../../guacamole/src/libguac/guacamole/protocol.h"
 #include "../../guacamole/src/libguac/guacamole/socket.h"
 
+void init_user_log(guac_user* user);
+
 const char *mimetypes[] = {"", NULL};
-void set_user_info(guac_user* user) {
+const char *audio_mimetypes[] = {"audio/x-ima-adpcm", NULL};
+void set_user_info(guac_user* user, int resolution) {
 	user->info.optimal_width = 1024;
 	user->info.optimal_height = 768;
-	user->info.optimal_resolution = 96;
+	user->info.optimal_resolution = resolution;
+	user->info.display_scale = 0;
+	user->info.audio_mimetypes = (const char**) audio_mimetypes;
 	user->info.video_mimetypes = (const char**) mimetypes;
 	user->info.image_mimetypes = (const char**) mimetypes;
 }
@@ -99,6 +104,15 @@ type connectInformation struct {
 	imageMimetypes    []string
 }
 
+// defaultResolution is the resolution of the user's display, in DPI, if the
+// client does not report one. Reported resolutions outside the range from
+// minResolution to maxResolution are also replaced by defaultResolution.
+const (
+	defaultResolution = 96
+	minResolution     = 48
+	maxResolution     = 480
+)
+
 // NewUser creates a user and associate the user with any specific client
 func NewUser(s *Socket, c *Client, owner bool, jwt *config.JWT) (*User, error) {
 	id := uuid.NewID("@")
@@ -111,6 +125,7 @@ func NewUser(s *Socket, c *Client, owner bool, jwt *config.JWT) (*User, error) {
 	}
 	user.socket = s.guacSocket
 	user.client = c.guacClient
+	C.init_user_log(user)
 	if owner {
 		user.owner = C.int(1)
 	} else {
@@ -135,6 +150,8 @@ func NewUser(s *Socket, c *Client, owner bool, jwt *config.JWT) (*User, error) {
 			Port:     port,
 			Username: jwt.Username,
 			Password: jwt.Password,
+
+			optimalResolution: defaultResolution,
 		},
 		client: c,
 	}, nil
@@ -159,7 +176,7 @@ const usecTimeout time.Duration = 15 * time.Millisecond
 
 func (u *User) Prepare() error {
 	// general args
-	C.set_user_info(u.guacUser)
+	C.set_user_info(u.guacUser, C.int(u.info.optimalResolution))
 
 	// client args
 	length := int(C.get_args_length(u.guacClient.args))
@@ -220,6 +237,24 @@ func (u *User) HandleConnection(done chan struct{}) {
 	close(done)
 }
 
+// SetResolution sets the resolution of the user's display, in DPI, as
+// reported by the client. It must be called before Prepare. Resolutions
+// which are missing or implausible are replaced by the default of 96 DPI.
+func (u *User) SetResolution(dpi int) {
+	if dpi < minResolution || dpi > maxResolution {
+		dpi = defaultResolution
+	}
+	u.info.optimalResolution = dpi
+}
+
+// ReportThrottle advises the plugin that output to the user is being
+// delayed by the given duration due to bandwidth limits, such that frame
+// rate and image quality are lowered until the delay elapses. A duration of
+// zero denotes that output is no longer throttled.
+func (u *User) ReportThrottle(d time.Duration) {
+	C.guac_user_report_throttle(u.guacUser, C.int(d/time.Millisecond))
+}
+
 // Stop signals the given user that it must disconnect, or advises
 // cooperating services that the given user is no longer connected.
 func (u *User) Stop() {
@@ -0,0 +1,328 @@
+// Copyright 2019 Changkun Ou. All rights reserved.
+// Use of this source code is governed by a MIT
+// license that can be found in the LICENSE file.
+
+// Package pprof writes profiles of native code in the gzip-compressed
+// protocol buffer format understood by `go tool pprof`.
+package pprof
+
+import (
+	"compress/gzip"
+	"fmt"
+	"io"
+	"sort"
+	"time"
+)
+
+// ValueType describes the type and unit of a sample value.
+type ValueType struct {
+	Type string
+	Unit string
+}
+
+// Sample is a single call stack, innermost frame first, with one value per
+// sample type of the profile.
+type Sample struct {
+	Stack  []uint64
+	Values []int64
+	Labels map[string]string
+}
+
+// Symbol describes the function and binary containing a code address.
+type Symbol struct {
+	Name string // function name, empty if unknown
+	File string // path of the containing binary, empty if unknown
+	Base uint64 // load address of the containing binary
+}
+
+// Profile is a profile of native code.
+type Profile struct {
+	SampleTypes []ValueType
+	PeriodType  ValueType
+	Period      int64
+	Time        time.Time
+	Duration    time.Duration
+	Samples     []Sample
+
+	// Symbolize resolves a code address appearing within the stack of any
+	// sample.
+	Symbolize func(addr uint64) Symbol
+}
+
+// field numbers of the profile.proto messages
+const (
+	profileSampleType    = 1
+	profileSample        = 2
+	profileMapping       = 3
+	profileLocation      = 4
+	profileFunction      = 5
+	profileStringTable   = 6
+	profileTimeNanos     = 9
+	profileDurationNanos = 10
+	profilePeriodType    = 11
+	profilePeriod        = 12
+
+	valueTypeType = 1
+	valueTypeUnit = 2
+
+	sampleLocationID = 1
+	sampleValue      = 2
+	sampleLabel      = 3
+
+	labelKey = 1
+	labelStr = 2
+
+	mappingID           = 1
+	mappingMemoryStart  = 2
+	mappingMemoryLimit  = 3
+	mappingFilename     = 5
+	mappingHasFunctions = 7
+
+	locationID        = 1
+	locationMappingID = 2
+	locationAddress   = 3
+	locationLine      = 4
+
+	lineFunctionID = 1
+
+	functionID         = 1
+	functionName       = 2
+	functionSystemName = 3
+	functionFilename   = 4
+)
+
+// Write writes the profile to w in the gzip-compressed protocol buffer
+// format.
+func (p *Profile) Write(w io.Writer) error {
+	e := &encoder{strings: map[string]int64{"": 0}, stringTable: []string{""}}
+	b := &buffer{}
+
+	for _, t := range p.SampleTypes {
+		b.message(profileSampleType, e.valueType(t))
+	}
+
+	// resolve every distinct address to a location, function and mapping
+	type mapping struct {
+		id    uint64
+		start uint64
+		limit uint64
+		file  string
+	}
+	mappings := map[string]*mapping{}
+	functions := map[Symbol]uint64{}
+	locations := map[uint64]uint64{}
+	loc := &buffer{}
+	fn := &buffer{}
+	for _, s := range p.Samples {
+		for _, addr := range s.Stack {
+			if _, ok := locations[addr]; ok {
+				continue
+			}
+			sym := Symbol{}
+			if p.Symbolize != nil {
+				sym = p.Symbolize(addr)
+			}
+
+			var mid uint64
+			if sym.File != "" {
+				m, ok := mappings[sym.File]
+				if !ok {
+					m = &mapping{id: uint64(len(mappings) + 1), start: sym.Base, limit: sym.Base + 1, file: sym.File}
+					mappings[sym.File] = m
+				}
+				if addr >= m.limit {
+					m.limit = addr + 1
+				}
+				mid = m.id
+			}
+
+			if sym.Name == "" {
+				if sym.File != "" {
+					sym.Name = fmt.Sprintf("%s+0x%x", sym.File, addr-sym.Base)
+				} else {
+					sym.Name = fmt.Sprintf("0x%x", addr)
+				}
+			}
+			key := Symbol{Name: sym.Name, File: sym.File}
+			fid, ok := functions[key]
+			if !ok {
+				fid = uint64(len(functions) + 1)
+				functions[key] = fid
+				name, file := e.string(sym.Name), e.string(sym.File)
+				fn.message(profileFunction, func(b *buffer) {
+					b.uint64(functionID, fid)
+					b.int64(functionName, name)
+					b.int64(functionSystemName, name)
+					b.int64(functionFilename, file)
+				})
+			}
+
+			lid := uint64(len(locations) + 1)
+			locations[addr] = lid
+			loc.message(profileLocation, func(b *buffer) {
+				b.uint64(locationID, lid)
+				b.uint64(locationMappingID, mid)
+				b.uint64(locationAddress, addr)
+				b.message(locationLine, func(b *buffer) {
+					b.uint64(lineFunctionID, fid)
+				})
+			})
+		}
+	}
+
+	for _, s := range p.Samples {
+		ids := make([]uint64, len(s.Stack))
+		for i, addr := range s.Stack {
+			ids[i] = locations[addr]
+		}
+		keys := make([]string, 0, len(s.Labels))
+		for k := range s.Labels {
+			keys = append(keys, k)
+		}
+		sort.Strings(keys)
+		labels := make([][2]int64, len(keys))
+		for i, k := range keys {
+			labels[i] = [2]int64{e.string(k), e.string(s.Labels[k])}
+		}
+		b.message(profileSample, func(b *buffer) {
+			b.packedUint64(sampleLocationID, ids)
+			b.packedInt64(sampleValue, s.Values)
+			for _, l := range labels {
+				b.message(sampleLabel, func(b *buffer) {
+					b.int64(labelKey, l[0])
+					b.int64(labelStr, l[1])
+				})
+			}
+		})
+	}
+
+	ms := make([]*mapping, 0, len(mappings))
+	for _, m := range mappings {
+		ms = append(ms, m)
+	}
+	sort.Slice(ms, func(i, j int) bool { return ms[i].id < ms[j].id })
+	for _, m := range ms {
+		file := e.string(m.file)
+		b.message(profileMapping, func(b *buffer) {
+			b.uint64(mappingID, m.id)
+			b.uint64(mappingMemoryStart, m.start)
+			b.uint64(mappingMemoryLimit, m.limit)
+			b.int64(mappingFilename, file)
+			b.bool(mappingHasFunctions, true)
+		})
+	}
+	b.data = append(b.data, loc.data...)
+	b.data = append(b.data, fn.data...)
+
+	b.int64(profileTimeNanos, p.Time.UnixNano())
+	b.int64(profileDurationNanos, int64(p.Duration))
+	b.message(profilePeriodType, e.valueType(p.PeriodType))
+	b.int64(profilePeriod, p.Period)
+
+	// the string table must be written last, once all strings are known
+	for _, s := range e.stringTable {
+		b.string(profileStringTable, s)
+	}
+
+	zw := gzip.NewWriter(w)
+	if _, err := zw.Write(b.data); err != nil {
+		return err
+	}
+	return zw.Close()
+}
+
+// encoder interns the strings of a profile.
+type encoder struct {
+	strings     map[string]int64
+	stringTable []string
+}
+
+func (e *encoder) string(s string) int64 {
+	if i, ok := e.strings[s]; ok {
+		return i
+	}
+	i := int64(len(e.stringTable))
+	e.strings[s] = i
+	e.stringTable = append(e.stringTable, s)
+	return i
+}
+
+func (e *encoder) valueType(t ValueType) func(b *buffer) {
+	typ, unit := e.string(t.Type), e.string(t.Unit)
+	return func(b *buffer) {
+		b.int64(valueTypeType, typ)
+		b.int64(valueTypeUnit, unit)
+	}
+}
+
+// buffer is a minimal protocol buffer writer.
+type buffer struct {
+	data []byte
+}
+
+func (b *buffer) varint(x uint64) {
+	for x >= 0x80 {
+		b.data = append(b.data, byte(x)|0x80)
+		x >>= 7
+	}
+	b.data = append(b.data, byte(x))
+}
+
+func (b *buffer) key(field int, wireType int) {
+	b.varint(uint64(field)<<3 | uint64(wireType))
+}
+
+func (b *buffer) uint64(field int, x uint64) {
+	if x == 0 {
+		return
+	}
+	b.key(field, 0)
+	b.varint(x)
+}
+
+func (b *buffer) int64(field int, x int64) {
+	b.uint64(field, uint64(x))
+}
+
+func (b *buffer) bool(field int, x bool) {
+	if x {
+		b.uint64(field, 1)
+	}
+}
+
+// string writes a string field, including empty strings, as required for
+// entries of the string table.
+func (b *buffer) string(field int, s string) {
+	b.key(field, 2)
+	b.varint(uint64(len(s)))
+	b.data = append(b.data, s...)
+}
+
+func (b *buffer) packedUint64(field int, xs []uint64) {
+	if len(xs) == 0 {
+		return
+	}
+	packed := &buffer{}
+	for _, x := range xs {
+		packed.varint(x)
+	}
+	b.key(field, 2)
+	b.varint(uint64(len(packed.data)))
+	b.data = append(b.data, packed.data...)
+}
+
+func (b *buffer) packedInt64(field int, xs []int64) {
+	us := make([]uint64, len(xs))
+	for i, x := range xs {
+		us[i] = uint64(x)
+	}
+	b.packedUint64(field, us)
+}
+
+func (b *buffer) message(field int, fill func(b *buffer)) {
+	m := &buffer{}
+	fill(m)
+	b.key(field, 2)
+	b.varint(uint64(len(m.data)))
+	b.data = append(b.data, m.data...)
+}
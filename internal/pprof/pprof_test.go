@@ -0,0 +1,205 @@
+// Copyright 2019 Changkun Ou. All rights reserved.
+// Use of this source code is governed by a MIT
+// license that can be found in the LICENSE file.
+
+package pprof_test
+
+import (
+	"bytes"
+	"compress/gzip"
+	"encoding/binary"
+	"fmt"
+	"io/ioutil"
+	"testing"
+	"time"
+
+	"changkun.de/x/occamy/internal/pprof"
+)
+
+func TestProfile_Write(t *testing.T) {
+	p := &pprof.Profile{
+		SampleTypes: []pprof.ValueType{{Type: "cpu", Unit: "nanoseconds"}},
+		PeriodType:  pprof.ValueType{Type: "cpu", Unit: "nanoseconds"},
+		Period:      int64(10 * time.Millisecond),
+		Time:        time.Now(),
+		Duration:    time.Second,
+		Samples: []pprof.Sample{
+			{Stack: []uint64{0x1010, 0x2020}, Values: []int64{10}, Labels: map[string]string{"session": "$abc"}},
+			{Stack: []uint64{0x1010, 0x3030}, Values: []int64{20}, Labels: map[string]string{"session": "$abc"}},
+		},
+		Symbolize: func(addr uint64) pprof.Symbol {
+			switch addr {
+			case 0x1010:
+				return pprof.Symbol{Name: "guac_png_write", File: "libguac.so", Base: 0x1000}
+			case 0x2020:
+				return pprof.Symbol{File: "libguac.so", Base: 0x1000}
+			}
+			return pprof.Symbol{}
+		},
+	}
+
+	var buf bytes.Buffer
+	if err := p.Write(&buf); err != nil {
+		t.Fatalf("write profile failed: %v", err)
+	}
+	zr, err := gzip.NewReader(&buf)
+	if err != nil {
+		t.Fatalf("profile is not gzip-compressed: %v", err)
+	}
+	raw, err := ioutil.ReadAll(zr)
+	if err != nil {
+		t.Fatalf("read profile failed: %v", err)
+	}
+
+	// resolve every sample back to function names through the decoded
+	// string, function and location tables
+	prof := decode(t, raw)
+	var strs []string
+	for _, v := range prof[6] {
+		strs = append(strs, string(v.([]byte)))
+	}
+	str := func(i uint64) string {
+		if i >= uint64(len(strs)) {
+			t.Fatalf("string index %d out of range", i)
+		}
+		return strs[i]
+	}
+	functions := map[uint64]string{}
+	for _, f := range prof.messages(t, 5) {
+		functions[f.uint(1)] = str(f.uint(2))
+	}
+	locations := map[uint64]string{}
+	for _, l := range prof.messages(t, 4) {
+		lines := l.messages(t, 4)
+		if len(lines) != 1 {
+			t.Fatalf("location %d has %d lines, want 1", l.uint(1), len(lines))
+		}
+		locations[l.uint(1)] = functions[lines[0].uint(1)]
+	}
+
+	types := prof.messages(t, 1)
+	if len(types) != 1 || str(types[0].uint(1)) != "cpu" || str(types[0].uint(2)) != "nanoseconds" {
+		t.Errorf("wrong sample types")
+	}
+	if got := prof.uint(12); got != uint64(p.Period) {
+		t.Errorf("wrong period, got %d, want %d", got, p.Period)
+	}
+
+	want := []struct {
+		stack []string
+		value uint64
+	}{
+		{[]string{"guac_png_write", "libguac.so+0x1020"}, 10},
+		{[]string{"guac_png_write", "0x3030"}, 20},
+	}
+	samples := prof.messages(t, 2)
+	if len(samples) != len(want) {
+		t.Fatalf("wrong number of samples, got %d, want %d", len(samples), len(want))
+	}
+	for i, s := range samples {
+		var stack []string
+		for _, id := range s.packed(t, 1) {
+			stack = append(stack, locations[id])
+		}
+		if fmt.Sprint(stack) != fmt.Sprint(want[i].stack) {
+			t.Errorf("sample %d: wrong stack, got %v, want %v", i, stack, want[i].stack)
+		}
+		if values := s.packed(t, 2); len(values) != 1 || values[0] != want[i].value {
+			t.Errorf("sample %d: wrong values, got %v, want [%d]", i, values, want[i].value)
+		}
+		labels := s.messages(t, 3)
+		if len(labels) != 1 || str(labels[0].uint(1)) != "session" || str(labels[0].uint(2)) != "$abc" {
+			t.Errorf("sample %d: wrong labels", i)
+		}
+	}
+
+	mappings := prof.messages(t, 3)
+	if len(mappings) != 1 || str(mappings[0].uint(5)) != "libguac.so" {
+		t.Errorf("wrong mappings")
+	} else if start, limit := mappings[0].uint(2), mappings[0].uint(3); start != 0x1000 || limit <= 0x2020 {
+		t.Errorf("wrong mapping range, got [%#x, %#x)", start, limit)
+	}
+}
+
+// message is a decoded protocol buffer message, mapping each field number to
+// its values in order of appearance: varints as uint64 and length-delimited
+// fields as []byte.
+type message map[int][]interface{}
+
+func decode(t *testing.T, data []byte) message {
+	t.Helper()
+	m := message{}
+	for len(data) > 0 {
+		key, n := binary.Uvarint(data)
+		if n <= 0 {
+			t.Fatal("malformed field key")
+		}
+		data = data[n:]
+		field := int(key >> 3)
+		switch key & 7 {
+		case 0:
+			v, n := binary.Uvarint(data)
+			if n <= 0 {
+				t.Fatalf("field %d: malformed varint", field)
+			}
+			data = data[n:]
+			m[field] = append(m[field], v)
+		case 2:
+			l, n := binary.Uvarint(data)
+			if n <= 0 || l > uint64(len(data)-n) {
+				t.Fatalf("field %d: malformed length", field)
+			}
+			m[field] = append(m[field], data[n:n+int(l)])
+			data = data[n+int(l):]
+		default:
+			t.Fatalf("field %d: unexpected wire type %d", field, key&7)
+		}
+	}
+	return m
+}
+
+// uint returns the first varint of the given field, or zero if absent.
+func (m message) uint(field int) uint64 {
+	for _, v := range m[field] {
+		if x, ok := v.(uint64); ok {
+			return x
+		}
+	}
+	return 0
+}
+
+// packed returns all varints of the given field, whether packed or not.
+func (m message) packed(t *testing.T, field int) []uint64 {
+	t.Helper()
+	var xs []uint64
+	for _, v := range m[field] {
+		switch v := v.(type) {
+		case uint64:
+			xs = append(xs, v)
+		case []byte:
+			for len(v) > 0 {
+				x, n := binary.Uvarint(v)
+				if n <= 0 {
+					t.Fatalf("field %d: malformed packed varint", field)
+				}
+				xs = append(xs, x)
+				v = v[n:]
+			}
+		}
+	}
+	return xs
+}
+
+// messages decodes all embedded messages of the given field.
+func (m message) messages(t *testing.T, field int) []message {
+	t.Helper()
+	var ms []message
+	for _, v := range m[field] {
+		b, ok := v.([]byte)
+		if !ok {
+			t.Fatalf("field %d: not a message", field)
+		}
+		ms = append(ms, decode(t, b))
+	}
+	return ms
+}
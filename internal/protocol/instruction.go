@@ -37,6 +37,23 @@ func NewInstruction(elements []string) *Instruction {
 
 // ParseInstruction parses an instruction: 1.a,2.bc,3.def,10.abcdefghij;
 func ParseInstruction(raw []byte) (ins *Instruction, err error) {
+	elements, err := parseElements(raw, -1)
+	if err != nil {
+		return nil, err
+	}
+	return NewInstruction(elements), nil
+}
+
+// ParseInstructionHead parses at most n leading elements of an instruction,
+// such as its opcode and stream index, without decoding the remaining
+// elements, which may be large.
+func ParseInstructionHead(raw []byte, n int) ([]string, error) {
+	return parseElements(raw, n)
+}
+
+// parseElements parses at most max elements of an instruction, or all
+// elements if max is negative.
+func parseElements(raw []byte, max int) ([]string, error) {
 	var (
 		cursor   int
 		elements []string
@@ -75,7 +92,7 @@ func ParseInstruction(raw []byte) (ins *Instruction, err error) {
 		elements = append(elements, element.String())
 
 		// 3. done
-		if cursor == bytes-1 {
+		if cursor == bytes-1 || len(elements) == max {
 			break
 		}
 
@@ -87,7 +104,7 @@ func ParseInstruction(raw []byte) (ins *Instruction, err error) {
 		cursor++
 	}
 
-	return NewInstruction(elements), nil
+	return elements, nil
 }
 
 func (i Instruction) String() string {
@@ -33,6 +33,40 @@ func TestNewInstruction(t *testing.T) {
 	}
 }
 
+func TestParseInstructionHead(t *testing.T) {
+	tests := []struct {
+		raw  string
+		n    int
+		want []string
+	}{
+		{"4.blob,1.3,8.AAECAwQF;", 2, []string{"blob", "3"}},
+		{"5.audio,1.0,17.audio/x-ima-adpcm;", 1, []string{"audio"}},
+		{"3.end,2.12;", 3, []string{"end", "12"}},
+		{"5.hello,2.世界;", 2, []string{"hello", "世界"}},
+	}
+	for _, tt := range tests {
+		got, err := protocol.ParseInstructionHead([]byte(tt.raw), tt.n)
+		if err != nil {
+			t.Errorf("parse instruction head of %s error: %v", tt.raw, err)
+			continue
+		}
+		if len(got) != len(tt.want) {
+			t.Errorf("parse instruction head of %s, got: %v", tt.raw, got)
+			continue
+		}
+		for i := range got {
+			if got[i] != tt.want[i] {
+				t.Errorf("parse instruction head of %s, got: %v", tt.raw, got)
+				break
+			}
+		}
+	}
+
+	if _, err := protocol.ParseInstructionHead([]byte("4blob;"), 1); err == nil {
+		t.Error("parse instruction head without dot should fail")
+	}
+}
+
 func TestNewInstructionIO(t *testing.T) {
 	raw := "5.hello,2.世界;"
 
@@ -11,10 +11,14 @@ import (
 	"net/http/pprof"
 	"os"
 	"os/signal"
+	"strconv"
 	"sync"
 	"time"
 
+	"changkun.de/x/occamy/internal/bandwidth"
 	"changkun.de/x/occamy/internal/config"
+	"changkun.de/x/occamy/internal/lib"
+	native "changkun.de/x/occamy/internal/pprof"
 	"changkun.de/x/occamy/internal/protocol"
 	jwt "github.com/appleboy/gin-jwt/v2"
 	"github.com/gin-gonic/gin"
@@ -27,8 +31,10 @@ func init() {
 
 // Run is an export method that serves occamy proxy
 func Run() {
+	bw := config.Runtime.Bandwidth
 	proxy := &proxy{
 		sessions: make(map[string]*Session),
+		tenants:  bandwidth.NewRegistry(bw.Tenant, bw.Burst),
 		upgrader: &websocket.Upgrader{
 			ReadBufferSize:  protocol.MaxInstructionLength,
 			WriteBufferSize: protocol.MaxInstructionLength,
@@ -47,6 +53,7 @@ type proxy struct {
 
 	mu       sync.Mutex
 	sessions map[string]*Session
+	tenants  *bandwidth.Registry // output limits shared by sessions of a tenant
 }
 
 func (p *proxy) serve() {
@@ -93,6 +100,12 @@ func (p *proxy) routers() *gin.Engine {
 	if gin.Mode() == gin.DebugMode {
 		p.profile()
 	}
+	if config.Runtime.Trace > 0 {
+		p.trace()
+	}
+	if config.Runtime.Profile {
+		p.nativeProfile()
+	}
 	return p.engine
 }
 
@@ -168,3 +181,92 @@ func (p *proxy) profile() {
 		r.GET("/threadcreate", pprofHandler(pprof.Handler("threadcreate").ServeHTTP))
 	}
 }
+
+// trace enables frame lifecycle tracing and serves the most recent trace
+// events in the Chrome trace event format, which can be loaded into
+// chrome://tracing or https://ui.perfetto.dev. As events expose session IDs,
+// they require a valid JWT:
+//
+//   wget -O frames.json "http://0.0.0.0:5636/debug/trace?token=$JWT"
+//
+func (p *proxy) trace() {
+	err := lib.EnableTrace(config.Runtime.Trace)
+	if err != nil {
+		log.Printf("enable tracing failed: %v", err)
+		return
+	}
+	p.engine.GET("/debug/trace", p.jwtm.MiddlewareFunc(), func(c *gin.Context) {
+		events, err := lib.DumpTrace()
+		if err != nil {
+			c.String(http.StatusInternalServerError, err.Error())
+			return
+		}
+		c.Data(http.StatusOK, "application/json", events)
+	})
+}
+
+// nativeProfile serves CPU profiles of the native threads of all connections,
+// which remain available in release mode. As profiles expose session IDs and
+// pin the sampler for their duration, they require a valid JWT. Samples are
+// labeled with the session and protocol of the sampled thread, and can be
+// filtered using pprof's -tagfocus flag:
+//
+//   go tool pprof -tagfocus protocol=rdp \
+//     "http://0.0.0.0:5636/debug/native/profile?seconds=30&hz=100&token=$JWT"
+//
+func (p *proxy) nativeProfile() {
+	r := p.engine.Group("/debug/native", p.jwtm.MiddlewareFunc())
+	r.GET("/profile", func(c *gin.Context) {
+		seconds, err := strconv.Atoi(c.DefaultQuery("seconds", "30"))
+		if err != nil || seconds <= 0 {
+			seconds = 30
+		}
+		hz, err := strconv.Atoi(c.DefaultQuery("hz", "100"))
+		if err != nil || hz <= 0 || hz > 1000 {
+			hz = 100
+		}
+
+		start := time.Now()
+		samples, err := lib.CollectProfile(time.Duration(seconds)*time.Second, hz)
+		if err != nil {
+			c.String(http.StatusServiceUnavailable, err.Error())
+			return
+		}
+
+		protocols := make(map[string]string)
+		p.mu.Lock()
+		for _, s := range p.sessions {
+			protocols[s.ID] = s.Protocol
+		}
+		p.mu.Unlock()
+
+		prof := &native.Profile{
+			SampleTypes: []native.ValueType{
+				{Type: "samples", Unit: "count"},
+				{Type: "cpu", Unit: "nanoseconds"},
+			},
+			PeriodType: native.ValueType{Type: "cpu", Unit: "nanoseconds"},
+			Period:     int64(time.Second) / int64(hz),
+			Time:       start,
+			Duration:   time.Since(start),
+			Symbolize:  lib.Symbolize,
+		}
+		for _, s := range samples {
+			prof.Samples = append(prof.Samples, native.Sample{
+				Stack:  s.Stack,
+				Values: []int64{1, int64(s.CPUTime)},
+				Labels: map[string]string{
+					"session":  s.Session,
+					"protocol": protocols[s.Session],
+				},
+			})
+		}
+
+		c.Header("Content-Disposition", `attachment; filename="native.pb.gz"`)
+		c.Header("Content-Type", "application/octet-stream")
+		c.Status(http.StatusOK)
+		if err := prof.Write(c.Writer); err != nil {
+			log.Printf("write native profile failed: %v", err)
+		}
+	})
+}
@@ -7,6 +7,7 @@ package server
 import (
 	"log"
 	"net/http"
+	"strconv"
 
 	"changkun.de/x/occamy/internal/config"
 	jwt "github.com/appleboy/gin-jwt/v2"
@@ -30,7 +31,10 @@ func (p *proxy) serveWS(c *gin.Context) {
 		Username: claims["username"].(string),
 		Password: claims["password"].(string),
 	}
-	err = p.routeConn(ws, jwt)
+	// resolution of the user's display, reported by the client, if any
+	dpi, _ := strconv.Atoi(c.Query("dpi"))
+
+	err = p.routeConn(ws, jwt, dpi)
 	if err != nil {
 		log.Printf("route connection failed: %v", err)
 		ws.WriteMessage(websocket.CloseMessage, []byte(err.Error()))
@@ -38,11 +42,11 @@ func (p *proxy) serveWS(c *gin.Context) {
 	ws.Close()
 }
 
-func (p *proxy) routeConn(ws *websocket.Conn, jwt *config.JWT) (err error) {
+func (p *proxy) routeConn(ws *websocket.Conn, jwt *config.JWT, dpi int) (err error) {
 	p.mu.Lock()
 	s, ok := p.sessions[jwt.GenerateID()]
 	if ok {
-		err = s.Join(ws, jwt, false, func() { p.mu.Unlock() })
+		err = s.Join(ws, jwt, dpi, false, func() { p.mu.Unlock() })
 		return
 	}
 
@@ -52,9 +56,13 @@ func (p *proxy) routeConn(ws *websocket.Conn, jwt *config.JWT) (err error) {
 		return
 	}
 
+	// sessions of the same remote user of the same host share the tenant
+	// limit for as long as any of their users remain connected
+	s.acquireTenant(p.tenants, jwt.Username+"@"+jwt.Host)
+
 	p.sessions[jwt.GenerateID()] = s
 	log.Printf("new session was created: %s", s.ID)
-	err = s.Join(ws, jwt, true, func() { p.mu.Unlock() }) // block here
+	err = s.Join(ws, jwt, dpi, true, func() { p.mu.Unlock() }) // block here
 
 	p.mu.Lock()
 	delete(p.sessions, jwt.GenerateID())
@@ -5,13 +5,16 @@
 package server
 
 import (
+	"bytes"
 	"fmt"
 	"log"
 	"runtime"
 	"sync"
 	"sync/atomic"
 	"syscall"
+	"time"
 
+	"changkun.de/x/occamy/internal/bandwidth"
 	"changkun.de/x/occamy/internal/config"
 	"changkun.de/x/occamy/internal/lib"
 	"changkun.de/x/occamy/internal/protocol"
@@ -22,9 +25,14 @@ import (
 // within an user group
 type Session struct {
 	ID             string
+	Protocol       string
 	connectedUsers uint64
 	once           sync.Once
-	client         *lib.Client // shared client in a session
+	client         *lib.Client       // shared client in a session
+	bucket         *bandwidth.Bucket // output limit of the session
+	tenant         *bandwidth.Bucket // output limit shared with the tenant
+	tenants        *bandwidth.Registry
+	tenantKey      string
 }
 
 // NewSession creates a new occamy proxy session
@@ -36,7 +44,12 @@ func NewSession(proto string) (*Session, error) {
 		return nil, fmt.Errorf("occamy-lib: new client error: %w", err)
 	}
 
-	s := &Session{client: cli}
+	bw := config.Runtime.Bandwidth
+	s := &Session{
+		client:   cli,
+		Protocol: proto,
+		bucket:   bandwidth.NewBucket(bw.Session, bw.Burst),
+	}
 	s.client.InitLogLevel(config.Runtime.Mode)
 	err = s.client.LoadProtocolPlugin(proto)
 	if err != nil {
@@ -50,8 +63,9 @@ func NewSession(proto string) (*Session, error) {
 // Join adds the given socket as a new user to the given process, automatically
 // reading/writing from the socket via read/write threads. The given socket,
 // parser, and any associated resources will be freed unless the user is not
-// added successfully.
-func (s *Session) Join(ws *websocket.Conn, jwt *config.JWT, owner bool, unlock func()) error {
+// added successfully. The resolution of the user's display, in DPI, is given
+// by dpi, or is zero if the client did not report one.
+func (s *Session) Join(ws *websocket.Conn, jwt *config.JWT, dpi int, owner bool, unlock func()) error {
 	defer s.close()
 	lib.ResetErrors()
 
@@ -75,6 +89,7 @@ func (s *Session) Join(ws *websocket.Conn, jwt *config.JWT, owner bool, unlock f
 		return fmt.Errorf("occamy-lib: create guac user error: %w", err)
 	}
 	defer u.Close()
+	u.SetResolution(dpi)
 
 	// 4. count new user
 	atomic.AddUint64(&s.connectedUsers, 1)
@@ -96,39 +111,92 @@ func (s *Session) Join(ws *websocket.Conn, jwt *config.JWT, owner bool, unlock f
 	conn := protocol.NewInstructionIO(fds[1])
 	defer conn.Close()
 
-	err = s.serveIO(conn, ws)
+	err = s.serveIO(conn, ws, u)
 	<-done
 	return err
 }
 
-// Close closes a session.
+// acquireTenant acquires the output limit shared by all sessions of the
+// given tenant. The limit is released once the session is closed.
+func (s *Session) acquireTenant(r *bandwidth.Registry, key string) {
+	s.tenants = r
+	s.tenantKey = key
+	s.tenant = r.Acquire(key)
+}
+
+// Close closes a session once its last user has left, releasing its tenant.
 func (s *Session) close() {
 	if atomic.LoadUint64(&s.connectedUsers) > 0 {
 		return
 	}
-	s.client.Close()
+	s.once.Do(func() {
+		if s.tenants != nil {
+			s.tenants.Release(s.tenantKey)
+		}
+		s.client.Close()
+	})
 }
 
-func (s *Session) serveIO(conn *protocol.InstructionIO, ws *websocket.Conn) (err error) {
+// throttle waits until the given number of bytes may be written within the
+// bandwidth limits of the session and its tenant, reporting any delay to the
+// given user. It returns false if the queue is stopped while waiting.
+func (s *Session) throttle(u *lib.User, out *outputQueue, n int, throttled *bool) bool {
+	now := time.Now()
+	wait := s.bucket.Reserve(n, now)
+	if w := s.tenant.Reserve(n, now); w > wait {
+		wait = w
+	}
+	if wait == 0 {
+		if *throttled {
+			u.ReportThrottle(0)
+			*throttled = false
+		}
+		return true
+	}
+	u.ReportThrottle(wait)
+	*throttled = true
+	return out.wait(wait)
+}
+
+func (s *Session) serveIO(conn *protocol.InstructionIO, ws *websocket.Conn, u *lib.User) (err error) {
 	wg := sync.WaitGroup{}
 	exit := make(chan error, 2)
-	wg.Add(2)
-	go func(conn *protocol.InstructionIO, ws *websocket.Conn) {
-		var err error
+	out := newOutputQueue()
+	wg.Add(3)
+	go func(conn *protocol.InstructionIO) {
 		for {
 			raw, err := conn.ReadRaw()
-			if err != nil {
+			if err != nil || !out.push(raw) {
+				break
+			}
+		}
+		out.close()
+		wg.Done()
+	}(conn)
+	go func(ws *websocket.Conn) {
+		// trace spans must begin and end on the same thread
+		runtime.LockOSThread()
+		defer runtime.UnlockOSThread()
+
+		var err error
+		throttled := false
+		for {
+			raw, ok := out.pop()
+			if !ok || !s.throttle(u, out, len(raw), &throttled) {
 				break
 			}
+			s.client.TraceWrite(true, len(raw))
 			err = ws.WriteMessage(websocket.TextMessage, raw)
+			s.client.TraceWrite(false, len(raw))
 			if err != nil {
 				break
 			}
 		}
+		out.stop()
 		exit <- err
 		log.Println("reading from desktop terminated.")
 		wg.Done()
-	}(conn, ws)
+	}(ws)
 	go func(conn *protocol.InstructionIO, ws *websocket.Conn) {
 		var err error
 		for {
@@ -147,7 +215,171 @@ func (s *Session) serveIO(conn *protocol.InstructionIO, ws *websocket.Conn) (err
 	}(conn, ws)
 	err = <-exit
 	conn.Close()
+	out.stop()
 	wg.Wait()
 	log.Println("IO goroutines are terminated.")
 	return
 }
+
+// outputQueue queues instructions read from the desktop until they are
+// written to the websocket. Instructions of audio streams have their own
+// priority class and are always written before any other queued
+// instruction, such that audio never waits behind image data. The relative
+// order of instructions within each class is preserved.
+//
+// Audio streams share their indexes with all other streams. An audio stream
+// whose index is reused while an earlier stream of that index still has
+// queued instructions is written in order with all other instructions, such
+// that the client never sees the instructions of both streams interleaved.
+type outputQueue struct {
+	audio   chan []byte
+	bulk    chan []byte
+	done    chan struct{}
+	once    sync.Once
+	streams map[string]bool // indexes of open audio streams
+
+	mu   sync.Mutex
+	ends map[string]int // number of queued bulk ends of each stream index
+}
+
+// the maximum number of queued instructions of each class; once full,
+// reading from the desktop blocks, applying backpressure to the plugin
+const (
+	outputAudioQueueSize = 64
+	outputBulkQueueSize  = 256
+)
+
+func newOutputQueue() *outputQueue {
+	return &outputQueue{
+		audio:   make(chan []byte, outputAudioQueueSize),
+		bulk:    make(chan []byte, outputBulkQueueSize),
+		done:    make(chan struct{}),
+		streams: map[string]bool{},
+		ends:    map[string]int{},
+	}
+}
+
+// isAudio reports whether the given instruction belongs to an audio stream,
+// tracking audio streams as they are opened and closed. It must only be
+// called from the goroutine pushing instructions.
+func (q *outputQueue) isAudio(raw []byte) bool {
+	head, err := protocol.ParseInstructionHead(raw, 2)
+	if err != nil || len(head) < 2 {
+		return false
+	}
+	switch head[0] {
+	case "audio":
+		// every stream ends before its index is reused, thus a queued end
+		// follows all queued instructions of an earlier stream
+		q.mu.Lock()
+		pending := q.ends[head[1]] > 0
+		q.mu.Unlock()
+		if pending {
+			return false
+		}
+		q.streams[head[1]] = true
+		return true
+	case "blob":
+		return q.streams[head[1]]
+	case "end":
+		if q.streams[head[1]] {
+			delete(q.streams, head[1])
+			return true
+		}
+		q.mu.Lock()
+		q.ends[head[1]]++
+		q.mu.Unlock()
+	}
+	return false
+}
+
+// popped accounts for the given instruction being popped from the bulk
+// class.
+func (q *outputQueue) popped(raw []byte) {
+	if !bytes.HasPrefix(raw, []byte("3.end,")) {
+		return
+	}
+	head, err := protocol.ParseInstructionHead(raw, 2)
+	if err != nil || len(head) < 2 {
+		return
+	}
+	q.mu.Lock()
+	if q.ends[head[1]]--; q.ends[head[1]] <= 0 {
+		delete(q.ends, head[1])
+	}
+	q.mu.Unlock()
+}
+
+// push queues the given instruction, blocking while its class is full. It
+// returns false if the queue has been stopped.
+func (q *outputQueue) push(raw []byte) bool {
+	ch := q.bulk
+	if q.isAudio(raw) {
+		ch = q.audio
+	}
+	select {
+	case ch <- raw:
+		return true
+	case <-q.done:
+		return false
+	}
+}
+
+// close signals that no further instructions will be pushed. Instructions
+// already queued may still be popped.
+func (q *outputQueue) close() {
+	close(q.audio)
+	close(q.bulk)
+}
+
+// stop discards all queued instructions, unblocking any pending push or
+// pop.
+func (q *outputQueue) stop() {
+	q.once.Do(func() { close(q.done) })
+}
+
+// wait sleeps for the given duration. It returns false if the queue is
+// stopped before the duration elapses.
+func (q *outputQueue) wait(d time.Duration) bool {
+	t := time.NewTimer(d)
+	defer t.Stop()
+	select {
+	case <-t.C:
+		return true
+	case <-q.done:
+		return false
+	}
+}
+
+// pop returns the next instruction to write, preferring queued audio. It
+// returns false once the queue is closed and drained, or once stopped.
+func (q *outputQueue) pop() ([]byte, bool) {
+	audio, bulk := q.audio, q.bulk
+	for audio != nil || bulk != nil {
+		select {
+		case raw, ok := <-audio:
+			if ok {
+				return raw, true
+			}
+			audio = nil
+			continue
+		default:
+		}
+		select {
+		case raw, ok := <-audio:
+			if ok {
+				return raw, true
+			}
+			audio = nil
+		case raw, ok := <-bulk:
+			if ok {
+				q.popped(raw)
+				return raw, true
+			}
+			bulk = nil
+		case <-q.done:
+			return nil, false
+		}
+	}
+	return nil, false
+}